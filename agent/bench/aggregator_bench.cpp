@@ -0,0 +1,35 @@
+#include "metrics_aggregator.h"
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <string>
+
+namespace {
+SystemMetrics sized_sample() {
+    SystemMetrics metrics{};
+    metrics.per_core_cpu_percent.assign(32, 12.5);
+    for (int pid = 1000; pid < 1012; ++pid) {
+        metrics.top_processes.push_back(ProcessMetrics{pid, "worker-" + std::to_string(pid), 4.2, 512.75, 8, 1.5, 0.25, 40});
+    }
+    metrics.fresh_families = kMetricFamilyAll;
+    return metrics;
+}
+}  // namespace
+
+TEST_CASE("Rolling window aggregation", "[benchmark][aggregate]") {
+    SystemMetrics sample = sized_sample();
+    SystemMetrics summary{};
+
+    // 8 samples per window, e.g. 250 ms sampling uploaded every 2 s; every
+    // eighth add also writes the summary.
+    MetricsAggregator aggregator(8, 12);
+    for (int warm_up = 0; warm_up < 16; ++warm_up) {
+        aggregator.add(sample, summary);
+    }
+
+    BENCHMARK("MetricsAggregator::add, 32 cores, 12 processes") {
+        sample.total_cpu_percent += 0.5;
+        return aggregator.add(sample, summary);
+    };
+}
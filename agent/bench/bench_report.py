@@ -0,0 +1,84 @@
+#!/usr/bin/env python3
+"""Converts metrics_agent_bench XML results to JSON and compares two runs.
+
+    bench_report.py results.xml -o results.json
+    bench_report.py results.xml -o results.json --baseline previous.json --threshold 0.10
+
+Catch2's XML reporter is the one that carries full benchmark statistics;
+this flattens them into one JSON object per benchmark, keyed by test case
+and benchmark name, with times in nanoseconds. With --baseline, benchmarks
+whose mean grew by more than --threshold are listed and the exit status is 1.
+"""
+
+import argparse
+import json
+import sys
+import xml.etree.ElementTree as ElementTree
+
+
+def parse_results(path):
+        root = ElementTree.parse(path).getroot()
+        benchmarks = []
+        for test_case in root.iter("TestCase"):
+                for result in test_case.iter("BenchmarkResults"):
+                        mean = result.find("mean")
+                        deviation = result.find("standardDeviation")
+                        benchmarks.append({
+                                "test_case": test_case.get("name"),
+                                "name": result.get("name"),
+                                "samples": int(result.get("samples", 0)),
+                                "iterations": int(result.get("iterations", 0)),
+                                "mean_ns": float(mean.get("value")),
+                                "mean_low_ns": float(mean.get("lowerBound")),
+                                "mean_high_ns": float(mean.get("upperBound")),
+                                "std_dev_ns": float(deviation.get("value")),
+                        })
+        return benchmarks
+
+
+def find_regressions(current, baseline, threshold):
+        previous = {(item["test_case"], item["name"]): item for item in baseline}
+        regressions = []
+        for item in current:
+                before = previous.get((item["test_case"], item["name"]))
+                if before is None or before["mean_ns"] <= 0:
+                        continue
+                change = item["mean_ns"] / before["mean_ns"] - 1.0
+                if change > threshold:
+                        regressions.append((item, before, change))
+        return regressions
+
+
+def main():
+        parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+        parser.add_argument("results", help="XML written by metrics_agent_bench --reporter XML")
+        parser.add_argument("-o", "--output", help="JSON file to write (default: stdout)")
+        parser.add_argument("--baseline", help="JSON written by an earlier run of this script")
+        parser.add_argument("--threshold", type=float, default=0.10, help="allowed relative mean increase (default: 0.10)")
+        args = parser.parse_args()
+
+        benchmarks = parse_results(args.results)
+        document = json.dumps({"benchmarks": benchmarks}, indent=2)
+        if args.output:
+                with open(args.output, "w", encoding="utf-8") as out:
+                        out.write(document + "\n")
+        else:
+                print(document)
+
+        if not args.baseline:
+                return 0
+
+        with open(args.baseline, encoding="utf-8") as baseline_file:
+                baseline = json.load(baseline_file)["benchmarks"]
+        regressions = find_regressions(benchmarks, baseline, args.threshold)
+        for item, before, change in regressions:
+                print(
+                        f"regression: {item['test_case']} / {item['name']}: "
+                        f"{before['mean_ns']:.0f} ns -> {item['mean_ns']:.0f} ns (+{change:.0%})",
+                        file=sys.stderr,
+                )
+        return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+        sys.exit(main())
@@ -0,0 +1,62 @@
+#include "agent_config.h"
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <regex>
+#include <string>
+
+namespace {
+// Every key the loader reads, as in the README example.
+const char* const kKeys[] = {
+    "backend_url", "backend_enabled", "interval_seconds", "interval_ms", "cpu_interval_ms", "memory_interval_ms",
+    "process_interval_ms", "upload_interval_ms", "queue_capacity", "collector_threads", "top_n", "proc_root",
+    "process_events", "proc_io_uring", "cgroup_root", "batch_max_items", "batch_max_bytes", "wire_format",
+    "compression", "delta_uploads", "delta_keyframe_interval", "delta_cpu_deadband_percent",
+    "delta_memory_deadband_mb", "log_level", "connect_timeout_ms", "request_timeout_ms", "retry_max_attempts",
+    "retry_base_delay_ms", "retry_max_delay_ms", "breaker_failure_threshold", "breaker_open_ms",
+    "breaker_max_open_ms", "spool_dir", "spool_max_bytes", "spool_segment_bytes", "spool_replay_items",
+    "metrics_listen_port", "metrics_listen_address", "telemetry_log_interval_ms", "total_cpu", "per_core_cpu",
+    "system_memory", "top_processes", "process_threads", "process_io", "process_handles", "top_cgroups"};
+
+std::string example_yaml() {
+    std::string document;
+    for (const char* key : kKeys) {
+        document.append(key).append(": 1\n");
+    }
+    return document;
+}
+
+/**
+ * Pre-change lookup of agent_config.cpp: up to three patterns compiled and
+ * searched over the whole document per key, kept here as the benchmark
+ * baseline.
+ */
+size_t legacy_regex_lookup(const std::string& content) {
+    size_t found = 0;
+    for (const char* key : kKeys) {
+        const std::string name(key);
+        std::smatch match;
+        if (std::regex_search(content, match, std::regex("\"" + name + "\"\\s*:\\s*\"([^\"]*)\"")) ||
+            std::regex_search(content, match, std::regex("\"" + name + "\"\\s*:\\s*([^,}\\n]+)")) ||
+            std::regex_search(content, match, std::regex("(^|\\n)\\s*" + name + "\\s*:\\s*([^\\n#]+)"))) {
+            ++found;
+        }
+    }
+    return found;
+}
+}  // namespace
+
+TEST_CASE("Config file loading", "[benchmark][config]") {
+    const std::string document = example_yaml();
+
+    BENCHMARK("legacy std::regex lookup, 47 YAML keys") {
+        return legacy_regex_lookup(document);
+    };
+
+    BENCHMARK("parse_agent_config, 47 YAML keys") {
+        AgentConfig config = AgentConfig::defaults();
+        std::string error;
+        return parse_agent_config(document, config, error);
+    };
+}
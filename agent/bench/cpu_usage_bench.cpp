@@ -0,0 +1,80 @@
+#include "cpu_usage.h"
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace {
+constexpr size_t kCores = 192;
+
+struct LegacyCpuTimes {
+    uint64_t idle_time;
+    uint64_t total_time;
+};
+
+/**
+ * Pre-change per-core loop of MetricsCollector::get_per_core_cpu, kept here
+ * as the benchmark baseline.
+ */
+void legacy_per_core_cpu(const std::vector<LegacyCpuTimes>& previous_core_times,
+                         const std::vector<LegacyCpuTimes>& current_core_times, std::vector<double>& per_core_cpu) {
+    per_core_cpu.clear();
+    const size_t core_count = std::min(previous_core_times.size(), current_core_times.size());
+    per_core_cpu.reserve(core_count);
+    for (size_t index = 0; index < core_count; ++index) {
+        const auto& previous = previous_core_times[index];
+        const auto& current = current_core_times[index];
+
+        const uint64_t total_delta =
+            (current.total_time > previous.total_time) ? (current.total_time - previous.total_time) : 0;
+        const uint64_t idle_delta =
+            (current.idle_time > previous.idle_time) ? (current.idle_time - previous.idle_time) : 0;
+
+        double usage = 0.0;
+        if (total_delta > 0) {
+            usage = (static_cast<double>(total_delta - std::min(total_delta, idle_delta)) /
+                     static_cast<double>(total_delta)) *
+                100.0;
+        }
+        per_core_cpu.push_back(std::min(std::max(usage, 0.0), 100.0));
+    }
+}
+}  // namespace
+
+TEST_CASE("Per-core CPU usage", "[benchmark][cpu]") {
+    // 100 ms of jiffies at USER_HZ 100, busy 0..10 of them.
+    std::vector<LegacyCpuTimes> previous_times(kCores);
+    std::vector<LegacyCpuTimes> current_times(kCores);
+    CpuCounterArrays previous;
+    CpuCounterArrays current;
+    previous.resize(kCores);
+    current.resize(kCores);
+    for (size_t core = 0; core < kCores; ++core) {
+        previous_times[core] = {800000 + core, 1000000 + core * 3};
+        current_times[core] = {previous_times[core].idle_time + 10 - core % 11, previous_times[core].total_time + 10};
+        previous.idle[core] = static_cast<double>(previous_times[core].idle_time);
+        previous.total[core] = static_cast<double>(previous_times[core].total_time);
+        current.idle[core] = static_cast<double>(current_times[core].idle_time);
+        current.total[core] = static_cast<double>(current_times[core].total_time);
+    }
+    std::vector<double> usage(kCores);
+
+    BENCHMARK("legacy per-core loop, 192 cores") {
+        legacy_per_core_cpu(previous_times, current_times, usage);
+        return usage.back();
+    };
+
+    BENCHMARK("compute_cpu_usage (" + std::string(cpu_usage_kernel()) + "), 192 cores") {
+        compute_cpu_usage(previous, current, usage.data());
+        return usage.back();
+    };
+
+    BENCHMARK("compute_cpu_usage_scalar, 192 cores") {
+        compute_cpu_usage_scalar(previous, current, usage.data());
+        return usage.back();
+    };
+}
@@ -0,0 +1,124 @@
+#include "delta_encoder.h"
+#include "json_writer.h"
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <iomanip>
+#include <sstream>
+#include <string>
+
+namespace {
+/**
+ * Pre-change HttpClient::metrics_to_json, kept here as the benchmark baseline.
+ */
+std::string legacy_metrics_to_json(const SystemMetrics& metrics) {
+    std::ostringstream json;
+
+    json << "{";
+    json << "\"timestamp\":" << metrics.timestamp << ",";
+    json << "\"timestamp_ms\":" << metrics.timestamp_ms << ",";
+    json << "\"total_cpu_percent\":" << std::fixed << std::setprecision(2) << metrics.total_cpu_percent << ",";
+    json << "\"per_core_cpu_percent\":[";
+    for (size_t index = 0; index < metrics.per_core_cpu_percent.size(); ++index) {
+        json << std::fixed << std::setprecision(2) << metrics.per_core_cpu_percent[index];
+        if (index < metrics.per_core_cpu_percent.size() - 1) {
+            json << ",";
+        }
+    }
+    json << "],";
+    json << "\"system_memory_total_mb\":" << std::fixed << std::setprecision(2) << metrics.system_memory_total_mb << ",";
+    json << "\"system_memory_used_mb\":" << std::fixed << std::setprecision(2) << metrics.system_memory_used_mb << ",";
+    json << "\"top_processes\":[";
+
+    for (size_t i = 0; i < metrics.top_processes.size(); ++i) {
+        const auto& proc = metrics.top_processes[i];
+        json << "{";
+        json << "\"pid\":" << proc.pid << ",";
+        json << "\"name\":\"" << proc.name << "\",";
+        json << "\"cpu_percent\":" << std::fixed << std::setprecision(2) << proc.cpu_percent << ",";
+        json << "\"memory_mb\":" << std::fixed << std::setprecision(2) << proc.memory_mb << ",";
+        json << "\"thread_count\":" << proc.thread_count << ",";
+        json << "\"io_read_mb\":" << std::fixed << std::setprecision(2) << proc.io_read_mb << ",";
+        json << "\"io_write_mb\":" << std::fixed << std::setprecision(2) << proc.io_write_mb << ",";
+        json << "\"handle_count\":" << proc.handle_count;
+        json << "}";
+
+        if (i < metrics.top_processes.size() - 1) {
+            json << ",";
+        }
+    }
+
+    json << "]";
+    json << "}";
+
+    return json.str();
+}
+
+// A 32-core host reporting the default 12 processes.
+SystemMetrics sample_metrics() {
+    SystemMetrics metrics{};
+    metrics.timestamp = 1700000000;
+    metrics.timestamp_ms = 1700000000250;
+    metrics.total_cpu_percent = 37.125;
+    for (int core = 0; core < 32; ++core) {
+        metrics.per_core_cpu_percent.push_back(12.5 + core * 2.37);
+    }
+    metrics.system_memory_total_mb = 128000.0;
+    metrics.system_memory_used_mb = 93211.42;
+    for (int index = 0; index < 12; ++index) {
+        metrics.top_processes.push_back(ProcessMetrics{
+            1000 + index, "postgres: checkpointer", 4.2 * index, 512.75 + index, 8 + index,
+            1234.5 * index, 87.25 * index, 40 + index});
+    }
+    return metrics;
+}
+}  // namespace
+
+TEST_CASE("metrics JSON serialization", "[benchmark][json]") {
+    const SystemMetrics metrics = sample_metrics();
+
+    std::string appended;
+    append_metrics_json(appended, metrics);
+    REQUIRE(appended == legacy_metrics_to_json(metrics));
+
+    BENCHMARK("legacy ostringstream metrics_to_json") {
+        return legacy_metrics_to_json(metrics);
+    };
+
+    std::string buffer;
+    BENCHMARK("append_metrics_json into a reused buffer") {
+        buffer.clear();
+        append_metrics_json(buffer, metrics);
+        return buffer.size();
+    };
+}
+
+TEST_CASE("delta document serialization", "[benchmark][json][delta]") {
+    const SystemMetrics first = sample_metrics();
+    // The next tick: two cores and one process moved, the rest stayed put.
+    SystemMetrics next = first;
+    next.timestamp_ms += 2000;
+    next.timestamp += 2;
+    next.per_core_cpu_percent[3] += 20.0;
+    next.per_core_cpu_percent[17] -= 10.0;
+    next.top_processes[11].cpu_percent += 5.0;
+
+    MetricsDeltaEncoder encoder;
+    std::string keyframe;
+    encoder.begin();
+    REQUIRE(encoder.append(first, keyframe));
+    encoder.commit();
+
+    std::string buffer;
+    encoder.begin();
+    REQUIRE_FALSE(encoder.append(next, buffer));
+    CHECK(buffer.size() * 5 < keyframe.size());
+
+    BENCHMARK("MetricsDeltaEncoder::append, 32 cores, 12 processes") {
+        buffer.clear();
+        encoder.begin();
+        encoder.append(next, buffer);
+        return buffer.size();
+    };
+}
@@ -0,0 +1,46 @@
+#include "structured_logger.h"
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstdio>
+#include <string>
+
+TEST_CASE("Structured log lines", "[benchmark][log]") {
+    const std::string queue_size = std::to_string(3);
+
+    std::string line;
+    BENCHMARK("append_log_line into a reused buffer") {
+        line.clear();
+        append_log_line(line, "2026-01-01T00:00:00Z", LogLevel::info, "collector.snapshot", "Collected metrics snapshot", {
+            {"queue_size", queue_size},
+            {"fresh_families", "cpu,memory,processes"}
+        });
+        return line.size();
+    };
+
+    set_log_level(LogLevel::warn);
+    BENCHMARK("log_event below the level filter") {
+        log_event(LogLevel::info, "collector.snapshot", "Collected metrics snapshot", {
+            {"queue_size", queue_size}
+        });
+    };
+
+    // The per-snapshot lines of a running agent: formatted on the calling
+    // thread, written by the background writer.
+    std::FILE* sink = std::fopen("/dev/null", "w");
+    REQUIRE(sink != nullptr);
+    LoggerOptions options;
+    options.out = sink;
+    options.err = sink;
+    set_log_level(LogLevel::info);
+    start_async_logger(options);
+    BENCHMARK("log_event through the background writer") {
+        log_event(LogLevel::info, "collector.snapshot", "Collected metrics snapshot", {
+            {"queue_size", queue_size},
+            {"fresh_families", "cpu,memory,processes"}
+        });
+    };
+    stop_async_logger();
+    std::fclose(sink);
+}
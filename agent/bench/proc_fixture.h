@@ -0,0 +1,81 @@
+#pragma once
+
+#if defined(__linux__)
+
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include <unistd.h>
+
+/**
+ * @class SyntheticProcTree
+ * @brief A /proc-shaped directory with a fixed, generated process population.
+ *
+ * Each of the `process_count` PIDs gets a `stat` line, an `io` file and an
+ * `fd` directory with three entries; the root also has `stat` and `meminfo`.
+ * CPU times differ per PID, so rankings are stable and non-trivial, and
+ * names repeat the way they do on real hosts. The tree lives under the
+ * system temp directory and is removed again on destruction.
+ */
+class SyntheticProcTree {
+public:
+    explicit SyntheticProcTree(size_t process_count)
+        : root_(std::filesystem::temp_directory_path() /
+                ("metrics-agent-proc-" + std::to_string(process_count) + "-" + std::to_string(::getpid()))) {
+        std::filesystem::remove_all(root_);
+        std::filesystem::create_directories(root_);
+        write(root_ / "stat",
+              "cpu  4705 356 584 3699 23 23 0 0 0 0\n"
+              "cpu0 2353 178 292 1849 11 11 0 0 0 0\n"
+              "cpu1 2352 178 292 1850 12 12 0 0 0 0\n");
+        write(root_ / "meminfo", "MemTotal:       16384000 kB\nMemFree:         2048000 kB\nMemAvailable:    8192000 kB\n");
+
+        for (size_t index = 0; index < process_count; ++index) {
+            const int pid = static_cast<int>(100 + index);
+            const std::filesystem::path directory = root_ / std::to_string(pid);
+            std::filesystem::create_directories(directory / "fd");
+            write(directory / "stat", stat_line(pid));
+            write(directory / "io", "rchar: 4096\nwchar: 2048\nread_bytes: 1048576\nwrite_bytes: 524288\n");
+            for (int fd = 0; fd < 3; ++fd) {
+                write(directory / "fd" / std::to_string(fd), "");
+            }
+        }
+    }
+
+    ~SyntheticProcTree() {
+        std::error_code ignored;
+        std::filesystem::remove_all(root_, ignored);
+    }
+
+    SyntheticProcTree(const SyntheticProcTree&) = delete;
+    SyntheticProcTree& operator=(const SyntheticProcTree&) = delete;
+
+    const std::filesystem::path& root() const {
+        return root_;
+    }
+
+    /**
+     * @brief The generated /proc/[pid]/stat contents of `pid`.
+     */
+    static std::string stat_line(int pid) {
+        static const char* const kNames[] = {"postgres", "nginx: worker", "java", "kworker/3:1", "python3", "sshd"};
+        const uint64_t utime = static_cast<uint64_t>(pid) * 7919 % 100000;
+        return std::to_string(pid) + " (" + kNames[pid % 6] + ") S 1 " + std::to_string(pid) + " " +
+            std::to_string(pid) + " 0 -1 4194560 1000 0 0 0 " + std::to_string(utime) + " " +
+            std::to_string(utime / 4) + " 0 0 20 0 " + std::to_string(1 + pid % 32) + " 0 " +
+            std::to_string(1000 + pid) + " 104857600 " + std::to_string(256 + pid % 4096) +
+            " 18446744073709551615 1 1 0 0 0 0 0 0 0 0 0 0 17 0 0 0 0 0 0\n";
+    }
+
+private:
+    static void write(const std::filesystem::path& path, const std::string& contents) {
+        std::ofstream out(path, std::ios::binary);
+        out << contents;
+    }
+
+    std::filesystem::path root_;
+};
+
+#endif
@@ -0,0 +1,107 @@
+#include "proc_source.h"
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#if defined(__linux__)
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+namespace {
+// Representative /proc/[pid]/stat line of a busy multi-threaded process.
+const std::string kSampleStatLine =
+    "2481 (postgres: wal) S 2470 2481 2481 0 -1 4194624 183520 0 12 0 "
+    "918273 102938 0 0 20 0 24 0 3123456 2147483648 524288 18446744073709551615 "
+    "94241775722496 94241785372113 140724998212464 0 0 0 0 4096 134234626 0 0 0 17 3 0 0 0 0 0";
+
+/**
+ * Pre-change implementation of read_linux_process_stat's parsing step, kept
+ * here as the benchmark baseline.
+ */
+bool legacy_parse_process_stat(const std::string& line, std::string& process_name, uint64_t& cpu_time, uint64_t& rss_pages) {
+    const std::size_t open_paren = line.find('(');
+    const std::size_t close_paren = line.rfind(')');
+    if (open_paren == std::string::npos || close_paren == std::string::npos || close_paren <= open_paren) {
+        return false;
+    }
+
+    process_name = line.substr(open_paren + 1, close_paren - open_paren - 1);
+
+    std::string tail = line.substr(close_paren + 2);
+    std::istringstream stream(tail);
+    std::vector<std::string> fields;
+    std::string token;
+    while (stream >> token) {
+        fields.push_back(token);
+    }
+
+    if (fields.size() < 22) {
+        return false;
+    }
+
+    try {
+        const uint64_t user_ticks = std::stoull(fields[11]);
+        const uint64_t system_ticks = std::stoull(fields[12]);
+        cpu_time = user_ticks + system_ticks;
+        rss_pages = std::stoull(fields[21]);
+    } catch (...) {
+        return false;
+    }
+
+    return true;
+}
+
+bool legacy_read_process_stat(int pid, std::string& process_name, uint64_t& cpu_time, uint64_t& rss_pages) {
+    const std::string stat_path = std::string("/proc/") + std::to_string(pid) + "/stat";
+    std::ifstream stat_file(stat_path);
+    if (!stat_file.is_open()) {
+        return false;
+    }
+
+    std::string line;
+    std::getline(stat_file, line);
+    if (line.empty()) {
+        return false;
+    }
+
+    return legacy_parse_process_stat(line, process_name, cpu_time, rss_pages);
+}
+}  // namespace
+
+TEST_CASE("/proc/[pid]/stat parsing", "[benchmark][proc]") {
+    const int self_pid = static_cast<int>(getpid());
+
+    BENCHMARK("legacy istringstream parse") {
+        std::string name;
+        uint64_t cpu_time = 0;
+        uint64_t rss_pages = 0;
+        legacy_parse_process_stat(kSampleStatLine, name, cpu_time, rss_pages);
+        return cpu_time + rss_pages;
+    };
+
+    BENCHMARK("from_chars in-place parse") {
+        LinuxPidStat stat{};
+        parse_linux_pid_stat(kSampleStatLine, stat);
+        return stat.utime_ticks + stat.stime_ticks + stat.rss_pages;
+    };
+
+    BENCHMARK("legacy ifstream read + parse /proc/self/stat") {
+        std::string name;
+        uint64_t cpu_time = 0;
+        uint64_t rss_pages = 0;
+        legacy_read_process_stat(self_pid, name, cpu_time, rss_pages);
+        return cpu_time + rss_pages;
+    };
+
+    BENCHMARK("stack buffer read + parse /proc/self/stat") {
+        char buffer[kLinuxPidStatBufferSize];
+        LinuxPidStat stat{};
+        read_linux_pid_stat(self_pid, buffer, sizeof(buffer), stat);
+        return stat.utime_ticks + stat.stime_ticks + stat.rss_pages;
+    };
+}
+#endif
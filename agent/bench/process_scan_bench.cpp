@@ -0,0 +1,152 @@
+#include "process_scanner.h"
+#include "process_table.h"
+#include "proc_fixture.h"
+#include "proc_source.h"
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#if defined(__linux__)
+#include <cstdlib>
+#include <string>
+#endif
+
+#if defined(__linux__)
+TEST_CASE("/proc process scan by worker count", "[benchmark][scan]") {
+    MetricsSelection selection{};
+
+    LinuxProcessScanner one_worker(1);
+    LinuxProcessScanner two_workers(2);
+    LinuxProcessScanner four_workers(4);
+    LinuxProcessScanner eight_workers(8);
+
+    BENCHMARK("scan /proc, 1 worker") {
+        return one_worker.scan(selection).size();
+    };
+
+    BENCHMARK("scan /proc, 2 workers") {
+        return two_workers.scan(selection).size();
+    };
+
+    BENCHMARK("scan /proc, 4 workers") {
+        return four_workers.scan(selection).size();
+    };
+
+    BENCHMARK("scan /proc, 8 workers") {
+        return eight_workers.scan(selection).size();
+    };
+}
+#endif
+
+#if defined(__linux__)
+TEST_CASE("/proc process scan through io_uring", "[benchmark][scan][io_uring]") {
+    MetricsSelection selection{};
+
+    LinuxProcessScanner syscalls(1);
+    LinuxProcessScanner batched(1);
+    std::string error;
+    if (!batched.enable_io_uring(error)) {
+        return;
+    }
+
+    BENCHMARK("scan /proc, 1 worker, open/read/close") {
+        return syscalls.scan(selection).size();
+    };
+
+    BENCHMARK("scan /proc, 1 worker, io_uring") {
+        return batched.scan(selection).size();
+    };
+}
+#endif
+
+#if defined(__linux__)
+TEST_CASE("Process table update after a scan", "[benchmark][scan]") {
+    MetricsSelection selection{};
+    LinuxProcessScanner scanner(1);
+    const ProcessScanBuffer& scan = scanner.scan(selection);
+
+    ProcessTable table;
+    table.update(scan);
+
+    BENCHMARK("ProcessTable::update, steady state") {
+        table.update(scan);
+        return table.size();
+    };
+}
+#endif
+
+#if defined(__linux__)
+TEST_CASE("Synthetic process population by size", "[benchmark][scan][fixture]") {
+    for (const size_t process_count : {size_t{1000}, size_t{10000}, size_t{50000}}) {
+        const SyntheticProcTree tree(process_count);
+        const std::string suffix = ", " + std::to_string(process_count) + " processes";
+
+        const MetricsSelection selection{};
+        LinuxProcessScanner scanner(1, ProcRoot(tree.root().string()));
+        REQUIRE(scanner.scan(selection).size() == process_count);
+        BENCHMARK("LinuxProcessScanner::scan, 1 worker" + suffix) {
+            return scanner.scan(selection).size();
+        };
+
+        CollectorOptions options;
+        options.proc_root = tree.root().string();
+        MetricsCollector collector(selection, options);
+        SystemMetrics metrics{};
+        collector.collect(metrics);
+        REQUIRE(metrics.top_processes.size() == options.top_n);
+        BENCHMARK("MetricsCollector::collect, all families" + suffix) {
+            collector.collect(metrics);
+            return metrics.top_processes.size();
+        };
+
+        ProcessScanBuffer scan;
+        scan.resize(process_count);
+        for (size_t row = 0; row < process_count; ++row) {
+            const std::string line = SyntheticProcTree::stat_line(static_cast<int>(100 + row));
+            LinuxPidStat stat{};
+            REQUIRE(parse_linux_pid_stat(line, stat));
+            scan.pids[row] = static_cast<int>(100 + row);
+            scan.cpu_times[row] = stat.utime_ticks + stat.stime_ticks;
+            scan.start_times[row] = stat.start_time_ticks;
+            scan.rss_pages[row] = stat.rss_pages;
+            scan.thread_counts[row] = stat.num_threads;
+            scan.set_name(row, stat.name);
+            scan.valid[row] = 1;
+        }
+
+        ProcessTable table;
+        table.update(scan);
+        BENCHMARK("ProcessTable::update, steady state" + suffix) {
+            table.update(scan);
+            return table.size();
+        };
+    }
+}
+#endif
+
+#if defined(__linux__)
+// Replays a tree written by `proc_capture record`, for repeatable numbers on
+// a recorded host: METRICS_AGENT_BENCH_PROC_ROOT=/path/to/capture.
+TEST_CASE("Recorded /proc capture", "[benchmark][scan][capture]") {
+    const char* capture = std::getenv("METRICS_AGENT_BENCH_PROC_ROOT");
+    if (capture == nullptr) {
+        return;
+    }
+
+    const MetricsSelection selection{};
+    LinuxProcessScanner scanner(1, ProcRoot(capture));
+    BENCHMARK("LinuxProcessScanner::scan, recorded capture") {
+        return scanner.scan(selection).size();
+    };
+
+    CollectorOptions options;
+    options.proc_root = capture;
+    MetricsCollector collector(selection, options);
+    SystemMetrics metrics{};
+    collector.collect(metrics);
+    BENCHMARK("MetricsCollector::collect, recorded capture") {
+        collector.collect(metrics);
+        return metrics.top_processes.size();
+    };
+}
+#endif
@@ -0,0 +1,48 @@
+#include "metrics_collector.h"
+#include "ring_buffer.h"
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <thread>
+
+namespace {
+SystemMetrics sized_snapshot() {
+    SystemMetrics metrics{};
+    metrics.per_core_cpu_percent.assign(32, 12.5);
+    metrics.top_processes.assign(12, ProcessMetrics{1000, "postgres", 4.2, 512.75, 8, 1.5, 0.25, 40});
+    return metrics;
+}
+}  // namespace
+
+TEST_CASE("Collector to sender queue handoff", "[benchmark][queue]") {
+    constexpr size_t kHandoffs = 10000;
+    BoundedRing<SystemMetrics> ring(32);
+    SystemMetrics produced = sized_snapshot();
+    SystemMetrics consumed = sized_snapshot();
+
+    BENCHMARK("push + try_pop, one thread") {
+        ring.push(produced);
+        return ring.try_pop(consumed);
+    };
+
+    // Throughput of the real thread pair: the producer pushes as fast as it
+    // can and the consumer blocks in wait_pop, so this includes wake-ups.
+    BENCHMARK("10000 snapshots between two threads") {
+        BoundedRing<SystemMetrics> handoff(32);
+        size_t received = 0;
+        std::thread consumer([&]() {
+            SystemMetrics out = sized_snapshot();
+            while (handoff.wait_pop(out)) {
+                ++received;
+            }
+        });
+        SystemMetrics in = sized_snapshot();
+        for (size_t i = 0; i < kHandoffs; ++i) {
+            handoff.push(in);
+        }
+        handoff.close();
+        consumer.join();
+        return received + handoff.dropped();
+    };
+}
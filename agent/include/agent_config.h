@@ -7,12 +7,64 @@
 
 struct AgentConfig {
     std::string backend_url = "http://localhost:8000";
-    int interval_seconds = 2;
+    int interval_ms = 2000;
+    int cpu_interval_ms = 0; ///< 0 means every interval_ms.
+    int memory_interval_ms = 0; ///< 0 means every interval_ms.
+    int process_interval_ms = 0; ///< 0 means every interval_ms.
+    int upload_interval_ms = 0; ///< Window summarized per queued snapshot; 0 queues every sample.
     bool backend_enabled = true;
     size_t queue_capacity = 32;
+    size_t collector_threads = 1;
+    size_t top_n = 12;
+    std::string proc_root = "/proc"; ///< procfs root on Linux, e.g. /host/proc in a container.
+    std::string cgroup_root = "/sys/fs/cgroup"; ///< cgroup v2 mount point on Linux, e.g. /host/sys/fs/cgroup in a container.
+    bool process_events = false; ///< Track processes via the netlink proc connector (Linux, CAP_NET_ADMIN).
+    bool proc_io_uring = true; ///< Batch /proc/[pid]/stat reads through io_uring when built with liburing.
+    size_t batch_max_items = 1;
+    size_t batch_max_bytes = 256 * 1024;
+    std::string wire_format = "json";
+    std::string compression = "none";
+    bool delta_uploads = false; ///< Send change-only documents to /ingest/metrics/delta.
+    size_t delta_keyframe_interval = 30; ///< Documents per full keyframe in delta mode.
+    double delta_cpu_deadband_percent = 0.5; ///< CPU changes not sent in delta mode, in percentage points.
+    double delta_memory_deadband_mb = 1.0; ///< Memory and I/O changes not sent in delta mode, in MB.
+    std::string log_level = "info";
+    int connect_timeout_ms = 3000;
+    int request_timeout_ms = 5000; ///< Per attempt.
+    size_t retry_max_attempts = 3; ///< Attempts per send; 1 disables retries.
+    int retry_base_delay_ms = 250;
+    int retry_max_delay_ms = 10000;
+    size_t breaker_failure_threshold = 5;
+    int breaker_open_ms = 5000;
+    int breaker_max_open_ms = 120000;
+    std::string spool_dir; ///< Empty disables the on-disk spool.
+    size_t spool_max_bytes = 64 * 1024 * 1024;
+    size_t spool_segment_bytes = 4 * 1024 * 1024;
+    size_t spool_replay_items = 64; ///< Spooled snapshots re-sent per successful live send.
+    int metrics_listen_port = 0; ///< 0 disables the Prometheus /metrics endpoint.
+    std::string metrics_listen_address = "127.0.0.1";
+    int telemetry_log_interval_ms = 60000; ///< Period of the agent.telemetry log summary.
     MetricsSelection selection{};
 
     static AgentConfig defaults();
 };
 
+/**
+ * @brief Applies the keys of a JSON or YAML config document to `config`.
+ *
+ * The document is tokenized once. Keys are matched by their full path, so
+ * `interval_ms` only sets the top-level key and the metric selection is
+ * read from the `metrics` section (top-level `total_cpu` etc. are still
+ * accepted). Keys that are missing or hold invalid values leave `config`
+ * unchanged.
+ *
+ * @param content Whole document; JSON if it starts with `{`, YAML otherwise.
+ * @param error_message Receives the reason and line on failure.
+ * @return False if the document is malformed or the result is unusable.
+ */
+bool parse_agent_config(const std::string& content, AgentConfig& config, std::string& error_message);
+
+/**
+ * @brief Reads `path` and applies it with parse_agent_config().
+ */
 bool load_agent_config_file(const std::string& path, AgentConfig& config, std::string& error_message);
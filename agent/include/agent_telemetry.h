@@ -0,0 +1,149 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * @class LatencyHistogram
+ * @brief Lock-free log-linear histogram of durations in microseconds.
+ *
+ * Values below 8 get a bucket each; above that every power of two is split
+ * into 8 equal sub-buckets (the HDR histogram layout with 3 significant
+ * bits), so a reported quantile is at most 12.5% above the true value over
+ * the whole 64-bit range. record() is a few relaxed atomic adds; readers
+ * take a snapshot while writers keep recording.
+ */
+class LatencyHistogram {
+public:
+    static constexpr size_t kSubBuckets = 8;
+    static constexpr size_t kBucketCount = kSubBuckets + (64 - 3) * kSubBuckets;
+
+    /**
+     * @brief Copy of the counters at one point in time.
+     */
+    struct Snapshot {
+        std::array<uint64_t, kBucketCount> buckets{};
+        uint64_t count = 0;
+        uint64_t sum = 0;
+        uint64_t max = 0;
+
+        /**
+         * @brief Value at quantile `q` in [0, 1]: the upper bound of its bucket, at most max.
+         * @return 0 for an empty snapshot.
+         */
+        uint64_t quantile(double q) const;
+
+        /**
+         * @brief Turns the snapshot into the difference to an `earlier` one.
+         *
+         * `max` becomes the upper bound of the highest bucket that gained
+         * values, capped by the cumulative maximum.
+         */
+        void subtract(const Snapshot& earlier);
+    };
+
+    void record(uint64_t value);
+    void snapshot(Snapshot& out) const;
+
+    static size_t bucket_index(uint64_t value);
+
+    /**
+     * @brief Largest value that falls into bucket `index`.
+     */
+    static uint64_t bucket_upper_bound(size_t index);
+
+private:
+    std::array<std::atomic<uint64_t>, kBucketCount> buckets_{};
+    std::atomic<uint64_t> sum_{0};
+    std::atomic<uint64_t> max_{0};
+};
+
+/**
+ * @brief Pipeline stages with a latency histogram.
+ */
+enum class TelemetryStage : size_t {
+    collect, ///< MetricsCollector::collect, all due families.
+    proc_scan, ///< Top-process collection, including the /proc walk on Linux.
+    serialize, ///< Encoding a request body (JSON or binary).
+    send, ///< One HttpClient send, retries and backoff included.
+    count
+};
+
+/**
+ * @brief Prometheus label value of a stage.
+ */
+const char* telemetry_stage_name(TelemetryStage stage);
+
+/**
+ * @struct AgentTelemetry
+ * @brief Process-wide latency histograms and counters of the agent.
+ *
+ * Every member is an atomic updated with relaxed ordering, so the hot paths
+ * pay a few uncontended increments and any thread may read.
+ */
+struct AgentTelemetry {
+    std::array<LatencyHistogram, static_cast<size_t>(TelemetryStage::count)> stages;
+
+    std::atomic<uint64_t> collections{0};
+    std::atomic<uint64_t> queue_drops{0};
+    std::atomic<uint64_t> requests{0}; ///< HTTP requests made, retries included.
+    std::atomic<uint64_t> request_failures{0};
+    std::atomic<uint64_t> retries{0};
+    std::atomic<uint64_t> bytes_sent{0}; ///< Request body bytes on the wire, after compression.
+    std::atomic<uint64_t> proc_syscalls{0}; ///< open/read/pread/close/stat/opendir calls on procfs.
+    std::atomic<uint64_t> proc_listings{0}; ///< Full listings of the procfs root by the process scanner.
+    std::atomic<uint64_t> processes_started{0}; ///< Process start events from the proc connector.
+    std::atomic<uint64_t> processes_exited{0}; ///< Process exit events from the proc connector.
+    std::atomic<uint64_t> cycle_allocations{0}; ///< Heap allocations of the last collection cycle.
+
+    LatencyHistogram& stage(TelemetryStage which) {
+        return stages[static_cast<size_t>(which)];
+    }
+
+    /**
+     * @brief Appends everything in the Prometheus text exposition format (0.0.4).
+     *
+     * Stages are exported as a summary with 0.5, 0.9 and 0.99 quantiles.
+     */
+    void render_prometheus(std::string& out) const;
+};
+
+/**
+ * @brief The agent's telemetry registry.
+ */
+AgentTelemetry& agent_telemetry();
+
+/**
+ * @brief Adds `calls` to the procfs system call counter.
+ */
+inline void count_proc_syscalls(uint64_t calls) {
+    agent_telemetry().proc_syscalls.fetch_add(calls, std::memory_order_relaxed);
+}
+
+/**
+ * @class ScopedStageTimer
+ * @brief Records the steady-clock time between construction and destruction.
+ */
+class ScopedStageTimer {
+public:
+    explicit ScopedStageTimer(TelemetryStage stage)
+        : histogram_(agent_telemetry().stage(stage)),
+          start_(std::chrono::steady_clock::now()) {}
+
+    ~ScopedStageTimer() {
+        const auto elapsed = std::chrono::steady_clock::now() - start_;
+        histogram_.record(static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count()));
+    }
+
+    ScopedStageTimer(const ScopedStageTimer&) = delete;
+    ScopedStageTimer& operator=(const ScopedStageTimer&) = delete;
+
+private:
+    LatencyHistogram& histogram_;
+    std::chrono::steady_clock::time_point start_;
+};
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * @brief Heap allocations made so far by the calling thread.
+ *
+ * allocation_counter.cpp replaces the global operator new to keep this count,
+ * so it is only linked into the agent executable; the collector thread reads
+ * it around each cycle for the cycle_allocations gauge.
+ */
+uint64_t thread_allocation_count();
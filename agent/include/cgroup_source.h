@@ -0,0 +1,84 @@
+#pragma once
+
+#if defined(__linux__)
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @struct CgroupSample
+ * @brief Raw counters of one cgroup v2 directory.
+ */
+struct CgroupSample {
+    std::string path; ///< Path below the hierarchy root, e.g. "kubepods.slice/.../cri-containerd-<id>.scope"; "/" for the root itself.
+    uint64_t cpu_usage_usec; ///< `usage_usec` of cpu.stat.
+    uint64_t memory_bytes; ///< memory.current.
+    uint64_t io_read_bytes; ///< Sum of `rbytes` over the devices in io.stat.
+    uint64_t io_write_bytes; ///< Sum of `wbytes` over the devices in io.stat.
+};
+
+/**
+ * @brief Parses `usage_usec` from cpu.stat contents.
+ */
+bool parse_cgroup_cpu_stat(std::string_view contents, uint64_t& usage_usec);
+
+/**
+ * @brief Sums `rbytes=` and `wbytes=` over every device line of io.stat.
+ *
+ * Empty contents (no I/O yet) parse as zero.
+ */
+void parse_cgroup_io_stat(std::string_view contents, uint64_t& read_bytes, uint64_t& write_bytes);
+
+/**
+ * @class LinuxCgroupSource
+ * @brief Reads usage counters of the leaf cgroups of a cgroup v2 hierarchy.
+ *
+ * Leaves are the cgroups that do the accounting we care about: containers
+ * under a pod in Kubernetes, services and scopes under systemd. Their
+ * parents aggregate them, so reporting both would count usage twice. The
+ * root counts as a leaf when it has no child cgroups, as inside a container
+ * with its own cgroup namespace.
+ *
+ * A scan walks the hierarchy (a few dozen directories on a typical node)
+ * and reads three small files per leaf. Missing files count as zero, since
+ * controllers need not be enabled everywhere.
+ */
+class LinuxCgroupSource {
+public:
+    /// Deeper cgroups are not visited; systemd and kubelet nest 4-6 levels.
+    static constexpr size_t kMaxDepth = 8;
+
+    /**
+     * @param root Mount point of the cgroup v2 hierarchy; trailing slashes are ignored.
+     */
+    explicit LinuxCgroupSource(std::string root = "/sys/fs/cgroup");
+
+    const std::string& root() const;
+
+    /**
+     * @brief True if the root holds a cgroup v2 hierarchy (cgroup.controllers exists).
+     */
+    bool is_available() const;
+
+    /**
+     * @brief Replaces `samples` with the counters of every leaf cgroup.
+     *
+     * Elements and their path strings are reused, so a steady-state scan
+     * does not reallocate. The order is that of the directory walk.
+     */
+    void scan(std::vector<CgroupSample>& samples);
+
+private:
+    void walk(size_t depth, std::vector<CgroupSample>& samples, size_t& count);
+    bool read_file(const char* name, std::string_view& contents);
+
+    std::string root_;
+    bool available_;
+    std::string path_; ///< Directory being visited; grows and shrinks during the walk.
+    std::vector<char> buffer_; ///< Read buffer shared by every file.
+};
+
+#endif
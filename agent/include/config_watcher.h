@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+/**
+ * @class ConfigWatcher
+ * @brief Notices changes to the config file through inotify (Linux only).
+ *
+ * The file's directory is watched rather than the file itself, so editors
+ * that save by renaming a new file over the old one are noticed, and so
+ * are Kubernetes ConfigMap volumes, which swap a `..data` symlink. The
+ * descriptor is non-blocking and drained by poll(), so no extra thread is
+ * involved. On other platforms open() fails and the file is only read at
+ * startup.
+ */
+class ConfigWatcher {
+public:
+    ConfigWatcher() = default;
+    ~ConfigWatcher();
+
+    ConfigWatcher(const ConfigWatcher&) = delete;
+    ConfigWatcher& operator=(const ConfigWatcher&) = delete;
+
+    /**
+     * @brief Starts watching `path`.
+     * @param error_message Receives the reason on failure.
+     */
+    bool open(const std::string& path, std::string& error_message);
+
+    /**
+     * @brief Drains the queued events without blocking.
+     * @return True if any of them may have changed the file's content.
+     */
+    bool poll();
+
+    bool is_open() const;
+
+private:
+    int fd_ = -1;
+    std::string file_name_;
+    std::vector<char> buffer_;
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * @struct CpuCounterArrays
+ * @brief Structure-of-arrays copy of the per-core jiffy counters of one sample.
+ *
+ * Column `i` describes core `i`. The counters are held as doubles so the
+ * usage kernel needs no 64-bit integer compares or conversions, which SSE2
+ * lacks; jiffy counts stay exact as doubles far beyond any uptime (2^53).
+ * Storage is reused between samples.
+ */
+struct CpuCounterArrays {
+    std::vector<double> idle; ///< idle + iowait jiffies.
+    std::vector<double> total; ///< All jiffies.
+
+    /**
+     * @brief Resizes both columns to `cores`; does not shrink capacity.
+     */
+    void resize(size_t cores);
+
+    /**
+     * @brief Number of cores.
+     */
+    size_t size() const;
+};
+
+/**
+ * @brief Usage percentage of each core between two samples.
+ *
+ * Per core: the busy share of the total delta, in [0, 100]; 0 when the
+ * total did not advance. Deltas of counters that went backwards (a CPU
+ * brought back online) count as 0.
+ *
+ * @param previous Earlier sample.
+ * @param current Later sample.
+ * @param usage Receives min(previous.size(), current.size()) values.
+ * @return Number of values written.
+ */
+size_t compute_cpu_usage(const CpuCounterArrays& previous, const CpuCounterArrays& current, double* usage);
+
+/**
+ * @brief compute_cpu_usage() without SIMD; same results for the same inputs.
+ */
+size_t compute_cpu_usage_scalar(const CpuCounterArrays& previous, const CpuCounterArrays& current, double* usage);
+
+/**
+ * @brief Instruction set compute_cpu_usage() was built for: "sse2" or "scalar".
+ */
+const char* cpu_usage_kernel();
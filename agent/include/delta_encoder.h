@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "metrics_collector.h"
+
+/**
+ * @struct DeltaOptions
+ * @brief Keyframe cadence and deadbands of MetricsDeltaEncoder.
+ */
+struct DeltaOptions {
+    size_t keyframe_interval = 30; ///< Documents per keyframe, the keyframe included; 1 sends only keyframes.
+    double cpu_deadband_percent = 0.5; ///< CPU changes up to this many percentage points are not sent.
+    double memory_deadband_mb = 1.0; ///< Memory and I/O changes up to this many MB are not sent.
+    std::string stream_id; ///< Identifies this agent run to the backend; empty picks a random one.
+};
+
+/**
+ * @class MetricsDeltaEncoder
+ * @brief Encodes snapshots as change-only documents for `/ingest/metrics/delta`.
+ *
+ * Every document carries the stream ID and a sequence number. A keyframe
+ * holds the whole snapshot (`{"stream","sequence","keyframe":{...}}`, the
+ * object being the regular JSON payload); the documents after it hold only
+ * what changed since the backend's copy of the previous one
+ * (`{"stream","sequence","delta":{...}}`):
+ *
+ * - `timestamp` and `timestamp_ms`, always
+ * - `total_cpu_percent`, `system_memory_total_mb`, `system_memory_used_mb`
+ *   when they moved beyond the deadband
+ * - `per_core_cpu_percent` as an object of core index to value, changed cores only
+ * - `top_processes` keyed by `pid`: new processes (and reused PIDs, which
+ *   have a new name) with every field, known ones with the changed fields
+ *   only, unchanged ones left out; `removed_pids` lists those that left
+ * - `top_cgroups` keyed by `path` the same way, and `removed_cgroups`
+ * - `process_order` (pids) and `cgroup_order` (paths) with the snapshot's
+ *   ranking, when it differs from the backend's rebuilt order: the
+ *   previous order without the removed entries, new entries appended
+ * - `window`, whole, on MetricsAggregator summaries
+ *
+ * Values are compared against what the backend holds, not against the
+ * previous sample, so a slow drift is sent once it adds up to more than the
+ * deadband and the reconstructed values never lag by more than that.
+ * Integer fields are sent on any change. Rebuilt lists keep the agent's
+ * ranking exactly, so window entries stay aligned with `top_processes`.
+ * A change of the core count, and
+ * every `keyframe_interval`-th document, starts a keyframe.
+ *
+ * A request is built between begin() and commit(): begin() rewinds to the
+ * state the backend acknowledged, so a request that is re-encoded (to fit a
+ * size limit) or abandoned leaves no trace. After a failed request the
+ * backend's state is unknown and force_keyframe() makes the next document a
+ * keyframe; the backend answers 409 to a delta whose base it lacks (after a
+ * restart, for instance), which calls for the same.
+ */
+class MetricsDeltaEncoder {
+public:
+    explicit MetricsDeltaEncoder(const DeltaOptions& options = {});
+
+    const std::string& stream_id() const;
+
+    /**
+     * @brief Starts a request from the last state the backend acknowledged.
+     */
+    void begin();
+
+    /**
+     * @brief Appends the document of the next snapshot.
+     * @param out Destination buffer; existing contents are kept.
+     * @return True if the document is a keyframe.
+     */
+    bool append(const SystemMetrics& metrics, std::string& out);
+
+    /**
+     * @brief Records that the backend accepted every document since begin().
+     */
+    void commit();
+
+    /**
+     * @brief Makes the next document a keyframe.
+     */
+    void force_keyframe();
+
+private:
+    struct State {
+        bool valid = false; ///< Whether the backend holds a reference snapshot.
+        uint64_t sequence = 0; ///< Sequence number of the last document.
+        size_t since_keyframe = 0; ///< Documents since the last keyframe, that one included.
+        SystemMetrics reference{}; ///< The snapshot as the backend reconstructed it.
+    };
+
+    void append_delta(const SystemMetrics& metrics, std::string& out);
+    void append_process_changes(const std::vector<ProcessMetrics>& processes, std::string& out);
+    void append_cgroup_changes(const std::vector<CgroupMetrics>& cgroups, std::string& out);
+    bool cpu_changed(double sent, double current) const;
+    bool memory_changed(double sent, double current) const;
+
+    DeltaOptions options_;
+    int64_t cpu_deadband_hundredths_;
+    int64_t memory_deadband_hundredths_;
+    State acknowledged_;
+    State working_;
+    std::vector<char> seen_; ///< Reference entries matched by the current snapshot.
+};
@@ -1,7 +1,32 @@
 #pragma once
 
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
 #include <string>
+#include <vector>
+#include <curl/curl.h>
+#include "delta_encoder.h"
 #include "metrics_collector.h"
+#include "retry_policy.h"
+#include "wire_format.h"
+
+/**
+ * @struct HttpClientOptions
+ * @brief Payload encoding, timeouts and retry behaviour of HttpClient.
+ */
+struct HttpClientOptions {
+    WireFormat wire_format = WireFormat::json; ///< Body encoding; selects the Content-Type.
+    WireCompression compression = WireCompression::none; ///< Body compression; selects Content-Encoding.
+    long connect_timeout_ms = 3000; ///< CURLOPT_CONNECTTIMEOUT_MS.
+    long request_timeout_ms = 5000; ///< CURLOPT_TIMEOUT_MS, per attempt.
+    RetryPolicy retry{}; ///< Retries of transient failures and the circuit breaker.
+    uint32_t jitter_seed = 0; ///< Seed for backoff jitter; 0 picks a random one.
+    DeltaOptions delta{}; ///< Keyframes and deadbands of send_metrics_delta().
+};
 
 /**
  * @class HttpClient
@@ -9,20 +34,37 @@
  *
  * This class provides functionality to serialize system metrics into JSON format
  * and send them to a specified backend URL using HTTP POST requests.
+ *
+ * One libcurl easy handle is kept for the lifetime of the client so the
+ * connection to the backend stays open between sends. A share handle keeps
+ * DNS results and TLS sessions for reconnects. Instances are not thread-safe;
+ * the agent uses one client from its sender thread.
+ *
+ * Transient failures (transport errors, 429, 502, 503, 504) are retried
+ * within one send with jittered exponential backoff, waiting at least as
+ * long as a `Retry-After` header asks. Consecutive failed sends open a
+ * CircuitBreaker; while it is open, sends fail at once without touching the
+ * network, and after the cool-down a single probe decides whether to close
+ * it. cancel_retries() may be called from another thread to cut every wait
+ * short at shutdown.
  */
 class HttpClient {
 public:
     /**
      * @brief Constructs an HttpClient with the specified backend URL.
      * @param backend_url The URL of the backend server to which metrics will be sent.
+     * @param options Payload encoding and compression.
      */
-    HttpClient(const std::string& backend_url);
+    HttpClient(const std::string& backend_url, const HttpClientOptions& options = {});
 
     /**
      * @brief Destructor for the HttpClient class.
      */
     ~HttpClient();
 
+    HttpClient(const HttpClient&) = delete;
+    HttpClient& operator=(const HttpClient&) = delete;
+
     /**
      * @brief Sends system metrics to the backend server.
      * @param metrics The system metrics to be sent.
@@ -30,6 +72,45 @@ public:
      */
     bool send_metrics(const SystemMetrics& metrics);
 
+    /**
+     * @brief Sends several queued snapshots in one request to the batch endpoint.
+     * @param batch Snapshots in collection order.
+     * @param count Number of snapshots in `batch`.
+     * @param max_bytes Upper bound on the encoded (uncompressed) body size. The
+     *        first snapshot is always included, even if it alone exceeds the bound.
+     * @param sent_count Receives how many leading snapshots of `batch` were put
+     *        into the request, whether or not the request succeeded.
+     * @return True if the metrics were successfully sent, false otherwise.
+     */
+    bool send_metrics_batch(const SystemMetrics* batch, size_t count, size_t max_bytes, size_t& sent_count);
+
+    /**
+     * @brief Sends snapshots as change-only documents to the delta endpoint.
+     *
+     * Always JSON (see MetricsDeltaEncoder), whatever the wire format. A 409
+     * means the backend lacks the base of the first delta; the request is
+     * re-encoded from a keyframe and posted once more. After any other
+     * failure the next request starts with a keyframe.
+     *
+     * @param batch Snapshots in collection order.
+     * @param count Number of snapshots in `batch`.
+     * @param max_bytes Upper bound on the encoded (uncompressed) body size; the
+     *        first snapshot is always included.
+     * @param sent_count Receives how many leading snapshots were put into the request.
+     * @return True if the metrics were successfully sent, false otherwise.
+     */
+    bool send_metrics_delta(const SystemMetrics* batch, size_t count, size_t max_bytes, size_t& sent_count);
+
+    /**
+     * @brief Number of 409 answers that made send_metrics_delta() start over from a keyframe.
+     */
+    uint64_t delta_resyncs() const;
+
+    /**
+     * @brief Stream ID the delta documents of this client carry.
+     */
+    const std::string& delta_stream_id() const;
+
     /**
      * @brief Gets the last error message from send_metrics.
      * @return A human-readable error message. Empty if the last send succeeded.
@@ -42,6 +123,32 @@ public:
      */
     long last_http_status() const;
 
+    /**
+     * @brief Number of requests the last send made; 0 if the breaker refused it.
+     */
+    size_t last_attempts() const;
+
+    /**
+     * @brief Current circuit breaker state.
+     */
+    CircuitState circuit_state() const;
+
+    /**
+     * @brief When an open breaker lets the next probe through.
+     */
+    std::chrono::steady_clock::time_point circuit_retry_at() const;
+
+    /**
+     * @brief Blocks until an open breaker would let a probe through.
+     * @return False if cancel_retries() was called.
+     */
+    bool wait_for_circuit();
+
+    /**
+     * @brief Wakes any backoff or breaker wait and skips later ones. Thread-safe.
+     */
+    void cancel_retries();
+
     /**
      * @brief Converts system metrics into a JSON string.
      * @param metrics The system metrics to be converted.
@@ -50,7 +157,70 @@ public:
     std::string metrics_to_json(const SystemMetrics& metrics);
 
 private:
+    /**
+     * @brief Creates the easy handle and applies the options shared by every send.
+     * @return True if the handle is ready.
+     */
+    bool prepare_handle();
+
+    /**
+     * @brief Encodes `count` snapshots into request_body in the configured format.
+     * @param as_array For JSON, whether to emit an array even for one snapshot.
+     */
+    void encode_request(const SystemMetrics* snapshots, size_t count, bool as_array);
+
+    /**
+     * @brief Encodes up to `count` delta documents into request_body within `max_bytes`.
+     * @return Number of snapshots encoded.
+     */
+    size_t encode_delta_request(const SystemMetrics* snapshots, size_t count, size_t max_bytes);
+
+    /**
+     * @brief Compresses request_body if configured and posts it to `url`,
+     *        retrying transient failures.
+     * @param headers Request headers; null for request_headers.
+     * @return True on HTTP 2xx response.
+     */
+    bool post_request_body(const std::string& url, curl_slist* headers = nullptr);
+
+    /**
+     * @brief Makes one request with `body` and records the outcome.
+     * @param retry_after Receives the backend's Retry-After, 0 if none.
+     * @return True on HTTP 2xx response.
+     */
+    bool perform_request(const std::string& url, curl_slist* headers, const std::string& body,
+                         std::chrono::milliseconds& retry_after);
+
+    /**
+     * @brief Sleeps until `deadline` unless cancel_retries() is called.
+     * @return False if cancelled.
+     */
+    bool wait_until(std::chrono::steady_clock::time_point deadline);
+
     std::string backend_url; ///< The URL of the backend server.
+    HttpClientOptions options;
+    std::string ingest_url; ///< Precomputed `${backend_url}/ingest/metrics`.
+    std::string batch_url; ///< Precomputed `${backend_url}/ingest/metrics/batch`.
+    std::string delta_url; ///< Precomputed `${backend_url}/ingest/metrics/delta`.
     std::string last_error_message;
     long last_status_code = 0;
+    size_t last_attempt_count = 0;
+
+    CURL* curl_handle = nullptr; ///< Persistent easy handle; owns the connection cache.
+    CURLSH* curl_share = nullptr; ///< DNS and TLS session cache shared with curl_handle.
+    curl_slist* request_headers = nullptr; ///< Headers built once in the constructor.
+    curl_slist* delta_headers = nullptr; ///< request_headers with a JSON Content-Type, for delta documents.
+    std::string request_body; ///< Payload of the in-flight request.
+    std::string compressed_body; ///< Gzipped request_body when compression is enabled.
+    BinaryMetricsEncoder binary_encoder; ///< Reused encoder state for WireFormat::binary.
+    MetricsDeltaEncoder delta_encoder; ///< What the backend holds of this agent's delta stream.
+    uint64_t delta_resync_count = 0;
+    std::string response_body; ///< Response of the last request, reused between sends.
+    std::array<char, CURL_ERROR_SIZE> curl_error{}; ///< libcurl error buffer bound to curl_handle.
+
+    JitteredBackoff retry_backoff; ///< Delays between attempts of one send.
+    CircuitBreaker circuit_breaker;
+    std::mutex cancel_mutex; ///< Guards cancelled; the only state shared across threads.
+    std::condition_variable cancel_cv;
+    bool cancelled = false;
 };
\ No newline at end of file
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief Moves `deadline` to the next slot of a fixed cadence.
+ *
+ * Slots are `deadline + k * interval`. If the next slot already lies in the
+ * past (the previous cycle overran), every missed slot is skipped so the
+ * cadence keeps its phase instead of accumulating lag.
+ *
+ * @param deadline Slot that was just served; receives the next slot.
+ * @param now Current time.
+ * @param interval Cadence; must be positive.
+ * @return Number of slots skipped, 0 if the cycle finished in time.
+ */
+uint64_t advance_deadline(
+    std::chrono::steady_clock::time_point& deadline,
+    std::chrono::steady_clock::time_point now,
+    std::chrono::steady_clock::duration interval
+);
+
+/**
+ * @class IntervalScheduler
+ * @brief Paces a loop on absolute steady-clock deadlines.
+ *
+ * The first wait_next() returns at once and anchors the cadence; each later
+ * call sleeps until the next slot, so the time spent in the loop body does
+ * not shift later cycles. stop() wakes a sleeping wait_next() immediately.
+ *
+ * wait_next() and the counters belong to the scheduling thread; stop() may
+ * be called from any thread.
+ */
+class IntervalScheduler {
+public:
+    /**
+     * @brief Creates a scheduler with the given cadence.
+     * @param interval Time between slots; must be positive.
+     */
+    explicit IntervalScheduler(std::chrono::milliseconds interval);
+
+    IntervalScheduler(const IntervalScheduler&) = delete;
+    IntervalScheduler& operator=(const IntervalScheduler&) = delete;
+
+    /**
+     * @brief Blocks until the next slot.
+     * @return False once stop() has been called.
+     */
+    bool wait_next();
+
+    /**
+     * @brief Wakes wait_next() and makes it return false from then on.
+     */
+    void stop();
+
+    /**
+     * @brief Changes the cadence; the next slot is `interval` after the one last served.
+     * @param interval Time between slots; must be positive.
+     *
+     * Belongs to the scheduling thread, like wait_next(). Slot numbers keep
+     * counting, so tiers keyed to the old cadence should be rebuilt.
+     */
+    void set_interval(std::chrono::milliseconds interval);
+
+    /**
+     * @brief Index of the slot wait_next() last returned for, counting skipped slots.
+     */
+    uint64_t slot() const;
+
+    /**
+     * @brief Slots skipped just before the slot wait_next() last returned for.
+     */
+    uint64_t last_skipped() const;
+
+    /**
+     * @brief Number of cycles that overran their slot.
+     */
+    uint64_t overruns() const;
+
+    /**
+     * @brief Total slots skipped because of overruns.
+     */
+    uint64_t skipped_slots() const;
+
+private:
+    std::chrono::steady_clock::duration interval_;
+    std::chrono::steady_clock::time_point deadline_;
+    bool started_ = false;
+    uint64_t slot_ = 0;
+    uint64_t last_skipped_ = 0;
+    uint64_t overruns_ = 0;
+    uint64_t skipped_slots_ = 0;
+
+    std::mutex mutex_;
+    std::condition_variable stop_cv_;
+    bool stopped_ = false;
+};
+
+/**
+ * @class CollectionTiers
+ * @brief Decides which groups of work are due on each slot of a base cadence.
+ *
+ * Each tier runs every `period_slots` slots of the base scheduler. A tier is
+ * due once that many slots have passed since it last ran, so a tier whose
+ * slot was skipped by an overrun runs on the next slot instead of waiting a
+ * whole period. Every tier is due on the first slot.
+ */
+class CollectionTiers {
+public:
+    /**
+     * @brief Adds a tier.
+     * @param families Bits reported by due() when the tier runs.
+     * @param period_slots Base slots between runs; 0 is treated as 1.
+     */
+    void add(uint32_t families, uint64_t period_slots);
+
+    /**
+     * @brief Marks the tiers that are due on `slot` as run and returns their bits.
+     * @param slot Base scheduler slot, non-decreasing between calls.
+     */
+    uint32_t due(uint64_t slot);
+
+private:
+    struct Tier {
+        uint32_t families;
+        uint64_t period_slots;
+        uint64_t last_slot;
+        bool has_run;
+    };
+
+    std::vector<Tier> tiers_;
+};
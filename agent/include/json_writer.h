@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "metrics_collector.h"
+
+/**
+ * @brief Appends `value` as a quoted JSON string.
+ *
+ * Quotes, backslashes and control characters are escaped. Bytes that do not
+ * form valid UTF-8 (process names are arbitrary bytes on Linux) are replaced
+ * with U+FFFD so the document always decodes.
+ *
+ * @param out Destination buffer.
+ * @param value Raw string bytes.
+ */
+void append_json_string(std::string& out, std::string_view value);
+
+/**
+ * @brief Appends a signed integer in decimal.
+ */
+void append_json_int(std::string& out, int64_t value);
+
+/**
+ * @brief Appends a double with exactly two decimals, like `std::fixed << std::setprecision(2)`.
+ *
+ * Formatting does not depend on the global or stream locale.
+ */
+void append_json_fixed2(std::string& out, double value);
+
+/**
+ * @brief Appends one `top_processes` entry with every field.
+ */
+void append_process_json(std::string& out, const ProcessMetrics& proc);
+
+/**
+ * @brief Appends one `top_cgroups` entry with every field.
+ */
+void append_cgroup_json(std::string& out, const CgroupMetrics& cgroup);
+
+/**
+ * @brief Appends the `window` object of a MetricsAggregator summary.
+ */
+void append_window_json(std::string& out, const MetricsWindow& window);
+
+/**
+ * @brief Appends the backend JSON schema for one snapshot.
+ *
+ * Output is byte-identical to the former iostream serializer for every
+ * snapshot whose process names needed no escaping; `top_cgroups` is only
+ * written when non-empty, and `window` only for MetricsAggregator summaries.
+ *
+ * @param out Destination buffer; existing contents are kept.
+ * @param metrics Snapshot to serialize.
+ */
+void append_metrics_json(std::string& out, const SystemMetrics& metrics);
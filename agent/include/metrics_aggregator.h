@@ -0,0 +1,137 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "metrics_collector.h"
+
+/**
+ * @class P2Quantile
+ * @brief Streaming quantile estimate in constant memory (the P² algorithm of Jain and Chlamtac).
+ *
+ * Five markers track the minimum, the quantile, the maximum and two points
+ * in between; each sample moves them along a piecewise-parabolic fit, so
+ * add() is O(1) whatever the window length. Up to five samples value() is
+ * the exact nearest-rank quantile.
+ */
+class P2Quantile {
+public:
+    /**
+     * @param quantile Quantile to track, in (0, 1).
+     */
+    explicit P2Quantile(double quantile = 0.95);
+
+    void reset();
+
+    void add(double value);
+
+    /**
+     * @brief Current estimate; 0 before the first sample.
+     */
+    double value() const;
+
+    size_t count() const;
+
+private:
+    double quantile_;
+    size_t count_ = 0;
+    std::array<double, 5> heights_{}; ///< Marker values; the first samples until there are five.
+    std::array<double, 5> positions_{}; ///< Actual marker positions (sample ranks).
+    std::array<double, 5> desired_{}; ///< Desired marker positions.
+    std::array<double, 5> increments_{}; ///< Growth of the desired positions per sample.
+};
+
+/**
+ * @class RunningStats
+ * @brief Min, max, mean and p95 of a metric, updated in O(1) per sample.
+ */
+class RunningStats {
+public:
+    void reset();
+
+    void add(double value);
+
+    size_t count() const;
+
+    /**
+     * @brief Statistics of the samples so far; all zero before the first one.
+     */
+    WindowStats summary() const;
+
+private:
+    size_t count_ = 0;
+    double min_ = 0.0;
+    double max_ = 0.0;
+    double sum_ = 0.0;
+    P2Quantile p95_{0.95};
+};
+
+/**
+ * @class MetricsAggregator
+ * @brief Downsamples collected snapshots into one summary per window of samples.
+ *
+ * Sits between MetricsCollector::collect() and the send queue. Every sample
+ * updates running statistics of total CPU, each core, used memory and the
+ * CPU and memory of each top process; once `window_samples` samples are in,
+ * add() writes a summary and starts the next window. Only families that
+ * were sampled fresh enter the statistics, so slower families are not
+ * weighted by their carried-over values.
+ *
+ * The summary is the latest sample with total CPU, per-core CPU and used
+ * memory replaced by their window means, and `window` filled in. Its top
+ * processes are the ones that peaked highest during the window (by their
+ * maximum CPU), each with its latest details and mean CPU and memory, so a
+ * short spike still shows up. Up to kTrackedProcessesPerTopN * top_n
+ * distinct processes are tracked per window; later newcomers are ignored
+ * until the next window. Cgroups are those of the latest sample.
+ *
+ * Storage is sized on the first window and reused, so steady-state
+ * aggregation does not allocate.
+ */
+class MetricsAggregator {
+public:
+    /// Distinct processes tracked per window, as a multiple of top_n.
+    static constexpr size_t kTrackedProcessesPerTopN = 4;
+
+    /**
+     * @param window_samples Samples per summary; 0 is treated as 1.
+     * @param top_n Processes reported per summary.
+     */
+    MetricsAggregator(size_t window_samples, size_t top_n);
+
+    size_t window_samples() const;
+
+    /**
+     * @brief Adds one collected sample.
+     * @param sample Snapshot from MetricsCollector::collect().
+     * @param summary Overwritten with the window summary when this sample completes a window.
+     * @return True if `summary` was written.
+     */
+    bool add(const SystemMetrics& sample, SystemMetrics& summary);
+
+private:
+    struct ProcessSlot {
+        ProcessMetrics latest;
+        RunningStats cpu_percent;
+        RunningStats memory_mb;
+    };
+
+    void add_families(const SystemMetrics& sample, uint32_t families);
+    void add_processes(const std::vector<ProcessMetrics>& processes);
+    void emit(const SystemMetrics& sample, SystemMetrics& summary);
+    void reset();
+
+    size_t window_samples_;
+    size_t top_n_;
+    size_t samples_ = 0;
+    int64_t start_timestamp_ms_ = 0;
+    uint32_t fresh_families_ = 0;
+    RunningStats total_cpu_;
+    RunningStats memory_used_;
+    std::vector<RunningStats> cores_;
+    std::vector<ProcessSlot> processes_; ///< First process_count_ slots are in use.
+    size_t process_count_ = 0;
+    std::vector<size_t> ranking_; ///< Slot indexes, reordered at each summary.
+};
@@ -1,10 +1,16 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <ctime>
+#include <memory>
+#include <unordered_map>
 #include <utility>
 
+#include "cpu_usage.h"
+
 /**
  * @struct ProcessMetrics
  * @brief Represents metrics for an individual process.
@@ -23,6 +29,63 @@ struct ProcessMetrics {
     int handle_count; ///< Number of process handles (or file descriptors on Linux).
 };
 
+/**
+ * @struct CgroupMetrics
+ * @brief Usage of one cgroup (a container or service), from the cgroup v2 hierarchy.
+ */
+struct CgroupMetrics {
+    std::string path; ///< Path below the hierarchy root.
+    double cpu_percent; ///< CPU usage percentage, on the same scale as ProcessMetrics::cpu_percent.
+    double memory_mb; ///< memory.current in MB.
+    double io_read_mb; ///< Read I/O volume in MB.
+    double io_write_mb; ///< Write I/O volume in MB.
+};
+
+/**
+ * @struct WindowStats
+ * @brief Summary of one metric over an aggregation window.
+ */
+struct WindowStats {
+    double min;
+    double max;
+    double mean;
+    double p95; ///< Estimated 95th percentile (exact up to five samples).
+};
+
+/**
+ * @struct ProcessWindowMetrics
+ * @brief Window statistics of one reported process.
+ */
+struct ProcessWindowMetrics {
+    int pid; ///< Same as the ProcessMetrics at this index of SystemMetrics::top_processes.
+    uint32_t samples; ///< Samples in which the process was among the top processes.
+    WindowStats cpu_percent;
+    WindowStats memory_mb;
+};
+
+/**
+ * @struct MetricsWindow
+ * @brief Statistics over the raw samples that a downsampled snapshot summarizes.
+ */
+struct MetricsWindow {
+    uint32_t samples; ///< Raw samples summarized; 0 for a snapshot that is a single sample.
+    int64_t start_timestamp_ms; ///< Collection time of the first sample.
+    WindowStats total_cpu_percent;
+    std::vector<WindowStats> per_core_cpu_percent;
+    WindowStats system_memory_used_mb;
+    std::vector<ProcessWindowMetrics> top_processes; ///< Aligned with SystemMetrics::top_processes.
+};
+
+/**
+ * @brief Bit flags for the metric families that can be sampled at their own rate.
+ */
+enum MetricFamily : uint32_t {
+    kMetricFamilyCpu = 1u << 0, ///< Total and per-core CPU.
+    kMetricFamilyMemory = 1u << 1, ///< System memory.
+    kMetricFamilyProcesses = 1u << 2, ///< Top processes and top cgroups.
+    kMetricFamilyAll = kMetricFamilyCpu | kMetricFamilyMemory | kMetricFamilyProcesses,
+};
+
 /**
  * @struct SystemMetrics
  * @brief Represents system-wide metrics.
@@ -32,13 +95,25 @@ struct ProcessMetrics {
  */
 struct SystemMetrics {
     time_t timestamp; ///< Timestamp of when the metrics were collected.
+    int64_t timestamp_ms; ///< Collection time in milliseconds since the Unix epoch.
     double total_cpu_percent; ///< Total CPU usage percentage.
     std::vector<double> per_core_cpu_percent; ///< CPU usage percentage per core.
     double system_memory_total_mb; ///< Total system memory in MB.
     double system_memory_used_mb; ///< Used system memory in MB.
     std::vector<ProcessMetrics> top_processes; ///< List of top processes by resource usage.
+    std::vector<CgroupMetrics> top_cgroups; ///< Top leaf cgroups by CPU usage (Linux, cgroup v2).
+    uint32_t fresh_families; ///< MetricFamily bits sampled for this snapshot; other families are carried over.
+    MetricsWindow window; ///< Set by MetricsAggregator; `window.samples` is 0 otherwise.
 };
 
+#if defined(__linux__)
+struct CgroupSample;
+class LinuxCgroupSource;
+class LinuxProcSource;
+class LinuxProcessScanner;
+class ProcessTable;
+#endif
+
 struct MetricsSelection {
     bool total_cpu = true;
     bool per_core_cpu = true;
@@ -47,6 +122,18 @@ struct MetricsSelection {
     bool process_threads = true;
     bool process_io = true;
     bool process_handles = true;
+    bool top_cgroups = true;
+};
+
+/**
+ * @struct CollectorOptions
+ * @brief Tuning options that change how MetricsCollector gathers data, not what it reports.
+ */
+struct CollectorOptions {
+    size_t collector_threads = 1; ///< Threads used to scan /proc for the process table (Linux only).
+    size_t top_n = 12; ///< Number of processes reported in SystemMetrics::top_processes, and of cgroups in top_cgroups.
+    std::string proc_root = "/proc"; ///< procfs root, e.g. a host's /proc mounted elsewhere or a recorded tree (Linux only).
+    std::string cgroup_root = "/sys/fs/cgroup"; ///< cgroup v2 mount point (Linux only).
 };
 
 /**
@@ -64,8 +151,11 @@ public:
      *
      * Initializes any platform-specific resources required for
      * collecting metrics.
+     *
+     * @param selection Metric groups to collect.
+     * @param options Collection tuning options.
      */
-    explicit MetricsCollector(const MetricsSelection& selection = {});
+    explicit MetricsCollector(const MetricsSelection& selection = {}, const CollectorOptions& options = {});
 
     /**
      * @brief Destructor for the MetricsCollector class.
@@ -83,6 +173,58 @@ public:
      */
     SystemMetrics collect();
 
+    /**
+     * @brief Collects system metrics into an existing snapshot.
+     * @param metrics Snapshot to overwrite; its vectors and strings are reused.
+     */
+    void collect(SystemMetrics& metrics);
+
+    /**
+     * @brief Re-samples only some metric families into an existing snapshot.
+     * @param metrics Snapshot to update; families not in `families` keep their values.
+     * @param families MetricFamily bits to sample.
+     *
+     * CPU deltas of each family are taken against that family's previous
+     * sample, so families collected at different rates stay self-consistent.
+     */
+    void collect(SystemMetrics& metrics, uint32_t families);
+
+    /**
+     * @brief Replaces the metric groups collected from the next collect() on.
+     *
+     * Call it from the collecting thread, between collections. The first
+     * CPU figures of a group turned back on cover the time since it was
+     * last sampled.
+     */
+    void set_selection(const MetricsSelection& selection);
+
+    /**
+     * @brief Tracks process starts and exits through the netlink proc
+     *        connector instead of listing /proc every cycle (Linux only).
+     * @param error_message Receives the reason on failure; collection then
+     *        keeps listing /proc as before.
+     */
+    bool enable_process_events(std::string& error_message);
+
+    /**
+     * @brief Reads per-process stat files through io_uring, one submission
+     *        per batch of PIDs (Linux, built with liburing).
+     * @param error_message Receives the reason on failure; collection then
+     *        keeps one open/read/close per file.
+     */
+    bool enable_io_uring(std::string& error_message);
+
+    /**
+     * @struct ProcessRankKey
+     * @brief Lightweight ranking key; full ProcessMetrics are built only for the top N.
+     */
+    struct ProcessRankKey {
+        int pid; ///< Process ID.
+        double cpu_percent; ///< Primary sort key, descending.
+        double memory_mb; ///< Secondary sort key, descending.
+        size_t index; ///< Position of the process in the platform scan results.
+    };
+
 private:
     /**
      * @brief Retrieves the total CPU usage percentage.
@@ -92,9 +234,9 @@ private:
 
     /**
      * @brief Retrieves per-core CPU usage percentages.
-     * @return A vector containing CPU usage percentage for each core.
+     * @param per_core_cpu Receives the CPU usage percentage of each core.
      */
-    std::vector<double> get_per_core_cpu();
+    void get_per_core_cpu(std::vector<double>& per_core_cpu);
 
     /**
      * @brief Retrieves total and used system memory in MB.
@@ -104,11 +246,63 @@ private:
 
     /**
      * @brief Retrieves information about the top resource-consuming processes.
-     * @return A vector of ProcessMetrics objects representing the top processes.
+     * @param processes Receives the top processes; existing elements are reused.
+     *
+     * CPU usage is the delta against the previous call, so the first call
+     * reports 0% for every process.
+     */
+    void get_top_processes(std::vector<ProcessMetrics>& processes);
+
+    /**
+     * @brief Retrieves the leaf cgroups with the highest CPU usage.
+     * @param cgroups Receives the top cgroups; existing elements are reused.
+     *
+     * Like get_top_processes, CPU usage is the delta against the previous
+     * call. Empty where no cgroup v2 hierarchy is mounted.
      */
-    std::vector<ProcessMetrics> get_top_processes();
+    void get_top_cgroups(std::vector<CgroupMetrics>& cgroups);
 
     MetricsSelection selection_;
+    CollectorOptions options_;
+
+#ifdef _WIN32
+    /**
+     * @struct ProcessCpuSample
+     * @brief Per-process CPU baseline kept between get_top_processes calls.
+     */
+    struct ProcessCpuSample {
+        uint64_t cpu_time; ///< Accumulated user + kernel CPU time.
+        uint64_t start_time; ///< Process start time; a mismatch means the PID was reused.
+    };
+
+    std::unordered_map<int, ProcessCpuSample> previous_process_samples_; ///< Per-PID CPU baseline from the previous get_top_processes call.
+#endif
+    uint64_t previous_cpu_idle_ = 0; ///< System-wide idle time seen by the previous get_total_cpu call.
+    uint64_t previous_cpu_total_ = 0; ///< System-wide CPU time seen by the previous get_total_cpu call.
+    bool has_previous_cpu_sample_ = false; ///< True once get_total_cpu has a baseline.
+    uint64_t previous_process_system_time_ = 0; ///< System-wide CPU time seen by the previous get_top_processes call.
+    bool has_previous_process_sample_ = false; ///< True once a baseline process sample exists.
+    std::vector<ProcessRankKey> rank_keys_; ///< Reused ranking buffer for get_top_processes.
+
+#if defined(__linux__)
+    std::unique_ptr<LinuxProcSource> proc_source_; ///< Persistent /proc/stat and /proc/meminfo readers.
+    std::unique_ptr<LinuxProcessScanner> process_scanner_; ///< Parallel /proc/[pid]/stat scanner.
+    std::unique_ptr<ProcessTable> process_table_; ///< Flat per-PID table holding the CPU baseline between scans.
+    CpuCounterArrays previous_core_counters_; ///< Per-core counters of the previous get_per_core_cpu call.
+    CpuCounterArrays current_core_counters_; ///< Swapped with previous_core_counters_ after each call.
+    bool has_previous_core_sample_ = false; ///< True once get_per_core_cpu has a baseline.
+    std::unique_ptr<LinuxCgroupSource> cgroup_source_; ///< Leaf cgroup reader.
+    std::vector<CgroupSample> cgroup_samples_; ///< Reused cgroup scan buffer.
+    /// usage_usec of a cgroup at the last get_top_cgroups call that saw it.
+    struct CgroupCpuBaseline {
+        uint64_t usage_usec;
+        uint64_t seen_cycle;
+    };
+    std::unordered_map<std::string, CgroupCpuBaseline> cgroup_cpu_baselines_; ///< Per-cgroup baselines, updated in place; entries not seen in a call are swept.
+    uint64_t cgroup_cycle_ = 0; ///< Number of get_top_cgroups calls that scanned the hierarchy.
+    uint64_t previous_cgroup_system_time_ = 0; ///< System-wide CPU time seen by the previous get_top_cgroups call.
+    bool has_previous_cgroup_sample_ = false; ///< True once a baseline cgroup sample exists.
+#endif
 
 #ifdef _WIN32
     /**
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+
+/**
+ * @class MetricsEndpoint
+ * @brief Minimal HTTP server answering `GET /metrics` for Prometheus scrapes.
+ *
+ * One background thread accepts connections and serves them one at a time:
+ * every response is rendered fresh, sent with `Connection: close`, and any
+ * other path gets a 404. Reads and writes time out after a second, so a
+ * stuck client cannot hold the thread. It is meant for a local scraper and
+ * binds to 127.0.0.1 unless told otherwise.
+ *
+ * Only POSIX systems are supported; start() fails elsewhere.
+ */
+class MetricsEndpoint {
+public:
+    /// Appends the response body (Prometheus text format) to its argument.
+    using Renderer = std::function<void(std::string&)>;
+
+    /**
+     * @param address IPv4 address to bind.
+     * @param port TCP port; 0 picks a free one (see port()).
+     * @param render Called on the server thread for every scrape.
+     */
+    MetricsEndpoint(std::string address, uint16_t port, Renderer render);
+    ~MetricsEndpoint();
+
+    MetricsEndpoint(const MetricsEndpoint&) = delete;
+    MetricsEndpoint& operator=(const MetricsEndpoint&) = delete;
+
+    /**
+     * @brief Binds the socket and starts the server thread.
+     * @param error_message Receives the reason on failure.
+     */
+    bool start(std::string& error_message);
+
+    /**
+     * @brief Stops the server thread and closes the socket. Idempotent.
+     */
+    void stop();
+
+    /**
+     * @brief Port the server listens on, once started.
+     */
+    uint16_t port() const;
+
+private:
+    void run();
+    void serve(int client_fd);
+
+    std::string address_;
+    uint16_t port_;
+    Renderer render_;
+    int listen_fd_ = -1;
+    std::atomic<bool> stopping_{false};
+    std::thread thread_;
+    std::string request_;
+    std::string body_;
+    std::string response_;
+};
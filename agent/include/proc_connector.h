@@ -0,0 +1,82 @@
+#pragma once
+
+#if defined(__linux__)
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @struct ProcessEvent
+ * @brief A process (not thread) starting or exiting, as reported by the kernel.
+ */
+struct ProcessEvent {
+    enum class Kind : uint8_t {
+        started, ///< fork of a new process, or exec (the PID is alive either way).
+        exited
+    };
+
+    Kind kind;
+    int pid;
+};
+
+/**
+ * @class ProcConnector
+ * @brief Subscription to the kernel's netlink proc connector.
+ *
+ * The kernel multicasts fork, exec and exit events to every listener; this
+ * keeps only those of whole processes (thread group leaders) and drops
+ * thread events. The socket is non-blocking and drained by poll(), so no
+ * extra thread is involved: events queue in the socket buffer between
+ * collection cycles. If that buffer overflows, events are lost and poll()
+ * reports it so the caller can fall back to a full /proc listing. Forks
+ * and exits also count towards the agent telemetry.
+ *
+ * Subscribing needs CAP_NET_ADMIN; open() fails with EPERM otherwise.
+ */
+class ProcConnector {
+public:
+    ProcConnector() = default;
+    ~ProcConnector();
+
+    ProcConnector(const ProcConnector&) = delete;
+    ProcConnector& operator=(const ProcConnector&) = delete;
+
+    /**
+     * @brief Opens the netlink socket and subscribes to process events.
+     * @param error_message Receives the reason on failure.
+     */
+    bool open(std::string& error_message);
+
+    /**
+     * @brief Appends every queued event to `events` without blocking.
+     * @return False if events were lost since the previous call (socket
+     *         buffer overflow); the events that were read are still appended.
+     */
+    bool poll(std::vector<ProcessEvent>& events);
+
+    bool is_open() const;
+
+private:
+    int fd_ = -1;
+    std::vector<char> buffer_;
+};
+
+/**
+ * @brief Applies events in order to a sorted PID list.
+ *
+ * Started PIDs are inserted, exited PIDs removed; a PID that exits and is
+ * reused within the batch ends up present. Runs in one merge pass over
+ * `pids`, however many events there are. The scratch vectors are kept by
+ * the caller between calls, so once they have grown nothing is allocated.
+ *
+ * @param pids Ascending, duplicate-free PIDs; stays that way.
+ * @param events Events in the order the kernel reported them.
+ * @param changed Scratch: the events sorted by PID.
+ * @param merged Scratch: the next PID list, swapped with `pids`.
+ */
+void apply_process_events(std::vector<int>& pids, const std::vector<ProcessEvent>& events,
+                          std::vector<uint64_t>& changed, std::vector<int>& merged);
+
+#endif
@@ -0,0 +1,224 @@
+#pragma once
+
+#if defined(__linux__)
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @struct LinuxCpuTimes
+ * @brief Aggregated jiffy counters for one `cpu` line of /proc/stat.
+ */
+struct LinuxCpuTimes {
+    uint64_t idle_time; ///< idle + iowait jiffies.
+    uint64_t total_time; ///< Sum of user, nice, system, idle, iowait, irq, softirq and steal jiffies.
+};
+
+/**
+ * @class ProcRoot
+ * @brief Directory the Linux readers treat as /proc.
+ *
+ * "/proc" unless configured otherwise: a host's procfs bind-mounted into a
+ * container (for example /host/proc), or a tree written by `proc_capture
+ * record`. Such a copy is not a real procfs, so shortcuts that only procfs
+ * offers (the entry count as the size of /proc/[pid]/fd) are skipped for it.
+ */
+class ProcRoot {
+public:
+    /// Longest accepted root path, so per-PID paths fit in a stack buffer.
+    static constexpr size_t kMaxPathLength = 192;
+
+    /**
+     * @param path Root directory; trailing slashes are ignored.
+     */
+    explicit ProcRoot(std::string path = "/proc");
+
+    const std::string& path() const;
+
+    /**
+     * @brief True if the root is a mounted procfs rather than a copy.
+     */
+    bool is_procfs() const;
+
+    /**
+     * @brief Path of an entry directly below the root, such as "<root>/stat".
+     */
+    std::string file(std::string_view name) const;
+
+    /**
+     * @brief Writes "<root>/<pid><suffix>" into `out` without allocating.
+     * @return False if `pid` is not positive or the path does not fit.
+     */
+    bool format_pid_path(char* out, size_t capacity, int pid, std::string_view suffix) const;
+
+private:
+    std::string path_;
+    bool is_procfs_;
+};
+
+/**
+ * @brief The shared ProcRoot for "/proc".
+ */
+const ProcRoot& default_proc_root();
+
+/**
+ * @class ProcFile
+ * @brief A procfs file that stays open and is re-read with pread.
+ *
+ * The descriptor is opened lazily on the first read and reused afterwards.
+ * Contents are read into a buffer owned by the instance, which only grows,
+ * so steady-state reads perform one syscall and no allocation.
+ */
+class ProcFile {
+public:
+    /**
+     * @brief Creates a reader for the given procfs path.
+     * @param path Absolute path, for example /proc/stat.
+     */
+    explicit ProcFile(std::string path);
+
+    /**
+     * @brief Closes the underlying descriptor.
+     */
+    ~ProcFile();
+
+    ProcFile(const ProcFile&) = delete;
+    ProcFile& operator=(const ProcFile&) = delete;
+
+    /**
+     * @brief Reads the whole file from offset 0.
+     * @param contents Receives a view into the internal buffer, valid until the next read.
+     * @return True if the file was read, false if it could not be opened or read.
+     */
+    bool read(std::string_view& contents);
+
+private:
+    void close_descriptor();
+
+    std::string path_; ///< Path passed to open(2).
+    int fd_ = -1; ///< Cached descriptor, -1 until the first successful open.
+    std::vector<char> buffer_; ///< Reusable read buffer.
+};
+
+/**
+ * @class LinuxProcSource
+ * @brief System-wide procfs counters backed by persistent descriptors.
+ *
+ * Owns open handles to /proc/stat and /proc/meminfo. refresh_cpu_times()
+ * reads /proc/stat once and parses both the aggregate and per-core lines, so
+ * every consumer in a collection cycle shares one read.
+ */
+class LinuxProcSource {
+public:
+    explicit LinuxProcSource(const ProcRoot& root = default_proc_root());
+
+    /**
+     * @brief Re-reads /proc/stat and updates the cached CPU counters.
+     * @return True if the aggregate `cpu` line was parsed.
+     */
+    bool refresh_cpu_times();
+
+    /**
+     * @brief Whether the last refresh_cpu_times() call succeeded.
+     */
+    bool has_cpu_times() const;
+
+    /**
+     * @brief Aggregate counters from the last refresh.
+     */
+    const LinuxCpuTimes& total_cpu_times() const;
+
+    /**
+     * @brief Per-core counters from the last refresh, in `cpuN` order.
+     */
+    const std::vector<LinuxCpuTimes>& per_core_cpu_times() const;
+
+    /**
+     * @brief Reads MemTotal and MemAvailable from /proc/meminfo.
+     * @param total_kb Receives MemTotal in kB.
+     * @param available_kb Receives MemAvailable in kB.
+     * @return True if /proc/meminfo was read.
+     */
+    bool read_memory_info(uint64_t& total_kb, uint64_t& available_kb);
+
+private:
+    ProcFile stat_file_;
+    ProcFile meminfo_file_;
+    bool has_cpu_times_ = false;
+    LinuxCpuTimes total_cpu_times_{0, 0};
+    std::vector<LinuxCpuTimes> per_core_cpu_times_;
+};
+
+/**
+ * @struct LinuxPidStat
+ * @brief Fields of /proc/[pid]/stat used by the collector.
+ */
+struct LinuxPidStat {
+    std::string_view name; ///< Command name (comm) without parentheses; views the parsed buffer.
+    uint64_t utime_ticks; ///< Field 14: user-mode CPU time in clock ticks.
+    uint64_t stime_ticks; ///< Field 15: kernel-mode CPU time in clock ticks.
+    int num_threads; ///< Field 20: number of threads.
+    uint64_t start_time_ticks; ///< Field 22: process start time since boot, used to detect PID reuse.
+    uint64_t rss_pages; ///< Field 24: resident set size in pages.
+};
+
+/**
+ * @brief Size of the stack buffer callers should pass to read_linux_pid_stat.
+ *
+ * The fields we need end well before the first kilobyte of the line, so a
+ * truncated read still parses.
+ */
+constexpr size_t kLinuxPidStatBufferSize = 1024;
+
+/**
+ * @brief Parses /proc/[pid]/stat contents in place without allocating.
+ * @param contents File contents; only the fields up to rss are inspected.
+ * @param stat Receives the parsed fields. `name` points into `contents`.
+ * @return True if all required fields were present and numeric.
+ */
+bool parse_linux_pid_stat(std::string_view contents, LinuxPidStat& stat);
+
+/**
+ * @brief Reads and parses /proc/[pid]/stat into a caller-provided buffer.
+ * @param pid Process ID.
+ * @param buffer Scratch buffer, typically on the caller's stack.
+ * @param capacity Size of `buffer` in bytes.
+ * @param stat Receives the parsed fields. `name` points into `buffer`.
+ * @param root procfs root to read from.
+ * @return True if the file was read and parsed.
+ */
+bool read_linux_pid_stat(int pid, char* buffer, size_t capacity, LinuxPidStat& stat, const ProcRoot& root = default_proc_root());
+
+/**
+ * @brief Counts open file descriptors of a process.
+ * @param pid Process ID.
+ * @param fd_count Receives the number of entries in /proc/[pid]/fd.
+ * @param root procfs root to read from.
+ * @return True if the fd directory could be inspected.
+ *
+ * This is the most expensive per-process probe, so callers should only run
+ * it for processes that are actually reported.
+ */
+bool read_linux_pid_fd_count(int pid, int& fd_count, const ProcRoot& root = default_proc_root());
+
+/**
+ * @brief Reads storage I/O byte counters from /proc/[pid]/io.
+ * @param pid Process ID.
+ * @param read_bytes Receives `read_bytes`.
+ * @param write_bytes Receives `write_bytes`.
+ * @param root procfs root to read from.
+ * @return True if the file was read (it needs ptrace access to the process).
+ */
+bool read_linux_pid_io(int pid, uint64_t& read_bytes, uint64_t& write_bytes, const ProcRoot& root = default_proc_root());
+
+/**
+ * @brief Parses the counters of one /proc/stat `cpu` line.
+ * @param line Line without the trailing newline, starting with the `cpu` label.
+ * @param times Receives the aggregated counters.
+ * @return True if at least the user, nice, system and idle fields were parsed.
+ */
+bool parse_linux_cpu_line(std::string_view line, LinuxCpuTimes& times);
+
+#endif
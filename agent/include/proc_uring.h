@@ -0,0 +1,66 @@
+#pragma once
+
+#if defined(__linux__)
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include "proc_source.h"
+
+/**
+ * @class ProcUringReader
+ * @brief Reads /proc/[pid]/stat for a batch of PIDs with one io_uring submission.
+ *
+ * The plain path costs open, read and close per PID. Here each PID gets a
+ * hard-linked openat → read → close chain on a direct descriptor (a slot
+ * of the ring's file table, so no fd is ever installed in the process), and
+ * a whole batch is submitted and reaped with a single io_uring_enter.
+ *
+ * Only compiled in when CMake finds liburing (METRICS_AGENT_HAVE_LIBURING);
+ * needs liburing 2.2 and Linux 5.15 for direct descriptors. open() fails
+ * otherwise, and when the kernel or a seccomp profile refuses io_uring, so
+ * the caller keeps the syscall path. One reader serves one thread.
+ */
+class ProcUringReader {
+public:
+    /// PIDs per submission; every PID uses three submission queue entries.
+    static constexpr size_t kBatchSize = 64;
+
+    ProcUringReader();
+    ~ProcUringReader();
+
+    ProcUringReader(const ProcUringReader&) = delete;
+    ProcUringReader& operator=(const ProcUringReader&) = delete;
+
+    /**
+     * @brief Sets up the ring and checks that it can read `<root>/stat`.
+     * @param root procfs root the PID paths are built from; must outlive the reader.
+     * @param error_message Receives the reason on failure.
+     */
+    bool open(const ProcRoot& root, std::string& error_message);
+
+    /**
+     * @brief Reads the stat file of up to kBatchSize PIDs.
+     * @param pids PIDs to read.
+     * @param count Number of PIDs, at most kBatchSize.
+     * @param lengths Receives the bytes read per PID, 0 where the read failed
+     *        (typically because the process exited).
+     * @return False if the submission itself failed; the caller should read
+     *         this batch the plain way.
+     */
+    bool read_stats(const int* pids, size_t count, size_t* lengths);
+
+    /**
+     * @brief Contents read for PID `index` of the last batch.
+     */
+    const char* buffer(size_t index) const;
+
+private:
+    struct Ring;
+
+    std::unique_ptr<Ring> ring_;
+    const ProcRoot* root_ = nullptr;
+};
+
+#endif
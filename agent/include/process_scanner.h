@@ -0,0 +1,131 @@
+#pragma once
+
+#if defined(__linux__)
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "metrics_collector.h"
+#include "proc_source.h"
+#include "process_table.h"
+
+class ProcConnector;
+class ProcUringReader;
+struct ProcessEvent;
+
+/**
+ * @class LinuxProcessScanner
+ * @brief Enumerates /proc and reads every process's stat file, optionally in parallel.
+ *
+ * PIDs are sorted and laid out as rows of a ProcessScanBuffer. Up to
+ * `worker_count` threads claim fixed-size batches of rows from a shared
+ * cursor and fill them in place, so there is nothing to merge afterwards.
+ * The buffer is kept between scans so steady-state scans do not reallocate.
+ * The caller is one of the threads; the others are started by the first
+ * scan large enough to use them and stay parked on a condition variable
+ * between scans until the scanner is destroyed.
+ *
+ * With process events enabled, the PID list is kept up to date from the
+ * netlink proc connector instead: only the first scan (and any scan after
+ * the kernel dropped events) lists the root directory, the others apply
+ * the fork/exec/exit events seen since the previous scan. PIDs whose stat
+ * read fails are dropped from the list as well.
+ *
+ * With io_uring enabled, each worker reads its batch of stat files through
+ * its own ProcUringReader, one submission per batch instead of three
+ * syscalls per PID.
+ */
+class LinuxProcessScanner {
+public:
+    /**
+     * @brief Creates a scanner.
+     * @param worker_count Number of threads used per scan, including the caller. 0 is treated as 1.
+     * @param root procfs root to enumerate.
+     */
+    explicit LinuxProcessScanner(size_t worker_count = 1, ProcRoot root = ProcRoot());
+    ~LinuxProcessScanner();
+
+    LinuxProcessScanner(const LinuxProcessScanner&) = delete;
+    LinuxProcessScanner& operator=(const LinuxProcessScanner&) = delete;
+
+    /**
+     * @brief Switches PID discovery to proc connector events.
+     * @param error_message Receives the reason if the subscription failed;
+     *        the scanner then keeps listing the root directory.
+     *
+     * The events carry PIDs of the initial PID namespace, so the root
+     * should be the host's procfs.
+     */
+    bool enable_process_events(std::string& error_message);
+
+    bool process_events_enabled() const;
+
+    /**
+     * @brief Reads stat files through one io_uring per worker.
+     * @param error_message Receives the reason if a ring could not be set
+     *        up; the scanner then keeps the plain open/read/close path.
+     */
+    bool enable_io_uring(std::string& error_message);
+
+    bool io_uring_enabled() const;
+
+    /**
+     * @brief Number of threads used per scan.
+     */
+    size_t worker_count() const;
+
+    /**
+     * @brief procfs root the scanner reads.
+     */
+    const ProcRoot& root() const;
+
+    /**
+     * @brief Lists PIDs under the root and reads their stat files.
+     * @param selection Metric selection; controls whether thread counts are kept.
+     * @return One row per listed PID in ascending PID order; rows that could not
+     *         be read are marked invalid. The reference stays valid until the next scan.
+     */
+    const ProcessScanBuffer& scan(const MetricsSelection& selection);
+
+private:
+    bool list_pids();
+
+    bool update_pids();
+
+    void start_workers();
+
+    void run_worker(size_t worker);
+
+    ProcUringReader* reader_for(size_t worker) const;
+
+    size_t worker_count_;
+    ProcRoot root_;
+    std::unique_ptr<ProcConnector> connector_;
+    std::vector<ProcessEvent> events_;
+    std::vector<uint64_t> changed_pids_; ///< Scratch of apply_process_events.
+    std::vector<int> merged_pids_;       ///< Scratch of apply_process_events, swapped with pids_.
+    std::vector<std::unique_ptr<ProcUringReader>> uring_readers_; ///< One per worker, or empty.
+    bool needs_listing_ = true;
+    std::vector<int> pids_;
+    ProcessScanBuffer buffer_;
+
+    std::vector<std::thread> workers_; ///< worker_count - 1 helpers once started.
+    std::mutex workers_mutex_;
+    std::condition_variable scan_started_;
+    std::condition_variable scan_finished_;
+    uint64_t scan_generation_ = 0;  ///< Bumped for every scan that uses the helpers.
+    size_t scan_workers_ = 1;       ///< Threads taking part in the current scan, including the caller.
+    size_t busy_workers_ = 0;       ///< Helpers still filling rows of the current scan.
+    bool include_threads_ = true;
+    bool stopping_ = false;
+    std::atomic<size_t> cursor_{0};
+};
+
+#endif
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @struct ProcessScanBuffer
+ * @brief Structure-of-arrays scratch space for one process scan.
+ *
+ * Row `i` describes `pids[i]`. Scanner workers fill disjoint rows in place,
+ * so a parallel scan needs no merge step. Rows whose stat read failed keep
+ * `valid[i] == 0`. Storage is reused between scans.
+ */
+struct ProcessScanBuffer {
+    /// Bytes reserved per row for the command name (kernel threads can exceed TASK_COMM_LEN).
+    static constexpr size_t kNameSlotSize = 64;
+
+    std::vector<int> pids; ///< Process IDs in ascending order.
+    std::vector<uint64_t> cpu_times; ///< utime + stime in clock ticks.
+    std::vector<uint64_t> start_times; ///< Start time since boot in clock ticks.
+    std::vector<uint64_t> rss_pages; ///< Resident set size in pages.
+    std::vector<int> thread_counts; ///< Thread counts, 0 when not selected.
+    std::vector<uint8_t> valid; ///< 1 if the row was read successfully.
+    std::vector<uint8_t> name_lengths; ///< Name length per row.
+    std::vector<char> names; ///< kNameSlotSize bytes per row.
+
+    /**
+     * @brief Resizes every column to `rows` rows; does not shrink capacity.
+     */
+    void resize(size_t rows);
+
+    /**
+     * @brief Number of rows.
+     */
+    size_t size() const;
+
+    /**
+     * @brief Stores a row's name, truncating it to the slot size.
+     */
+    void set_name(size_t row, std::string_view name);
+
+    /**
+     * @brief Name of a row.
+     */
+    std::string_view name(size_t row) const;
+};
+
+/**
+ * @class ProcessNamePool
+ * @brief Interned storage for process names.
+ *
+ * Identical names (a host runs many `postgres` or `kworker` tasks) share one
+ * entry. The table compacts the pool once exited processes leave too much
+ * unreferenced text behind.
+ */
+class ProcessNamePool {
+public:
+    /**
+     * @brief Returns the ID of `name`, adding it if needed.
+     */
+    uint32_t intern(std::string_view name);
+
+    /**
+     * @brief Returns the text of an interned name.
+     */
+    std::string_view view(uint32_t id) const;
+
+    /**
+     * @brief Number of distinct names stored.
+     */
+    size_t size() const;
+
+    /**
+     * @brief Removes every name.
+     */
+    void clear();
+
+private:
+    std::unordered_map<std::string, uint32_t> index_; ///< Name -> ID; node keys are address-stable.
+    std::vector<const std::string*> names_by_id_; ///< ID -> key stored in index_.
+};
+
+/**
+ * @class ProcessTable
+ * @brief Persistent structure-of-arrays view of the process population.
+ *
+ * update() joins a new scan with the previous one by walking both sorted PID
+ * columns once. Columns are double-buffered, so steady-state updates do not
+ * allocate. After an update, row `i` holds the current counters of `pid(i)`
+ * and the CPU ticks it consumed since the previous update.
+ */
+class ProcessTable {
+public:
+    /**
+     * @brief Replaces the table with the valid rows of `scan`.
+     * @param scan Scan results with PIDs in ascending order.
+     *
+     * A row gets a CPU delta when the same PID with the same start time was
+     * present in the previous update; new and reused PIDs report 0.
+     */
+    void update(const ProcessScanBuffer& scan);
+
+    /**
+     * @brief Number of processes in the table.
+     */
+    size_t size() const;
+
+    int pid(size_t row) const;
+    uint64_t cpu_ticks_delta(size_t row) const;
+    uint64_t rss_pages(size_t row) const;
+    int thread_count(size_t row) const;
+    std::string_view name(size_t row) const;
+
+    /**
+     * @brief CPU delta column, parallel to the rows.
+     */
+    const std::vector<uint64_t>& cpu_ticks_deltas() const;
+
+    /**
+     * @brief RSS column, parallel to the rows.
+     */
+    const std::vector<uint64_t>& rss_pages_column() const;
+
+    /**
+     * @brief Distinct names currently held in the name pool.
+     */
+    size_t interned_name_count() const;
+
+private:
+    struct Columns {
+        std::vector<int> pids;
+        std::vector<uint64_t> cpu_times;
+        std::vector<uint64_t> start_times;
+        std::vector<uint64_t> previous_cpu_times;
+        std::vector<uint64_t> cpu_deltas;
+        std::vector<uint64_t> rss_pages;
+        std::vector<int> thread_counts;
+        std::vector<uint32_t> name_ids;
+
+        void clear();
+        void reserve(size_t rows);
+    };
+
+    void compact_names();
+
+    Columns current_;
+    Columns next_;
+    ProcessNamePool names_;
+};
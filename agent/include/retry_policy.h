@@ -0,0 +1,124 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+
+/**
+ * @struct RetryPolicy
+ * @brief Retry and circuit-breaker settings of HttpClient.
+ */
+struct RetryPolicy {
+    size_t max_attempts = 3; ///< Attempts per send, the first one included; 1 disables retries.
+    std::chrono::milliseconds base_delay{250}; ///< Backoff before the first retry.
+    std::chrono::milliseconds max_delay{10000}; ///< Longest wait inside one send; longer Retry-After values open the breaker instead.
+    size_t breaker_failure_threshold = 5; ///< Consecutive failed sends that open the breaker.
+    std::chrono::milliseconds breaker_open{5000}; ///< First cool-down; doubles while probes keep failing.
+    std::chrono::milliseconds breaker_max_open{120000}; ///< Upper bound of the cool-down.
+};
+
+/**
+ * @brief Whether a failed request is worth repeating.
+ *
+ * Transport failures (no HTTP status) and 429, 502, 503 and 504 are
+ * transient; any other status means the backend rejected the request itself.
+ */
+bool is_retryable_status(long http_status);
+
+/**
+ * @class JitteredBackoff
+ * @brief Exponential backoff with "equal jitter".
+ *
+ * The delay for attempt `n` is drawn uniformly from `[d/2, d]` with
+ * `d = min(max, base * 2^n)`. Keeping half of the exponential delay keeps the
+ * backoff meaningful; the random half spreads out agents that failed at the
+ * same moment, so they do not retry in lockstep when the backend comes back.
+ */
+class JitteredBackoff {
+public:
+    /**
+     * @param seed Random seed; 0 picks one from `std::random_device`.
+     */
+    JitteredBackoff(std::chrono::milliseconds base, std::chrono::milliseconds max, uint32_t seed = 0);
+
+    /**
+     * @brief Delay before retry number `attempt` (0-based).
+     */
+    std::chrono::milliseconds delay(size_t attempt);
+
+private:
+    std::chrono::milliseconds base_;
+    std::chrono::milliseconds max_;
+    std::minstd_rand random_;
+};
+
+/**
+ * @brief States of CircuitBreaker.
+ */
+enum class CircuitState {
+    closed, ///< Requests go out normally.
+    open, ///< Requests fail fast until the cool-down ends.
+    half_open ///< One probe request is allowed; its outcome closes or re-opens the breaker.
+};
+
+/**
+ * @class CircuitBreaker
+ * @brief Stops sending to a backend that keeps failing, then probes it.
+ *
+ * `breaker_failure_threshold` consecutive failures open the breaker for a
+ * jittered cool-down. The first allow() after the cool-down moves it to
+ * half-open and lets one request through: success closes the breaker,
+ * failure re-opens it with twice the cool-down. A failure that carries a
+ * Retry-After opens the breaker at once, for at least that long.
+ *
+ * Not thread-safe; time is passed in so the state machine can be tested
+ * without sleeping.
+ */
+class CircuitBreaker {
+public:
+    /**
+     * @param seed Jitter seed; 0 picks one from `std::random_device`.
+     */
+    explicit CircuitBreaker(const RetryPolicy& policy, uint32_t seed = 0);
+
+    /**
+     * @brief Whether a request may be sent at `now`.
+     */
+    bool allow(std::chrono::steady_clock::time_point now);
+
+    /**
+     * @brief Records a request the backend answered; closes the breaker.
+     */
+    void record_success();
+
+    /**
+     * @brief Records a transient failure.
+     * @param retry_after Cool-down requested by the backend and not already
+     *        waited out, 0 if none.
+     */
+    void record_failure(std::chrono::steady_clock::time_point now, std::chrono::milliseconds retry_after);
+
+    CircuitState state() const;
+
+    /**
+     * @brief End of the current cool-down; only meaningful while open.
+     */
+    std::chrono::steady_clock::time_point retry_at() const;
+
+    /**
+     * @brief Number of times the breaker has opened.
+     */
+    uint64_t open_count() const;
+
+private:
+    void open(std::chrono::steady_clock::time_point now, std::chrono::milliseconds retry_after);
+
+    size_t failure_threshold_;
+    JitteredBackoff cool_down_;
+    CircuitState state_ = CircuitState::closed;
+    size_t consecutive_failures_ = 0;
+    size_t consecutive_opens_ = 0;
+    uint64_t open_count_ = 0;
+    std::chrono::steady_clock::time_point retry_at_{};
+};
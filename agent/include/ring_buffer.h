@@ -0,0 +1,226 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+/**
+ * @class BoundedRing
+ * @brief Bounded single-producer/single-consumer ring with drop-oldest overflow.
+ *
+ * Slots are allocated once at construction. push() and try_pop() swap
+ * values with the slot instead of moving them out, so the storage owned by
+ * a `T` (vector capacity, string buffers) circulates between the producer,
+ * the ring and the consumer rather than being freed and reallocated.
+ *
+ * Each slot carries a sequence number (Vyukov-style). The producer owns the
+ * tail; the head is advanced with a CAS because a full ring lets the producer
+ * discard the oldest element itself. Neither side takes a lock except when
+ * the consumer is parked in wait_pop().
+ *
+ * @tparam T Default-constructible, swappable element type.
+ */
+template <typename T>
+class BoundedRing {
+public:
+    /**
+     * @brief Creates a ring holding at most `capacity` elements.
+     * @param capacity Maximum occupancy; must be greater than 0.
+     */
+    explicit BoundedRing(size_t capacity)
+        : capacity_(capacity),
+          slots_(new Slot[capacity]) {
+        for (size_t i = 0; i < capacity_; ++i) {
+            slots_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    BoundedRing(const BoundedRing&) = delete;
+    BoundedRing& operator=(const BoundedRing&) = delete;
+
+    /**
+     * @brief Appends an element, discarding the oldest one if the ring is full.
+     *
+     * Producer only. `item` is swapped into its slot, so on return it holds
+     * whatever the slot held before (a default value, or storage handed back
+     * by the consumer) and can be overwritten for the next push.
+     *
+     * @param item Element to append; receives recycled storage.
+     * @return True if the oldest element was dropped to make room.
+     */
+    bool push(T& item) {
+        bool dropped_oldest = false;
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        Slot& slot = slots_[tail % capacity_];
+
+        while (slot.sequence.load(std::memory_order_acquire) != tail) {
+            size_t head = head_.load(std::memory_order_acquire);
+            if (tail - head >= capacity_) {
+                // Full: the unread element in this slot is the oldest one.
+                // Claim it like a consumer would, then release the slot.
+                if (head_.compare_exchange_strong(head, head + 1, std::memory_order_acq_rel)) {
+                    slot.sequence.store(head + capacity_, std::memory_order_release);
+                    dropped_.fetch_add(1, std::memory_order_relaxed);
+                    dropped_oldest = true;
+                }
+            } else {
+                // The consumer has claimed this slot and is still swapping it out.
+                std::this_thread::yield();
+            }
+        }
+
+        using std::swap;
+        swap(slot.value, item);
+        slot.sequence.store(tail + 1, std::memory_order_release);
+        pushed_.fetch_add(1, std::memory_order_relaxed);
+
+        // The tail store and the waiting_ load are sequentially consistent, as
+        // are their counterparts in wait_pop(): either the consumer sees the
+        // new element on its re-check, or we see it waiting and wake it.
+        tail_.store(tail + 1, std::memory_order_seq_cst);
+        if (waiting_.load(std::memory_order_seq_cst)) {
+            std::lock_guard<std::mutex> lock(wait_mutex_);
+            wait_cv_.notify_one();
+        }
+        return dropped_oldest;
+    }
+
+    /**
+     * @brief Takes the oldest element without blocking.
+     *
+     * Consumer only. The element is swapped into `out`, and the previous
+     * contents of `out` go back into the slot for the producer to reuse.
+     *
+     * @param out Receives the element.
+     * @return True if an element was taken, false if the ring was empty.
+     */
+    bool try_pop(T& out) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        while (true) {
+            Slot& slot = slots_[head % capacity_];
+            const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            const std::ptrdiff_t ready = static_cast<std::ptrdiff_t>(sequence - (head + 1));
+
+            if (ready == 0) {
+                if (head_.compare_exchange_weak(head, head + 1, std::memory_order_acq_rel)) {
+                    using std::swap;
+                    swap(slot.value, out);
+                    slot.sequence.store(head + capacity_, std::memory_order_release);
+                    return true;
+                }
+                // head was reloaded by the failed CAS.
+            } else if (ready < 0) {
+                return false;
+            } else {
+                // The producer dropped this element; the head has moved on.
+                head = head_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * @brief Takes the oldest element, blocking until one is available.
+     *
+     * Consumer only. Elements pushed before close() are still delivered.
+     *
+     * @param out Receives the element.
+     * @return True if an element was taken, false once the ring is closed and empty.
+     */
+    bool wait_pop(T& out) {
+        while (true) {
+            if (try_pop(out)) {
+                return true;
+            }
+            if (closed_.load(std::memory_order_acquire)) {
+                return try_pop(out);
+            }
+
+            std::unique_lock<std::mutex> lock(wait_mutex_);
+            waiting_.store(true, std::memory_order_seq_cst);
+            if (!empty() || closed_.load(std::memory_order_acquire)) {
+                waiting_.store(false, std::memory_order_relaxed);
+                continue;
+            }
+            wait_cv_.wait(lock);
+            waiting_.store(false, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * @brief Wakes the consumer; wait_pop() returns false once the ring drains.
+     */
+    void close() {
+        closed_.store(true, std::memory_order_release);
+        std::lock_guard<std::mutex> lock(wait_mutex_);
+        wait_cv_.notify_all();
+    }
+
+    /**
+     * @brief True after close().
+     */
+    bool closed() const {
+        return closed_.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Current occupancy; a snapshot that may be stale by the time it is read.
+     */
+    size_t size() const {
+        const size_t head = head_.load(std::memory_order_seq_cst);
+        const size_t tail = tail_.load(std::memory_order_seq_cst);
+        return tail > head ? tail - head : 0;
+    }
+
+    /**
+     * @brief True if size() is 0.
+     */
+    bool empty() const {
+        return size() == 0;
+    }
+
+    /**
+     * @brief Maximum occupancy.
+     */
+    size_t capacity() const {
+        return capacity_;
+    }
+
+    /**
+     * @brief Total elements pushed since construction.
+     */
+    size_t pushed() const {
+        return pushed_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Total elements discarded by drop-oldest overflow since construction.
+     */
+    size_t dropped() const {
+        return dropped_.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Slot {
+        std::atomic<size_t> sequence{0};
+        T value{};
+    };
+
+    const size_t capacity_;
+    std::unique_ptr<Slot[]> slots_;
+
+    // Head and tail sit on separate cache lines so the two threads do not
+    // bounce one line on every push and pop.
+    alignas(64) std::atomic<size_t> head_{0};
+    alignas(64) std::atomic<size_t> tail_{0};
+
+    alignas(64) std::atomic<size_t> pushed_{0};
+    std::atomic<size_t> dropped_{0};
+    std::atomic<bool> closed_{false};
+    std::atomic<bool> waiting_{false};
+    std::mutex wait_mutex_;
+    std::condition_variable wait_cv_;
+};
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "metrics_collector.h"
+#include "wire_format.h"
+
+/**
+ * @struct SpoolOptions
+ * @brief Location and size limits of the on-disk snapshot spool.
+ */
+struct SpoolOptions {
+    std::string directory; ///< Directory holding the segment files; created if missing.
+    size_t max_bytes = 64 * 1024 * 1024; ///< Disk budget; the oldest segment is evicted beyond it.
+    size_t segment_bytes = 4 * 1024 * 1024; ///< Size of each preallocated segment file.
+};
+
+/**
+ * @class SnapshotSpool
+ * @brief Append-only, memory-mapped store for snapshots the backend did not accept.
+ *
+ * The spool is a directory of fixed-size segment files (`spool-<id>.seg`),
+ * each preallocated and mapped with `MAP_SHARED`. A segment starts with an
+ * 8-byte header (`MSPL`, version) followed by records:
+ *
+ * - u32 payload length (0 marks the end of the written part)
+ * - u32 CRC-32 of the payload
+ * - u32 flags (bit 0: acknowledged by the backend)
+ * - payload: one snapshot in the binary wire format
+ *
+ * The length is stored last, so a record only becomes visible once it is
+ * complete. open() rescans every segment, stops at the first record with a
+ * bad length or checksum, and resumes after the last acknowledged record, so
+ * a crash costs at most the record being written and one re-sent batch.
+ * When a new segment would exceed `max_bytes`, the oldest segment is deleted
+ * along with any unsent records in it.
+ *
+ * Only POSIX systems are supported; open() fails elsewhere. The spool is not
+ * thread-safe and is meant to be owned by the sender thread.
+ */
+class SnapshotSpool {
+public:
+    explicit SnapshotSpool(const SpoolOptions& options);
+    ~SnapshotSpool();
+
+    SnapshotSpool(const SnapshotSpool&) = delete;
+    SnapshotSpool& operator=(const SnapshotSpool&) = delete;
+
+    /**
+     * @brief Creates the directory if needed and recovers existing segments.
+     * @param error_message Receives the reason on failure.
+     * @return True if the spool is ready for append().
+     */
+    bool open(std::string& error_message);
+
+    /**
+     * @brief Appends snapshots, one record each.
+     * @return Number of snapshots written; a snapshot larger than a segment is skipped.
+     */
+    size_t append(const SystemMetrics* snapshots, size_t count);
+
+    /**
+     * @brief Reads the oldest unacknowledged snapshots without removing them.
+     * @param out Replaced with up to `max_count` snapshots, oldest first.
+     * @return Number of snapshots read.
+     */
+    size_t peek(std::vector<SystemMetrics>& out, size_t max_count);
+
+    /**
+     * @brief Acknowledges the first `count` snapshots returned by the last peek().
+     *
+     * Segments whose records are all acknowledged are deleted.
+     */
+    void consume(size_t count);
+
+    /**
+     * @brief Number of snapshots waiting to be replayed.
+     */
+    size_t pending() const;
+
+    /**
+     * @brief Unsent snapshots lost to segment eviction since open().
+     */
+    uint64_t evicted() const;
+
+    /**
+     * @brief Bytes of segment files currently on disk.
+     */
+    size_t disk_bytes() const;
+
+private:
+    struct Segment {
+        uint64_t id = 0;
+        int fd = -1;
+        unsigned char* data = nullptr;
+        size_t size = 0; ///< Mapped file size.
+        size_t write_offset = 0; ///< End of the last valid record.
+        size_t read_offset = 0; ///< First unacknowledged record.
+        size_t pending = 0; ///< Unacknowledged records.
+    };
+
+    bool open_segment(uint64_t id, bool create, Segment& segment, std::string& error_message);
+    void recover_segment(Segment& segment);
+    bool roll_segment();
+    void close_segment(Segment& segment, bool remove_file);
+    std::string segment_path(uint64_t id) const;
+
+    SpoolOptions options_;
+    bool opened_ = false;
+    bool active_ = false; ///< Whether segments_.back() was created by this process and takes appends.
+    std::vector<Segment> segments_; ///< Oldest first; the last one is written to.
+    size_t pending_ = 0;
+    uint64_t evicted_ = 0;
+    uint64_t next_id_ = 1;
+    BinaryMetricsEncoder encoder_;
+    std::string record_;
+};
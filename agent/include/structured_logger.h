@@ -1,11 +1,109 @@
 #pragma once
 
-#include <map>
+#include <cstddef>
+#include <cstdio>
+#include <initializer_list>
 #include <string>
+#include <string_view>
 
+/**
+ * @brief Log severities, in increasing order.
+ */
+enum class LogLevel {
+    debug,
+    info,
+    warn,
+    error
+};
+
+/**
+ * @struct LogField
+ * @brief One key/value pair of a log line.
+ *
+ * Both members are views: a call such as
+ * `log_event(LogLevel::info, "e", "m", {{"size", std::to_string(n)}})` keeps
+ * the temporary string alive until log_event returns, and nothing is copied
+ * into a container on the way.
+ */
+struct LogField {
+    std::string_view key;
+    std::string_view value;
+};
+
+/**
+ * @struct LoggerOptions
+ * @brief Settings for the background log writer.
+ */
+struct LoggerOptions {
+    size_t queue_capacity = 1024; ///< Lines buffered before new lines are dropped.
+    std::FILE* out = nullptr; ///< Sink for DEBUG and INFO lines; stdout if null.
+    std::FILE* err = nullptr; ///< Sink for WARN and ERROR lines; stderr if null.
+};
+
+/**
+ * @brief Parses `debug`, `info`, `warn` or `error` (case-insensitive).
+ * @return False if `text` is not a known level; `level` is then unchanged.
+ */
+bool parse_log_level(std::string_view text, LogLevel& level);
+
+/**
+ * @brief Sets the minimum level; lower-level calls return before formatting.
+ */
+void set_log_level(LogLevel level);
+
+/**
+ * @brief True if a line at `level` would be written.
+ *
+ * Use it to skip building expensive field values for lines that the level
+ * filter would discard anyway.
+ */
+bool log_enabled(LogLevel level);
+
+/**
+ * @brief Starts the background writer.
+ *
+ * Afterwards log_event() only formats the line into a thread-local buffer
+ * and hands it to a lock-free queue. The writer thread writes queued lines
+ * in batches, with one flush per batch instead of one per line. If the
+ * queue is full, the line is dropped and counted; the writer reports drops
+ * as a `log.dropped` line. Does nothing if the writer is already running.
+ */
+void start_async_logger(const LoggerOptions& options = {});
+
+/**
+ * @brief Writes every queued line, flushes and stops the background writer.
+ *
+ * Later log_event() calls write synchronously again.
+ */
+void stop_async_logger();
+
+/**
+ * @brief Number of lines dropped because the queue was full.
+ */
+size_t dropped_log_lines();
+
+/**
+ * @brief Appends one JSON log line, without the trailing newline, to `out`.
+ * @param timestamp Pre-formatted `ts` value.
+ */
+void append_log_line(
+    std::string& out,
+    std::string_view timestamp,
+    LogLevel level,
+    std::string_view event,
+    std::string_view message,
+    std::initializer_list<LogField> fields
+);
+
+/**
+ * @brief Writes a line-delimited JSON log entry.
+ *
+ * WARN and ERROR go to stderr, everything else to stdout. Without a running
+ * background writer the line is written and flushed before returning.
+ */
 void log_event(
-    const std::string& level,
-    const std::string& event,
-    const std::string& message,
-    const std::map<std::string, std::string>& fields = {}
+    LogLevel level,
+    std::string_view event,
+    std::string_view message,
+    std::initializer_list<LogField> fields = {}
 );
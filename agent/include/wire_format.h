@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "metrics_collector.h"
+
+/**
+ * @brief Payload encodings understood by the backend ingest endpoints.
+ */
+enum class WireFormat {
+    json, ///< `application/json`, one object or an array of objects.
+    binary ///< `application/x-metrics-binary`, see BinaryMetricsEncoder.
+};
+
+/**
+ * @brief Optional request body compression.
+ */
+enum class WireCompression {
+    none,
+    gzip ///< Sent with `Content-Encoding: gzip`; needs zlib at build time.
+};
+
+/// Content type of BinaryMetricsEncoder payloads.
+constexpr const char* kBinaryMetricsContentType = "application/x-metrics-binary";
+
+/**
+ * @brief Parses a `wire_format` config value (`json` or `binary`).
+ */
+bool parse_wire_format(const std::string& text, WireFormat& format);
+
+/**
+ * @brief Parses a `compression` config value (`none` or `gzip`).
+ */
+bool parse_wire_compression(const std::string& text, WireCompression& compression);
+
+/**
+ * @brief Whether this build can gzip request bodies.
+ */
+bool wire_compression_available(WireCompression compression);
+
+/**
+ * @brief Gzips `input` into `output`.
+ * @return False if compression failed or zlib support was not compiled in.
+ */
+bool gzip_compress(const std::string& input, std::string& output);
+
+/**
+ * @class BinaryMetricsEncoder
+ * @brief Encodes snapshots in the compact binary ingest format (version 1).
+ *
+ * Layout: the 4-byte header `M` `T` `B` `0x01`, then snapshots until the end
+ * of the body. Integers are LEB128 varints; signed values are zigzag encoded.
+ * Every metric that the JSON format sends with two decimals is sent as a
+ * fixed-point integer in hundredths. Per snapshot:
+ *
+ * - timestamp in milliseconds, as a delta to the previous snapshot in the
+ *   payload (first: to 0)
+ * - total CPU
+ * - core count, then each core as a delta to the same core of the previous snapshot
+ * - memory total and used, each as a delta to the previous snapshot
+ * - process count, then per process: pid, name reference, CPU, memory,
+ *   thread count, I/O read, I/O write, handle count
+ * - cgroup count, then per cgroup: path (a name reference), CPU, memory,
+ *   I/O read, I/O write
+ * - window sample count (0 for a raw sample, which ends the snapshot), then
+ *   the window start as milliseconds before the timestamp, total CPU stats,
+ *   core count and each core's stats, used memory stats, process count and
+ *   per process (aligned with the process section above): sample count, CPU
+ *   stats, memory stats. Stats are min, max, mean and p95
+ *
+ * A name reference equal to the number of names defined so far introduces a
+ * new name (length + bytes) and assigns it that ID; smaller values refer to an
+ * earlier name. Process names and cgroup paths share one ID space. IDs are
+ * scoped to one payload, so the backend keeps no state between requests.
+ */
+class BinaryMetricsEncoder {
+public:
+    /**
+     * @brief Replaces `out` with the encoding of `count` snapshots.
+     */
+    void encode(const SystemMetrics* snapshots, size_t count, std::string& out);
+
+private:
+    void append_snapshot(const SystemMetrics& metrics, std::string& out);
+    void append_name(const std::string& name, std::string& out);
+
+    std::unordered_map<std::string, uint32_t> name_ids_; ///< Names defined in the current payload.
+    std::vector<int64_t> previous_cores_; ///< Per-core hundredths of the previous snapshot.
+    int64_t previous_timestamp_ = 0;
+    int64_t previous_memory_total_ = 0;
+    int64_t previous_memory_used_ = 0;
+};
+
+/**
+ * @brief Decodes a binary payload written by BinaryMetricsEncoder.
+ *
+ * Used to read back spooled snapshots. Decoded snapshots are appended to
+ * `out` with every family marked fresh.
+ *
+ * @param body Complete payload, header included.
+ * @param out Receives the snapshots in payload order.
+ * @return False if the payload is truncated or malformed; `out` may then
+ *         hold a partial result.
+ */
+bool decode_binary_metrics(std::string_view body, std::vector<SystemMetrics>& out);
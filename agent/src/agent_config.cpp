@@ -2,9 +2,14 @@
 
 #include <algorithm>
 #include <cctype>
+#include <cmath>
 #include <fstream>
-#include <regex>
+#include <cstdint>
+#include <limits>
 #include <sstream>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 
 namespace {
 std::string trim(const std::string& value) {
@@ -58,133 +63,588 @@ bool parse_size_text(const std::string& value, size_t& parsed) {
     }
 }
 
-bool extract_json_string(const std::string& content, const std::string& key, std::string& out) {
-    const std::regex pattern("\"" + key + "\"\\s*:\\s*\"([^\"]*)\"");
-    std::smatch match;
-    if (!std::regex_search(content, match, pattern) || match.size() < 2) {
+bool parse_double_text(const std::string& value, double& parsed) {
+    try {
+        parsed = std::stod(trim(value));
+        return std::isfinite(parsed);
+    } catch (...) {
         return false;
     }
-    out = match[1].str();
-    return true;
 }
 
-bool extract_json_scalar(const std::string& content, const std::string& key, std::string& out) {
-    const std::regex pattern("\"" + key + "\"\\s*:\\s*([^,}\\n]+)");
-    std::smatch match;
-    if (!std::regex_search(content, match, pattern) || match.size() < 2) {
-        return false;
+// Scalar values of a config document by key path, e.g. "metrics.total_cpu".
+using ConfigValues = std::unordered_map<std::string, std::string>;
+
+// JSON nested deeper than this is rejected instead of recursed into.
+constexpr size_t kMaxJsonDepth = 32;
+
+bool is_blank(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+std::string join_path(const std::string& parent, std::string_view key) {
+    std::string path;
+    path.reserve(parent.size() + key.size() + 1);
+    if (!parent.empty()) {
+        path.append(parent).push_back('.');
     }
-    out = trim(match[1].str());
-    return true;
+    path.append(key.data(), key.size());
+    return path;
 }
 
-bool extract_yaml_scalar(const std::string& content, const std::string& key, std::string& out) {
-    const std::regex pattern("(^|\\n)\\s*" + key + "\\s*:\\s*([^\\n#]+)");
-    std::smatch match;
-    if (!std::regex_search(content, match, pattern) || match.size() < 3) {
-        return false;
+void append_utf8(std::string& out, uint32_t code_point) {
+    if (code_point < 0x80) {
+        out.push_back(static_cast<char>(code_point));
+    } else if (code_point < 0x800) {
+        out.push_back(static_cast<char>(0xC0 | (code_point >> 6)));
+        out.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+    } else if (code_point < 0x10000) {
+        out.push_back(static_cast<char>(0xE0 | (code_point >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+    } else {
+        out.push_back(static_cast<char>(0xF0 | (code_point >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((code_point >> 12) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
     }
-    out = trim(match[2].str());
-    return true;
 }
 
-bool extract_value(const std::string& content, const std::string& key, std::string& out) {
-    if (extract_json_string(content, key, out)) {
+/**
+ * Single-pass reader of a JSON document. Scalars inside objects are
+ * recorded under their key path; array elements are checked but not
+ * recorded, since no setting is a list. null leaves a key unset.
+ */
+class JsonConfigTokenizer {
+public:
+    JsonConfigTokenizer(std::string_view content, ConfigValues& values)
+        : content_(content), values_(values) {}
+
+    bool parse(std::string& error_message) {
+        skip_whitespace();
+        bool parsed = peek() == '{' ? parse_object(std::string(), 1, true) : fail("expected an object");
+        if (parsed) {
+            skip_whitespace();
+            parsed = position_ == content_.size() || fail("unexpected content after the closing brace");
+        }
+        if (!parsed) {
+            const size_t line = 1 + static_cast<size_t>(std::count(content_.begin(), content_.begin() + position_, '\n'));
+            error_message = error_ + " at line " + std::to_string(line);
+        }
+        return parsed;
+    }
+
+private:
+    char peek() const {
+        return position_ < content_.size() ? content_[position_] : '\0';
+    }
+
+    bool fail(const char* reason) {
+        error_ = reason;
+        return false;
+    }
+
+    void skip_whitespace() {
+        while (position_ < content_.size() && is_blank(content_[position_])) {
+            ++position_;
+        }
+    }
+
+    bool parse_value(const std::string& path, size_t depth, bool record) {
+        skip_whitespace();
+        const char c = peek();
+        if (c == '{') {
+            return parse_object(path, depth + 1, record);
+        }
+        if (c == '[') {
+            return parse_array(depth + 1);
+        }
+
+        std::string value;
+        if (c == '"') {
+            if (!parse_string(value)) {
+                return false;
+            }
+        } else {
+            const size_t begin = position_;
+            while (position_ < content_.size() && !is_blank(content_[position_]) &&
+                   content_[position_] != ',' && content_[position_] != '}' && content_[position_] != ']') {
+                ++position_;
+            }
+            if (position_ == begin) {
+                return fail("expected a value");
+            }
+            value.assign(content_.substr(begin, position_ - begin));
+            if (value == "null") {
+                return true;
+            }
+        }
+
+        if (record) {
+            values_[path] = std::move(value);
+        }
         return true;
     }
-    if (extract_json_scalar(content, key, out)) {
+
+    bool parse_object(const std::string& path, size_t depth, bool record) {
+        if (depth > kMaxJsonDepth) {
+            return fail("nesting is too deep");
+        }
+        ++position_;
+        skip_whitespace();
+        if (peek() == '}') {
+            ++position_;
+            return true;
+        }
+
+        std::string key;
+        while (true) {
+            skip_whitespace();
+            if (peek() != '"') {
+                return fail("expected a quoted key");
+            }
+            if (!parse_string(key)) {
+                return false;
+            }
+            skip_whitespace();
+            if (peek() != ':') {
+                return fail("expected ':' after a key");
+            }
+            ++position_;
+            if (!parse_value(record ? join_path(path, key) : path, depth, record)) {
+                return false;
+            }
+
+            skip_whitespace();
+            if (peek() == ',') {
+                ++position_;
+            } else if (peek() == '}') {
+                ++position_;
+                return true;
+            } else {
+                return fail("expected ',' or '}'");
+            }
+        }
+    }
+
+    bool parse_array(size_t depth) {
+        if (depth > kMaxJsonDepth) {
+            return fail("nesting is too deep");
+        }
+        ++position_;
+        skip_whitespace();
+        if (peek() == ']') {
+            ++position_;
+            return true;
+        }
+
+        while (true) {
+            if (!parse_value(std::string(), depth, false)) {
+                return false;
+            }
+            skip_whitespace();
+            if (peek() == ',') {
+                ++position_;
+            } else if (peek() == ']') {
+                ++position_;
+                return true;
+            } else {
+                return fail("expected ',' or ']'");
+            }
+        }
+    }
+
+    bool parse_hex4(uint32_t& code_unit) {
+        if (content_.size() - position_ < 4) {
+            return fail("truncated \\u escape");
+        }
+        code_unit = 0;
+        for (size_t i = 0; i < 4; ++i) {
+            const char c = content_[position_++];
+            code_unit <<= 4;
+            if (c >= '0' && c <= '9') {
+                code_unit |= static_cast<uint32_t>(c - '0');
+            } else if (c >= 'a' && c <= 'f') {
+                code_unit |= static_cast<uint32_t>(c - 'a' + 10);
+            } else if (c >= 'A' && c <= 'F') {
+                code_unit |= static_cast<uint32_t>(c - 'A' + 10);
+            } else {
+                return fail("invalid \\u escape");
+            }
+        }
         return true;
     }
-    if (extract_yaml_scalar(content, key, out)) {
+
+    bool parse_string(std::string& out) {
+        out.clear();
+        ++position_;
+        while (position_ < content_.size()) {
+            const char c = content_[position_++];
+            if (c == '"') {
+                return true;
+            }
+            if (static_cast<unsigned char>(c) < 0x20) {
+                return fail("control character in a string");
+            }
+            if (c != '\\') {
+                out.push_back(c);
+                continue;
+            }
+
+            const char escaped = peek();
+            ++position_;
+            switch (escaped) {
+                case '"': out.push_back('"'); break;
+                case '\\': out.push_back('\\'); break;
+                case '/': out.push_back('/'); break;
+                case 'b': out.push_back('\b'); break;
+                case 'f': out.push_back('\f'); break;
+                case 'n': out.push_back('\n'); break;
+                case 'r': out.push_back('\r'); break;
+                case 't': out.push_back('\t'); break;
+                case 'u': {
+                    uint32_t code_point = 0;
+                    if (!parse_hex4(code_point)) {
+                        return false;
+                    }
+                    if (code_point >= 0xD800 && code_point < 0xDC00) {
+                        uint32_t low = 0;
+                        if (content_.substr(position_, 2) != "\\u") {
+                            return fail("unpaired surrogate in \\u escape");
+                        }
+                        position_ += 2;
+                        if (!parse_hex4(low)) {
+                            return false;
+                        }
+                        if (low < 0xDC00 || low >= 0xE000) {
+                            return fail("unpaired surrogate in \\u escape");
+                        }
+                        code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+                    } else if (code_point >= 0xDC00 && code_point < 0xE000) {
+                        return fail("unpaired surrogate in \\u escape");
+                    }
+                    append_utf8(out, code_point);
+                    break;
+                }
+                default:
+                    return fail("invalid escape in a string");
+            }
+        }
+        return fail("unterminated string");
+    }
+
+    std::string_view content_;
+    ConfigValues& values_;
+    size_t position_ = 0;
+    std::string error_;
+};
+
+/**
+ * Reads a YAML scalar that follows `key:`: plain (up to a ` #` comment),
+ * single-quoted ('' is a quote) or double-quoted (backslash escapes).
+ * Returns false with `reason` set for an unterminated quote or text after
+ * the closing quote.
+ */
+bool parse_yaml_scalar(std::string_view text, std::string& value, bool& quoted, const char*& reason) {
+    size_t begin = 0;
+    while (begin < text.size() && is_blank(text[begin])) {
+        ++begin;
+    }
+    text.remove_prefix(begin);
+    value.clear();
+    quoted = !text.empty() && (text[0] == '"' || text[0] == '\'');
+
+    if (!quoted) {
+        size_t end = 0;
+        while (end < text.size() && !(text[end] == '#' && (end == 0 || is_blank(text[end - 1])))) {
+            ++end;
+        }
+        while (end > 0 && is_blank(text[end - 1])) {
+            --end;
+        }
+        value.assign(text.substr(0, end));
         return true;
     }
-    return false;
+
+    const char quote = text[0];
+    size_t position = 1;
+    bool closed = false;
+    while (position < text.size()) {
+        const char c = text[position++];
+        if (c == quote) {
+            if (quote == '\'' && position < text.size() && text[position] == '\'') {
+                value.push_back('\'');
+                ++position;
+                continue;
+            }
+            closed = true;
+            break;
+        }
+        if (quote == '"' && c == '\\' && position < text.size()) {
+            const char escaped = text[position++];
+            value.push_back(escaped == 'n' ? '\n' : escaped == 't' ? '\t' : escaped);
+            continue;
+        }
+        value.push_back(c);
+    }
+    if (!closed) {
+        reason = "unterminated quoted value";
+        return false;
+    }
+
+    const std::string_view rest = text.substr(position);
+    const auto tail = std::find_if_not(rest.begin(), rest.end(), is_blank);
+    if (tail != rest.end() && *tail != '#') {
+        reason = "unexpected text after a quoted value";
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Single-pass reader of block-style YAML mappings. Nesting follows the
+ * indentation; `key:` with nothing after it opens a section. Sequence
+ * items are skipped, since no setting is a list.
+ */
+bool parse_yaml_config(std::string_view content, ConfigValues& values, std::string& error_message) {
+    struct Section {
+        size_t indent;
+        std::string path;
+    };
+    std::vector<Section> sections;
+    std::string value;
+    size_t line_number = 0;
+
+    size_t line_begin = 0;
+    while (line_begin < content.size()) {
+        size_t line_end = content.find('\n', line_begin);
+        if (line_end == std::string_view::npos) {
+            line_end = content.size();
+        }
+        std::string_view line = content.substr(line_begin, line_end - line_begin);
+        line_begin = line_end + 1;
+        ++line_number;
+
+        size_t indent = 0;
+        while (indent < line.size() && (line[indent] == ' ' || line[indent] == '\t')) {
+            ++indent;
+        }
+        std::string_view text = line.substr(indent);
+        while (!text.empty() && is_blank(text.back())) {
+            text.remove_suffix(1);
+        }
+        if (text.empty() || text[0] == '#' || text[0] == '-' || text == "...") {
+            continue;
+        }
+
+        const char* reason = nullptr;
+        std::string_view key;
+        size_t after_key = 0;
+        if (text[0] == '"' || text[0] == '\'') {
+            const size_t close = text.find(text[0], 1);
+            if (close != std::string_view::npos) {
+                key = text.substr(1, close - 1);
+                after_key = close + 1;
+                while (after_key < text.size() && is_blank(text[after_key])) {
+                    ++after_key;
+                }
+            }
+            if (close == std::string_view::npos || after_key >= text.size() || text[after_key] != ':') {
+                reason = "expected 'key: value'";
+            }
+        } else {
+            // The key ends at the first ':' followed by a blank or the end of the line.
+            after_key = text.find(':');
+            while (after_key != std::string_view::npos && after_key + 1 < text.size() && !is_blank(text[after_key + 1])) {
+                after_key = text.find(':', after_key + 1);
+            }
+            if (after_key == std::string_view::npos || after_key == 0) {
+                reason = "expected 'key: value'";
+            } else {
+                key = text.substr(0, after_key);
+                while (!key.empty() && is_blank(key.back())) {
+                    key.remove_suffix(1);
+                }
+            }
+        }
+
+        bool quoted = false;
+        if (reason != nullptr || !parse_yaml_scalar(text.substr(after_key + 1), value, quoted, reason)) {
+            error_message = std::string(reason) + " at line " + std::to_string(line_number);
+            return false;
+        }
+
+        while (!sections.empty() && sections.back().indent >= indent) {
+            sections.pop_back();
+        }
+        std::string path = join_path(sections.empty() ? std::string() : sections.back().path, key);
+        if (value.empty() && !quoted) {
+            sections.push_back({indent, std::move(path)});
+        } else if (quoted || (value != "null" && value != "~")) {
+            values[std::move(path)] = value;
+        }
+    }
+    return true;
+}
+
+const std::string* find_value(const ConfigValues& values, const std::string& key) {
+    const auto found = values.find(key);
+    return found == values.end() ? nullptr : &found->second;
 }
 
-void apply_bool(const std::string& content, const std::string& key, bool& target) {
-    std::string raw;
-    if (!extract_value(content, key, raw)) {
+void apply_bool(const ConfigValues& values, const std::string& key, bool& target) {
+    const std::string* raw = find_value(values, key);
+    if (raw == nullptr) {
         return;
     }
 
     bool parsed = false;
-    if (parse_bool_text(raw, parsed)) {
+    if (parse_bool_text(*raw, parsed)) {
         target = parsed;
     }
 }
 
-void apply_int(const std::string& content, const std::string& key, int& target) {
-    std::string raw;
-    if (!extract_value(content, key, raw)) {
+void apply_int(const ConfigValues& values, const std::string& key, int& target) {
+    const std::string* raw = find_value(values, key);
+    if (raw == nullptr) {
         return;
     }
 
     int parsed = 0;
-    if (parse_int_text(raw, parsed) && parsed > 0) {
+    if (parse_int_text(*raw, parsed) && parsed > 0) {
         target = parsed;
     }
 }
 
-void apply_size(const std::string& content, const std::string& key, size_t& target) {
-    std::string raw;
-    if (!extract_value(content, key, raw)) {
+void apply_size(const ConfigValues& values, const std::string& key, size_t& target) {
+    const std::string* raw = find_value(values, key);
+    if (raw == nullptr) {
         return;
     }
 
     size_t parsed = 0;
-    if (parse_size_text(raw, parsed)) {
+    if (parse_size_text(*raw, parsed)) {
+        target = parsed;
+    }
+}
+
+void apply_double(const ConfigValues& values, const std::string& key, double& target) {
+    const std::string* raw = find_value(values, key);
+    if (raw == nullptr) {
+        return;
+    }
+
+    double parsed = 0.0;
+    if (parse_double_text(*raw, parsed) && parsed >= 0.0) {
         target = parsed;
     }
 }
 
-void apply_string(const std::string& content, const std::string& key, std::string& target) {
-    std::string raw;
-    if (!extract_value(content, key, raw)) {
+void apply_string(const ConfigValues& values, const std::string& key, std::string& target) {
+    const std::string* raw = find_value(values, key);
+    if (raw == nullptr) {
         return;
     }
 
-    const std::string value = trim(raw);
+    const std::string value = trim(*raw);
     if (!value.empty()) {
         target = value;
     }
 }
+
+// Selection keys belong in the `metrics` section; older flat files put them
+// at the top level, and the section wins if both are present.
+void apply_selection(const ConfigValues& values, const std::string& key, bool& target) {
+    apply_bool(values, key, target);
+    apply_bool(values, "metrics." + key, target);
+}
 }
 
 AgentConfig AgentConfig::defaults() {
     return AgentConfig{};
 }
 
-bool load_agent_config_file(const std::string& path, AgentConfig& config, std::string& error_message) {
-    std::ifstream file(path);
-    if (!file.is_open()) {
-        error_message = "Unable to open config file: " + path;
+bool parse_agent_config(const std::string& content, AgentConfig& config, std::string& error_message) {
+    std::string_view document(content);
+    if (document.substr(0, 3) == "\xEF\xBB\xBF") {
+        document.remove_prefix(3);
+    }
+
+    ConfigValues values;
+    const auto first = std::find_if_not(document.begin(), document.end(), is_blank);
+    if (first == document.end()) {
+        error_message = "Config document is empty";
+        return false;
+    }
+    const bool parsed = *first == '{'
+        ? JsonConfigTokenizer(document, values).parse(error_message)
+        : parse_yaml_config(document, values, error_message);
+    if (!parsed) {
         return false;
     }
 
-    std::ostringstream buffer;
-    buffer << file.rdbuf();
-    const std::string content = buffer.str();
+    apply_string(values, "backend_url", config.backend_url);
+    apply_bool(values, "backend_enabled", config.backend_enabled);
 
-    if (content.empty()) {
-        error_message = "Config file is empty: " + path;
+    // interval_seconds is kept for older config files; interval_ms wins if both are set.
+    int interval_seconds = 0;
+    apply_int(values, "interval_seconds", interval_seconds);
+    if (interval_seconds > std::numeric_limits<int>::max() / 1000) {
+        error_message = "interval_seconds is too large";
         return false;
     }
+    if (interval_seconds > 0) {
+        config.interval_ms = interval_seconds * 1000;
+    }
+    apply_int(values, "interval_ms", config.interval_ms);
+    apply_int(values, "cpu_interval_ms", config.cpu_interval_ms);
+    apply_int(values, "memory_interval_ms", config.memory_interval_ms);
+    apply_int(values, "process_interval_ms", config.process_interval_ms);
+    apply_int(values, "upload_interval_ms", config.upload_interval_ms);
 
-    apply_string(content, "backend_url", config.backend_url);
-    apply_bool(content, "backend_enabled", config.backend_enabled);
-    apply_int(content, "interval_seconds", config.interval_seconds);
-    apply_size(content, "queue_capacity", config.queue_capacity);
+    apply_size(values, "queue_capacity", config.queue_capacity);
+    apply_size(values, "collector_threads", config.collector_threads);
+    apply_size(values, "top_n", config.top_n);
+    apply_string(values, "proc_root", config.proc_root);
+    apply_bool(values, "process_events", config.process_events);
+    apply_bool(values, "proc_io_uring", config.proc_io_uring);
+    apply_string(values, "cgroup_root", config.cgroup_root);
+    apply_size(values, "batch_max_items", config.batch_max_items);
+    apply_size(values, "batch_max_bytes", config.batch_max_bytes);
+    apply_string(values, "wire_format", config.wire_format);
+    apply_string(values, "compression", config.compression);
+    apply_bool(values, "delta_uploads", config.delta_uploads);
+    apply_size(values, "delta_keyframe_interval", config.delta_keyframe_interval);
+    apply_double(values, "delta_cpu_deadband_percent", config.delta_cpu_deadband_percent);
+    apply_double(values, "delta_memory_deadband_mb", config.delta_memory_deadband_mb);
+    apply_string(values, "log_level", config.log_level);
+    apply_int(values, "connect_timeout_ms", config.connect_timeout_ms);
+    apply_int(values, "request_timeout_ms", config.request_timeout_ms);
+    apply_size(values, "retry_max_attempts", config.retry_max_attempts);
+    apply_int(values, "retry_base_delay_ms", config.retry_base_delay_ms);
+    apply_int(values, "retry_max_delay_ms", config.retry_max_delay_ms);
+    apply_size(values, "breaker_failure_threshold", config.breaker_failure_threshold);
+    apply_int(values, "breaker_open_ms", config.breaker_open_ms);
+    apply_int(values, "breaker_max_open_ms", config.breaker_max_open_ms);
+    apply_string(values, "spool_dir", config.spool_dir);
+    apply_size(values, "spool_max_bytes", config.spool_max_bytes);
+    apply_size(values, "spool_segment_bytes", config.spool_segment_bytes);
+    apply_size(values, "spool_replay_items", config.spool_replay_items);
+    apply_int(values, "metrics_listen_port", config.metrics_listen_port);
+    apply_string(values, "metrics_listen_address", config.metrics_listen_address);
+    apply_int(values, "telemetry_log_interval_ms", config.telemetry_log_interval_ms);
 
-    apply_bool(content, "total_cpu", config.selection.total_cpu);
-    apply_bool(content, "per_core_cpu", config.selection.per_core_cpu);
-    apply_bool(content, "system_memory", config.selection.system_memory);
-    apply_bool(content, "top_processes", config.selection.top_processes);
-    apply_bool(content, "process_threads", config.selection.process_threads);
-    apply_bool(content, "process_io", config.selection.process_io);
-    apply_bool(content, "process_handles", config.selection.process_handles);
+    apply_selection(values, "total_cpu", config.selection.total_cpu);
+    apply_selection(values, "per_core_cpu", config.selection.per_core_cpu);
+    apply_selection(values, "system_memory", config.selection.system_memory);
+    apply_selection(values, "top_processes", config.selection.top_processes);
+    apply_selection(values, "process_threads", config.selection.process_threads);
+    apply_selection(values, "process_io", config.selection.process_io);
+    apply_selection(values, "process_handles", config.selection.process_handles);
+    apply_selection(values, "top_cgroups", config.selection.top_cgroups);
 
-    if (config.interval_seconds <= 0) {
-        error_message = "interval_seconds must be greater than 0";
+    if (config.interval_ms <= 0) {
+        error_message = "interval_ms must be greater than 0";
         return false;
     }
 
@@ -195,3 +655,27 @@ bool load_agent_config_file(const std::string& path, AgentConfig& config, std::s
 
     return true;
 }
+
+bool load_agent_config_file(const std::string& path, AgentConfig& config, std::string& error_message) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        error_message = "Unable to open config file: " + path;
+        return false;
+    }
+
+    std::ostringstream buffer;
+    buffer << file.rdbuf();
+    const std::string content = buffer.str();
+
+    if (content.empty()) {
+        error_message = "Config file is empty: " + path;
+        return false;
+    }
+
+    std::string parse_error;
+    if (!parse_agent_config(content, config, parse_error)) {
+        error_message = "Invalid config file " + path + ": " + parse_error;
+        return false;
+    }
+    return true;
+}
\ No newline at end of file
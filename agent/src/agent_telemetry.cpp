@@ -0,0 +1,170 @@
+#include "agent_telemetry.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+constexpr const char* kStageMetric = "metrics_agent_stage_duration_microseconds";
+constexpr struct {
+    double value;
+    const char* label;
+} kExportedQuantiles[] = {{0.5, "0.5"}, {0.9, "0.9"}, {0.99, "0.99"}};
+
+int highest_bit(uint64_t value) {
+    int bit = 63;
+    while ((value >> bit) == 0) {
+        --bit;
+    }
+    return bit;
+}
+
+void append_counter(std::string& out, const char* name, const char* help, const char* type, uint64_t value) {
+    out += "# HELP ";
+    out += name;
+    out.push_back(' ');
+    out += help;
+    out += "\n# TYPE ";
+    out += name;
+    out.push_back(' ');
+    out += type;
+    out.push_back('\n');
+    out += name;
+    out.push_back(' ');
+    out += std::to_string(value);
+    out.push_back('\n');
+}
+}  // namespace
+
+size_t LatencyHistogram::bucket_index(uint64_t value) {
+    if (value < kSubBuckets) {
+        return static_cast<size_t>(value);
+    }
+    const int exponent = highest_bit(value);
+    const size_t sub_bucket = static_cast<size_t>((value >> (exponent - 3)) & (kSubBuckets - 1));
+    return kSubBuckets + static_cast<size_t>(exponent - 3) * kSubBuckets + sub_bucket;
+}
+
+uint64_t LatencyHistogram::bucket_upper_bound(size_t index) {
+    if (index < kSubBuckets) {
+        return index;
+    }
+    const size_t shift = (index - kSubBuckets) / kSubBuckets;
+    const uint64_t sub_bucket = (index - kSubBuckets) % kSubBuckets;
+    const uint64_t lower = (kSubBuckets + sub_bucket) << shift;
+    return lower + ((uint64_t{1} << shift) - 1);
+}
+
+void LatencyHistogram::record(uint64_t value) {
+    buckets_[bucket_index(value)].fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(value, std::memory_order_relaxed);
+
+    uint64_t current = max_.load(std::memory_order_relaxed);
+    while (value > current && !max_.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+void LatencyHistogram::snapshot(Snapshot& out) const {
+    // The count is the bucket total, so quantiles stay consistent with the
+    // buckets even while writers are recording.
+    out.count = 0;
+    for (size_t index = 0; index < kBucketCount; ++index) {
+        out.buckets[index] = buckets_[index].load(std::memory_order_relaxed);
+        out.count += out.buckets[index];
+    }
+    out.sum = sum_.load(std::memory_order_relaxed);
+    out.max = max_.load(std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::Snapshot::quantile(double q) const {
+    if (count == 0) {
+        return 0;
+    }
+    const double clamped = std::min(std::max(q, 0.0), 1.0);
+    const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(clamped * static_cast<double>(count))));
+
+    uint64_t seen = 0;
+    for (size_t index = 0; index < kBucketCount; ++index) {
+        seen += buckets[index];
+        if (seen >= rank) {
+            return std::min(bucket_upper_bound(index), max);
+        }
+    }
+    return max;
+}
+
+void LatencyHistogram::Snapshot::subtract(const Snapshot& earlier) {
+    uint64_t highest = 0;
+    count = 0;
+    for (size_t index = 0; index < kBucketCount; ++index) {
+        buckets[index] -= std::min(buckets[index], earlier.buckets[index]);
+        count += buckets[index];
+        if (buckets[index] > 0) {
+            highest = bucket_upper_bound(index);
+        }
+    }
+    sum -= std::min(sum, earlier.sum);
+    max = std::min(max, highest);
+}
+
+const char* telemetry_stage_name(TelemetryStage stage) {
+    switch (stage) {
+        case TelemetryStage::collect:
+            return "collect";
+        case TelemetryStage::proc_scan:
+            return "proc_scan";
+        case TelemetryStage::serialize:
+            return "serialize";
+        case TelemetryStage::send:
+            return "send";
+        case TelemetryStage::count:
+            break;
+    }
+    return "unknown";
+}
+
+void AgentTelemetry::render_prometheus(std::string& out) const {
+    out += "# HELP ";
+    out += kStageMetric;
+    out += " Time spent in each agent pipeline stage.\n# TYPE ";
+    out += kStageMetric;
+    out += " summary\n";
+
+    LatencyHistogram::Snapshot snapshot;
+    for (size_t index = 0; index < stages.size(); ++index) {
+        stages[index].snapshot(snapshot);
+        const std::string label = std::string("stage=\"") + telemetry_stage_name(static_cast<TelemetryStage>(index)) + "\"";
+
+        for (const auto& quantile : kExportedQuantiles) {
+            out += kStageMetric;
+            out += "{" + label + ",quantile=\"";
+            out += quantile.label;
+            out += "\"} ";
+            out += std::to_string(snapshot.quantile(quantile.value));
+            out.push_back('\n');
+        }
+        out += kStageMetric;
+        out += "_sum{" + label + "} " + std::to_string(snapshot.sum) + "\n";
+        out += kStageMetric;
+        out += "_count{" + label + "} " + std::to_string(snapshot.count) + "\n";
+    }
+
+    const auto load = [](const std::atomic<uint64_t>& value) {
+        return value.load(std::memory_order_relaxed);
+    };
+    append_counter(out, "metrics_agent_collections_total", "Collection cycles run.", "counter", load(collections));
+    append_counter(out, "metrics_agent_queue_drops_total", "Snapshots dropped because the send queue was full.", "counter", load(queue_drops));
+    append_counter(out, "metrics_agent_requests_total", "HTTP requests to the backend, retries included.", "counter", load(requests));
+    append_counter(out, "metrics_agent_request_failures_total", "HTTP requests that failed.", "counter", load(request_failures));
+    append_counter(out, "metrics_agent_retries_total", "HTTP requests that were retries.", "counter", load(retries));
+    append_counter(out, "metrics_agent_sent_bytes_total", "Request body bytes sent, after compression.", "counter", load(bytes_sent));
+    append_counter(out, "metrics_agent_proc_syscalls_total", "System calls made to read procfs.", "counter", load(proc_syscalls));
+    append_counter(out, "metrics_agent_proc_listings_total", "Full listings of the procfs root for the process scan.", "counter", load(proc_listings));
+    append_counter(out, "metrics_agent_processes_started_total", "Process start events received from the proc connector.", "counter", load(processes_started));
+    append_counter(out, "metrics_agent_processes_exited_total", "Process exit events received from the proc connector.", "counter", load(processes_exited));
+    append_counter(out, "metrics_agent_cycle_allocations", "Heap allocations on the collector thread in the last cycle.", "gauge", load(cycle_allocations));
+}
+
+AgentTelemetry& agent_telemetry() {
+    static AgentTelemetry telemetry;
+    return telemetry;
+}
@@ -0,0 +1,29 @@
+#include "allocation_counter.h"
+
+#include <cstdlib>
+#include <new>
+
+namespace {
+thread_local uint64_t thread_allocations = 0;
+}
+
+uint64_t thread_allocation_count() {
+    return thread_allocations;
+}
+
+// The array and nothrow forms forward to these by default.
+void* operator new(std::size_t size) {
+    ++thread_allocations;
+    if (void* memory = std::malloc(size == 0 ? 1 : size)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
@@ -0,0 +1,175 @@
+#include "cgroup_source.h"
+
+#if defined(__linux__)
+
+#include <cerrno>
+#include <charconv>
+#include <utility>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+// io.stat has one line per device; this covers a few dozen disks.
+constexpr size_t kCgroupFileBufferSize = 4096;
+
+bool parse_uint64(std::string_view text, uint64_t& value) {
+    const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+    return error == std::errc() && end != text.data();
+}
+
+bool is_child_directory(const std::string& parent, const dirent* entry) {
+    if (entry->d_name[0] == '.') {
+        return false;
+    }
+    if (entry->d_type == DT_DIR) {
+        return true;
+    }
+    if (entry->d_type != DT_UNKNOWN) {
+        return false;
+    }
+    struct stat info;
+    const std::string child = parent + "/" + entry->d_name;
+    return ::stat(child.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+}
+}  // namespace
+
+bool parse_cgroup_cpu_stat(std::string_view contents, uint64_t& usage_usec) {
+    constexpr std::string_view kKey = "usage_usec ";
+    while (!contents.empty()) {
+        const size_t newline = contents.find('\n');
+        const std::string_view line = contents.substr(0, newline);
+        contents.remove_prefix((newline == std::string_view::npos) ? contents.size() : newline + 1);
+        if (line.substr(0, kKey.size()) == kKey) {
+            return parse_uint64(line.substr(kKey.size()), usage_usec);
+        }
+    }
+    return false;
+}
+
+void parse_cgroup_io_stat(std::string_view contents, uint64_t& read_bytes, uint64_t& write_bytes) {
+    read_bytes = 0;
+    write_bytes = 0;
+    while (!contents.empty()) {
+        const size_t separator = contents.find_first_of(" \n");
+        const std::string_view token = contents.substr(0, separator);
+        contents.remove_prefix((separator == std::string_view::npos) ? contents.size() : separator + 1);
+
+        uint64_t value = 0;
+        if (token.substr(0, 7) == "rbytes=" && parse_uint64(token.substr(7), value)) {
+            read_bytes += value;
+        } else if (token.substr(0, 7) == "wbytes=" && parse_uint64(token.substr(7), value)) {
+            write_bytes += value;
+        }
+    }
+}
+
+LinuxCgroupSource::LinuxCgroupSource(std::string root)
+    : root_(std::move(root)),
+      available_(false),
+      buffer_(kCgroupFileBufferSize) {
+    while (root_.size() > 1 && root_.back() == '/') {
+        root_.pop_back();
+    }
+    struct stat info;
+    available_ = ::stat((root_ + "/cgroup.controllers").c_str(), &info) == 0;
+}
+
+const std::string& LinuxCgroupSource::root() const {
+    return root_;
+}
+
+bool LinuxCgroupSource::is_available() const {
+    return available_;
+}
+
+void LinuxCgroupSource::scan(std::vector<CgroupSample>& samples) {
+    size_t count = 0;
+    if (available_) {
+        path_ = root_;
+        walk(0, samples, count);
+    }
+    samples.resize(count);
+}
+
+void LinuxCgroupSource::walk(size_t depth, std::vector<CgroupSample>& samples, size_t& count) {
+    DIR* directory = ::opendir(path_.c_str());
+    if (directory == nullptr) {
+        return;
+    }
+
+    bool has_children = false;
+    while (const dirent* entry = ::readdir(directory)) {
+        if (!is_child_directory(path_, entry)) {
+            continue;
+        }
+        has_children = true;
+        if (depth < kMaxDepth) {
+            const size_t parent_length = path_.size();
+            path_ += '/';
+            path_ += entry->d_name;
+            walk(depth + 1, samples, count);
+            path_.resize(parent_length);
+        }
+    }
+    ::closedir(directory);
+
+    // Inner cgroups only aggregate their children; anything at the depth
+    // limit stands for its subtree. A root without children (a container's
+    // own cgroup namespace) is reported as "/".
+    if (has_children && depth < kMaxDepth) {
+        return;
+    }
+
+    if (count == samples.size()) {
+        samples.emplace_back();
+    }
+    CgroupSample& sample = samples[count++];
+    if (depth == 0) {
+        sample.path.assign("/");
+    } else {
+        sample.path.assign(path_, root_.size() + 1, std::string::npos);
+    }
+    sample.cpu_usage_usec = 0;
+    sample.memory_bytes = 0;
+    sample.io_read_bytes = 0;
+    sample.io_write_bytes = 0;
+
+    std::string_view contents;
+    if (read_file("cpu.stat", contents)) {
+        parse_cgroup_cpu_stat(contents, sample.cpu_usage_usec);
+    }
+    if (read_file("memory.current", contents)) {
+        parse_uint64(contents, sample.memory_bytes);
+    }
+    if (read_file("io.stat", contents)) {
+        parse_cgroup_io_stat(contents, sample.io_read_bytes, sample.io_write_bytes);
+    }
+}
+
+bool LinuxCgroupSource::read_file(const char* name, std::string_view& contents) {
+    const size_t directory_length = path_.size();
+    path_ += '/';
+    path_ += name;
+    const int fd = ::open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+    path_.resize(directory_length);
+    if (fd < 0) {
+        return false;
+    }
+
+    ssize_t count = 0;
+    do {
+        count = ::read(fd, buffer_.data(), buffer_.size());
+    } while (count < 0 && errno == EINTR);
+    ::close(fd);
+
+    if (count < 0) {
+        return false;
+    }
+    contents = std::string_view(buffer_.data(), static_cast<size_t>(count));
+    return true;
+}
+
+#endif
@@ -0,0 +1,98 @@
+#include "config_watcher.h"
+
+#if defined(__linux__)
+
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+
+#include <sys/inotify.h>
+#include <unistd.h>
+
+namespace {
+constexpr size_t kReadBufferBytes = 16 * 1024;
+// Name of the symlink a ConfigMap volume swaps atomically on each update.
+constexpr const char* kConfigMapDataLink = "..data";
+}  // namespace
+
+ConfigWatcher::~ConfigWatcher() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+}
+
+bool ConfigWatcher::open(const std::string& path, std::string& error_message) {
+    if (fd_ >= 0) {
+        return true;
+    }
+
+    const std::filesystem::path file(path);
+    const std::filesystem::path directory = file.has_parent_path() ? file.parent_path() : std::filesystem::path(".");
+    const int fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+        error_message = std::string("inotify_init1 failed: ") + std::strerror(errno);
+        return false;
+    }
+    if (::inotify_add_watch(fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0) {
+        error_message = "cannot watch " + directory.string() + ": " + std::strerror(errno);
+        ::close(fd);
+        return false;
+    }
+
+    fd_ = fd;
+    file_name_ = file.filename().string();
+    buffer_.resize(kReadBufferBytes);
+    return true;
+}
+
+bool ConfigWatcher::poll() {
+    if (fd_ < 0) {
+        return false;
+    }
+
+    bool changed = false;
+    while (true) {
+        const ssize_t count = ::read(fd_, buffer_.data(), buffer_.size());
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        for (size_t offset = 0; offset + sizeof(inotify_event) <= static_cast<size_t>(count);) {
+            const auto* event = reinterpret_cast<const inotify_event*>(buffer_.data() + offset);
+            offset += sizeof(inotify_event) + event->len;
+            if ((event->mask & IN_Q_OVERFLOW) != 0) {
+                changed = true;
+            } else if (event->len > 0 && (file_name_ == event->name || std::strcmp(event->name, kConfigMapDataLink) == 0)) {
+                changed = true;
+            }
+        }
+    }
+    return changed;
+}
+
+bool ConfigWatcher::is_open() const {
+    return fd_ >= 0;
+}
+
+#else
+
+ConfigWatcher::~ConfigWatcher() = default;
+
+bool ConfigWatcher::open(const std::string& path, std::string& error_message) {
+    (void)path;
+    error_message = "config hot reload needs inotify (Linux only)";
+    return false;
+}
+
+bool ConfigWatcher::poll() {
+    return false;
+}
+
+bool ConfigWatcher::is_open() const {
+    return false;
+}
+
+#endif
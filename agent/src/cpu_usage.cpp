@@ -0,0 +1,79 @@
+#include "cpu_usage.h"
+
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define METRICS_AGENT_CPU_USAGE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+/// Same operations, in the same order, as one lane of the SSE2 kernel.
+inline double core_usage(double previous_idle, double previous_total, double current_idle, double current_total) {
+    const double total_delta = std::max(current_total - previous_total, 0.0);
+    const double idle_delta = std::max(current_idle - previous_idle, 0.0);
+    const double busy = total_delta - std::min(total_delta, idle_delta);
+    const double usage = (total_delta > 0.0) ? (busy / total_delta) * 100.0 : 0.0;
+    return std::min(std::max(usage, 0.0), 100.0);
+}
+
+void usage_scalar(const double* previous_idle, const double* previous_total, const double* current_idle,
+                  const double* current_total, size_t begin, size_t end, double* usage) {
+    for (size_t core = begin; core < end; ++core) {
+        usage[core] = core_usage(previous_idle[core], previous_total[core], current_idle[core], current_total[core]);
+    }
+}
+}  // namespace
+
+void CpuCounterArrays::resize(size_t cores) {
+    idle.resize(cores);
+    total.resize(cores);
+}
+
+size_t CpuCounterArrays::size() const {
+    return total.size();
+}
+
+size_t compute_cpu_usage_scalar(const CpuCounterArrays& previous, const CpuCounterArrays& current, double* usage) {
+    const size_t cores = std::min(previous.size(), current.size());
+    usage_scalar(previous.idle.data(), previous.total.data(), current.idle.data(), current.total.data(), 0, cores,
+                 usage);
+    return cores;
+}
+
+size_t compute_cpu_usage(const CpuCounterArrays& previous, const CpuCounterArrays& current, double* usage) {
+#if defined(METRICS_AGENT_CPU_USAGE_SSE2)
+    const size_t cores = std::min(previous.size(), current.size());
+    const double* previous_idle = previous.idle.data();
+    const double* previous_total = previous.total.data();
+    const double* current_idle = current.idle.data();
+    const double* current_total = current.total.data();
+
+    const __m128d zero = _mm_setzero_pd();
+    const __m128d hundred = _mm_set1_pd(100.0);
+    size_t core = 0;
+    for (; core + 2 <= cores; core += 2) {
+        const __m128d total_delta =
+            _mm_max_pd(_mm_sub_pd(_mm_loadu_pd(current_total + core), _mm_loadu_pd(previous_total + core)), zero);
+        const __m128d idle_delta =
+            _mm_max_pd(_mm_sub_pd(_mm_loadu_pd(current_idle + core), _mm_loadu_pd(previous_idle + core)), zero);
+        const __m128d busy = _mm_sub_pd(total_delta, _mm_min_pd(total_delta, idle_delta));
+        // 0/0 lanes are NaN until the mask zeroes them.
+        const __m128d advanced = _mm_cmpgt_pd(total_delta, zero);
+        const __m128d value = _mm_and_pd(_mm_mul_pd(_mm_div_pd(busy, total_delta), hundred), advanced);
+        _mm_storeu_pd(usage + core, _mm_min_pd(_mm_max_pd(value, zero), hundred));
+    }
+    usage_scalar(previous_idle, previous_total, current_idle, current_total, core, cores, usage);
+    return cores;
+#else
+    return compute_cpu_usage_scalar(previous, current, usage);
+#endif
+}
+
+const char* cpu_usage_kernel() {
+#if defined(METRICS_AGENT_CPU_USAGE_SSE2)
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
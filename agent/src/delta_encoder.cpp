@@ -0,0 +1,356 @@
+#include "delta_encoder.h"
+#include "json_writer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+
+namespace {
+constexpr char kHexDigits[] = "0123456789abcdef";
+
+int64_t hundredths(double value) {
+    return std::llround(value * 100.0);
+}
+
+std::string random_stream_id() {
+    std::random_device device;
+    const uint64_t value = (static_cast<uint64_t>(device()) << 32) | device();
+    std::string id(16, '0');
+    for (size_t index = 0; index < id.size(); ++index) {
+        id[index] = kHexDigits[(value >> (60 - 4 * index)) & 0x0F];
+    }
+    return id;
+}
+
+/**
+ * Brings `reference` into the order of `current`, which lists the same
+ * entries. The backend's copy is in the order it rebuilt (known entries as
+ * before, new ones appended), so the snapshot's order is only sent, as
+ * `field`, when it differs from that.
+ */
+template <typename Entry, typename KeyOf, typename AppendKey>
+void append_order(std::vector<Entry>& reference, const std::vector<Entry>& current, KeyOf key_of,
+                  AppendKey append_key, const char* field, std::string& out) {
+    size_t first_moved = 0;
+    while (first_moved < current.size() && key_of(reference[first_moved]) == key_of(current[first_moved])) {
+        ++first_moved;
+    }
+    if (first_moved == current.size()) {
+        return;
+    }
+
+    out += field;
+    for (size_t index = 0; index < current.size(); ++index) {
+        if (index > 0) {
+            out.push_back(',');
+        }
+        append_key(out, current[index]);
+        if (index >= first_moved) {
+            size_t match = index;
+            while (key_of(reference[match]) != key_of(current[index])) {
+                ++match;
+            }
+            std::swap(reference[index], reference[match]);
+        }
+    }
+    out.push_back(']');
+}
+}  // namespace
+
+MetricsDeltaEncoder::MetricsDeltaEncoder(const DeltaOptions& options)
+    : options_(options),
+      cpu_deadband_hundredths_(hundredths(std::max(options.cpu_deadband_percent, 0.0))),
+      memory_deadband_hundredths_(hundredths(std::max(options.memory_deadband_mb, 0.0))) {
+    if (options_.stream_id.empty()) {
+        options_.stream_id = random_stream_id();
+    }
+    if (options_.keyframe_interval == 0) {
+        options_.keyframe_interval = 1;
+    }
+}
+
+const std::string& MetricsDeltaEncoder::stream_id() const {
+    return options_.stream_id;
+}
+
+void MetricsDeltaEncoder::begin() {
+    // Assignment reuses the reference's vectors and strings.
+    working_ = acknowledged_;
+}
+
+void MetricsDeltaEncoder::commit() {
+    acknowledged_ = working_;
+}
+
+void MetricsDeltaEncoder::force_keyframe() {
+    acknowledged_.valid = false;
+    working_.valid = false;
+}
+
+bool MetricsDeltaEncoder::cpu_changed(double sent, double current) const {
+    return std::llabs(hundredths(current) - hundredths(sent)) > cpu_deadband_hundredths_;
+}
+
+bool MetricsDeltaEncoder::memory_changed(double sent, double current) const {
+    return std::llabs(hundredths(current) - hundredths(sent)) > memory_deadband_hundredths_;
+}
+
+bool MetricsDeltaEncoder::append(const SystemMetrics& metrics, std::string& out) {
+    const bool keyframe = !working_.valid ||
+        working_.since_keyframe >= options_.keyframe_interval ||
+        working_.reference.per_core_cpu_percent.size() != metrics.per_core_cpu_percent.size();
+
+    ++working_.sequence;
+    out += "{\"stream\":";
+    append_json_string(out, options_.stream_id);
+    out += ",\"sequence\":";
+    append_json_int(out, static_cast<int64_t>(working_.sequence));
+    if (keyframe) {
+        out += ",\"keyframe\":";
+        append_metrics_json(out, metrics);
+        working_.reference = metrics;
+        working_.valid = true;
+        working_.since_keyframe = 1;
+    } else {
+        out += ",\"delta\":";
+        append_delta(metrics, out);
+        ++working_.since_keyframe;
+    }
+    out.push_back('}');
+    return keyframe;
+}
+
+void MetricsDeltaEncoder::append_delta(const SystemMetrics& metrics, std::string& out) {
+    SystemMetrics& reference = working_.reference;
+    reference.timestamp = metrics.timestamp;
+    reference.timestamp_ms = metrics.timestamp_ms;
+    out += "{\"timestamp\":";
+    append_json_int(out, static_cast<int64_t>(metrics.timestamp));
+    out += ",\"timestamp_ms\":";
+    append_json_int(out, metrics.timestamp_ms);
+
+    if (cpu_changed(reference.total_cpu_percent, metrics.total_cpu_percent)) {
+        reference.total_cpu_percent = metrics.total_cpu_percent;
+        out += ",\"total_cpu_percent\":";
+        append_json_fixed2(out, metrics.total_cpu_percent);
+    }
+
+    // The core counts match; a change starts a keyframe.
+    bool any_core = false;
+    for (size_t core = 0; core < metrics.per_core_cpu_percent.size(); ++core) {
+        if (!cpu_changed(reference.per_core_cpu_percent[core], metrics.per_core_cpu_percent[core])) {
+            continue;
+        }
+        reference.per_core_cpu_percent[core] = metrics.per_core_cpu_percent[core];
+        out += any_core ? ",\"" : ",\"per_core_cpu_percent\":{\"";
+        any_core = true;
+        append_json_int(out, static_cast<int64_t>(core));
+        out += "\":";
+        append_json_fixed2(out, metrics.per_core_cpu_percent[core]);
+    }
+    if (any_core) {
+        out.push_back('}');
+    }
+
+    if (memory_changed(reference.system_memory_total_mb, metrics.system_memory_total_mb)) {
+        reference.system_memory_total_mb = metrics.system_memory_total_mb;
+        out += ",\"system_memory_total_mb\":";
+        append_json_fixed2(out, metrics.system_memory_total_mb);
+    }
+    if (memory_changed(reference.system_memory_used_mb, metrics.system_memory_used_mb)) {
+        reference.system_memory_used_mb = metrics.system_memory_used_mb;
+        out += ",\"system_memory_used_mb\":";
+        append_json_fixed2(out, metrics.system_memory_used_mb);
+    }
+
+    append_process_changes(metrics.top_processes, out);
+    append_cgroup_changes(metrics.top_cgroups, out);
+
+    if (metrics.window.samples > 0) {
+        out += ",\"window\":";
+        append_window_json(out, metrics.window);
+    }
+    out.push_back('}');
+}
+
+void MetricsDeltaEncoder::append_process_changes(const std::vector<ProcessMetrics>& processes, std::string& out) {
+    std::vector<ProcessMetrics>& reference = working_.reference.top_processes;
+    const size_t known = reference.size();
+    seen_.assign(known, 0);
+
+    bool any = false;
+    for (const auto& proc : processes) {
+        size_t index = 0;
+        while (index < known && reference[index].pid != proc.pid) {
+            ++index;
+        }
+        const size_t rollback = out.size();
+        out += any ? "," : ",\"top_processes\":[";
+
+        // A new PID, or a reused one (new name), is sent in full.
+        if (index == known || reference[index].name != proc.name) {
+            append_process_json(out, proc);
+            if (index == known) {
+                reference.push_back(proc);
+            } else {
+                reference[index] = proc;
+                seen_[index] = 1;
+            }
+            any = true;
+            continue;
+        }
+
+        seen_[index] = 1;
+        ProcessMetrics& sent = reference[index];
+        out += "{\"pid\":";
+        append_json_int(out, proc.pid);
+        const size_t fields = out.size();
+        if (cpu_changed(sent.cpu_percent, proc.cpu_percent)) {
+            sent.cpu_percent = proc.cpu_percent;
+            out += ",\"cpu_percent\":";
+            append_json_fixed2(out, proc.cpu_percent);
+        }
+        if (memory_changed(sent.memory_mb, proc.memory_mb)) {
+            sent.memory_mb = proc.memory_mb;
+            out += ",\"memory_mb\":";
+            append_json_fixed2(out, proc.memory_mb);
+        }
+        if (sent.thread_count != proc.thread_count) {
+            sent.thread_count = proc.thread_count;
+            out += ",\"thread_count\":";
+            append_json_int(out, proc.thread_count);
+        }
+        if (memory_changed(sent.io_read_mb, proc.io_read_mb)) {
+            sent.io_read_mb = proc.io_read_mb;
+            out += ",\"io_read_mb\":";
+            append_json_fixed2(out, proc.io_read_mb);
+        }
+        if (memory_changed(sent.io_write_mb, proc.io_write_mb)) {
+            sent.io_write_mb = proc.io_write_mb;
+            out += ",\"io_write_mb\":";
+            append_json_fixed2(out, proc.io_write_mb);
+        }
+        if (sent.handle_count != proc.handle_count) {
+            sent.handle_count = proc.handle_count;
+            out += ",\"handle_count\":";
+            append_json_int(out, proc.handle_count);
+        }
+        if (out.size() == fields) {
+            out.resize(rollback);
+            continue;
+        }
+        out.push_back('}');
+        any = true;
+    }
+    if (any) {
+        out.push_back(']');
+    }
+
+    // Entries the snapshot no longer lists, compacted out of the reference.
+    any = false;
+    size_t kept = 0;
+    for (size_t index = 0; index < reference.size(); ++index) {
+        if (index < known && !seen_[index]) {
+            out += any ? "," : ",\"removed_pids\":[";
+            any = true;
+            append_json_int(out, reference[index].pid);
+            continue;
+        }
+        if (kept != index) {
+            std::swap(reference[kept], reference[index]);
+        }
+        ++kept;
+    }
+    reference.resize(kept);
+    if (any) {
+        out.push_back(']');
+    }
+
+    append_order(
+        reference, processes, [](const ProcessMetrics& proc) { return proc.pid; },
+        [](std::string& buffer, const ProcessMetrics& proc) { append_json_int(buffer, proc.pid); },
+        ",\"process_order\":[", out);
+}
+
+void MetricsDeltaEncoder::append_cgroup_changes(const std::vector<CgroupMetrics>& cgroups, std::string& out) {
+    std::vector<CgroupMetrics>& reference = working_.reference.top_cgroups;
+    const size_t known = reference.size();
+    seen_.assign(known, 0);
+
+    bool any = false;
+    for (const auto& cgroup : cgroups) {
+        size_t index = 0;
+        while (index < known && reference[index].path != cgroup.path) {
+            ++index;
+        }
+        const size_t rollback = out.size();
+        out += any ? "," : ",\"top_cgroups\":[";
+
+        if (index == known) {
+            append_cgroup_json(out, cgroup);
+            reference.push_back(cgroup);
+            any = true;
+            continue;
+        }
+
+        seen_[index] = 1;
+        CgroupMetrics& sent = reference[index];
+        out += "{\"path\":";
+        append_json_string(out, cgroup.path);
+        const size_t fields = out.size();
+        if (cpu_changed(sent.cpu_percent, cgroup.cpu_percent)) {
+            sent.cpu_percent = cgroup.cpu_percent;
+            out += ",\"cpu_percent\":";
+            append_json_fixed2(out, cgroup.cpu_percent);
+        }
+        if (memory_changed(sent.memory_mb, cgroup.memory_mb)) {
+            sent.memory_mb = cgroup.memory_mb;
+            out += ",\"memory_mb\":";
+            append_json_fixed2(out, cgroup.memory_mb);
+        }
+        if (memory_changed(sent.io_read_mb, cgroup.io_read_mb)) {
+            sent.io_read_mb = cgroup.io_read_mb;
+            out += ",\"io_read_mb\":";
+            append_json_fixed2(out, cgroup.io_read_mb);
+        }
+        if (memory_changed(sent.io_write_mb, cgroup.io_write_mb)) {
+            sent.io_write_mb = cgroup.io_write_mb;
+            out += ",\"io_write_mb\":";
+            append_json_fixed2(out, cgroup.io_write_mb);
+        }
+        if (out.size() == fields) {
+            out.resize(rollback);
+            continue;
+        }
+        out.push_back('}');
+        any = true;
+    }
+    if (any) {
+        out.push_back(']');
+    }
+
+    any = false;
+    size_t kept = 0;
+    for (size_t index = 0; index < reference.size(); ++index) {
+        if (index < known && !seen_[index]) {
+            out += any ? "," : ",\"removed_cgroups\":[";
+            any = true;
+            append_json_string(out, reference[index].path);
+            continue;
+        }
+        if (kept != index) {
+            std::swap(reference[kept], reference[index]);
+        }
+        ++kept;
+    }
+    reference.resize(kept);
+    if (any) {
+        out.push_back(']');
+    }
+
+    append_order(
+        reference, cgroups, [](const CgroupMetrics& cgroup) -> const std::string& { return cgroup.path; },
+        [](std::string& buffer, const CgroupMetrics& cgroup) { append_json_string(buffer, cgroup.path); },
+        ",\"cgroup_order\":[", out);
+}
@@ -1,8 +1,8 @@
 #include "http_client.h"
+#include "agent_telemetry.h"
+#include "json_writer.h"
+#include <algorithm>
 #include <curl/curl.h>
-#include <sstream>
-#include <iomanip>
-#include <array>
 
 /**
  * @brief Appends response payload bytes emitted by libcurl.
@@ -26,138 +26,439 @@ static size_t write_callback(void* contents, size_t size, size_t nmemb, std::str
  *
  * Initializes global libcurl state for the current process. This class assumes
  * process-level startup/shutdown style usage consistent with the agent runtime.
+ * The ingest URL, request headers and the persistent handle are set up here so
+ * that a send only has to attach the payload.
  *
  * @param backend_url Base backend URL (for example: http://localhost:8000).
+ * @param options Payload encoding and compression.
  */
-HttpClient::HttpClient(const std::string& backend_url) 
-    : backend_url(backend_url) {
+HttpClient::HttpClient(const std::string& backend_url, const HttpClientOptions& options) 
+    : backend_url(backend_url),
+      options(options),
+      ingest_url(backend_url + "/ingest/metrics"),
+      batch_url(backend_url + "/ingest/metrics/batch"),
+      delta_url(backend_url + "/ingest/metrics/delta"),
+      delta_encoder(options.delta),
+      retry_backoff(options.retry.base_delay, options.retry.max_delay, options.jitter_seed),
+      circuit_breaker(options.retry, options.jitter_seed) {
     curl_global_init(CURL_GLOBAL_DEFAULT);
+
+    if (options.wire_format == WireFormat::binary) {
+        request_headers = curl_slist_append(
+            request_headers, (std::string("Content-Type: ") + kBinaryMetricsContentType).c_str());
+    } else {
+        request_headers = curl_slist_append(request_headers, "Content-Type: application/json");
+    }
+    delta_headers = curl_slist_append(delta_headers, "Content-Type: application/json");
+    if (options.compression == WireCompression::gzip) {
+        request_headers = curl_slist_append(request_headers, "Content-Encoding: gzip");
+        delta_headers = curl_slist_append(delta_headers, "Content-Encoding: gzip");
+    }
+
+    curl_share = curl_share_init();
+    if (curl_share) {
+        curl_share_setopt(curl_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+        curl_share_setopt(curl_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    }
+
+    prepare_handle();
 }
 
 /**
- * @brief Releases libcurl global resources.
+ * @brief Releases the persistent handle and libcurl global resources.
  */
 HttpClient::~HttpClient() {
+    if (curl_handle) {
+        curl_easy_cleanup(curl_handle);
+    }
+    if (curl_share) {
+        curl_share_cleanup(curl_share);
+    }
+    curl_slist_free_all(request_headers);
+    curl_slist_free_all(delta_headers);
     curl_global_cleanup();
 }
 
+/**
+ * @brief Creates the persistent easy handle if it does not exist yet.
+ *
+ * Options that do not change between sends are applied once. libcurl keeps
+ * the connection open after each transfer (HTTP keep-alive), and TCP
+ * keepalive probes stop idle middleboxes from silently dropping it between
+ * collection intervals.
+ *
+ * @return True if the handle is ready for a send.
+ */
+bool HttpClient::prepare_handle() {
+    if (curl_handle) {
+        return true;
+    }
+
+    curl_handle = curl_easy_init();
+    if (!curl_handle) {
+        return false;
+    }
+
+    curl_easy_setopt(curl_handle, CURLOPT_WRITEFUNCTION, write_callback);
+    curl_easy_setopt(curl_handle, CURLOPT_WRITEDATA, &response_body);
+    curl_easy_setopt(curl_handle, CURLOPT_ERRORBUFFER, curl_error.data());
+    curl_easy_setopt(curl_handle, CURLOPT_CONNECTTIMEOUT_MS, options.connect_timeout_ms);
+    curl_easy_setopt(curl_handle, CURLOPT_TIMEOUT_MS, options.request_timeout_ms);
+    // Timeouts must not rely on SIGALRM in a multi-threaded process.
+    curl_easy_setopt(curl_handle, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl_handle, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(curl_handle, CURLOPT_TCP_KEEPIDLE, 30L);
+    curl_easy_setopt(curl_handle, CURLOPT_TCP_KEEPINTVL, 15L);
+    if (curl_share) {
+        curl_easy_setopt(curl_handle, CURLOPT_SHARE, curl_share);
+    }
+    return true;
+}
+
 /**
  * @brief Serializes metrics into the backend JSON schema.
  *
  * Numeric values are emitted with two decimal places for consistency and
- * stable downstream parsing.
+ * stable downstream parsing. Process names are escaped. The send paths
+ * serialize straight into the client's reusable request buffer instead.
  *
  * @param metrics Metrics snapshot to serialize.
  * @return JSON payload string for the ingest endpoint.
  */
 std::string HttpClient::metrics_to_json(const SystemMetrics& metrics) {
-    std::ostringstream json;
-    
-    json << "{";
-    json << "\"timestamp\":" << metrics.timestamp << ",";
-    json << "\"total_cpu_percent\":" << std::fixed << std::setprecision(2) << metrics.total_cpu_percent << ",";
-    json << "\"per_core_cpu_percent\":[";
-    for (size_t index = 0; index < metrics.per_core_cpu_percent.size(); ++index) {
-        json << std::fixed << std::setprecision(2) << metrics.per_core_cpu_percent[index];
-        if (index < metrics.per_core_cpu_percent.size() - 1) {
-            json << ",";
-        }
-    }
-    json << "],";
-    json << "\"system_memory_total_mb\":" << std::fixed << std::setprecision(2) << metrics.system_memory_total_mb << ",";
-    json << "\"system_memory_used_mb\":" << std::fixed << std::setprecision(2) << metrics.system_memory_used_mb << ",";
-    json << "\"top_processes\":[";
-    
-    for (size_t i = 0; i < metrics.top_processes.size(); ++i) {
-        const auto& proc = metrics.top_processes[i];
-        json << "{";
-        json << "\"pid\":" << proc.pid << ",";
-        json << "\"name\":\"" << proc.name << "\",";
-        json << "\"cpu_percent\":" << std::fixed << std::setprecision(2) << proc.cpu_percent << ",";
-        json << "\"memory_mb\":" << std::fixed << std::setprecision(2) << proc.memory_mb << ",";
-        json << "\"thread_count\":" << proc.thread_count << ",";
-        json << "\"io_read_mb\":" << std::fixed << std::setprecision(2) << proc.io_read_mb << ",";
-        json << "\"io_write_mb\":" << std::fixed << std::setprecision(2) << proc.io_write_mb << ",";
-        json << "\"handle_count\":" << proc.handle_count;
-        json << "}";
-        
-        if (i < metrics.top_processes.size() - 1) {
-            json << ",";
-        }
-    }
-    
-    json << "]";
-    json << "}";
-    
-    return json.str();
+    std::string json;
+    append_metrics_json(json, metrics);
+    return json;
 }
 
 /**
  * @brief Sends a metrics snapshot to the backend ingest endpoint.
  *
- * This method posts JSON to `${backend_url}/ingest/metrics` and captures
- * diagnostic state for callers:
- * - `last_error_message` is set on failure and cleared at the start.
- * - `last_status_code` stores the latest HTTP response code when available.
+ * This method posts one snapshot to `${backend_url}/ingest/metrics` over the persistent
+ * handle, reusing the open connection when the backend kept it alive.
  *
  * @param metrics Metrics snapshot to send.
  * @return true on HTTP 2xx response; false on network, transport, or HTTP errors.
  */
 bool HttpClient::send_metrics(const SystemMetrics& metrics) {
+    {
+        ScopedStageTimer timer(TelemetryStage::serialize);
+        encode_request(&metrics, 1, false);
+    }
+    return post_request_body(ingest_url);
+}
+
+/**
+ * @brief Sends queued snapshots in one request to the batch endpoint.
+ *
+ * JSON snapshots are appended in order until the next one would push the
+ * array past `max_bytes`. The caller keeps the remainder for the next request.
+ *
+ * @param batch Snapshots in collection order.
+ * @param max_bytes Upper bound on the request body size.
+ * @param sent_count Receives the number of snapshots included in the request.
+ * @return true on HTTP 2xx response; false on network, transport, or HTTP errors.
+ */
+bool HttpClient::send_metrics_batch(const SystemMetrics* batch, size_t count, size_t max_bytes, size_t& sent_count) {
+    sent_count = 0;
+
+    if (count == 0) {
+        last_error_message.clear();
+        last_status_code = 0;
+        return true;
+    }
+
+    if (options.wire_format == WireFormat::binary) {
+        // Names and deltas refer back to earlier snapshots, so the payload is
+        // not appendable; halve the batch until it fits instead.
+        {
+            ScopedStageTimer timer(TelemetryStage::serialize);
+            sent_count = count;
+            encode_request(batch, sent_count, true);
+            while (sent_count > 1 && request_body.size() > max_bytes) {
+                sent_count /= 2;
+                encode_request(batch, sent_count, true);
+            }
+        }
+        return post_request_body(batch_url);
+    }
+
+    {
+        ScopedStageTimer timer(TelemetryStage::serialize);
+        request_body.clear();
+        request_body.push_back('[');
+        for (size_t i = 0; i < count; ++i) {
+            const size_t rollback_size = request_body.size();
+            if (sent_count > 0) {
+                request_body.push_back(',');
+            }
+            append_metrics_json(request_body, batch[i]);
+
+            // +1 for the closing bracket.
+            if (sent_count > 0 && request_body.size() + 1 > max_bytes) {
+                request_body.resize(rollback_size);
+                break;
+            }
+            ++sent_count;
+        }
+        request_body.push_back(']');
+    }
+
+    return post_request_body(batch_url);
+}
+
+/**
+ * @brief Sends queued snapshots as delta documents.
+ *
+ * The encoder advances only when the backend accepts the request. A 409
+ * (the backend lost or never had the base, e.g. after a restart) is
+ * answered at once with the same snapshots from a keyframe; any other
+ * failure leaves the backend's state unknown, so the next request starts
+ * with a keyframe too.
+ *
+ * @param batch Snapshots in collection order.
+ * @param max_bytes Upper bound on the request body size.
+ * @param sent_count Receives the number of snapshots included in the request.
+ * @return true on HTTP 2xx response; false on network, transport, or HTTP errors.
+ */
+bool HttpClient::send_metrics_delta(const SystemMetrics* batch, size_t count, size_t max_bytes, size_t& sent_count) {
+    sent_count = 0;
+
+    if (count == 0) {
+        last_error_message.clear();
+        last_status_code = 0;
+        return true;
+    }
+
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        {
+            ScopedStageTimer timer(TelemetryStage::serialize);
+            sent_count = encode_delta_request(batch, count, max_bytes);
+        }
+        if (post_request_body(delta_url, delta_headers)) {
+            delta_encoder.commit();
+            return true;
+        }
+        // A request the breaker refused never reached the backend.
+        if (last_attempt_count > 0) {
+            delta_encoder.force_keyframe();
+        }
+        if (last_status_code != 409) {
+            return false;
+        }
+        ++delta_resync_count;
+    }
+    return false;
+}
+
+uint64_t HttpClient::delta_resyncs() const {
+    return delta_resync_count;
+}
+
+const std::string& HttpClient::delta_stream_id() const {
+    return delta_encoder.stream_id();
+}
+
+/**
+ * @brief Encodes delta documents into the reusable request buffer.
+ *
+ * Documents refer to the ones before them, so one that would overflow
+ * `max_bytes` cannot just be cut off: the request is re-encoded without it.
+ */
+size_t HttpClient::encode_delta_request(const SystemMetrics* snapshots, size_t count, size_t max_bytes) {
+    delta_encoder.begin();
+    request_body.clear();
+    request_body.push_back('[');
+    size_t encoded = 0;
+    for (; encoded < count; ++encoded) {
+        if (encoded > 0) {
+            request_body.push_back(',');
+        }
+        delta_encoder.append(snapshots[encoded], request_body);
+        // +1 for the closing bracket.
+        if (encoded > 0 && request_body.size() + 1 > max_bytes) {
+            break;
+        }
+    }
+    if (encoded < count) {
+        delta_encoder.begin();
+        request_body.clear();
+        request_body.push_back('[');
+        for (size_t index = 0; index < encoded; ++index) {
+            if (index > 0) {
+                request_body.push_back(',');
+            }
+            delta_encoder.append(snapshots[index], request_body);
+        }
+    }
+    request_body.push_back(']');
+    return encoded;
+}
+
+/**
+ * @brief Encodes snapshots into the reusable request buffer.
+ *
+ * @param snapshots First snapshot to encode.
+ * @param count Number of snapshots.
+ * @param as_array For JSON, emit an array (batch endpoint) instead of one object.
+ */
+void HttpClient::encode_request(const SystemMetrics* snapshots, size_t count, bool as_array) {
+    if (options.wire_format == WireFormat::binary) {
+        binary_encoder.encode(snapshots, count, request_body);
+        return;
+    }
+
+    request_body.clear();
+    if (!as_array) {
+        append_metrics_json(request_body, snapshots[0]);
+        return;
+    }
+
+    request_body.push_back('[');
+    for (size_t index = 0; index < count; ++index) {
+        if (index > 0) {
+            request_body.push_back(',');
+        }
+        append_metrics_json(request_body, snapshots[index]);
+    }
+    request_body.push_back(']');
+}
+
+/**
+ * @brief Posts the prepared request body, retrying transient failures.
+ *
+ * The body is compressed once and re-posted as is. Between attempts the
+ * client waits for the jittered backoff or the backend's Retry-After,
+ * whichever is longer. A Retry-After beyond `retry.max_delay` is not waited
+ * out here: it is handed to the circuit breaker, so the sender fails fast
+ * (and spools) for that long instead of blocking.
+ *
+ * Captures diagnostic state for callers:
+ * - `last_error_message` is set on failure and cleared at the start.
+ * - `last_status_code` stores the latest HTTP response code when available.
+ * - `last_attempt_count` counts the requests made.
+ *
+ * @param url Endpoint to post to.
+ * @return true on HTTP 2xx response; false on network, transport, or HTTP errors.
+ */
+bool HttpClient::post_request_body(const std::string& url, curl_slist* headers) {
     last_error_message.clear();
     last_status_code = 0;
+    last_attempt_count = 0;
+
+    if (!circuit_breaker.allow(std::chrono::steady_clock::now())) {
+        last_error_message = "Circuit breaker open; skipped request to " + url;
+        return false;
+    }
 
-    CURL* curl = curl_easy_init();
-    if (!curl) {
+    if (!prepare_handle()) {
         last_error_message = "Failed to initialize CURL client";
         return false;
     }
-    
-    std::string json_data = metrics_to_json(metrics);
-    std::string response;
-    std::array<char, CURL_ERROR_SIZE> curl_error{};
-    
-    curl_easy_setopt(curl, CURLOPT_URL, (backend_url + "/ingest/metrics").c_str());
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, json_data.c_str());
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, static_cast<long>(json_data.size()));
-    
-    struct curl_slist* headers = nullptr;
-    headers = curl_slist_append(headers, "Content-Type: application/json");
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-    
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-    curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, curl_error.data());
-    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 3L);
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 5L);
-    
-    CURLcode res = curl_easy_perform(curl);
-    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &last_status_code);
-    
-    curl_slist_free_all(headers);
-    curl_easy_cleanup(curl);
+
+    ScopedStageTimer timer(TelemetryStage::send);
+
+    // libcurl only decompresses responses, so request bodies are gzipped here.
+    const std::string* body = &request_body;
+    if (options.compression == WireCompression::gzip) {
+        if (!gzip_compress(request_body, compressed_body)) {
+            last_error_message = "Failed to compress request body";
+            return false;
+        }
+        body = &compressed_body;
+    }
+
+    const size_t max_attempts = std::max<size_t>(options.retry.max_attempts, 1);
+    std::chrono::milliseconds retry_after{0};
+    AgentTelemetry& telemetry = agent_telemetry();
+    while (true) {
+        if (++last_attempt_count > 1) {
+            telemetry.retries.fetch_add(1, std::memory_order_relaxed);
+        }
+        telemetry.requests.fetch_add(1, std::memory_order_relaxed);
+        if (perform_request(url, (headers != nullptr) ? headers : request_headers, *body, retry_after)) {
+            telemetry.bytes_sent.fetch_add(body->size(), std::memory_order_relaxed);
+            circuit_breaker.record_success();
+            return true;
+        }
+        telemetry.request_failures.fetch_add(1, std::memory_order_relaxed);
+
+        if (!is_retryable_status(last_status_code)) {
+            // The backend answered and refused this request; it is not down.
+            circuit_breaker.record_success();
+            return false;
+        }
+        if (last_attempt_count >= max_attempts || retry_after > options.retry.max_delay) {
+            break;
+        }
+
+        const std::chrono::milliseconds delay = std::max(retry_backoff.delay(last_attempt_count - 1), retry_after);
+        retry_after = std::chrono::milliseconds::zero();
+        if (!wait_until(std::chrono::steady_clock::now() + delay)) {
+            break;
+        }
+    }
+
+    circuit_breaker.record_failure(std::chrono::steady_clock::now(), retry_after);
+    return false;
+}
+
+/**
+ * @brief Makes one request over the persistent handle.
+ *
+ * Sets `last_error_message` and `last_status_code` for this attempt.
+ */
+bool HttpClient::perform_request(const std::string& url, curl_slist* headers, const std::string& body,
+                                 std::chrono::milliseconds& retry_after) {
+    last_error_message.clear();
+    last_status_code = 0;
+    retry_after = std::chrono::milliseconds::zero();
+    response_body.clear();
+    curl_error[0] = '\0';
+
+    curl_easy_setopt(curl_handle, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl_handle, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(curl_handle, CURLOPT_POSTFIELDS, body.data());
+    curl_easy_setopt(curl_handle, CURLOPT_POSTFIELDSIZE, static_cast<long>(body.size()));
+
+    CURLcode res = curl_easy_perform(curl_handle);
+    curl_easy_getinfo(curl_handle, CURLINFO_RESPONSE_CODE, &last_status_code);
 
     if (res != CURLE_OK) {
-        last_error_message = "Network error while sending to " + backend_url + "/ingest/metrics: ";
+        last_error_message = "Network error while sending to " + url + ": ";
         if (!curl_error[0]) {
             last_error_message += curl_easy_strerror(res);
         } else {
             last_error_message += curl_error.data();
         }
+        last_status_code = 0;
         return false;
     }
 
     if (last_status_code < 200 || last_status_code >= 300) {
+#if LIBCURL_VERSION_NUM >= 0x074200
+        // Seconds from a Retry-After header (libcurl 7.66+); 0 if absent.
+        curl_off_t retry_after_seconds = 0;
+        if (curl_easy_getinfo(curl_handle, CURLINFO_RETRY_AFTER, &retry_after_seconds) == CURLE_OK &&
+            retry_after_seconds > 0) {
+            retry_after = std::chrono::seconds(retry_after_seconds);
+        }
+#endif
         last_error_message = "Backend returned HTTP " + std::to_string(last_status_code);
-        if (!response.empty()) {
-            last_error_message += " with response: " + response;
+        if (!response_body.empty()) {
+            last_error_message += " with response: " + response_body;
         }
         return false;
     }
-    
+
     return true;
 }
 
+bool HttpClient::wait_until(std::chrono::steady_clock::time_point deadline) {
+    std::unique_lock<std::mutex> lock(cancel_mutex);
+    return !cancel_cv.wait_until(lock, deadline, [this]() { return cancelled; });
+}
+
 /**
  * @brief Returns the most recent send error message.
  *
@@ -176,3 +477,36 @@ const std::string& HttpClient::last_error() const {
 long HttpClient::last_http_status() const {
     return last_status_code;
 }
+
+size_t HttpClient::last_attempts() const {
+    return last_attempt_count;
+}
+
+CircuitState HttpClient::circuit_state() const {
+    return circuit_breaker.state();
+}
+
+std::chrono::steady_clock::time_point HttpClient::circuit_retry_at() const {
+    return circuit_breaker.retry_at();
+}
+
+/**
+ * @brief Sleeps through an open breaker's cool-down.
+ *
+ * Returns at once when the breaker is not open, so the caller can use it
+ * unconditionally before a send.
+ */
+bool HttpClient::wait_for_circuit() {
+    if (circuit_breaker.state() != CircuitState::open) {
+        return true;
+    }
+    return wait_until(circuit_breaker.retry_at());
+}
+
+void HttpClient::cancel_retries() {
+    {
+        std::lock_guard<std::mutex> lock(cancel_mutex);
+        cancelled = true;
+    }
+    cancel_cv.notify_all();
+}
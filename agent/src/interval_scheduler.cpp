@@ -0,0 +1,87 @@
+#include "interval_scheduler.h"
+
+uint64_t advance_deadline(
+    std::chrono::steady_clock::time_point& deadline,
+    std::chrono::steady_clock::time_point now,
+    std::chrono::steady_clock::duration interval
+) {
+    deadline += interval;
+    if (now <= deadline) {
+        return 0;
+    }
+
+    // Land on the first slot after `now`, keeping the original phase.
+    const uint64_t skipped = static_cast<uint64_t>((now - deadline) / interval) + 1;
+    deadline += interval * static_cast<std::chrono::steady_clock::rep>(skipped);
+    return skipped;
+}
+
+IntervalScheduler::IntervalScheduler(std::chrono::milliseconds interval)
+    : interval_(interval) {}
+
+bool IntervalScheduler::wait_next() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (stopped_) {
+        return false;
+    }
+
+    if (!started_) {
+        started_ = true;
+        deadline_ = std::chrono::steady_clock::now();
+        return true;
+    }
+
+    last_skipped_ = advance_deadline(deadline_, std::chrono::steady_clock::now(), interval_);
+    slot_ += last_skipped_ + 1;
+    if (last_skipped_ > 0) {
+        ++overruns_;
+        skipped_slots_ += last_skipped_;
+    }
+
+    return !stop_cv_.wait_until(lock, deadline_, [this]() { return stopped_; });
+}
+
+void IntervalScheduler::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopped_ = true;
+    }
+    stop_cv_.notify_all();
+}
+
+void IntervalScheduler::set_interval(std::chrono::milliseconds interval) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    interval_ = interval;
+}
+
+uint64_t IntervalScheduler::slot() const {
+    return slot_;
+}
+
+uint64_t IntervalScheduler::last_skipped() const {
+    return last_skipped_;
+}
+
+uint64_t IntervalScheduler::overruns() const {
+    return overruns_;
+}
+
+uint64_t IntervalScheduler::skipped_slots() const {
+    return skipped_slots_;
+}
+
+void CollectionTiers::add(uint32_t families, uint64_t period_slots) {
+    tiers_.push_back({families, period_slots > 0 ? period_slots : 1, 0, false});
+}
+
+uint32_t CollectionTiers::due(uint64_t slot) {
+    uint32_t families = 0;
+    for (auto& tier : tiers_) {
+        if (!tier.has_run || slot - tier.last_slot >= tier.period_slots) {
+            tier.has_run = true;
+            tier.last_slot = slot;
+            families |= tier.families;
+        }
+    }
+    return families;
+}
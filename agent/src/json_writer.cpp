@@ -0,0 +1,245 @@
+#include "json_writer.h"
+
+#include <charconv>
+#include <cstdio>
+
+namespace {
+constexpr char kHexDigits[] = "0123456789abcdef";
+
+// Length of the valid UTF-8 sequence starting at `text[index]`, or 0 if the
+// bytes there are not one (overlong forms, surrogates and values above
+// U+10FFFF included).
+size_t utf8_sequence_length(std::string_view text, size_t index) {
+    const auto byte = [&](size_t offset) {
+        return static_cast<unsigned char>(text[index + offset]);
+    };
+    const auto is_continuation = [&](size_t offset) {
+        return index + offset < text.size() && (byte(offset) & 0xC0) == 0x80;
+    };
+
+    const unsigned char lead = byte(0);
+    if (lead >= 0xC2 && lead <= 0xDF) {
+        return is_continuation(1) ? 2 : 0;
+    }
+    if (lead >= 0xE0 && lead <= 0xEF) {
+        if (!is_continuation(1) || !is_continuation(2)) {
+            return 0;
+        }
+        if ((lead == 0xE0 && byte(1) < 0xA0) || (lead == 0xED && byte(1) >= 0xA0)) {
+            return 0;
+        }
+        return 3;
+    }
+    if (lead >= 0xF0 && lead <= 0xF4) {
+        if (!is_continuation(1) || !is_continuation(2) || !is_continuation(3)) {
+            return 0;
+        }
+        if ((lead == 0xF0 && byte(1) < 0x90) || (lead == 0xF4 && byte(1) >= 0x90)) {
+            return 0;
+        }
+        return 4;
+    }
+    return 0;
+}
+
+void append_window_stats(std::string& out, const WindowStats& stats) {
+    out += "{\"min\":";
+    append_json_fixed2(out, stats.min);
+    out += ",\"max\":";
+    append_json_fixed2(out, stats.max);
+    out += ",\"mean\":";
+    append_json_fixed2(out, stats.mean);
+    out += ",\"p95\":";
+    append_json_fixed2(out, stats.p95);
+    out.push_back('}');
+}
+
+void append_escaped_control(std::string& out, unsigned char c) {
+    switch (c) {
+        case '\b': out += "\\b"; return;
+        case '\f': out += "\\f"; return;
+        case '\n': out += "\\n"; return;
+        case '\r': out += "\\r"; return;
+        case '\t': out += "\\t"; return;
+        default: break;
+    }
+    const char escape[6] = {'\\', 'u', '0', '0', kHexDigits[c >> 4], kHexDigits[c & 0x0F]};
+    out.append(escape, sizeof(escape));
+}
+}  // namespace
+
+void append_json_string(std::string& out, std::string_view value) {
+    out.push_back('"');
+
+    // Copy runs of bytes that need no escaping in one append.
+    size_t run_start = 0;
+    size_t index = 0;
+    while (index < value.size()) {
+        const unsigned char c = static_cast<unsigned char>(value[index]);
+        if (c >= 0x20 && c < 0x80 && c != '"' && c != '\\') {
+            ++index;
+            continue;
+        }
+
+        if (c >= 0x80) {
+            const size_t length = utf8_sequence_length(value, index);
+            if (length > 0) {
+                index += length;
+                continue;
+            }
+        }
+
+        out.append(value.data() + run_start, index - run_start);
+        if (c == '"' || c == '\\') {
+            out.push_back('\\');
+            out.push_back(static_cast<char>(c));
+        } else if (c < 0x20) {
+            append_escaped_control(out, c);
+        } else {
+            out += "\\ufffd";
+        }
+        ++index;
+        run_start = index;
+    }
+    out.append(value.data() + run_start, value.size() - run_start);
+
+    out.push_back('"');
+}
+
+void append_json_int(std::string& out, int64_t value) {
+    char buffer[24];
+    const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, static_cast<size_t>(result.ptr - buffer));
+}
+
+void append_json_fixed2(std::string& out, double value) {
+    // Large enough for any double in fixed notation with two decimals.
+    char buffer[330];
+#if defined(__cpp_lib_to_chars)
+    const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value, std::chars_format::fixed, 2);
+    out.append(buffer, static_cast<size_t>(result.ptr - buffer));
+#else
+    // Standard libraries without floating-point to_chars; the agent never
+    // changes the C locale, so the decimal separator stays '.'.
+    const int length = std::snprintf(buffer, sizeof(buffer), "%.2f", value);
+    if (length > 0) {
+        out.append(buffer, static_cast<size_t>(length));
+    }
+#endif
+}
+
+void append_process_json(std::string& out, const ProcessMetrics& proc) {
+    out += "{\"pid\":";
+    append_json_int(out, proc.pid);
+    out += ",\"name\":";
+    append_json_string(out, proc.name);
+    out += ",\"cpu_percent\":";
+    append_json_fixed2(out, proc.cpu_percent);
+    out += ",\"memory_mb\":";
+    append_json_fixed2(out, proc.memory_mb);
+    out += ",\"thread_count\":";
+    append_json_int(out, proc.thread_count);
+    out += ",\"io_read_mb\":";
+    append_json_fixed2(out, proc.io_read_mb);
+    out += ",\"io_write_mb\":";
+    append_json_fixed2(out, proc.io_write_mb);
+    out += ",\"handle_count\":";
+    append_json_int(out, proc.handle_count);
+    out.push_back('}');
+}
+
+void append_cgroup_json(std::string& out, const CgroupMetrics& cgroup) {
+    out += "{\"path\":";
+    append_json_string(out, cgroup.path);
+    out += ",\"cpu_percent\":";
+    append_json_fixed2(out, cgroup.cpu_percent);
+    out += ",\"memory_mb\":";
+    append_json_fixed2(out, cgroup.memory_mb);
+    out += ",\"io_read_mb\":";
+    append_json_fixed2(out, cgroup.io_read_mb);
+    out += ",\"io_write_mb\":";
+    append_json_fixed2(out, cgroup.io_write_mb);
+    out.push_back('}');
+}
+
+void append_window_json(std::string& out, const MetricsWindow& window) {
+    out += "{\"samples\":";
+    append_json_int(out, window.samples);
+    out += ",\"start_timestamp_ms\":";
+    append_json_int(out, window.start_timestamp_ms);
+    out += ",\"total_cpu_percent\":";
+    append_window_stats(out, window.total_cpu_percent);
+    out += ",\"per_core_cpu_percent\":[";
+    for (size_t index = 0; index < window.per_core_cpu_percent.size(); ++index) {
+        if (index > 0) {
+            out.push_back(',');
+        }
+        append_window_stats(out, window.per_core_cpu_percent[index]);
+    }
+    out += "],\"system_memory_used_mb\":";
+    append_window_stats(out, window.system_memory_used_mb);
+    out += ",\"top_processes\":[";
+    for (size_t index = 0; index < window.top_processes.size(); ++index) {
+        const auto& proc = window.top_processes[index];
+        if (index > 0) {
+            out.push_back(',');
+        }
+        out += "{\"pid\":";
+        append_json_int(out, proc.pid);
+        out += ",\"samples\":";
+        append_json_int(out, proc.samples);
+        out += ",\"cpu_percent\":";
+        append_window_stats(out, proc.cpu_percent);
+        out += ",\"memory_mb\":";
+        append_window_stats(out, proc.memory_mb);
+        out.push_back('}');
+    }
+    out += "]}";
+}
+
+void append_metrics_json(std::string& out, const SystemMetrics& metrics) {
+    out += "{\"timestamp\":";
+    append_json_int(out, static_cast<int64_t>(metrics.timestamp));
+    out += ",\"timestamp_ms\":";
+    append_json_int(out, metrics.timestamp_ms);
+    out += ",\"total_cpu_percent\":";
+    append_json_fixed2(out, metrics.total_cpu_percent);
+    out += ",\"per_core_cpu_percent\":[";
+    for (size_t index = 0; index < metrics.per_core_cpu_percent.size(); ++index) {
+        if (index > 0) {
+            out.push_back(',');
+        }
+        append_json_fixed2(out, metrics.per_core_cpu_percent[index]);
+    }
+    out += "],\"system_memory_total_mb\":";
+    append_json_fixed2(out, metrics.system_memory_total_mb);
+    out += ",\"system_memory_used_mb\":";
+    append_json_fixed2(out, metrics.system_memory_used_mb);
+    out += ",\"top_processes\":[";
+    for (size_t index = 0; index < metrics.top_processes.size(); ++index) {
+        if (index > 0) {
+            out.push_back(',');
+        }
+        append_process_json(out, metrics.top_processes[index]);
+    }
+    out.push_back(']');
+
+    // Only sent when there is something to send, so hosts without cgroup v2
+    // keep the original document.
+    if (!metrics.top_cgroups.empty()) {
+        out += ",\"top_cgroups\":[";
+        for (size_t index = 0; index < metrics.top_cgroups.size(); ++index) {
+            if (index > 0) {
+                out.push_back(',');
+            }
+            append_cgroup_json(out, metrics.top_cgroups[index]);
+        }
+        out.push_back(']');
+    }
+
+    if (metrics.window.samples > 0) {
+        out += ",\"window\":";
+        append_window_json(out, metrics.window);
+    }
+    out.push_back('}');
+}
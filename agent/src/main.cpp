@@ -1,21 +1,35 @@
+#include <algorithm>
+#include <array>
 #include <atomic>
 #include <cctype>
 #include <chrono>
-#include <condition_variable>
 #include <csignal>
+#include <cstddef>
 #include <cstdlib>
-#include <deque>
-#include <map>
+#include <filesystem>
+#include <limits>
 #include <memory>
 #include <mutex>
 #include <sstream>
+#include <string>
 #include <thread>
+#include <utility>
 #include <vector>
 
 #include "agent_config.h"
+#include "allocation_counter.h"
+#include "agent_telemetry.h"
+#include "config_watcher.h"
 #include "structured_logger.h"
+#include "metrics_aggregator.h"
 #include "metrics_collector.h"
 #include "http_client.h"
+#include "interval_scheduler.h"
+#include "metrics_endpoint.h"
+#include "proc_source.h"
+#include "ring_buffer.h"
+#include "snapshot_spool.h"
+#include "wire_format.h"
 
 std::atomic<bool> should_exit(false);
 
@@ -25,6 +39,10 @@ void signal_handler(int signum) {
 }
 
 namespace {
+// Largest catch-up batch after a circuit breaker cool-down; the backend's
+// default MAX_BATCH_ITEMS.
+constexpr size_t kCatchUpBatchItems = 256;
+
 std::vector<std::string> split_csv(const std::string& input) {
     std::vector<std::string> tokens;
     std::stringstream stream(input);
@@ -37,6 +55,15 @@ std::vector<std::string> split_csv(const std::string& input) {
     return tokens;
 }
 
+const char* describe_families(uint32_t families) {
+    // Indexed by the MetricFamily bits, so per-snapshot logging does not build a string.
+    static const char* const kNames[] = {
+        "", "cpu", "memory", "cpu,memory",
+        "processes", "cpu,processes", "memory,processes", "cpu,memory,processes"
+    };
+    return kNames[families & kMetricFamilyAll];
+}
+
 bool apply_metrics_override(const std::string& csv, MetricsSelection& selection, std::string& error) {
     MetricsSelection updated{};
     updated.total_cpu = false;
@@ -46,6 +73,7 @@ bool apply_metrics_override(const std::string& csv, MetricsSelection& selection,
     updated.process_threads = false;
     updated.process_io = false;
     updated.process_handles = false;
+    updated.top_cgroups = false;
 
     for (const std::string& raw_token : split_csv(csv)) {
         std::string token = raw_token;
@@ -75,6 +103,8 @@ bool apply_metrics_override(const std::string& csv, MetricsSelection& selection,
         } else if (token == "process_handles") {
             updated.process_handles = true;
             updated.top_processes = true;
+        } else if (token == "top_cgroups") {
+            updated.top_cgroups = true;
         } else {
             error = "Unknown metric selector: " + raw_token;
             return false;
@@ -89,6 +119,286 @@ bool apply_metrics_override(const std::string& csv, MetricsSelection& selection,
     }
     return true;
 }
+
+// Applies the command line over `config`; it takes precedence over the
+// config file, on reloads too.
+bool apply_command_line(int argc, char* argv[], AgentConfig& config) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--backend-url" && i + 1 < argc) {
+            config.backend_url = argv[++i];
+        } else if (arg == "--interval" && i + 1 < argc) {
+            const int interval_seconds = std::stoi(argv[++i]);
+            config.interval_ms = interval_seconds > std::numeric_limits<int>::max() / 1000
+                ? -1
+                : interval_seconds * 1000;
+        } else if (arg == "--interval-ms" && i + 1 < argc) {
+            config.interval_ms = std::stoi(argv[++i]);
+        } else if (arg == "--cpu-interval-ms" && i + 1 < argc) {
+            config.cpu_interval_ms = std::stoi(argv[++i]);
+        } else if (arg == "--memory-interval-ms" && i + 1 < argc) {
+            config.memory_interval_ms = std::stoi(argv[++i]);
+        } else if (arg == "--process-interval-ms" && i + 1 < argc) {
+            config.process_interval_ms = std::stoi(argv[++i]);
+        } else if (arg == "--upload-interval-ms" && i + 1 < argc) {
+            config.upload_interval_ms = std::stoi(argv[++i]);
+        } else if (arg == "--collector-threads" && i + 1 < argc) {
+            config.collector_threads = static_cast<size_t>(std::stoul(argv[++i]));
+        } else if (arg == "--top-n" && i + 1 < argc) {
+            config.top_n = static_cast<size_t>(std::stoul(argv[++i]));
+        } else if (arg == "--proc-root" && i + 1 < argc) {
+            config.proc_root = argv[++i];
+        } else if (arg == "--cgroup-root" && i + 1 < argc) {
+            config.cgroup_root = argv[++i];
+        } else if (arg == "--process-events") {
+            config.process_events = true;
+        } else if (arg == "--no-proc-io-uring") {
+            config.proc_io_uring = false;
+        } else if (arg == "--batch-max-items" && i + 1 < argc) {
+            config.batch_max_items = static_cast<size_t>(std::stoul(argv[++i]));
+        } else if (arg == "--batch-max-bytes" && i + 1 < argc) {
+            config.batch_max_bytes = static_cast<size_t>(std::stoul(argv[++i]));
+        } else if (arg == "--wire-format" && i + 1 < argc) {
+            config.wire_format = argv[++i];
+        } else if (arg == "--compression" && i + 1 < argc) {
+            config.compression = argv[++i];
+        } else if (arg == "--delta-uploads") {
+            config.delta_uploads = true;
+        } else if (arg == "--delta-keyframe-interval" && i + 1 < argc) {
+            config.delta_keyframe_interval = static_cast<size_t>(std::stoul(argv[++i]));
+        } else if (arg == "--delta-cpu-deadband" && i + 1 < argc) {
+            config.delta_cpu_deadband_percent = std::stod(argv[++i]);
+        } else if (arg == "--delta-memory-deadband-mb" && i + 1 < argc) {
+            config.delta_memory_deadband_mb = std::stod(argv[++i]);
+        } else if (arg == "--log-level" && i + 1 < argc) {
+            config.log_level = argv[++i];
+        } else if (arg == "--connect-timeout-ms" && i + 1 < argc) {
+            config.connect_timeout_ms = std::stoi(argv[++i]);
+        } else if (arg == "--request-timeout-ms" && i + 1 < argc) {
+            config.request_timeout_ms = std::stoi(argv[++i]);
+        } else if (arg == "--retry-max-attempts" && i + 1 < argc) {
+            config.retry_max_attempts = static_cast<size_t>(std::stoul(argv[++i]));
+        } else if (arg == "--spool-dir" && i + 1 < argc) {
+            config.spool_dir = argv[++i];
+        } else if (arg == "--metrics-port" && i + 1 < argc) {
+            config.metrics_listen_port = std::stoi(argv[++i]);
+        } else if (arg == "--no-backend") {
+            config.backend_enabled = false;
+        } else if (arg == "--metrics" && i + 1 < argc) {
+            std::string error;
+            if (!apply_metrics_override(argv[++i], config.selection, error)) {
+                log_event(LogLevel::error, "config.invalid_metrics", error);
+                return false;
+            }
+        } else if (arg == "--config") {
+            ++i;
+        }
+    }
+    return true;
+}
+
+// Checks the settings a reload may change (intervals and batching), logging
+// the first invalid one, and builds the collection tiers for them.
+bool check_reloadable_settings(const AgentConfig& config, CollectionTiers& tiers) {
+    if (config.interval_ms <= 0) {
+        log_event(LogLevel::error, "config.invalid_interval", "interval must be > 0 and fit in interval_ms");
+        return false;
+    }
+
+    const std::pair<const char*, int> family_intervals[] = {
+        {"cpu_interval_ms", config.cpu_interval_ms},
+        {"memory_interval_ms", config.memory_interval_ms},
+        {"process_interval_ms", config.process_interval_ms}
+    };
+    const uint32_t family_bits[] = {kMetricFamilyCpu, kMetricFamilyMemory, kMetricFamilyProcesses};
+    for (size_t family = 0; family < 3; ++family) {
+        const auto& [key, interval_ms] = family_intervals[family];
+        const int effective_ms = interval_ms == 0 ? config.interval_ms : interval_ms;
+        if (effective_ms < config.interval_ms || effective_ms % config.interval_ms != 0) {
+            log_event(LogLevel::error, "config.invalid_family_interval", "family intervals must be multiples of interval_ms", {
+                {"key", key},
+                {"value", std::to_string(interval_ms)},
+                {"interval_ms", std::to_string(config.interval_ms)}
+            });
+            return false;
+        }
+        tiers.add(family_bits[family], static_cast<uint64_t>(effective_ms / config.interval_ms));
+    }
+
+    if (config.upload_interval_ms < 0 ||
+        (config.upload_interval_ms > 0 && (config.upload_interval_ms < config.interval_ms || config.upload_interval_ms % config.interval_ms != 0))) {
+        log_event(LogLevel::error, "config.invalid_upload_interval", "upload_interval_ms must be 0 or a multiple of interval_ms", {
+            {"upload_interval_ms", std::to_string(config.upload_interval_ms)},
+            {"interval_ms", std::to_string(config.interval_ms)}
+        });
+        return false;
+    }
+
+    if (config.batch_max_items == 0) {
+        log_event(LogLevel::error, "config.invalid_batch_max_items", "batch_max_items must be > 0");
+        return false;
+    }
+
+    if (config.batch_max_bytes == 0) {
+        log_event(LogLevel::error, "config.invalid_batch_max_bytes", "batch_max_bytes must be > 0");
+        return false;
+    }
+
+    return true;
+}
+
+// Keys whose new value a reload cannot apply, comma-separated.
+std::string restart_only_changes(const AgentConfig& running, const AgentConfig& reloaded) {
+    std::string changed;
+    const auto check = [&changed](const char* key, bool differs) {
+        if (differs) {
+            changed.append(changed.empty() ? "" : ",").append(key);
+        }
+    };
+    check("backend_url", running.backend_url != reloaded.backend_url);
+    check("backend_enabled", running.backend_enabled != reloaded.backend_enabled);
+    check("queue_capacity", running.queue_capacity != reloaded.queue_capacity);
+    check("collector_threads", running.collector_threads != reloaded.collector_threads);
+    check("top_n", running.top_n != reloaded.top_n);
+    check("proc_root", running.proc_root != reloaded.proc_root);
+    check("cgroup_root", running.cgroup_root != reloaded.cgroup_root);
+    check("process_events", running.process_events != reloaded.process_events);
+    check("proc_io_uring", running.proc_io_uring != reloaded.proc_io_uring);
+    check("wire_format", running.wire_format != reloaded.wire_format);
+    check("compression", running.compression != reloaded.compression);
+    check("delta_uploads", running.delta_uploads != reloaded.delta_uploads);
+    check("delta_keyframe_interval", running.delta_keyframe_interval != reloaded.delta_keyframe_interval);
+    check("delta_cpu_deadband_percent", running.delta_cpu_deadband_percent != reloaded.delta_cpu_deadband_percent);
+    check("delta_memory_deadband_mb", running.delta_memory_deadband_mb != reloaded.delta_memory_deadband_mb);
+    check("log_level", running.log_level != reloaded.log_level);
+    check("connect_timeout_ms", running.connect_timeout_ms != reloaded.connect_timeout_ms);
+    check("request_timeout_ms", running.request_timeout_ms != reloaded.request_timeout_ms);
+    check("retry_max_attempts", running.retry_max_attempts != reloaded.retry_max_attempts);
+    check("retry_base_delay_ms", running.retry_base_delay_ms != reloaded.retry_base_delay_ms);
+    check("retry_max_delay_ms", running.retry_max_delay_ms != reloaded.retry_max_delay_ms);
+    check("breaker_failure_threshold", running.breaker_failure_threshold != reloaded.breaker_failure_threshold);
+    check("breaker_open_ms", running.breaker_open_ms != reloaded.breaker_open_ms);
+    check("breaker_max_open_ms", running.breaker_max_open_ms != reloaded.breaker_max_open_ms);
+    check("spool_dir", running.spool_dir != reloaded.spool_dir);
+    check("spool_max_bytes", running.spool_max_bytes != reloaded.spool_max_bytes);
+    check("spool_segment_bytes", running.spool_segment_bytes != reloaded.spool_segment_bytes);
+    check("spool_replay_items", running.spool_replay_items != reloaded.spool_replay_items);
+    check("metrics_listen_port", running.metrics_listen_port != reloaded.metrics_listen_port);
+    check("metrics_listen_address", running.metrics_listen_address != reloaded.metrics_listen_address);
+    check("telemetry_log_interval_ms", running.telemetry_log_interval_ms != reloaded.telemetry_log_interval_ms);
+    return changed;
+}
+
+// Re-reads the configuration the way startup did: defaults, BACKEND_URL,
+// the file, then the command line. `next` receives the running config with
+// the reloadable settings replaced; false (logged) if the file is unusable.
+bool reload_config(int argc, char* argv[], const std::string& config_path, const AgentConfig& running, AgentConfig& next) {
+    AgentConfig reloaded = AgentConfig::defaults();
+    if (const char* backend_env = std::getenv("BACKEND_URL")) {
+        reloaded.backend_url = backend_env;
+    }
+
+    std::string error;
+    if (!load_agent_config_file(config_path, reloaded, error)) {
+        log_event(LogLevel::error, "config.reload_failed", error, {{"path", config_path}});
+        return false;
+    }
+    CollectionTiers tiers;
+    if (!apply_command_line(argc, argv, reloaded) || !check_reloadable_settings(reloaded, tiers)) {
+        log_event(LogLevel::error, "config.reload_failed", "Keeping the running configuration", {{"path", config_path}});
+        return false;
+    }
+
+    const std::string ignored = restart_only_changes(running, reloaded);
+    if (!ignored.empty()) {
+        log_event(LogLevel::warn, "config.reload_needs_restart", "Some changed keys only take effect on restart", {
+            {"keys", ignored}
+        });
+    }
+
+    next = running;
+    next.interval_ms = reloaded.interval_ms;
+    next.cpu_interval_ms = reloaded.cpu_interval_ms;
+    next.memory_interval_ms = reloaded.memory_interval_ms;
+    next.process_interval_ms = reloaded.process_interval_ms;
+    next.upload_interval_ms = reloaded.upload_interval_ms;
+    next.batch_max_items = reloaded.batch_max_items;
+    next.batch_max_bytes = reloaded.batch_max_bytes;
+    next.selection = reloaded.selection;
+    return true;
+}
+
+/**
+ * Hands reloaded configurations to the collector and sender threads. Each
+ * compares version() once per cycle and takes latest() only when it moved,
+ * so the steady state costs one atomic load.
+ */
+class ConfigUpdates {
+public:
+    explicit ConfigUpdates(const AgentConfig& initial)
+        : latest_(std::make_shared<const AgentConfig>(initial)) {}
+
+    void publish(AgentConfig config) {
+        auto next = std::make_shared<const AgentConfig>(std::move(config));
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            latest_ = std::move(next);
+        }
+        version_.fetch_add(1, std::memory_order_release);
+    }
+
+    uint64_t version() const {
+        return version_.load(std::memory_order_acquire);
+    }
+
+    std::shared_ptr<const AgentConfig> latest() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return latest_;
+    }
+
+private:
+    mutable std::mutex mutex_;
+    std::shared_ptr<const AgentConfig> latest_;
+    std::atomic<uint64_t> version_{0};
+};
+
+using StageSnapshots = std::array<LatencyHistogram::Snapshot, static_cast<size_t>(TelemetryStage::count)>;
+
+std::string stage_quantile(StageSnapshots& interval, TelemetryStage stage, double q) {
+    return std::to_string(interval[static_cast<size_t>(stage)].quantile(q));
+}
+
+// Logs stage latencies since the previous call, so the summary follows the
+// recent behaviour instead of the whole uptime.
+void log_telemetry_summary(StageSnapshots& previous) {
+    AgentTelemetry& telemetry = agent_telemetry();
+    StageSnapshots interval;
+    for (size_t index = 0; index < interval.size(); ++index) {
+        telemetry.stages[index].snapshot(interval[index]);
+        LatencyHistogram::Snapshot current = interval[index];
+        interval[index].subtract(previous[index]);
+        previous[index] = current;
+    }
+
+    const auto load = [](const std::atomic<uint64_t>& value) {
+        return std::to_string(value.load(std::memory_order_relaxed));
+    };
+    log_event(LogLevel::info, "agent.telemetry", "Agent pipeline telemetry", {
+        {"collect_p50_us", stage_quantile(interval, TelemetryStage::collect, 0.5)},
+        {"collect_p99_us", stage_quantile(interval, TelemetryStage::collect, 0.99)},
+        {"proc_scan_p50_us", stage_quantile(interval, TelemetryStage::proc_scan, 0.5)},
+        {"proc_scan_p99_us", stage_quantile(interval, TelemetryStage::proc_scan, 0.99)},
+        {"serialize_p50_us", stage_quantile(interval, TelemetryStage::serialize, 0.5)},
+        {"serialize_p99_us", stage_quantile(interval, TelemetryStage::serialize, 0.99)},
+        {"send_p50_us", stage_quantile(interval, TelemetryStage::send, 0.5)},
+        {"send_p99_us", stage_quantile(interval, TelemetryStage::send, 0.99)},
+        {"collections_total", load(telemetry.collections)},
+        {"queue_drops_total", load(telemetry.queue_drops)},
+        {"sent_bytes_total", load(telemetry.bytes_sent)},
+        {"proc_syscalls_total", load(telemetry.proc_syscalls)},
+        {"cycle_allocations", load(telemetry.cycle_allocations)}
+    });
+}
 }
 
 int main(int argc, char* argv[]) {
@@ -112,149 +422,536 @@ int main(int argc, char* argv[]) {
     if (!config_path.empty()) {
         std::string error;
         if (!load_agent_config_file(config_path, config, error)) {
-            log_event("ERROR", "config.load_failed", error, {{"path", config_path}});
+            log_event(LogLevel::error, "config.load_failed", error, {{"path", config_path}});
             return 1;
         }
-        log_event("INFO", "config.loaded", "Loaded runtime configuration", {{"path", config_path}});
+        log_event(LogLevel::info, "config.loaded", "Loaded runtime configuration", {{"path", config_path}});
     }
 
-    for (int i = 1; i < argc; ++i) {
-        std::string arg = argv[i];
-        if (arg == "--backend-url" && i + 1 < argc) {
-            config.backend_url = argv[++i];
-        } else if (arg == "--interval" && i + 1 < argc) {
-            config.interval_seconds = std::stoi(argv[++i]);
-        } else if (arg == "--no-backend") {
-            config.backend_enabled = false;
-        } else if (arg == "--metrics" && i + 1 < argc) {
-            std::string error;
-            if (!apply_metrics_override(argv[++i], config.selection, error)) {
-                log_event("ERROR", "config.invalid_metrics", error);
-                return 1;
-            }
-        } else if (arg == "--config") {
-            ++i;
-        }
+    if (!apply_command_line(argc, argv, config)) {
+        return 1;
+    }
+
+    LogLevel log_level = LogLevel::info;
+    if (!parse_log_level(config.log_level, log_level)) {
+        log_event(LogLevel::error, "config.invalid_log_level", "log_level must be debug, info, warn or error", {
+            {"log_level", config.log_level}
+        });
+        return 1;
     }
+    set_log_level(log_level);
 
-    if (config.interval_seconds <= 0) {
-        log_event("ERROR", "config.invalid_interval", "interval must be > 0");
+    CollectionTiers tiers;
+    if (!check_reloadable_settings(config, tiers)) {
         return 1;
     }
 
     if (config.queue_capacity == 0) {
-        log_event("ERROR", "config.invalid_queue_capacity", "queue_capacity must be > 0");
+        log_event(LogLevel::error, "config.invalid_queue_capacity", "queue_capacity must be > 0");
+        return 1;
+    }
+
+    if (config.top_n == 0) {
+        log_event(LogLevel::error, "config.invalid_top_n", "top_n must be > 0");
+        return 1;
+    }
+
+#if defined(__linux__)
+    std::error_code proc_root_error;
+    if (config.proc_root.empty() || config.proc_root.size() > ProcRoot::kMaxPathLength ||
+        !std::filesystem::exists(std::filesystem::path(config.proc_root) / "stat", proc_root_error)) {
+        log_event(LogLevel::error, "config.invalid_proc_root", "proc_root must be a procfs root (or a recorded copy) with a stat file", {
+            {"proc_root", config.proc_root}
+        });
+        return 1;
+    }
+#endif
+
+    if (config.collector_threads == 0) {
+        log_event(LogLevel::error, "config.invalid_collector_threads", "collector_threads must be > 0");
+        return 1;
+    }
+
+    if (config.delta_keyframe_interval == 0 ||
+        !(config.delta_cpu_deadband_percent >= 0.0) || !(config.delta_memory_deadband_mb >= 0.0)) {
+        log_event(LogLevel::error, "config.invalid_delta", "delta_keyframe_interval must be > 0 and deadbands >= 0", {
+            {"delta_keyframe_interval", std::to_string(config.delta_keyframe_interval)},
+            {"delta_cpu_deadband_percent", std::to_string(config.delta_cpu_deadband_percent)},
+            {"delta_memory_deadband_mb", std::to_string(config.delta_memory_deadband_mb)}
+        });
+        return 1;
+    }
+
+    if (config.connect_timeout_ms <= 0 || config.request_timeout_ms <= 0) {
+        log_event(LogLevel::error, "config.invalid_timeout", "connect_timeout_ms and request_timeout_ms must be > 0");
+        return 1;
+    }
+
+    if (config.retry_max_attempts == 0 || config.breaker_failure_threshold == 0) {
+        log_event(LogLevel::error, "config.invalid_retry", "retry_max_attempts and breaker_failure_threshold must be > 0");
+        return 1;
+    }
+
+    if (config.retry_base_delay_ms <= 0 || config.retry_base_delay_ms > config.retry_max_delay_ms ||
+        config.breaker_open_ms <= 0 || config.breaker_open_ms > config.breaker_max_open_ms) {
+        log_event(LogLevel::error, "config.invalid_backoff", "backoff delays must be > 0 and not exceed their maximum", {
+            {"retry_base_delay_ms", std::to_string(config.retry_base_delay_ms)},
+            {"retry_max_delay_ms", std::to_string(config.retry_max_delay_ms)},
+            {"breaker_open_ms", std::to_string(config.breaker_open_ms)},
+            {"breaker_max_open_ms", std::to_string(config.breaker_max_open_ms)}
+        });
+        return 1;
+    }
+
+    if (!config.spool_dir.empty()) {
+        if (config.spool_segment_bytes == 0 || config.spool_segment_bytes > config.spool_max_bytes) {
+            log_event(LogLevel::error, "config.invalid_spool_size", "spool_segment_bytes must be > 0 and <= spool_max_bytes");
+            return 1;
+        }
+        if (config.spool_replay_items == 0) {
+            log_event(LogLevel::error, "config.invalid_spool_replay_items", "spool_replay_items must be > 0");
+            return 1;
+        }
+    }
+
+    if (config.metrics_listen_port < 0 || config.metrics_listen_port > 65535) {
+        log_event(LogLevel::error, "config.invalid_metrics_port", "metrics_listen_port must be between 0 and 65535", {
+            {"metrics_listen_port", std::to_string(config.metrics_listen_port)}
+        });
+        return 1;
+    }
+
+    HttpClientOptions client_options;
+    if (!parse_wire_format(config.wire_format, client_options.wire_format)) {
+        log_event(LogLevel::error, "config.invalid_wire_format", "wire_format must be json or binary", {
+            {"wire_format", config.wire_format}
+        });
         return 1;
     }
 
+    if (!parse_wire_compression(config.compression, client_options.compression)) {
+        log_event(LogLevel::error, "config.invalid_compression", "compression must be none or gzip", {
+            {"compression", config.compression}
+        });
+        return 1;
+    }
+
+    if (!wire_compression_available(client_options.compression)) {
+        log_event(LogLevel::error, "config.compression_unavailable", "Agent was built without zlib; gzip is unavailable");
+        return 1;
+    }
+
+    client_options.connect_timeout_ms = config.connect_timeout_ms;
+    client_options.request_timeout_ms = config.request_timeout_ms;
+    client_options.retry.max_attempts = config.retry_max_attempts;
+    client_options.retry.base_delay = std::chrono::milliseconds(config.retry_base_delay_ms);
+    client_options.retry.max_delay = std::chrono::milliseconds(config.retry_max_delay_ms);
+    client_options.retry.breaker_failure_threshold = config.breaker_failure_threshold;
+    client_options.retry.breaker_open = std::chrono::milliseconds(config.breaker_open_ms);
+    client_options.retry.breaker_max_open = std::chrono::milliseconds(config.breaker_max_open_ms);
+    client_options.delta.keyframe_interval = config.delta_keyframe_interval;
+    client_options.delta.cpu_deadband_percent = config.delta_cpu_deadband_percent;
+    client_options.delta.memory_deadband_mb = config.delta_memory_deadband_mb;
+
     std::signal(SIGINT, signal_handler);
     std::signal(SIGTERM, signal_handler);
 
-    MetricsCollector collector(config.selection);
+    CollectorOptions collector_options;
+    collector_options.collector_threads = config.collector_threads;
+    collector_options.top_n = config.top_n;
+    collector_options.proc_root = config.proc_root;
+    collector_options.cgroup_root = config.cgroup_root;
+
+    MetricsCollector collector(config.selection, collector_options);
+    if (config.process_events) {
+        std::string error;
+        if (collector.enable_process_events(error)) {
+            log_event(LogLevel::info, "collector.process_events", "Tracking processes through the proc connector");
+        } else {
+            log_event(LogLevel::warn, "collector.process_events_unavailable", error, {
+                {"fallback", "proc_listing"}
+            });
+        }
+    }
+    bool proc_io_uring = false;
+    if (config.proc_io_uring) {
+        std::string error;
+        proc_io_uring = collector.enable_io_uring(error);
+        if (!proc_io_uring) {
+            log_event(LogLevel::info, "collector.proc_io_uring_unavailable", error, {
+                {"fallback", "syscalls"}
+            });
+        }
+    }
     std::unique_ptr<HttpClient> client;
     if (config.backend_enabled) {
-        client = std::make_unique<HttpClient>(config.backend_url);
+        client = std::make_unique<HttpClient>(config.backend_url, client_options);
+    }
+
+    std::unique_ptr<SnapshotSpool> spool;
+    if (config.backend_enabled && !config.spool_dir.empty()) {
+        SpoolOptions spool_options;
+        spool_options.directory = config.spool_dir;
+        spool_options.max_bytes = config.spool_max_bytes;
+        spool_options.segment_bytes = config.spool_segment_bytes;
+        spool = std::make_unique<SnapshotSpool>(spool_options);
+
+        std::string error;
+        if (!spool->open(error)) {
+            log_event(LogLevel::error, "config.spool_unavailable", error, {{"spool_dir", config.spool_dir}});
+            return 1;
+        }
+    }
+
+    std::unique_ptr<MetricsEndpoint> metrics_endpoint;
+    if (config.metrics_listen_port > 0) {
+        metrics_endpoint = std::make_unique<MetricsEndpoint>(
+            config.metrics_listen_address,
+            static_cast<uint16_t>(config.metrics_listen_port),
+            [](std::string& body) { agent_telemetry().render_prometheus(body); }
+        );
+
+        std::string error;
+        if (!metrics_endpoint->start(error)) {
+            log_event(LogLevel::error, "config.metrics_endpoint_unavailable", error, {
+                {"metrics_listen_address", config.metrics_listen_address},
+                {"metrics_listen_port", std::to_string(config.metrics_listen_port)}
+            });
+            return 1;
+        }
     }
 
-    std::map<std::string, std::string> startup_fields = {
+    start_async_logger();
+
+    log_event(LogLevel::info, "agent.start", "Metrics agent started", {
         {"backend_enabled", config.backend_enabled ? "true" : "false"},
         {"backend_url", config.backend_url},
-        {"interval_seconds", std::to_string(config.interval_seconds)},
-        {"queue_capacity", std::to_string(config.queue_capacity)}
-    };
-    log_event("INFO", "agent.start", "Metrics agent started", startup_fields);
+        {"interval_ms", std::to_string(config.interval_ms)},
+        {"cpu_interval_ms", std::to_string(config.cpu_interval_ms)},
+        {"memory_interval_ms", std::to_string(config.memory_interval_ms)},
+        {"process_interval_ms", std::to_string(config.process_interval_ms)},
+        {"upload_interval_ms", std::to_string(config.upload_interval_ms)},
+        {"queue_capacity", std::to_string(config.queue_capacity)},
+        {"collector_threads", std::to_string(config.collector_threads)},
+        {"top_n", std::to_string(config.top_n)},
+        {"proc_root", config.proc_root},
+        {"cgroup_root", config.cgroup_root},
+        {"process_events", config.process_events ? "true" : "false"},
+        {"proc_reader", proc_io_uring ? "io_uring" : "syscalls"},
+        {"batch_max_items", std::to_string(config.batch_max_items)},
+        {"batch_max_bytes", std::to_string(config.batch_max_bytes)},
+        {"wire_format", config.wire_format},
+        {"compression", config.compression},
+        {"delta_uploads", config.delta_uploads ? "true" : "false"},
+        {"delta_keyframe_interval", std::to_string(config.delta_keyframe_interval)},
+        {"delta_stream", client && config.delta_uploads ? client->delta_stream_id() : ""},
+        {"log_level", config.log_level},
+        {"connect_timeout_ms", std::to_string(config.connect_timeout_ms)},
+        {"request_timeout_ms", std::to_string(config.request_timeout_ms)},
+        {"retry_max_attempts", std::to_string(config.retry_max_attempts)},
+        {"spool_dir", config.spool_dir},
+        {"spool_pending", std::to_string(spool ? spool->pending() : 0)},
+        {"metrics_listen_port", std::to_string(config.metrics_listen_port)}
+    });
 
-    std::deque<SystemMetrics> queue;
-    std::mutex queue_mutex;
-    std::condition_variable queue_cv;
+    // Edits to the config file are applied without a restart where they can
+    // be: metric selection, intervals and batching.
+    ConfigWatcher config_watcher;
+    if (!config_path.empty()) {
+        std::string error;
+        if (config_watcher.open(config_path, error)) {
+            log_event(LogLevel::info, "config.watching", "Reloading configuration when the file changes", {{"path", config_path}});
+        } else {
+            log_event(LogLevel::warn, "config.watch_unavailable", error, {{"path", config_path}});
+        }
+    }
+    ConfigUpdates config_updates(config);
+    BoundedRing<SystemMetrics> queue(config.queue_capacity);
+    IntervalScheduler scheduler(std::chrono::milliseconds(config.interval_ms));
 
     std::thread collector_thread([&]() {
-        while (!should_exit) {
+        // `latest` accumulates every family at its own rate; each tick copies
+        // it (or, with an upload interval, each window's summary) into
+        // `metrics`, which push() swaps for a recycled snapshot, so the
+        // per-core and process vectors keep their capacity.
+        SystemMetrics latest{};
+        SystemMetrics metrics{};
+        std::shared_ptr<const AgentConfig> active = config_updates.latest();
+        uint64_t active_version = config_updates.version();
+        std::unique_ptr<MetricsAggregator> aggregator;
+        const auto reset_aggregator = [&]() {
+            aggregator.reset();
+            if (active->upload_interval_ms > active->interval_ms) {
+                aggregator = std::make_unique<MetricsAggregator>(
+                    static_cast<size_t>(active->upload_interval_ms / active->interval_ms), active->top_n);
+            }
+        };
+        reset_aggregator();
+
+        while (scheduler.wait_next()) {
+            if (scheduler.last_skipped() > 0) {
+                log_event(LogLevel::warn, "collector.overrun", "Collection overran its interval; skipped missed slots", {
+                    {"skipped_slots", std::to_string(scheduler.last_skipped())},
+                    {"overruns_total", std::to_string(scheduler.overruns())},
+                    {"interval_ms", std::to_string(active->interval_ms)}
+                });
+            }
+
+            // A reload takes effect between two collections: every family is
+            // sampled on this slot, the new cadence starts after it, and a
+            // summary window in progress is dropped.
+            if (config_updates.version() != active_version) {
+                active_version = config_updates.version();
+                active = config_updates.latest();
+                collector.set_selection(active->selection);
+                tiers = CollectionTiers{};
+                check_reloadable_settings(*active, tiers);
+                scheduler.set_interval(std::chrono::milliseconds(active->interval_ms));
+                reset_aggregator();
+                log_event(LogLevel::info, "collector.reconfigured", "Applied reloaded collection settings", {
+                    {"interval_ms", std::to_string(active->interval_ms)},
+                    {"upload_interval_ms", std::to_string(active->upload_interval_ms)}
+                });
+            }
+
             try {
-                SystemMetrics metrics = collector.collect();
-
-                size_t queue_size = 0;
-                bool dropped_oldest = false;
-                {
-                    std::lock_guard<std::mutex> lock(queue_mutex);
-                    if (queue.size() >= config.queue_capacity) {
-                        queue.pop_front();
-                        dropped_oldest = true;
-                    }
-                    queue.push_back(std::move(metrics));
-                    queue_size = queue.size();
+                const uint64_t allocations_before = thread_allocation_count();
+                collector.collect(latest, tiers.due(scheduler.slot()));
+                bool window_complete = true;
+                if (aggregator) {
+                    window_complete = aggregator->add(latest, metrics);
+                } else {
+                    metrics = latest;
                 }
-                queue_cv.notify_one();
+                agent_telemetry().cycle_allocations.store(thread_allocation_count() - allocations_before, std::memory_order_relaxed);
+                if (!window_complete) {
+                    continue;
+                }
+
+                // push() swaps `metrics` for a recycled snapshot.
+                const uint32_t fresh_families = metrics.fresh_families;
+                const uint32_t window_samples = metrics.window.samples;
+                const bool dropped_oldest = queue.push(metrics);
 
                 if (dropped_oldest) {
-                    log_event("WARN", "collector.queue_overflow", "Dropped oldest metrics snapshot", {
-                        {"queue_capacity", std::to_string(config.queue_capacity)}
+                    agent_telemetry().queue_drops.fetch_add(1, std::memory_order_relaxed);
+                    log_event(LogLevel::warn, "collector.queue_overflow", "Dropped oldest metrics snapshot", {
+                        {"queue_capacity", std::to_string(queue.capacity())},
+                        {"dropped_total", std::to_string(queue.dropped())}
                     });
                 }
 
-                log_event("INFO", "collector.snapshot", "Collected metrics snapshot", {
-                    {"queue_size", std::to_string(queue_size)}
-                });
+                // Checked first so a filtered-out line formats nothing.
+                if (log_enabled(LogLevel::info)) {
+                    log_event(LogLevel::info, "collector.snapshot", "Collected metrics snapshot", {
+                        {"queue_size", std::to_string(queue.size())},
+                        {"fresh_families", describe_families(fresh_families)},
+                        {"window_samples", std::to_string(window_samples)}
+                    });
+                }
             } catch (const std::exception& ex) {
-                log_event("ERROR", "collector.error", "Collector failed", {{"error", ex.what()}});
-            }
-
-            const auto sleep_deadline = std::chrono::steady_clock::now() + std::chrono::seconds(config.interval_seconds);
-            while (!should_exit && std::chrono::steady_clock::now() < sleep_deadline) {
-                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                log_event(LogLevel::error, "collector.error", "Collector failed", {{"error", ex.what()}});
             }
         }
 
-        queue_cv.notify_all();
+        queue.close();
     });
 
     std::thread sender_thread([&]() {
+        // Snapshots taken off the queue but not yet put into a request; a
+        // batch that hits batch_max_bytes leaves its tail here. The slots are
+        // swapped with the ring, so their storage is recycled too. Normal
+        // sends use the first batch_max_items slots; the rest only fill up
+        // for a catch-up batch.
+        std::shared_ptr<const AgentConfig> active = config_updates.latest();
+        uint64_t active_version = config_updates.version();
+        std::vector<SystemMetrics> pending(std::max(active->batch_max_items, std::min(config.queue_capacity, kCatchUpBatchItems)));
+        size_t pending_count = 0;
+        std::vector<SystemMetrics> replay;
+        CircuitState circuit = CircuitState::closed;
+        bool catch_up = false;
+
         while (true) {
-            SystemMetrics metrics;
-            {
-                std::unique_lock<std::mutex> lock(queue_mutex);
-                queue_cv.wait(lock, [&]() {
-                    return should_exit || !queue.empty();
-                });
+            // Reloaded batch limits apply from the next request; snapshots
+            // already pending stay at the front.
+            if (config_updates.version() != active_version) {
+                active_version = config_updates.version();
+                active = config_updates.latest();
+                if (active->batch_max_items > pending.size()) {
+                    pending.resize(active->batch_max_items);
+                }
+            }
+
+            // Without a spool, snapshots wait in the ring (which drops the
+            // oldest) while the breaker is open, and go out as one batch with
+            // the probe. With a spool, sends fail fast and are spooled instead.
+            if (client && !spool && client->circuit_state() == CircuitState::open) {
+                client->wait_for_circuit();
+                catch_up = true;
+            }
 
-                if (queue.empty() && should_exit) {
+            if (pending_count == 0) {
+                if (!queue.wait_pop(pending[0])) {
                     break;
                 }
-                if (queue.empty()) {
-                    continue;
-                }
+                pending_count = 1;
+            }
 
-                metrics = std::move(queue.front());
-                queue.pop_front();
+            const size_t fill_limit = catch_up ? pending.size() : active->batch_max_items;
+            while (pending_count < fill_limit && queue.try_pop(pending[pending_count])) {
+                ++pending_count;
             }
 
             if (!config.backend_enabled) {
-                log_event("INFO", "sender.skipped", "Backend disabled; metrics not sent", {
-                    {"timestamp", std::to_string(metrics.timestamp)}
-                });
+                for (size_t i = 0; i < pending_count && log_enabled(LogLevel::info); ++i) {
+                    log_event(LogLevel::info, "sender.skipped", "Backend disabled; metrics not sent", {
+                        {"timestamp", std::to_string(pending[i].timestamp)}
+                    });
+                }
+                pending_count = 0;
                 continue;
             }
 
-            if (client->send_metrics(metrics)) {
-                log_event("INFO", "sender.sent", "Sent metrics to backend", {
-                    {"timestamp", std::to_string(metrics.timestamp)},
-                    {"http_status", std::to_string(client->last_http_status())}
-                });
+            size_t sent_count = 0;
+            bool sent = false;
+            const uint64_t resyncs = client->delta_resyncs();
+            if (config.delta_uploads) {
+                sent = client->send_metrics_delta(pending.data(), pending_count, active->batch_max_bytes, sent_count);
+                if (client->delta_resyncs() != resyncs) {
+                    log_event(LogLevel::info, "sender.delta_resync", "Backend lacked the delta base; resent from a keyframe", {
+                        {"http_status", std::to_string(client->last_http_status())}
+                    });
+                }
+            } else if (active->batch_max_items == 1 && pending_count == 1) {
+                sent = client->send_metrics(pending.front());
+                sent_count = 1;
             } else {
-                log_event("ERROR", "sender.failed", "Failed to send metrics", {
-                    {"timestamp", std::to_string(metrics.timestamp)},
+                sent = client->send_metrics_batch(pending.data(), pending_count, active->batch_max_bytes, sent_count);
+            }
+            catch_up = false;
+
+            if (client->circuit_state() != circuit) {
+                circuit = client->circuit_state();
+                if (circuit == CircuitState::open) {
+                    const auto retry_in = std::chrono::duration_cast<std::chrono::milliseconds>(
+                        client->circuit_retry_at() - std::chrono::steady_clock::now());
+                    log_event(LogLevel::warn, "sender.circuit_open", "Backend keeps failing; pausing requests", {
+                        {"retry_in_ms", std::to_string(std::max<long long>(retry_in.count(), 0))},
+                        {"spool", spool ? "true" : "false"}
+                    });
+                } else if (circuit == CircuitState::closed) {
+                    log_event(LogLevel::info, "sender.circuit_closed", "Backend recovered; resuming requests");
+                }
+            }
+
+            const time_t first_timestamp = pending.front().timestamp;
+            const time_t last_timestamp = pending[sent_count - 1].timestamp;
+            if (sent) {
+                if (log_enabled(LogLevel::info)) {
+                    log_event(LogLevel::info, "sender.sent", "Sent metrics to backend", {
+                        {"timestamp", std::to_string(last_timestamp)},
+                        {"first_timestamp", std::to_string(first_timestamp)},
+                        {"snapshots", std::to_string(sent_count)},
+                        {"http_status", std::to_string(client->last_http_status())}
+                    });
+                }
+
+                // The backend is reachable again: re-send one batch of spooled
+                // snapshots per live send, so the backlog drains without
+                // delaying fresh data by more than one request.
+                if (spool && spool->pending() > 0) {
+                    size_t replayed = 0;
+                    const size_t peeked = spool->peek(replay, config.spool_replay_items);
+                    if (peeked > 0 && client->send_metrics_batch(replay.data(), peeked, active->batch_max_bytes, replayed)) {
+                        spool->consume(replayed);
+                        log_event(LogLevel::info, "sender.replayed", "Re-sent spooled metrics", {
+                            {"snapshots", std::to_string(replayed)},
+                            {"spool_pending", std::to_string(spool->pending())}
+                        });
+                    } else {
+                        log_event(LogLevel::warn, "sender.replay_failed", "Failed to re-send spooled metrics", {
+                            {"error", client->last_error()},
+                            {"spool_pending", std::to_string(spool->pending())}
+                        });
+                    }
+                }
+            } else if (client->last_attempts() == 0) {
+                if (log_enabled(LogLevel::debug)) {
+                    log_event(LogLevel::debug, "sender.circuit_skipped", "Circuit breaker open; metrics not sent", {
+                        {"timestamp", std::to_string(last_timestamp)},
+                        {"snapshots", std::to_string(sent_count)}
+                    });
+                }
+            } else {
+                log_event(LogLevel::error, "sender.failed", "Failed to send metrics", {
+                    {"timestamp", std::to_string(last_timestamp)},
+                    {"first_timestamp", std::to_string(first_timestamp)},
+                    {"snapshots", std::to_string(sent_count)},
+                    {"attempts", std::to_string(client->last_attempts())},
                     {"error", client->last_error()},
                     {"http_status", std::to_string(client->last_http_status())}
                 });
             }
+
+            if (!sent) {
+                if (spool) {
+                    const size_t spooled = spool->append(pending.data(), sent_count);
+                    log_event(LogLevel::warn, "sender.spooled", "Spooled unsent metrics to disk", {
+                        {"snapshots", std::to_string(spooled)},
+                        {"spool_pending", std::to_string(spool->pending())},
+                        {"spool_evicted", std::to_string(spool->evicted())}
+                    });
+                }
+            }
+
+            // Keep the unsent tail at the front; the sent slots move behind it
+            // to be refilled.
+            std::rotate(
+                pending.begin(),
+                pending.begin() + static_cast<std::ptrdiff_t>(sent_count),
+                pending.begin() + static_cast<std::ptrdiff_t>(pending_count)
+            );
+            pending_count -= sent_count;
         }
     });
 
+    // Signal handlers may only set a flag, so the main thread relays it to
+    // the collector, which sleeps on the scheduler rather than polling. It
+    // also writes the periodic telemetry summary and reloads the config
+    // file once it has stopped changing for a tick, so a file written in
+    // several steps is read once.
+    StageSnapshots previous_stages;
+    const auto telemetry_interval = std::chrono::milliseconds(config.telemetry_log_interval_ms);
+    auto next_telemetry_log = std::chrono::steady_clock::now() + telemetry_interval;
+    bool reload_pending = false;
     while (!should_exit) {
         std::this_thread::sleep_for(std::chrono::milliseconds(200));
-    }
+        const auto now = std::chrono::steady_clock::now();
+        if (now >= next_telemetry_log) {
+            log_telemetry_summary(previous_stages);
+            next_telemetry_log = now + telemetry_interval;
+        }
 
-    queue_cv.notify_all();
+        if (config_watcher.poll()) {
+            reload_pending = true;
+        } else if (reload_pending) {
+            reload_pending = false;
+            AgentConfig reloaded;
+            if (reload_config(argc, argv, config_path, *config_updates.latest(), reloaded)) {
+                config_updates.publish(reloaded);
+                log_event(LogLevel::info, "config.reloaded", "Reloaded runtime configuration", {
+                    {"path", config_path},
+                    {"interval_ms", std::to_string(reloaded.interval_ms)},
+                    {"batch_max_items", std::to_string(reloaded.batch_max_items)},
+                    {"batch_max_bytes", std::to_string(reloaded.batch_max_bytes)}
+                });
+            }
+        }
+    }
+    scheduler.stop();
+    if (client) {
+        client->cancel_retries();
+    }
 
     if (collector_thread.joinable()) {
         collector_thread.join();
@@ -262,7 +959,11 @@ int main(int argc, char* argv[]) {
     if (sender_thread.joinable()) {
         sender_thread.join();
     }
+    if (metrics_endpoint) {
+        metrics_endpoint->stop();
+    }
 
-    log_event("INFO", "agent.stop", "Metrics agent exited cleanly");
+    log_event(LogLevel::info, "agent.stop", "Metrics agent exited cleanly");
+    stop_async_logger();
     return 0;
 }
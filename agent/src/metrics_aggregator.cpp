@@ -0,0 +1,268 @@
+#include "metrics_aggregator.h"
+
+#include <algorithm>
+#include <cmath>
+
+P2Quantile::P2Quantile(double quantile)
+    : quantile_(quantile) {
+}
+
+void P2Quantile::reset() {
+    count_ = 0;
+}
+
+void P2Quantile::add(double value) {
+    if (count_ < heights_.size()) {
+        heights_[count_++] = value;
+        if (count_ == heights_.size()) {
+            std::sort(heights_.begin(), heights_.end());
+            positions_ = {1.0, 2.0, 3.0, 4.0, 5.0};
+            desired_ = {1.0, 1.0 + 2.0 * quantile_, 1.0 + 4.0 * quantile_, 3.0 + 2.0 * quantile_, 5.0};
+            increments_ = {0.0, quantile_ / 2.0, quantile_, (1.0 + quantile_) / 2.0, 1.0};
+        }
+        return;
+    }
+
+    // Find the cell the value falls in, widening the outer markers if needed.
+    size_t cell = 0;
+    if (value < heights_[0]) {
+        heights_[0] = value;
+    } else if (value >= heights_[4]) {
+        heights_[4] = value;
+        cell = 3;
+    } else {
+        while (cell < 3 && value >= heights_[cell + 1]) {
+            ++cell;
+        }
+    }
+    ++count_;
+    for (size_t marker = cell + 1; marker < positions_.size(); ++marker) {
+        positions_[marker] += 1.0;
+    }
+    for (size_t marker = 0; marker < desired_.size(); ++marker) {
+        desired_[marker] += increments_[marker];
+    }
+
+    // Move each inner marker by one rank towards its desired position.
+    for (size_t marker = 1; marker < 4; ++marker) {
+        const double offset = desired_[marker] - positions_[marker];
+        const double gap_above = positions_[marker + 1] - positions_[marker];
+        const double gap_below = positions_[marker - 1] - positions_[marker];
+        if (!((offset >= 1.0 && gap_above > 1.0) || (offset <= -1.0 && gap_below < -1.0))) {
+            continue;
+        }
+        const double step = (offset >= 0.0) ? 1.0 : -1.0;
+        const double below = heights_[marker - 1];
+        const double height = heights_[marker];
+        const double above = heights_[marker + 1];
+        const double parabolic = height + step / (positions_[marker + 1] - positions_[marker - 1]) *
+            ((positions_[marker] - positions_[marker - 1] + step) * (above - height) / gap_above +
+             (positions_[marker + 1] - positions_[marker] - step) * (height - below) / -gap_below);
+        if (below < parabolic && parabolic < above) {
+            heights_[marker] = parabolic;
+        } else {
+            const size_t neighbour = (step > 0.0) ? marker + 1 : marker - 1;
+            heights_[marker] = height + step * (heights_[neighbour] - height) /
+                (positions_[neighbour] - positions_[marker]);
+        }
+        positions_[marker] += step;
+    }
+}
+
+double P2Quantile::value() const {
+    if (count_ == 0) {
+        return 0.0;
+    }
+    if (count_ > heights_.size()) {
+        return heights_[2];
+    }
+
+    std::array<double, 5> sorted = heights_;
+    std::sort(sorted.begin(), sorted.begin() + static_cast<std::ptrdiff_t>(count_));
+    const double rank = std::ceil(quantile_ * static_cast<double>(count_));
+    const size_t index = (rank < 1.0) ? 0 : static_cast<size_t>(rank) - 1;
+    return sorted[std::min(index, count_ - 1)];
+}
+
+size_t P2Quantile::count() const {
+    return count_;
+}
+
+void RunningStats::reset() {
+    count_ = 0;
+    sum_ = 0.0;
+    p95_.reset();
+}
+
+void RunningStats::add(double value) {
+    if (count_ == 0) {
+        min_ = value;
+        max_ = value;
+    } else {
+        min_ = std::min(min_, value);
+        max_ = std::max(max_, value);
+    }
+    sum_ += value;
+    p95_.add(value);
+    ++count_;
+}
+
+size_t RunningStats::count() const {
+    return count_;
+}
+
+WindowStats RunningStats::summary() const {
+    if (count_ == 0) {
+        return {0.0, 0.0, 0.0, 0.0};
+    }
+    // The estimate can stray marginally outside the observed range.
+    const double p95 = std::min(std::max(p95_.value(), min_), max_);
+    return {min_, max_, sum_ / static_cast<double>(count_), p95};
+}
+
+MetricsAggregator::MetricsAggregator(size_t window_samples, size_t top_n)
+    : window_samples_((window_samples == 0) ? 1 : window_samples),
+      top_n_(top_n),
+      processes_(top_n * kTrackedProcessesPerTopN) {
+    ranking_.reserve(processes_.size());
+}
+
+size_t MetricsAggregator::window_samples() const {
+    return window_samples_;
+}
+
+bool MetricsAggregator::add(const SystemMetrics& sample, SystemMetrics& summary) {
+    if (samples_ == 0) {
+        start_timestamp_ms_ = sample.timestamp_ms;
+    }
+    add_families(sample, sample.fresh_families);
+    fresh_families_ |= sample.fresh_families;
+    ++samples_;
+
+    if (samples_ < window_samples_) {
+        return false;
+    }
+    emit(sample, summary);
+    reset();
+    return true;
+}
+
+void MetricsAggregator::add_families(const SystemMetrics& sample, uint32_t families) {
+    if (families & kMetricFamilyCpu) {
+        total_cpu_.add(sample.total_cpu_percent);
+        if (cores_.size() < sample.per_core_cpu_percent.size()) {
+            cores_.resize(sample.per_core_cpu_percent.size());
+        }
+        for (size_t core = 0; core < sample.per_core_cpu_percent.size(); ++core) {
+            cores_[core].add(sample.per_core_cpu_percent[core]);
+        }
+    }
+    if (families & kMetricFamilyMemory) {
+        memory_used_.add(sample.system_memory_used_mb);
+    }
+    if (families & kMetricFamilyProcesses) {
+        add_processes(sample.top_processes);
+    }
+}
+
+void MetricsAggregator::add_processes(const std::vector<ProcessMetrics>& processes) {
+    for (const auto& proc : processes) {
+        // A PID with a new name has been reused; its history does not carry over.
+        ProcessSlot* slot = nullptr;
+        for (size_t index = 0; index < process_count_; ++index) {
+            if (processes_[index].latest.pid == proc.pid) {
+                slot = &processes_[index];
+                if (slot->latest.name != proc.name) {
+                    slot->cpu_percent.reset();
+                    slot->memory_mb.reset();
+                }
+                break;
+            }
+        }
+        if (slot == nullptr) {
+            if (process_count_ == processes_.size()) {
+                continue;
+            }
+            slot = &processes_[process_count_++];
+            slot->cpu_percent.reset();
+            slot->memory_mb.reset();
+        }
+
+        slot->latest = proc;
+        slot->cpu_percent.add(proc.cpu_percent);
+        slot->memory_mb.add(proc.memory_mb);
+    }
+}
+
+void MetricsAggregator::emit(const SystemMetrics& sample, SystemMetrics& summary) {
+    // A family that was not sampled during the window (its interval is
+    // longer) is summarized from its carried-over value.
+    add_families(sample, kMetricFamilyAll & ~fresh_families_);
+
+    summary = sample;
+    summary.fresh_families = fresh_families_;
+    MetricsWindow& window = summary.window;
+    window.samples = static_cast<uint32_t>(samples_);
+    window.start_timestamp_ms = start_timestamp_ms_;
+
+    window.total_cpu_percent = total_cpu_.summary();
+    summary.total_cpu_percent = window.total_cpu_percent.mean;
+
+    const size_t core_count = sample.per_core_cpu_percent.size();
+    if (cores_.size() < core_count) {
+        cores_.resize(core_count);
+    }
+    window.per_core_cpu_percent.resize(core_count);
+    for (size_t core = 0; core < core_count; ++core) {
+        window.per_core_cpu_percent[core] = cores_[core].summary();
+        summary.per_core_cpu_percent[core] = window.per_core_cpu_percent[core].mean;
+    }
+
+    window.system_memory_used_mb = memory_used_.summary();
+    summary.system_memory_used_mb = window.system_memory_used_mb.mean;
+
+    ranking_.resize(process_count_);
+    for (size_t index = 0; index < process_count_; ++index) {
+        ranking_[index] = index;
+    }
+    const size_t reported = std::min(top_n_, process_count_);
+    std::partial_sort(ranking_.begin(), ranking_.begin() + static_cast<std::ptrdiff_t>(reported), ranking_.end(),
+        [this](size_t left, size_t right) {
+            const WindowStats left_cpu = processes_[left].cpu_percent.summary();
+            const WindowStats right_cpu = processes_[right].cpu_percent.summary();
+            if (left_cpu.max != right_cpu.max) {
+                return left_cpu.max > right_cpu.max;
+            }
+            if (left_cpu.mean != right_cpu.mean) {
+                return left_cpu.mean > right_cpu.mean;
+            }
+            return processes_[left].latest.pid < processes_[right].latest.pid;
+        });
+
+    summary.top_processes.resize(reported);
+    window.top_processes.resize(reported);
+    for (size_t index = 0; index < reported; ++index) {
+        const ProcessSlot& slot = processes_[ranking_[index]];
+        ProcessMetrics& proc = summary.top_processes[index];
+        ProcessWindowMetrics& stats = window.top_processes[index];
+        stats.pid = slot.latest.pid;
+        stats.samples = static_cast<uint32_t>(slot.cpu_percent.count());
+        stats.cpu_percent = slot.cpu_percent.summary();
+        stats.memory_mb = slot.memory_mb.summary();
+
+        proc = slot.latest;
+        proc.cpu_percent = stats.cpu_percent.mean;
+        proc.memory_mb = stats.memory_mb.mean;
+    }
+}
+
+void MetricsAggregator::reset() {
+    samples_ = 0;
+    fresh_families_ = 0;
+    total_cpu_.reset();
+    memory_used_.reset();
+    for (auto& core : cores_) {
+        core.reset();
+    }
+    process_count_ = 0;
+}
@@ -1,14 +1,16 @@
 #include "metrics_collector.h"
+#include "agent_telemetry.h"
+#include "cgroup_source.h"
+#include "cpu_usage.h"
+#include "proc_source.h"
+#include "process_scanner.h"
+#include "process_table.h"
 #include <algorithm>
-#include <cctype>
 #include <chrono>
+#include <cstddef>
 #include <cstdlib>
 #include <cstring>
-#include <filesystem>
-#include <fstream>
 #include <limits>
-#include <sstream>
-#include <thread>
 #include <unordered_map>
 
 namespace {
@@ -28,6 +30,32 @@ constexpr T clamp_value(T value, T low, T high) {
 }
 }  // namespace
 
+namespace {
+using ProcessRankKey = MetricsCollector::ProcessRankKey;
+
+bool ranks_higher(const ProcessRankKey& left, const ProcessRankKey& right) {
+    if (left.cpu_percent != right.cpu_percent) {
+        return left.cpu_percent > right.cpu_percent;
+    }
+    if (left.memory_mb != right.memory_mb) {
+        return left.memory_mb > right.memory_mb;
+    }
+    return left.pid < right.pid;
+}
+
+/**
+ * Keeps the `top_n` highest-ranked keys, ordered best first. nth_element
+ * partitions in O(n), so only the winners are fully sorted.
+ */
+void select_top_ranked(std::vector<ProcessRankKey>& keys, size_t top_n) {
+    if (keys.size() > top_n) {
+        std::nth_element(keys.begin(), keys.begin() + static_cast<std::ptrdiff_t>(top_n), keys.end(), ranks_higher);
+        keys.resize(top_n);
+    }
+    std::sort(keys.begin(), keys.end(), ranks_higher);
+}
+}  // namespace
+
 #if defined(__linux__)
 #include <unistd.h>
 #include <sys/sysinfo.h>
@@ -80,17 +108,19 @@ bool get_system_times(uint64_t& idle_time, uint64_t& total_time) {
     return true;
 }
 
-bool get_process_cpu_time(HANDLE process_handle, uint64_t& process_time) {
+bool get_process_cpu_time(HANDLE process_handle, uint64_t& process_time, uint64_t& start_time) {
     FILETIME creation_time;
     FILETIME exit_time;
     FILETIME kernel_time;
     FILETIME user_time;
     if (!GetProcessTimes(process_handle, &creation_time, &exit_time, &kernel_time, &user_time)) {
         process_time = 0;
+        start_time = 0;
         return false;
     }
 
     process_time = filetime_to_uint64(kernel_time) + filetime_to_uint64(user_time);
+    start_time = filetime_to_uint64(creation_time);
     return true;
 }
 
@@ -122,261 +152,19 @@ std::string process_name_to_utf8(const TCHAR* process_name) {
 
 #if defined(__linux__)
 namespace {
-bool read_linux_cpu_times(uint64_t& idle_time, uint64_t& total_time) {
-    std::ifstream stat_file("/proc/stat");
-    if (!stat_file.is_open()) {
-        idle_time = 0;
-        total_time = 0;
-        return false;
-    }
-
-    std::string cpu_label;
-    uint64_t user = 0;
-    uint64_t nice = 0;
-    uint64_t system = 0;
-    uint64_t idle = 0;
-    uint64_t iowait = 0;
-    uint64_t irq = 0;
-    uint64_t softirq = 0;
-    uint64_t steal = 0;
-
-    stat_file >> cpu_label >> user >> nice >> system >> idle >> iowait >> irq >> softirq >> steal;
-
-    if (!stat_file.good() || cpu_label != "cpu") {
-        idle_time = 0;
-        total_time = 0;
-        return false;
+void probe_linux_process_details(const MetricsSelection& selection, const ProcRoot& root, ProcessMetrics& proc) {
+    if (selection.process_handles) {
+        read_linux_pid_fd_count(proc.pid, proc.handle_count, root);
     }
 
-    idle_time = idle + iowait;
-    total_time = user + nice + system + idle + iowait + irq + softirq + steal;
-    return true;
-}
-
-struct LinuxProcessSnapshot {
-    int pid;
-    std::string name;
-    uint64_t cpu_time;
-    double memory_mb;
-    int thread_count;
-    double io_read_mb;
-    double io_write_mb;
-    int handle_count;
-};
-
-struct LinuxCpuTimes {
-    uint64_t idle_time;
-    uint64_t total_time;
-};
-
-bool is_numeric_text(const char* text) {
-    if (text == nullptr || *text == '\0') {
-        return false;
-    }
-
-    for (const char* current = text; *current != '\0'; ++current) {
-        if (!std::isdigit(static_cast<unsigned char>(*current))) {
-            return false;
+    if (selection.process_io) {
+        uint64_t read_bytes = 0;
+        uint64_t write_bytes = 0;
+        if (read_linux_pid_io(proc.pid, read_bytes, write_bytes, root)) {
+            proc.io_read_mb = static_cast<double>(read_bytes) / (1024.0 * 1024.0);
+            proc.io_write_mb = static_cast<double>(write_bytes) / (1024.0 * 1024.0);
         }
     }
-
-    return true;
-}
-
-bool read_linux_process_stat(int pid, std::string& process_name, uint64_t& cpu_time, uint64_t& rss_pages) {
-    const std::string stat_path = std::string("/proc/") + std::to_string(pid) + "/stat";
-    std::ifstream stat_file(stat_path);
-    if (!stat_file.is_open()) {
-        return false;
-    }
-
-    std::string line;
-    std::getline(stat_file, line);
-    if (line.empty()) {
-        return false;
-    }
-
-    const std::size_t open_paren = line.find('(');
-    const std::size_t close_paren = line.rfind(')');
-    if (open_paren == std::string::npos || close_paren == std::string::npos || close_paren <= open_paren) {
-        return false;
-    }
-
-    process_name = line.substr(open_paren + 1, close_paren - open_paren - 1);
-
-    std::string tail = line.substr(close_paren + 2);
-    std::istringstream stream(tail);
-    std::vector<std::string> fields;
-    std::string token;
-    while (stream >> token) {
-        fields.push_back(token);
-    }
-
-    if (fields.size() < 22) {
-        return false;
-    }
-
-    try {
-        const uint64_t user_ticks = std::stoull(fields[11]);
-        const uint64_t system_ticks = std::stoull(fields[12]);
-        cpu_time = user_ticks + system_ticks;
-        rss_pages = std::stoull(fields[21]);
-    } catch (...) {
-        return false;
-    }
-
-    return true;
-}
-
-bool read_linux_process_status_fields(int pid, int& thread_count, int& handle_count) {
-    thread_count = 0;
-    handle_count = 0;
-
-    const std::string status_path = std::string("/proc/") + std::to_string(pid) + "/status";
-    std::ifstream status_file(status_path);
-    if (!status_file.is_open()) {
-        return false;
-    }
-
-    std::string line;
-    while (std::getline(status_file, line)) {
-        if (line.rfind("Threads:", 0) == 0) {
-            std::istringstream parser(line.substr(8));
-            parser >> thread_count;
-            break;
-        }
-    }
-
-    std::error_code fd_error;
-    const auto fd_dir = std::filesystem::path("/proc") / std::to_string(pid) / "fd";
-    int fd_count = 0;
-    for (const auto& _ : std::filesystem::directory_iterator(fd_dir, fd_error)) {
-        (void)_;
-        if (fd_error) {
-            break;
-        }
-        ++fd_count;
-    }
-    if (!fd_error) {
-        handle_count = fd_count;
-    }
-
-    return true;
-}
-
-bool read_linux_process_io(int pid, double& io_read_mb, double& io_write_mb) {
-    io_read_mb = 0.0;
-    io_write_mb = 0.0;
-
-    const std::string io_path = std::string("/proc/") + std::to_string(pid) + "/io";
-    std::ifstream io_file(io_path);
-    if (!io_file.is_open()) {
-        return false;
-    }
-
-    uint64_t read_bytes = 0;
-    uint64_t write_bytes = 0;
-    std::string key;
-    uint64_t value = 0;
-
-    while (io_file >> key >> value) {
-        if (key == "read_bytes:") {
-            read_bytes = value;
-        } else if (key == "write_bytes:") {
-            write_bytes = value;
-        }
-    }
-
-    io_read_mb = static_cast<double>(read_bytes) / (1024.0 * 1024.0);
-    io_write_mb = static_cast<double>(write_bytes) / (1024.0 * 1024.0);
-    return true;
-}
-
-bool read_linux_per_core_cpu_times(std::vector<LinuxCpuTimes>& core_times) {
-    core_times.clear();
-
-    std::ifstream stat_file("/proc/stat");
-    if (!stat_file.is_open()) {
-        return false;
-    }
-
-    std::string line;
-    while (std::getline(stat_file, line)) {
-        if (line.rfind("cpu", 0) != 0 || (line.size() > 3 && !std::isdigit(static_cast<unsigned char>(line[3])))) {
-            continue;
-        }
-
-        std::istringstream parser(line);
-        std::string label;
-        uint64_t user = 0;
-        uint64_t nice = 0;
-        uint64_t system = 0;
-        uint64_t idle = 0;
-        uint64_t iowait = 0;
-        uint64_t irq = 0;
-        uint64_t softirq = 0;
-        uint64_t steal = 0;
-
-        parser >> label >> user >> nice >> system >> idle >> iowait >> irq >> softirq >> steal;
-        if (!parser.good() && !parser.eof()) {
-            continue;
-        }
-
-        LinuxCpuTimes times;
-        times.idle_time = idle + iowait;
-        times.total_time = user + nice + system + idle + iowait + irq + softirq + steal;
-        core_times.push_back(times);
-    }
-
-    return !core_times.empty();
-}
-
-std::unordered_map<int, LinuxProcessSnapshot> collect_linux_process_snapshot() {
-    std::unordered_map<int, LinuxProcessSnapshot> snapshots;
-    snapshots.reserve(512);
-
-    const long page_size = sysconf(_SC_PAGESIZE);
-    std::error_code iter_error;
-    for (const auto& entry : std::filesystem::directory_iterator("/proc", iter_error)) {
-        if (iter_error) {
-            continue;
-        }
-
-        const std::string pid_text = entry.path().filename().string();
-        if (!is_numeric_text(pid_text.c_str())) {
-            continue;
-        }
-
-        const int pid = std::atoi(pid_text.c_str());
-        if (pid <= 0) {
-            continue;
-        }
-
-        LinuxProcessSnapshot snapshot;
-        snapshot.pid = pid;
-        snapshot.cpu_time = 0;
-        snapshot.memory_mb = 0.0;
-        snapshot.thread_count = 0;
-        snapshot.io_read_mb = 0.0;
-        snapshot.io_write_mb = 0.0;
-        snapshot.handle_count = 0;
-
-        uint64_t rss_pages = 0;
-        if (!read_linux_process_stat(pid, snapshot.name, snapshot.cpu_time, rss_pages)) {
-            continue;
-        }
-
-        if (page_size > 0) {
-            snapshot.memory_mb =
-                (static_cast<double>(rss_pages) * static_cast<double>(page_size)) / (1024.0 * 1024.0);
-        }
-
-        read_linux_process_status_fields(pid, snapshot.thread_count, snapshot.handle_count);
-        read_linux_process_io(pid, snapshot.io_read_mb, snapshot.io_write_mb);
-
-        snapshots[pid] = std::move(snapshot);
-    }
-    return snapshots;
 }
 }  // namespace
 #endif
@@ -387,10 +175,17 @@ std::unordered_map<int, LinuxProcessSnapshot> collect_linux_process_snapshot() {
  * Initializes platform-specific resources required for collecting system metrics.
  * On Windows, this includes initializing PDH (Performance Data Helper) resources.
  */
-MetricsCollector::MetricsCollector(const MetricsSelection& selection)
-    : selection_(selection) {
+MetricsCollector::MetricsCollector(const MetricsSelection& selection, const CollectorOptions& options)
+    : selection_(selection),
+      options_(options) {
 #ifdef _WIN32
     initialize_pdh();
+#elif defined(__linux__)
+    const ProcRoot root(options_.proc_root);
+    proc_source_ = std::make_unique<LinuxProcSource>(root);
+    process_scanner_ = std::make_unique<LinuxProcessScanner>(options_.collector_threads, root);
+    process_table_ = std::make_unique<ProcessTable>();
+    cgroup_source_ = std::make_unique<LinuxCgroupSource>(options_.cgroup_root);
 #endif
 }
 
@@ -406,6 +201,28 @@ MetricsCollector::~MetricsCollector() {
 #endif
 }
 
+void MetricsCollector::set_selection(const MetricsSelection& selection) {
+    selection_ = selection;
+}
+
+bool MetricsCollector::enable_process_events(std::string& error_message) {
+#if defined(__linux__)
+    return process_scanner_->enable_process_events(error_message);
+#else
+    error_message = "process events are only supported on Linux";
+    return false;
+#endif
+}
+
+bool MetricsCollector::enable_io_uring(std::string& error_message) {
+#if defined(__linux__)
+    return process_scanner_->enable_io_uring(error_message);
+#else
+    error_message = "io_uring is only supported on Linux";
+    return false;
+#endif
+}
+
 /**
  * @brief Collects system-wide metrics, including CPU usage and top processes.
  *
@@ -416,36 +233,97 @@ MetricsCollector::~MetricsCollector() {
  */
 SystemMetrics MetricsCollector::collect() {
     SystemMetrics metrics;
-    metrics.timestamp = time(nullptr);
+    collect(metrics);
+    return metrics;
+}
 
-    if (selection_.total_cpu) {
-        metrics.total_cpu_percent = get_total_cpu();
-    } else {
-        metrics.total_cpu_percent = 0.0;
+/**
+ * @brief Collects system-wide metrics into an existing snapshot.
+ *
+ * Every field is overwritten. The per-core and process vectors (and the
+ * process name strings) keep their capacity, so a snapshot that is recycled
+ * between cycles does not reallocate in steady state.
+ *
+ * @param metrics Snapshot to overwrite.
+ */
+void MetricsCollector::collect(SystemMetrics& metrics) {
+    collect(metrics, kMetricFamilyAll);
+}
+
+/**
+ * @brief Re-samples the given metric families into an existing snapshot.
+ *
+ * The timestamp is always refreshed. Families in `families` are overwritten
+ * (or cleared when not selected); the others are left as they are, so a
+ * snapshot that is updated in place carries their last sample forward.
+ *
+ * @param metrics Snapshot to update.
+ * @param families MetricFamily bits to sample.
+ */
+void MetricsCollector::collect(SystemMetrics& metrics, uint32_t families) {
+    const bool cpu_due = (families & kMetricFamilyCpu) != 0;
+    const bool memory_due = (families & kMetricFamilyMemory) != 0;
+    const bool processes_due = (families & kMetricFamilyProcesses) != 0;
+    ScopedStageTimer timer(TelemetryStage::collect);
+    agent_telemetry().collections.fetch_add(1, std::memory_order_relaxed);
+
+    const auto now = std::chrono::system_clock::now().time_since_epoch();
+    metrics.timestamp_ms = std::chrono::duration_cast<std::chrono::milliseconds>(now).count();
+    metrics.timestamp = static_cast<time_t>(metrics.timestamp_ms / 1000);
+
+#if defined(__linux__)
+    // One /proc/stat read per cycle feeds total, per-core and process CPU.
+    if ((cpu_due && (selection_.total_cpu || selection_.per_core_cpu)) ||
+        (processes_due && (selection_.top_processes || selection_.top_cgroups))) {
+        proc_source_->refresh_cpu_times();
     }
+#endif
+
+    if (cpu_due) {
+        if (selection_.total_cpu) {
+            metrics.total_cpu_percent = get_total_cpu();
+        } else {
+            metrics.total_cpu_percent = 0.0;
+        }
 
-    if (selection_.per_core_cpu) {
-        metrics.per_core_cpu_percent = get_per_core_cpu();
+        if (selection_.per_core_cpu) {
+            get_per_core_cpu(metrics.per_core_cpu_percent);
+        } else {
+            metrics.per_core_cpu_percent.clear();
+        }
     }
 
-    if (selection_.system_memory) {
-        const auto [memory_total_mb, memory_used_mb] = get_system_memory();
-        metrics.system_memory_total_mb = memory_total_mb;
-        metrics.system_memory_used_mb = memory_used_mb;
-    } else {
-        metrics.system_memory_total_mb = 0.0;
-        metrics.system_memory_used_mb = 0.0;
+    if (memory_due) {
+        if (selection_.system_memory) {
+            const auto [memory_total_mb, memory_used_mb] = get_system_memory();
+            metrics.system_memory_total_mb = memory_total_mb;
+            metrics.system_memory_used_mb = memory_used_mb;
+        } else {
+            metrics.system_memory_total_mb = 0.0;
+            metrics.system_memory_used_mb = 0.0;
+        }
     }
 
-    if (selection_.top_processes) {
-        metrics.top_processes = get_top_processes();
+    if (processes_due) {
+        if (selection_.top_processes) {
+            ScopedStageTimer scan_timer(TelemetryStage::proc_scan);
+            get_top_processes(metrics.top_processes);
+        } else {
+            metrics.top_processes.clear();
+        }
+
+        if (selection_.top_cgroups) {
+            get_top_cgroups(metrics.top_cgroups);
+        } else {
+            metrics.top_cgroups.clear();
+        }
     }
 
-    return metrics;
+    metrics.fresh_families = families & kMetricFamilyAll;
 }
 
-std::vector<double> MetricsCollector::get_per_core_cpu() {
-    std::vector<double> per_core_cpu;
+void MetricsCollector::get_per_core_cpu(std::vector<double>& per_core_cpu) {
+    per_core_cpu.clear();
 
 #ifdef _WIN32
     SYSTEM_INFO system_info;
@@ -454,47 +332,26 @@ std::vector<double> MetricsCollector::get_per_core_cpu() {
         per_core_cpu.assign(static_cast<size_t>(system_info.dwNumberOfProcessors), 0.0);
     }
 #elif defined(__linux__)
-    static bool has_previous = false;
-    static std::vector<LinuxCpuTimes> previous_core_times;
-
-    std::vector<LinuxCpuTimes> current_core_times;
-    if (!read_linux_per_core_cpu_times(current_core_times)) {
-        return per_core_cpu;
-    }
-
-    if (!has_previous) {
-        has_previous = true;
-        previous_core_times = current_core_times;
-        per_core_cpu.assign(current_core_times.size(), 0.0);
-        return per_core_cpu;
-    }
-
-    const size_t core_count = min_value(previous_core_times.size(), current_core_times.size());
-    per_core_cpu.reserve(core_count);
-    for (size_t index = 0; index < core_count; ++index) {
-        const auto& previous = previous_core_times[index];
-        const auto& current = current_core_times[index];
-
-        const uint64_t total_delta =
-            (current.total_time > previous.total_time) ? (current.total_time - previous.total_time) : 0;
-        const uint64_t idle_delta =
-            (current.idle_time > previous.idle_time) ? (current.idle_time - previous.idle_time) : 0;
-
-        double usage = 0.0;
-        if (total_delta > 0) {
-            usage =
-                (static_cast<double>(total_delta - min_value(total_delta, idle_delta)) /
-                 static_cast<double>(total_delta)) *
-                100.0;
-        }
+    const std::vector<LinuxCpuTimes>& core_times = proc_source_->per_core_cpu_times();
+    if (core_times.empty()) {
+        return;
+    }
 
-            per_core_cpu.push_back(clamp_value(usage, 0.0, 100.0));
+    current_core_counters_.resize(core_times.size());
+    for (size_t index = 0; index < core_times.size(); ++index) {
+        current_core_counters_.idle[index] = static_cast<double>(core_times[index].idle_time);
+        current_core_counters_.total[index] = static_cast<double>(core_times[index].total_time);
     }
 
-    previous_core_times = std::move(current_core_times);
+    if (!has_previous_core_sample_) {
+        has_previous_core_sample_ = true;
+        per_core_cpu.assign(core_times.size(), 0.0);
+    } else {
+        per_core_cpu.resize(min_value(previous_core_counters_.size(), current_core_counters_.size()));
+        compute_cpu_usage(previous_core_counters_, current_core_counters_, per_core_cpu.data());
+    }
+    std::swap(previous_core_counters_, current_core_counters_);
 #endif
-
-    return per_core_cpu;
 }
 
 std::pair<double, double> MetricsCollector::get_system_memory() {
@@ -512,23 +369,10 @@ std::pair<double, double> MetricsCollector::get_system_memory() {
     const double used_mb = max_value(0.0, total_mb - available_mb);
     return {total_mb, used_mb};
 #elif defined(__linux__)
-    std::ifstream meminfo_file("/proc/meminfo");
-    if (!meminfo_file.is_open()) {
-        return {0.0, 0.0};
-    }
-
     uint64_t mem_total_kb = 0;
     uint64_t mem_available_kb = 0;
-    std::string key;
-    uint64_t value = 0;
-    std::string unit;
-
-    while (meminfo_file >> key >> value >> unit) {
-        if (key == "MemTotal:") {
-            mem_total_kb = value;
-        } else if (key == "MemAvailable:") {
-            mem_available_kb = value;
-        }
+    if (!proc_source_->read_memory_info(mem_total_kb, mem_available_kb)) {
+        return {0.0, 0.0};
     }
 
     const double total_mb = static_cast<double>(mem_total_kb) / 1024.0;
@@ -551,30 +395,26 @@ std::pair<double, double> MetricsCollector::get_system_memory() {
  */
 double MetricsCollector::get_total_cpu() {
 #ifdef _WIN32
-    static bool has_previous = false;
-    static uint64_t previous_idle = 0;
-    static uint64_t previous_total = 0;
-
     uint64_t current_idle = 0;
     uint64_t current_total = 0;
     if (!get_system_times(current_idle, current_total)) {
         return 0.0;
     }
 
-    if (!has_previous) {
-        has_previous = true;
-        previous_idle = current_idle;
-        previous_total = current_total;
+    if (!has_previous_cpu_sample_) {
+        has_previous_cpu_sample_ = true;
+        previous_cpu_idle_ = current_idle;
+        previous_cpu_total_ = current_total;
         return 0.0;
     }
 
     const uint64_t total_delta =
-        (current_total > previous_total) ? (current_total - previous_total) : 0;
+        (current_total > previous_cpu_total_) ? (current_total - previous_cpu_total_) : 0;
     const uint64_t idle_delta =
-        (current_idle > previous_idle) ? (current_idle - previous_idle) : 0;
+        (current_idle > previous_cpu_idle_) ? (current_idle - previous_cpu_idle_) : 0;
 
-    previous_idle = current_idle;
-    previous_total = current_total;
+    previous_cpu_idle_ = current_idle;
+    previous_cpu_total_ = current_total;
 
     if (total_delta == 0) {
         return 0.0;
@@ -586,30 +426,27 @@ double MetricsCollector::get_total_cpu() {
         100.0;
     return clamp_value(usage, 0.0, 100.0);
 #elif defined(__linux__)
-    static bool has_previous = false;
-    static uint64_t previous_idle = 0;
-    static uint64_t previous_total = 0;
-
-    uint64_t current_idle = 0;
-    uint64_t current_total = 0;
-    if (!read_linux_cpu_times(current_idle, current_total)) {
+    if (!proc_source_->has_cpu_times()) {
         return 0.0;
     }
 
-    if (!has_previous) {
-        has_previous = true;
-        previous_idle = current_idle;
-        previous_total = current_total;
+    const uint64_t current_idle = proc_source_->total_cpu_times().idle_time;
+    const uint64_t current_total = proc_source_->total_cpu_times().total_time;
+
+    if (!has_previous_cpu_sample_) {
+        has_previous_cpu_sample_ = true;
+        previous_cpu_idle_ = current_idle;
+        previous_cpu_total_ = current_total;
         return 0.0;
     }
 
     const uint64_t total_delta =
-        (current_total > previous_total) ? (current_total - previous_total) : 0;
+        (current_total > previous_cpu_total_) ? (current_total - previous_cpu_total_) : 0;
     const uint64_t idle_delta =
-        (current_idle > previous_idle) ? (current_idle - previous_idle) : 0;
+        (current_idle > previous_cpu_idle_) ? (current_idle - previous_cpu_idle_) : 0;
 
-    previous_idle = current_idle;
-    previous_total = current_total;
+    previous_cpu_idle_ = current_idle;
+    previous_cpu_total_ = current_total;
 
     if (total_delta == 0) {
         return 0.0;
@@ -632,207 +469,285 @@ double MetricsCollector::get_total_cpu() {
  * and gather their metrics. The processes are sorted by CPU usage, and
  * only the top N are returned.
  *
- * @return A vector of ProcessMetrics objects representing the top processes.
+ * Each call performs a single scan. Per-process CPU usage is computed from
+ * the CPU time recorded by the previous call, so no sampling sleep is needed.
+ *
+ * Existing elements of @p processes are overwritten rather than rebuilt so a
+ * recycled snapshot keeps its process name buffers.
+ *
+ * @param processes Receives the top processes, highest rank first.
  */
-std::vector<ProcessMetrics> MetricsCollector::get_top_processes() {
-    std::vector<ProcessMetrics> processes;
+void MetricsCollector::get_top_processes(std::vector<ProcessMetrics>& processes) {
+    rank_keys_.clear();
 
 #ifdef _WIN32
-    std::unordered_map<int, uint64_t> process_time_start;
-    process_time_start.reserve(512);
+    std::unordered_map<int, ProcessCpuSample> process_samples;
+    process_samples.reserve(max_value<size_t>(512, previous_process_samples_.size()));
 
-    uint64_t system_time_start = 0;
-    if (!get_total_system_cpu_time(system_time_start)) {
-        return processes;
+    uint64_t system_time = 0;
+    if (!get_total_system_cpu_time(system_time)) {
+        processes.clear();
+        return;
     }
 
+    const uint64_t system_time_delta =
+        (has_previous_process_sample_ && system_time > previous_process_system_time_)
+            ? (system_time - previous_process_system_time_)
+            : 0;
+
     HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
     if (snapshot == INVALID_HANDLE_VALUE) {
-        return processes;
+        processes.clear();
+        return;
     }
 
+    std::vector<PROCESSENTRY32> entries;
+    entries.reserve(512);
+
     PROCESSENTRY32 entry;
     entry.dwSize = sizeof(PROCESSENTRY32);
 
     if (Process32First(snapshot, &entry)) {
         do {
-            ProcessMetrics proc;
-            proc.pid = entry.th32ProcessID;
-            proc.name = process_name_to_utf8(entry.szExeFile);
-            proc.cpu_percent = 0.0;
-            proc.memory_mb = 0.0;
-            proc.thread_count = selection_.process_threads ? static_cast<int>(entry.cntThreads) : 0;
-            proc.io_read_mb = 0.0;
-            proc.io_write_mb = 0.0;
-            proc.handle_count = 0;
+            const int pid = static_cast<int>(entry.th32ProcessID);
+            double cpu_percent = 0.0;
+            double memory_mb = 0.0;
 
             HANDLE process_handle = OpenProcess(
                 PROCESS_QUERY_LIMITED_INFORMATION | PROCESS_VM_READ,
                 FALSE,
-                static_cast<DWORD>(proc.pid)
+                static_cast<DWORD>(pid)
             );
             if (process_handle != nullptr) {
                 uint64_t process_time = 0;
-                if (get_process_cpu_time(process_handle, process_time)) {
-                    process_time_start[proc.pid] = process_time;
+                uint64_t start_time = 0;
+                if (get_process_cpu_time(process_handle, process_time, start_time)) {
+                    process_samples[pid] = ProcessCpuSample{process_time, start_time};
+
+                    const auto previous_it = previous_process_samples_.find(pid);
+                    if (system_time_delta > 0 &&
+                        previous_it != previous_process_samples_.end() &&
+                        previous_it->second.start_time == start_time &&
+                        process_time >= previous_it->second.cpu_time) {
+                        const uint64_t process_time_delta = process_time - previous_it->second.cpu_time;
+                        cpu_percent = (static_cast<double>(process_time_delta) /
+                                       static_cast<double>(system_time_delta)) *
+                                      100.0;
+                    }
+                }
+
+                PROCESS_MEMORY_COUNTERS_EX memory_counters;
+                std::memset(&memory_counters, 0, sizeof(memory_counters));
+                if (GetProcessMemoryInfo(process_handle,
+                                         reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&memory_counters),
+                                         sizeof(memory_counters))) {
+                    memory_mb = static_cast<double>(memory_counters.WorkingSetSize) / (1024.0 * 1024.0);
                 }
+
                 CloseHandle(process_handle);
             }
 
-            processes.push_back(proc);
+            rank_keys_.push_back(ProcessRankKey{pid, cpu_percent, memory_mb, entries.size()});
+            entries.push_back(entry);
         } while (Process32Next(snapshot, &entry));
     }
 
     CloseHandle(snapshot);
 
-    std::this_thread::sleep_for(std::chrono::milliseconds(200));
-
-    uint64_t system_time_end = 0;
-    if (!get_total_system_cpu_time(system_time_end)) {
-        return processes;
-    }
-
-    const uint64_t system_time_delta =
-        (system_time_end > system_time_start) ? (system_time_end - system_time_start) : 0;
-
-    for (auto& proc : processes) {
-        HANDLE process_handle = OpenProcess(
-            PROCESS_QUERY_LIMITED_INFORMATION | PROCESS_VM_READ,
-            FALSE,
-            static_cast<DWORD>(proc.pid)
-        );
-        if (process_handle == nullptr) {
-            continue;
-        }
-
-        uint64_t process_time_end = 0;
-        auto it = process_time_start.find(proc.pid);
-        if (system_time_delta > 0 &&
-            it != process_time_start.end() &&
-            get_process_cpu_time(process_handle, process_time_end) &&
-            process_time_end >= it->second) {
-            const uint64_t process_time_delta = process_time_end - it->second;
-            proc.cpu_percent = (static_cast<double>(process_time_delta) /
-                                static_cast<double>(system_time_delta)) *
-                               100.0;
-        }
-
-        PROCESS_MEMORY_COUNTERS_EX memory_counters;
-        std::memset(&memory_counters, 0, sizeof(memory_counters));
-        if (GetProcessMemoryInfo(process_handle,
-                                 reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&memory_counters),
-                                 sizeof(memory_counters))) {
-            proc.memory_mb =
-                static_cast<double>(memory_counters.WorkingSetSize) / (1024.0 * 1024.0);
-        }
+    previous_process_samples_ = std::move(process_samples);
+    previous_process_system_time_ = system_time;
+    has_previous_process_sample_ = true;
+
+    select_top_ranked(rank_keys_, options_.top_n);
+
+    // Only the winners pay for name conversion and the I/O / handle probes.
+    processes.resize(rank_keys_.size());
+    for (size_t rank = 0; rank < rank_keys_.size(); ++rank) {
+        const ProcessRankKey& key = rank_keys_[rank];
+        const PROCESSENTRY32& winner = entries[key.index];
+
+        ProcessMetrics& proc = processes[rank];
+        proc.pid = key.pid;
+        proc.name = process_name_to_utf8(winner.szExeFile);
+        proc.cpu_percent = key.cpu_percent;
+        proc.memory_mb = key.memory_mb;
+        proc.thread_count = selection_.process_threads ? static_cast<int>(winner.cntThreads) : 0;
+        proc.io_read_mb = 0.0;
+        proc.io_write_mb = 0.0;
+        proc.handle_count = 0;
+
+        if (selection_.process_io || selection_.process_handles) {
+            HANDLE process_handle = OpenProcess(
+                PROCESS_QUERY_LIMITED_INFORMATION,
+                FALSE,
+                static_cast<DWORD>(proc.pid)
+            );
+            if (process_handle != nullptr) {
+                if (selection_.process_io) {
+                    IO_COUNTERS io_counters;
+                    std::memset(&io_counters, 0, sizeof(io_counters));
+                    if (GetProcessIoCounters(process_handle, &io_counters)) {
+                        proc.io_read_mb = static_cast<double>(io_counters.ReadTransferCount) / (1024.0 * 1024.0);
+                        proc.io_write_mb = static_cast<double>(io_counters.WriteTransferCount) / (1024.0 * 1024.0);
+                    }
+                }
 
-        if (selection_.process_io) {
-            IO_COUNTERS io_counters;
-            std::memset(&io_counters, 0, sizeof(io_counters));
-            if (GetProcessIoCounters(process_handle, &io_counters)) {
-                proc.io_read_mb = static_cast<double>(io_counters.ReadTransferCount) / (1024.0 * 1024.0);
-                proc.io_write_mb = static_cast<double>(io_counters.WriteTransferCount) / (1024.0 * 1024.0);
-            }
-        }
+                if (selection_.process_handles) {
+                    DWORD handle_count = 0;
+                    if (GetProcessHandleCount(process_handle, &handle_count)) {
+                        proc.handle_count = static_cast<int>(handle_count);
+                    }
+                }
 
-        if (selection_.process_handles) {
-            DWORD handle_count = 0;
-            if (GetProcessHandleCount(process_handle, &handle_count)) {
-                proc.handle_count = static_cast<int>(handle_count);
+                CloseHandle(process_handle);
             }
         }
-
-        CloseHandle(process_handle);
-    }
-
-    std::sort(processes.begin(), processes.end(), [](const ProcessMetrics& left, const ProcessMetrics& right) {
-        if (left.cpu_percent != right.cpu_percent) {
-            return left.cpu_percent > right.cpu_percent;
-        }
-        return left.memory_mb > right.memory_mb;
-    });
-
-    // Sort by CPU and take top 12
-    if (processes.size() > 12) {
-        processes.resize(12);
     }
 #elif defined(__linux__)
-    uint64_t system_idle_start = 0;
-    uint64_t system_total_start = 0;
-    if (!read_linux_cpu_times(system_idle_start, system_total_start)) {
-        return processes;
+    if (!proc_source_->has_cpu_times()) {
+        processes.clear();
+        return;
     }
 
-    const auto start_snapshot = collect_linux_process_snapshot();
-
-    std::this_thread::sleep_for(std::chrono::milliseconds(200));
-
-    uint64_t system_idle_end = 0;
-    uint64_t system_total_end = 0;
-    if (!read_linux_cpu_times(system_idle_end, system_total_end)) {
-        return processes;
-    }
+    const uint64_t system_total = proc_source_->total_cpu_times().total_time;
+    process_table_->update(process_scanner_->scan(selection_));
+    const long page_size = sysconf(_SC_PAGESIZE);
 
+    // Deltas are taken against the previous call instead of a second scan, so
+    // the first call only establishes the baseline and reports 0% everywhere.
     const uint64_t system_total_delta =
-        (system_total_end > system_total_start) ? (system_total_end - system_total_start) : 0;
-    if (system_total_delta == 0) {
-        return processes;
+        (has_previous_process_sample_ && system_total > previous_process_system_time_)
+            ? (system_total - previous_process_system_time_)
+            : 0;
+    previous_process_system_time_ = system_total;
+    has_previous_process_sample_ = true;
+
+    const size_t rows = process_table_->size();
+    const uint64_t* cpu_deltas = process_table_->cpu_ticks_deltas().data();
+    const uint64_t* rss_pages = process_table_->rss_pages_column().data();
+    const double cpu_scale = (system_total_delta > 0) ? 100.0 / static_cast<double>(system_total_delta) : 0.0;
+    const double memory_scale = (page_size > 0) ? static_cast<double>(page_size) / (1024.0 * 1024.0) : 0.0;
+
+    rank_keys_.reserve(rows);
+    for (size_t row = 0; row < rows; ++row) {
+        rank_keys_.push_back(ProcessRankKey{
+            process_table_->pid(row),
+            static_cast<double>(cpu_deltas[row]) * cpu_scale,
+            static_cast<double>(rss_pages[row]) * memory_scale,
+            row});
+    }
+
+    select_top_ranked(rank_keys_, options_.top_n);
+
+    // Only the winners get a ProcessMetrics (and a name copy) and the
+    // fd / I/O probes.
+    processes.resize(rank_keys_.size());
+    for (size_t rank = 0; rank < rank_keys_.size(); ++rank) {
+        const ProcessRankKey& key = rank_keys_[rank];
+        const std::string_view name = process_table_->name(key.index);
+
+        // Assigning into the recycled element keeps its name buffer.
+        ProcessMetrics& proc = processes[rank];
+        proc.pid = key.pid;
+        proc.name.assign(name.data(), name.size());
+        proc.cpu_percent = key.cpu_percent;
+        proc.memory_mb = key.memory_mb;
+        proc.thread_count = process_table_->thread_count(key.index);
+        proc.io_read_mb = 0.0;
+        proc.io_write_mb = 0.0;
+        proc.handle_count = 0;
+
+        probe_linux_process_details(selection_, process_scanner_->root(), proc);
     }
+#endif
+}
 
-    const auto end_snapshot = collect_linux_process_snapshot();
-
-    processes.reserve(end_snapshot.size());
-    for (const auto& [pid, end_process] : end_snapshot) {
-        const auto start_it = start_snapshot.find(pid);
-        if (start_it == start_snapshot.end()) {
-            continue;
-        }
+/**
+ * @brief Retrieves the leaf cgroups with the highest CPU usage (Linux, cgroup v2).
+ *
+ * One walk of the hierarchy reads cpu.stat, memory.current and io.stat of
+ * each leaf; no per-process file is touched. CPU usage is the usage_usec
+ * delta against the previous call, scaled by the same system-wide CPU time
+ * as the process CPU, so the first call reports 0% everywhere.
+ *
+ * @param cgroups Receives the top cgroups, highest rank first.
+ */
+void MetricsCollector::get_top_cgroups(std::vector<CgroupMetrics>& cgroups) {
+#if defined(__linux__)
+    if (!proc_source_->has_cpu_times() || !cgroup_source_->is_available()) {
+        cgroups.clear();
+        return;
+    }
 
-        const uint64_t start_cpu = start_it->second.cpu_time;
-        if (end_process.cpu_time < start_cpu) {
-            continue;
-        }
+    const uint64_t system_total = proc_source_->total_cpu_times().total_time;
+    cgroup_source_->scan(cgroup_samples_);
 
-        const uint64_t process_delta = end_process.cpu_time - start_cpu;
-
-        ProcessMetrics proc;
-        proc.pid = pid;
-        proc.name = end_process.name;
-        proc.cpu_percent =
-            (static_cast<double>(process_delta) / static_cast<double>(system_total_delta)) * 100.0;
-        proc.memory_mb = end_process.memory_mb;
-        proc.thread_count = end_process.thread_count;
-        proc.io_read_mb = end_process.io_read_mb;
-        proc.io_write_mb = end_process.io_write_mb;
-        proc.handle_count = end_process.handle_count;
-
-        if (!selection_.process_threads) {
-            proc.thread_count = 0;
-        }
-        if (!selection_.process_io) {
-            proc.io_read_mb = 0.0;
-            proc.io_write_mb = 0.0;
+    const uint64_t system_total_delta =
+        (has_previous_cgroup_sample_ && system_total > previous_cgroup_system_time_)
+            ? (system_total - previous_cgroup_system_time_)
+            : 0;
+    previous_cgroup_system_time_ = system_total;
+    has_previous_cgroup_sample_ = true;
+
+    // usage_usec is in microseconds, the system total in clock ticks.
+    const long ticks_per_second = sysconf(_SC_CLK_TCK);
+    const double system_usec_delta = (ticks_per_second > 0)
+        ? static_cast<double>(system_total_delta) * 1e6 / static_cast<double>(ticks_per_second)
+        : 0.0;
+    const double cpu_scale = (system_usec_delta > 0.0) ? 100.0 / system_usec_delta : 0.0;
+    constexpr double kBytesPerMb = 1024.0 * 1024.0;
+
+    // The rank keys are shared with get_top_processes; `pid` holds the
+    // sample index so ties still break deterministically.
+    rank_keys_.clear();
+    rank_keys_.reserve(cgroup_samples_.size());
+    ++cgroup_cycle_;
+    for (size_t index = 0; index < cgroup_samples_.size(); ++index) {
+        const CgroupSample& sample = cgroup_samples_[index];
+
+        // Known cgroups are updated in place; only new ones allocate a node.
+        uint64_t cpu_delta = 0;
+        const auto baseline = cgroup_cpu_baselines_.find(sample.path);
+        if (baseline == cgroup_cpu_baselines_.end()) {
+            cgroup_cpu_baselines_.emplace(sample.path, CgroupCpuBaseline{sample.cpu_usage_usec, cgroup_cycle_});
+        } else {
+            if (sample.cpu_usage_usec > baseline->second.usage_usec) {
+                cpu_delta = sample.cpu_usage_usec - baseline->second.usage_usec;
+            }
+            baseline->second = CgroupCpuBaseline{sample.cpu_usage_usec, cgroup_cycle_};
         }
-        if (!selection_.process_handles) {
-            proc.handle_count = 0;
+        rank_keys_.push_back(ProcessRankKey{
+            static_cast<int>(index),
+            static_cast<double>(cpu_delta) * cpu_scale,
+            static_cast<double>(sample.memory_bytes) / kBytesPerMb,
+            index});
+    }
+    // Cgroups that are gone start from a fresh baseline if their path returns.
+    for (auto baseline = cgroup_cpu_baselines_.begin(); baseline != cgroup_cpu_baselines_.end();) {
+        if (baseline->second.seen_cycle != cgroup_cycle_) {
+            baseline = cgroup_cpu_baselines_.erase(baseline);
+        } else {
+            ++baseline;
         }
-
-        processes.push_back(proc);
     }
 
-    std::sort(processes.begin(), processes.end(), [](const ProcessMetrics& left, const ProcessMetrics& right) {
-        if (left.cpu_percent != right.cpu_percent) {
-            return left.cpu_percent > right.cpu_percent;
-        }
-        return left.memory_mb > right.memory_mb;
-    });
+    select_top_ranked(rank_keys_, options_.top_n);
 
-    if (processes.size() > 12) {
-        processes.resize(12);
+    cgroups.resize(rank_keys_.size());
+    for (size_t rank = 0; rank < rank_keys_.size(); ++rank) {
+        const ProcessRankKey& key = rank_keys_[rank];
+        const CgroupSample& sample = cgroup_samples_[key.index];
+
+        CgroupMetrics& cgroup = cgroups[rank];
+        cgroup.path.assign(sample.path);
+        cgroup.cpu_percent = key.cpu_percent;
+        cgroup.memory_mb = key.memory_mb;
+        cgroup.io_read_mb = static_cast<double>(sample.io_read_bytes) / kBytesPerMb;
+        cgroup.io_write_mb = static_cast<double>(sample.io_write_bytes) / kBytesPerMb;
     }
+#else
+    cgroups.clear();
 #endif
-
-    return processes;
 }
 
 #ifdef _WIN32
@@ -0,0 +1,196 @@
+#include "metrics_endpoint.h"
+
+#include <cerrno>
+#include <cstring>
+#include <string_view>
+#include <utility>
+
+#if !defined(_WIN32)
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+namespace {
+constexpr size_t kMaxRequestBytes = 4096;
+constexpr int kAcceptPollMs = 200;
+
+#if !defined(_WIN32)
+// A scraper that hangs up early must not kill the agent with SIGPIPE.
+#if defined(MSG_NOSIGNAL)
+constexpr int kSendFlags = MSG_NOSIGNAL;
+#else
+constexpr int kSendFlags = 0;
+#endif
+
+bool send_all(int fd, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        const ssize_t count = ::send(fd, data.data() + sent, data.size() - sent, kSendFlags);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            return false;
+        }
+        sent += static_cast<size_t>(count);
+    }
+    return true;
+}
+#endif
+
+void build_response(std::string& response, const char* status, const char* content_type, const std::string& body) {
+    response.clear();
+    response += "HTTP/1.1 ";
+    response += status;
+    response += "\r\nContent-Type: ";
+    response += content_type;
+    response += "\r\nContent-Length: ";
+    response += std::to_string(body.size());
+    response += "\r\nConnection: close\r\n\r\n";
+    response += body;
+}
+}  // namespace
+
+MetricsEndpoint::MetricsEndpoint(std::string address, uint16_t port, Renderer render)
+    : address_(std::move(address)),
+      port_(port),
+      render_(std::move(render)) {}
+
+MetricsEndpoint::~MetricsEndpoint() {
+    stop();
+}
+
+bool MetricsEndpoint::start(std::string& error_message) {
+#if defined(_WIN32)
+    error_message = "metrics endpoint is only supported on POSIX systems";
+    return false;
+#else
+    if (listen_fd_ >= 0) {
+        return true;
+    }
+
+    sockaddr_in bind_address{};
+    bind_address.sin_family = AF_INET;
+    bind_address.sin_port = htons(port_);
+    if (::inet_pton(AF_INET, address_.c_str(), &bind_address.sin_addr) != 1) {
+        error_message = "invalid listen address: " + address_;
+        return false;
+    }
+
+    const int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        error_message = std::string("socket failed: ") + std::strerror(errno);
+        return false;
+    }
+
+    const int reuse = 1;
+    ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    if (::bind(fd, reinterpret_cast<const sockaddr*>(&bind_address), sizeof(bind_address)) != 0 ||
+        ::listen(fd, 16) != 0) {
+        error_message = "cannot listen on " + address_ + ":" + std::to_string(port_) + ": " + std::strerror(errno);
+        ::close(fd);
+        return false;
+    }
+
+    sockaddr_in bound{};
+    socklen_t bound_size = sizeof(bound);
+    if (::getsockname(fd, reinterpret_cast<sockaddr*>(&bound), &bound_size) == 0) {
+        port_ = ntohs(bound.sin_port);
+    }
+
+    listen_fd_ = fd;
+    stopping_.store(false, std::memory_order_relaxed);
+    thread_ = std::thread(&MetricsEndpoint::run, this);
+    return true;
+#endif
+}
+
+void MetricsEndpoint::stop() {
+    stopping_.store(true, std::memory_order_relaxed);
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+#if !defined(_WIN32)
+    if (listen_fd_ >= 0) {
+        ::close(listen_fd_);
+        listen_fd_ = -1;
+    }
+#endif
+}
+
+uint16_t MetricsEndpoint::port() const {
+    return port_;
+}
+
+void MetricsEndpoint::run() {
+#if !defined(_WIN32)
+    // Polling with a timeout lets stop() end the loop without closing the
+    // socket under a blocked accept().
+    while (!stopping_.load(std::memory_order_relaxed)) {
+        pollfd listener{listen_fd_, POLLIN, 0};
+        const int ready = ::poll(&listener, 1, kAcceptPollMs);
+        if (ready <= 0) {
+            continue;
+        }
+
+        const int client_fd = ::accept(listen_fd_, nullptr, nullptr);
+        if (client_fd < 0) {
+            continue;
+        }
+
+        timeval timeout{1, 0};
+        ::setsockopt(client_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        ::setsockopt(client_fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+#if defined(SO_NOSIGPIPE)
+        const int no_sigpipe = 1;
+        ::setsockopt(client_fd, SOL_SOCKET, SO_NOSIGPIPE, &no_sigpipe, sizeof(no_sigpipe));
+#endif
+        serve(client_fd);
+        ::close(client_fd);
+    }
+#endif
+}
+
+void MetricsEndpoint::serve(int client_fd) {
+#if !defined(_WIN32)
+    request_.clear();
+    char chunk[1024];
+    while (request_.find("\r\n\r\n") == std::string::npos && request_.size() < kMaxRequestBytes) {
+        const ssize_t count = ::recv(client_fd, chunk, sizeof(chunk), 0);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            break;
+        }
+        request_.append(chunk, static_cast<size_t>(count));
+    }
+
+    // Only the request line matters: "GET /metrics[?query] HTTP/1.x".
+    const std::string_view line = std::string_view(request_).substr(0, request_.find("\r\n"));
+    const size_t method_end = line.find(' ');
+    const std::string_view method = line.substr(0, method_end);
+    std::string_view target = method_end == std::string_view::npos ? std::string_view() : line.substr(method_end + 1);
+    target = target.substr(0, target.find(' '));
+    target = target.substr(0, target.find('?'));
+
+    body_.clear();
+    if (method != "GET") {
+        body_ = "method not allowed\n";
+        build_response(response_, "405 Method Not Allowed", "text/plain; charset=utf-8", body_);
+    } else if (target != "/metrics") {
+        body_ = "not found\n";
+        build_response(response_, "404 Not Found", "text/plain; charset=utf-8", body_);
+    } else {
+        render_(body_);
+        build_response(response_, "200 OK", "text/plain; version=0.0.4; charset=utf-8", body_);
+    }
+    send_all(client_fd, response_);
+#else
+    (void)client_fd;
+#endif
+}
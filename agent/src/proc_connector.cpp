@@ -0,0 +1,184 @@
+#include "proc_connector.h"
+#include "agent_telemetry.h"
+
+#if defined(__linux__)
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <linux/cn_proc.h>
+#include <linux/connector.h>
+#include <linux/netlink.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+// Room for the events of a busy build host between two collection cycles;
+// the kernel caps it at net.core.rmem_max.
+constexpr int kReceiveBufferBytes = 4 * 1024 * 1024;
+constexpr size_t kReadBufferBytes = 64 * 1024;
+
+bool send_listen(int fd, proc_cn_mcast_op op) {
+    // nlmsghdr, then cn_msg whose payload is the multicast op.
+    alignas(nlmsghdr) char request[NLMSG_SPACE(sizeof(cn_msg) + sizeof(proc_cn_mcast_op))] = {};
+    auto* header = reinterpret_cast<nlmsghdr*>(request);
+    header->nlmsg_len = NLMSG_LENGTH(sizeof(cn_msg) + sizeof(proc_cn_mcast_op));
+    header->nlmsg_type = NLMSG_DONE;
+    header->nlmsg_pid = static_cast<uint32_t>(::getpid());
+
+    auto* message = static_cast<cn_msg*>(NLMSG_DATA(header));
+    message->id.idx = CN_IDX_PROC;
+    message->id.val = CN_VAL_PROC;
+    message->len = sizeof(proc_cn_mcast_op);
+    std::memcpy(message->data, &op, sizeof(op));
+    return ::send(fd, request, header->nlmsg_len, 0) == static_cast<ssize_t>(header->nlmsg_len);
+}
+}  // namespace
+
+ProcConnector::~ProcConnector() {
+    if (fd_ >= 0) {
+        send_listen(fd_, PROC_CN_MCAST_IGNORE);
+        ::close(fd_);
+    }
+}
+
+bool ProcConnector::open(std::string& error_message) {
+    if (fd_ >= 0) {
+        return true;
+    }
+
+    const int fd = ::socket(PF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_CONNECTOR);
+    if (fd < 0) {
+        error_message = std::string("netlink socket failed: ") + std::strerror(errno);
+        return false;
+    }
+
+    const int receive_buffer = kReceiveBufferBytes;
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &receive_buffer, sizeof(receive_buffer));
+
+    sockaddr_nl address{};
+    address.nl_family = AF_NETLINK;
+    address.nl_groups = CN_IDX_PROC;
+    address.nl_pid = 0;
+    if (::bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        error_message = std::string("cannot subscribe to the proc connector: ") + std::strerror(errno);
+        ::close(fd);
+        return false;
+    }
+    if (!send_listen(fd, PROC_CN_MCAST_LISTEN)) {
+        error_message = std::string("proc connector listen request failed: ") + std::strerror(errno);
+        ::close(fd);
+        return false;
+    }
+
+    fd_ = fd;
+    buffer_.resize(kReadBufferBytes);
+    return true;
+}
+
+bool ProcConnector::poll(std::vector<ProcessEvent>& events) {
+    if (fd_ < 0) {
+        return false;
+    }
+
+    AgentTelemetry& telemetry = agent_telemetry();
+    bool complete = true;
+    while (true) {
+        const ssize_t count = ::recv(fd_, buffer_.data(), buffer_.size(), 0);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == ENOBUFS) {
+                // The kernel dropped events; keep reading what is left.
+                complete = false;
+                continue;
+            }
+            break;
+        }
+
+        size_t remaining = static_cast<size_t>(count);
+        for (auto* header = reinterpret_cast<nlmsghdr*>(buffer_.data());
+             NLMSG_OK(header, remaining);
+             header = NLMSG_NEXT(header, remaining)) {
+            if (header->nlmsg_type == NLMSG_ERROR || header->nlmsg_type == NLMSG_NOOP) {
+                continue;
+            }
+            const auto* message = static_cast<const cn_msg*>(NLMSG_DATA(header));
+            if (message->id.idx != CN_IDX_PROC || message->id.val != CN_VAL_PROC) {
+                continue;
+            }
+
+            const auto* event = reinterpret_cast<const proc_event*>(message->data);
+            switch (event->what) {
+                case proc_event::PROC_EVENT_FORK:
+                    if (event->event_data.fork.child_pid == event->event_data.fork.child_tgid) {
+                        events.push_back({ProcessEvent::Kind::started, event->event_data.fork.child_tgid});
+                        telemetry.processes_started.fetch_add(1, std::memory_order_relaxed);
+                    }
+                    break;
+                case proc_event::PROC_EVENT_EXEC:
+                    if (event->event_data.exec.process_pid == event->event_data.exec.process_tgid) {
+                        events.push_back({ProcessEvent::Kind::started, event->event_data.exec.process_tgid});
+                    }
+                    break;
+                case proc_event::PROC_EVENT_EXIT:
+                    if (event->event_data.exit.process_pid == event->event_data.exit.process_tgid) {
+                        events.push_back({ProcessEvent::Kind::exited, event->event_data.exit.process_tgid});
+                        telemetry.processes_exited.fetch_add(1, std::memory_order_relaxed);
+                    }
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+    return complete;
+}
+
+bool ProcConnector::is_open() const {
+    return fd_ >= 0;
+}
+
+void apply_process_events(std::vector<int>& pids, const std::vector<ProcessEvent>& events,
+                          std::vector<uint64_t>& changed, std::vector<int>& merged) {
+    if (events.empty()) {
+        return;
+    }
+
+    // Keys are (pid, position in the batch), so a plain sort orders each
+    // PID's events as the kernel reported them; std::stable_sort would
+    // allocate its merge buffer on every call.
+    changed.clear();
+    for (size_t index = 0; index < events.size(); ++index) {
+        if (events[index].pid > 0) {
+            changed.push_back((static_cast<uint64_t>(events[index].pid) << 32) | index);
+        }
+    }
+    std::sort(changed.begin(), changed.end());
+
+    merged.clear();
+    merged.reserve(pids.size() + changed.size());
+    size_t current = 0;
+    for (size_t key = 0; key < changed.size(); ++key) {
+        const int pid = static_cast<int>(changed[key] >> 32);
+        // Last state per PID wins, so exit-then-reuse within a batch is handled.
+        if (key + 1 < changed.size() && static_cast<int>(changed[key + 1] >> 32) == pid) {
+            continue;
+        }
+        while (current < pids.size() && pids[current] < pid) {
+            merged.push_back(pids[current++]);
+        }
+        if (current < pids.size() && pids[current] == pid) {
+            ++current;
+        }
+        if (events[changed[key] & 0xFFFFFFFFu].kind == ProcessEvent::Kind::started) {
+            merged.push_back(pid);
+        }
+    }
+    merged.insert(merged.end(), pids.begin() + static_cast<std::ptrdiff_t>(current), pids.end());
+    pids.swap(merged);
+}
+
+#endif
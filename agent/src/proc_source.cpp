@@ -0,0 +1,447 @@
+#include "proc_source.h"
+#include "agent_telemetry.h"
+
+#if defined(__linux__)
+
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <utility>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+#include <unistd.h>
+
+namespace {
+constexpr size_t kInitialProcBufferSize = 16 * 1024;
+
+std::string_view next_line(std::string_view& contents) {
+    const size_t newline = contents.find('\n');
+    std::string_view line = contents.substr(0, newline);
+    contents.remove_prefix((newline == std::string_view::npos) ? contents.size() : newline + 1);
+    return line;
+}
+
+void skip_spaces(std::string_view& text) {
+    size_t index = 0;
+    while (index < text.size() && (text[index] == ' ' || text[index] == '\t')) {
+        ++index;
+    }
+    text.remove_prefix(index);
+}
+
+bool consume_uint64(std::string_view& text, uint64_t& value) {
+    skip_spaces(text);
+    const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (error != std::errc()) {
+        return false;
+    }
+    text.remove_prefix(static_cast<size_t>(end - text.data()));
+    return true;
+}
+
+bool consume_int64(std::string_view& text, int64_t& value) {
+    skip_spaces(text);
+    const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (error != std::errc()) {
+        return false;
+    }
+    text.remove_prefix(static_cast<size_t>(end - text.data()));
+    return true;
+}
+
+bool skip_token(std::string_view& text) {
+    skip_spaces(text);
+    if (text.empty()) {
+        return false;
+    }
+    const size_t end = text.find(' ');
+    text.remove_prefix((end == std::string_view::npos) ? text.size() : end);
+    return true;
+}
+
+bool parse_keyed_value(std::string_view line, std::string_view key, uint64_t& value) {
+    if (line.substr(0, key.size()) != key) {
+        return false;
+    }
+    line.remove_prefix(key.size());
+    return consume_uint64(line, value);
+}
+
+// Room for the longest accepted root, a PID and the longest suffix.
+constexpr size_t kPidPathSize = ProcRoot::kMaxPathLength + 40;
+
+// statfs f_type of procfs (PROC_SUPER_MAGIC in <linux/magic.h>).
+constexpr long kProcSuperMagic = 0x9fa0;
+
+bool read_small_file(const char* path, char* buffer, size_t capacity, size_t& length) {
+    length = 0;
+
+    count_proc_syscalls(1);
+    const int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+
+    ssize_t count = 0;
+    do {
+        count_proc_syscalls(1);
+        count = ::read(fd, buffer, capacity);
+    } while (count < 0 && errno == EINTR);
+    count_proc_syscalls(1);
+    ::close(fd);
+
+    if (count <= 0) {
+        return false;
+    }
+
+    length = static_cast<size_t>(count);
+    return true;
+}
+}  // namespace
+
+ProcRoot::ProcRoot(std::string path)
+    : path_(std::move(path)),
+      is_procfs_(false) {
+    while (path_.size() > 1 && path_.back() == '/') {
+        path_.pop_back();
+    }
+    struct statfs filesystem;
+    is_procfs_ = ::statfs(path_.c_str(), &filesystem) == 0 && static_cast<long>(filesystem.f_type) == kProcSuperMagic;
+}
+
+const std::string& ProcRoot::path() const {
+    return path_;
+}
+
+bool ProcRoot::is_procfs() const {
+    return is_procfs_;
+}
+
+std::string ProcRoot::file(std::string_view name) const {
+    std::string joined = path_;
+    joined.push_back('/');
+    joined.append(name);
+    return joined;
+}
+
+bool ProcRoot::format_pid_path(char* out, size_t capacity, int pid, std::string_view suffix) const {
+    // Root, '/', at most 10 PID digits, suffix and the terminator.
+    if (pid <= 0 || path_.size() + 1 + 10 + suffix.size() + 1 > capacity) {
+        return false;
+    }
+    std::memcpy(out, path_.data(), path_.size());
+    char* cursor = out + path_.size();
+    *cursor++ = '/';
+    const auto [pid_end, error] = std::to_chars(cursor, cursor + 10, pid);
+    if (error != std::errc()) {
+        return false;
+    }
+    std::memcpy(pid_end, suffix.data(), suffix.size());
+    pid_end[suffix.size()] = '\0';
+    return true;
+}
+
+const ProcRoot& default_proc_root() {
+    static const ProcRoot root;
+    return root;
+}
+
+ProcFile::ProcFile(std::string path)
+    : path_(std::move(path)) {
+}
+
+ProcFile::~ProcFile() {
+    close_descriptor();
+}
+
+void ProcFile::close_descriptor() {
+    if (fd_ >= 0) {
+        count_proc_syscalls(1);
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+bool ProcFile::read(std::string_view& contents) {
+    contents = std::string_view();
+
+    if (fd_ < 0) {
+        count_proc_syscalls(1);
+        fd_ = ::open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd_ < 0) {
+            return false;
+        }
+    }
+
+    if (buffer_.empty()) {
+        buffer_.resize(kInitialProcBufferSize);
+    }
+
+    size_t used = 0;
+    while (true) {
+        count_proc_syscalls(1);
+        const ssize_t count = ::pread(fd_, buffer_.data() + used, buffer_.size() - used, static_cast<off_t>(used));
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            close_descriptor();
+            return false;
+        }
+
+        used += static_cast<size_t>(count);
+
+        // procfs single_open files hand out everything that fits in one read,
+        // so a short read means end of file and saves a second pread.
+        if (used < buffer_.size()) {
+            break;
+        }
+        buffer_.resize(buffer_.size() * 2);
+    }
+
+    contents = std::string_view(buffer_.data(), used);
+    return true;
+}
+
+bool parse_linux_cpu_line(std::string_view line, LinuxCpuTimes& times) {
+    if (line.substr(0, 3) != "cpu") {
+        return false;
+    }
+
+    size_t label_end = 3;
+    while (label_end < line.size() && std::isdigit(static_cast<unsigned char>(line[label_end]))) {
+        ++label_end;
+    }
+    line.remove_prefix(label_end);
+
+    // user nice system idle iowait irq softirq steal; older kernels omit the tail.
+    uint64_t fields[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+    size_t parsed = 0;
+    while (parsed < 8 && consume_uint64(line, fields[parsed])) {
+        ++parsed;
+    }
+    if (parsed < 4) {
+        return false;
+    }
+
+    times.idle_time = fields[3] + fields[4];
+    times.total_time = fields[0] + fields[1] + fields[2] + fields[3] + fields[4] + fields[5] + fields[6] + fields[7];
+    return true;
+}
+
+bool parse_linux_pid_stat(std::string_view contents, LinuxPidStat& stat) {
+    // comm may itself contain spaces and parentheses, so it spans from the
+    // first '(' to the last ')'.
+    const size_t open_paren = contents.find('(');
+    const size_t close_paren = contents.rfind(')');
+    if (open_paren == std::string_view::npos || close_paren == std::string_view::npos ||
+        close_paren <= open_paren) {
+        return false;
+    }
+
+    stat.name = contents.substr(open_paren + 1, close_paren - open_paren - 1);
+    std::string_view tail = contents.substr(close_paren + 1);
+
+    // Field numbers follow proc(5): the tail starts at field 3 (state).
+    for (int field = 3; field <= 24; ++field) {
+        bool ok = true;
+        switch (field) {
+            case 14:
+                ok = consume_uint64(tail, stat.utime_ticks);
+                break;
+            case 15:
+                ok = consume_uint64(tail, stat.stime_ticks);
+                break;
+            case 20: {
+                int64_t threads = 0;
+                ok = consume_int64(tail, threads);
+                stat.num_threads = (threads > 0) ? static_cast<int>(threads) : 0;
+                break;
+            }
+            case 22:
+                ok = consume_uint64(tail, stat.start_time_ticks);
+                break;
+            case 24: {
+                // rss is printed as a signed long.
+                int64_t rss = 0;
+                ok = consume_int64(tail, rss);
+                stat.rss_pages = (rss > 0) ? static_cast<uint64_t>(rss) : 0;
+                break;
+            }
+            default:
+                ok = skip_token(tail);
+                break;
+        }
+        if (!ok) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool read_linux_pid_stat(int pid, char* buffer, size_t capacity, LinuxPidStat& stat, const ProcRoot& root) {
+    char path[kPidPathSize];
+    if (!root.format_pid_path(path, sizeof(path), pid, "/stat")) {
+        return false;
+    }
+
+    size_t length = 0;
+    if (!read_small_file(path, buffer, capacity, length)) {
+        return false;
+    }
+
+    return parse_linux_pid_stat(std::string_view(buffer, length), stat);
+}
+
+bool read_linux_pid_fd_count(int pid, int& fd_count, const ProcRoot& root) {
+    fd_count = 0;
+
+    char path[kPidPathSize];
+    if (!root.format_pid_path(path, sizeof(path), pid, "/fd")) {
+        return false;
+    }
+
+    // Since Linux 6.2 the size of /proc/[pid]/fd is its entry count, which
+    // saves walking the directory. Older kernels report 0 and fall through,
+    // and so does a copied tree, where the size is the directory's own.
+    if (root.is_procfs()) {
+        struct stat fd_dir_stat;
+        count_proc_syscalls(1);
+        if (::stat(path, &fd_dir_stat) != 0) {
+            return false;
+        }
+        if (fd_dir_stat.st_size > 0) {
+            fd_count = static_cast<int>(fd_dir_stat.st_size);
+            return true;
+        }
+    }
+
+    // opendir and closedir; the getdents calls behind readdir are not counted.
+    count_proc_syscalls(2);
+    DIR* fd_dir = ::opendir(path);
+    if (fd_dir == nullptr) {
+        return false;
+    }
+
+    int count = 0;
+    while (const dirent* entry = ::readdir(fd_dir)) {
+        if (entry->d_name[0] != '.') {
+            ++count;
+        }
+    }
+    ::closedir(fd_dir);
+
+    fd_count = count;
+    return true;
+}
+
+bool read_linux_pid_io(int pid, uint64_t& read_bytes, uint64_t& write_bytes, const ProcRoot& root) {
+    read_bytes = 0;
+    write_bytes = 0;
+
+    char path[kPidPathSize];
+    if (!root.format_pid_path(path, sizeof(path), pid, "/io")) {
+        return false;
+    }
+
+    char buffer[512];
+    size_t length = 0;
+    if (!read_small_file(path, buffer, sizeof(buffer), length)) {
+        return false;
+    }
+
+    std::string_view contents(buffer, length);
+    while (!contents.empty()) {
+        const std::string_view line = next_line(contents);
+        if (parse_keyed_value(line, "read_bytes:", read_bytes)) {
+            continue;
+        }
+        parse_keyed_value(line, "write_bytes:", write_bytes);
+    }
+
+    return true;
+}
+
+LinuxProcSource::LinuxProcSource(const ProcRoot& root)
+    : stat_file_(root.file("stat")),
+      meminfo_file_(root.file("meminfo")) {
+}
+
+bool LinuxProcSource::refresh_cpu_times() {
+    has_cpu_times_ = false;
+    per_core_cpu_times_.clear();
+
+    std::string_view contents;
+    if (!stat_file_.read(contents)) {
+        return false;
+    }
+
+    bool has_total = false;
+    while (!contents.empty()) {
+        const std::string_view line = next_line(contents);
+        if (line.substr(0, 3) != "cpu") {
+            // cpu lines are contiguous at the top of the file.
+            if (has_total) {
+                break;
+            }
+            continue;
+        }
+
+        LinuxCpuTimes times{0, 0};
+        if (!parse_linux_cpu_line(line, times)) {
+            continue;
+        }
+
+        if (line.size() > 3 && std::isdigit(static_cast<unsigned char>(line[3]))) {
+            per_core_cpu_times_.push_back(times);
+        } else {
+            total_cpu_times_ = times;
+            has_total = true;
+        }
+    }
+
+    has_cpu_times_ = has_total;
+    return has_cpu_times_;
+}
+
+bool LinuxProcSource::has_cpu_times() const {
+    return has_cpu_times_;
+}
+
+const LinuxCpuTimes& LinuxProcSource::total_cpu_times() const {
+    return total_cpu_times_;
+}
+
+const std::vector<LinuxCpuTimes>& LinuxProcSource::per_core_cpu_times() const {
+    return per_core_cpu_times_;
+}
+
+bool LinuxProcSource::read_memory_info(uint64_t& total_kb, uint64_t& available_kb) {
+    total_kb = 0;
+    available_kb = 0;
+
+    std::string_view contents;
+    if (!meminfo_file_.read(contents)) {
+        return false;
+    }
+
+    bool has_total = false;
+    bool has_available = false;
+    while (!contents.empty() && !(has_total && has_available)) {
+        const std::string_view line = next_line(contents);
+        if (!has_total && parse_keyed_value(line, "MemTotal:", total_kb)) {
+            has_total = true;
+        } else if (!has_available && parse_keyed_value(line, "MemAvailable:", available_kb)) {
+            has_available = true;
+        }
+    }
+
+    return true;
+}
+
+#endif
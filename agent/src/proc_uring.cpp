@@ -0,0 +1,212 @@
+#include "proc_uring.h"
+#include "agent_telemetry.h"
+
+#if defined(__linux__)
+
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+#if defined(METRICS_AGENT_HAVE_LIBURING)
+#include <fcntl.h>
+#include <liburing.h>
+#endif
+
+namespace {
+// Room for the longest accepted root, a PID and "/stat".
+constexpr size_t kUringPathSize = ProcRoot::kMaxPathLength + 40;
+
+#if defined(METRICS_AGENT_HAVE_LIBURING)
+constexpr unsigned kOpsPerPid = 3;
+
+enum UringOp : uint64_t {
+    kOpOpen = 0,
+    kOpRead = 1,
+    kOpClose = 2
+};
+
+uint64_t op_data(size_t index, UringOp op) {
+    return (static_cast<uint64_t>(index) << 2) | op;
+}
+#endif
+}  // namespace
+
+#if defined(METRICS_AGENT_HAVE_LIBURING)
+struct ProcUringReader::Ring {
+    io_uring ring{};
+    bool initialized = false;
+    std::array<std::array<char, kUringPathSize>, kBatchSize> paths{};
+    std::array<std::array<char, kLinuxPidStatBufferSize>, kBatchSize> buffers{};
+    std::array<io_uring_cqe*, kBatchSize * kOpsPerPid> completions{};
+
+    ~Ring() {
+        if (initialized) {
+            io_uring_queue_exit(&ring);
+        }
+    }
+};
+#else
+struct ProcUringReader::Ring {};
+#endif
+
+ProcUringReader::ProcUringReader() = default;
+
+ProcUringReader::~ProcUringReader() = default;
+
+bool ProcUringReader::open(const ProcRoot& root, std::string& error_message) {
+#if defined(METRICS_AGENT_HAVE_LIBURING)
+    auto ring = std::make_unique<Ring>();
+    const int result = io_uring_queue_init(kBatchSize * kOpsPerPid, &ring->ring, 0);
+    if (result < 0) {
+        error_message = std::string("io_uring_queue_init failed: ") + std::strerror(-result);
+        return false;
+    }
+    ring->initialized = true;
+
+    // A sparse table: one direct descriptor slot per PID of a batch.
+    std::array<int, kBatchSize> slots;
+    slots.fill(-1);
+    const int registered = io_uring_register_files(&ring->ring, slots.data(), kBatchSize);
+    if (registered < 0) {
+        error_message = std::string("io_uring_register_files failed: ") + std::strerror(-registered);
+        return false;
+    }
+
+    ring_ = std::move(ring);
+    root_ = &root;
+
+    // <root>/stat always exists (startup checks it); reading it through the
+    // ring proves the kernel supports direct descriptors.
+    const std::string probe = root.file("stat");
+    if (probe.size() >= kUringPathSize) {
+        error_message = "procfs root path too long";
+        ring_.reset();
+        return false;
+    }
+    std::memcpy(ring_->paths[0].data(), probe.c_str(), probe.size() + 1);
+
+    io_uring_sqe* open_sqe = io_uring_get_sqe(&ring_->ring);
+    io_uring_prep_openat_direct(open_sqe, AT_FDCWD, ring_->paths[0].data(), O_RDONLY, 0, 0);
+    open_sqe->flags |= IOSQE_IO_HARDLINK;
+    io_uring_sqe_set_data64(open_sqe, op_data(0, kOpOpen));
+    io_uring_sqe* read_sqe = io_uring_get_sqe(&ring_->ring);
+    io_uring_prep_read(read_sqe, 0, ring_->buffers[0].data(), kLinuxPidStatBufferSize, 0);
+    read_sqe->flags |= IOSQE_FIXED_FILE | IOSQE_IO_HARDLINK;
+    io_uring_sqe_set_data64(read_sqe, op_data(0, kOpRead));
+    io_uring_sqe* close_sqe = io_uring_get_sqe(&ring_->ring);
+    io_uring_prep_close_direct(close_sqe, 0);
+    io_uring_sqe_set_data64(close_sqe, op_data(0, kOpClose));
+
+    int read_result = -EIO;
+    const int submitted = io_uring_submit_and_wait(&ring_->ring, kOpsPerPid);
+    if (submitted >= 0) {
+        const unsigned reaped = io_uring_peek_batch_cqe(&ring_->ring, ring_->completions.data(), kOpsPerPid);
+        for (unsigned index = 0; index < reaped; ++index) {
+            if ((io_uring_cqe_get_data64(ring_->completions[index]) & 3) == kOpRead) {
+                read_result = ring_->completions[index]->res;
+            }
+        }
+        io_uring_cq_advance(&ring_->ring, reaped);
+    }
+    if (read_result <= 0) {
+        error_message = std::string("io_uring cannot read ") + probe + ": " +
+            std::strerror((read_result < 0) ? -read_result : EIO);
+        ring_.reset();
+        return false;
+    }
+    return true;
+#else
+    (void)root;
+    error_message = "built without liburing";
+    return false;
+#endif
+}
+
+bool ProcUringReader::read_stats(const int* pids, size_t count, size_t* lengths) {
+#if defined(METRICS_AGENT_HAVE_LIBURING)
+    if (!ring_ || count > kBatchSize) {
+        return false;
+    }
+
+    size_t queued = 0;
+    for (size_t index = 0; index < count; ++index) {
+        lengths[index] = 0;
+        char* path = ring_->paths[index].data();
+        if (!root_->format_pid_path(path, kUringPathSize, pids[index], "/stat")) {
+            continue;
+        }
+
+        // Hard links keep the chain going when a step fails, so the slot is
+        // closed even after a short or failed read. Direct descriptors never
+        // reach the fd table, so the kernel rejects O_CLOEXEC for them.
+        const unsigned slot = static_cast<unsigned>(index);
+        io_uring_sqe* open_sqe = io_uring_get_sqe(&ring_->ring);
+        io_uring_prep_openat_direct(open_sqe, AT_FDCWD, path, O_RDONLY, 0, slot);
+        open_sqe->flags |= IOSQE_IO_HARDLINK;
+        io_uring_sqe_set_data64(open_sqe, op_data(index, kOpOpen));
+
+        io_uring_sqe* read_sqe = io_uring_get_sqe(&ring_->ring);
+        io_uring_prep_read(read_sqe, static_cast<int>(slot), ring_->buffers[index].data(), kLinuxPidStatBufferSize, 0);
+        read_sqe->flags |= IOSQE_FIXED_FILE | IOSQE_IO_HARDLINK;
+        io_uring_sqe_set_data64(read_sqe, op_data(index, kOpRead));
+
+        io_uring_sqe* close_sqe = io_uring_get_sqe(&ring_->ring);
+        io_uring_prep_close_direct(close_sqe, slot);
+        io_uring_sqe_set_data64(close_sqe, op_data(index, kOpClose));
+        ++queued;
+    }
+    if (queued == 0) {
+        return true;
+    }
+
+    // A failed wait may leave completions in the ring that would be taken
+    // for the next batch's, so the reader is dropped instead.
+    count_proc_syscalls(1);
+    const unsigned expected = static_cast<unsigned>(queued) * kOpsPerPid;
+    if (io_uring_submit_and_wait(&ring_->ring, expected) < 0) {
+        ring_.reset();
+        return false;
+    }
+
+    unsigned reaped_total = 0;
+    while (reaped_total < expected) {
+        const unsigned reaped = io_uring_peek_batch_cqe(&ring_->ring, ring_->completions.data(), expected - reaped_total);
+        if (reaped == 0) {
+            // submit_and_wait returned early (a signal); wait for the rest.
+            count_proc_syscalls(1);
+            if (io_uring_submit_and_wait(&ring_->ring, 1) < 0) {
+                ring_.reset();
+                return false;
+            }
+            continue;
+        }
+        for (unsigned index = 0; index < reaped; ++index) {
+            const io_uring_cqe* cqe = ring_->completions[index];
+            const uint64_t data = io_uring_cqe_get_data64(cqe);
+            if ((data & 3) == kOpRead && cqe->res > 0) {
+                lengths[data >> 2] = static_cast<size_t>(cqe->res);
+            }
+        }
+        io_uring_cq_advance(&ring_->ring, reaped);
+        reaped_total += reaped;
+    }
+    return true;
+#else
+    (void)pids;
+    (void)count;
+    (void)lengths;
+    return false;
+#endif
+}
+
+const char* ProcUringReader::buffer(size_t index) const {
+#if defined(METRICS_AGENT_HAVE_LIBURING)
+    return ring_->buffers[index].data();
+#else
+    (void)index;
+    return nullptr;
+#endif
+}
+
+#endif
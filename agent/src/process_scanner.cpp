@@ -0,0 +1,259 @@
+#include "process_scanner.h"
+#include "agent_telemetry.h"
+#include "proc_connector.h"
+#include "proc_uring.h"
+
+#if defined(__linux__)
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstring>
+#include <utility>
+
+#include <dirent.h>
+
+namespace {
+// PIDs handed to a worker per claim; large enough to amortize the atomic,
+// small enough to balance processes whose stat reads are slow.
+constexpr size_t kScanBatchSize = 64;
+
+// Below this many PIDs waking a worker costs more than it saves.
+constexpr size_t kMinPidsPerWorker = 256;
+
+bool parse_pid_name(const char* name, int& pid) {
+    const char* end = name + std::strlen(name);
+    const auto [parsed_end, error] = std::from_chars(name, end, pid);
+    return error == std::errc() && parsed_end == end && pid > 0;
+}
+
+static_assert(kScanBatchSize == ProcUringReader::kBatchSize, "a claimed batch is one io_uring submission");
+
+void store_row(ProcessScanBuffer& buffer, size_t row, const LinuxPidStat& stat, bool include_threads) {
+    buffer.cpu_times[row] = stat.utime_ticks + stat.stime_ticks;
+    buffer.start_times[row] = stat.start_time_ticks;
+    buffer.rss_pages[row] = stat.rss_pages;
+    buffer.thread_counts[row] = include_threads ? stat.num_threads : 0;
+    buffer.set_name(row, stat.name);
+    buffer.valid[row] = 1;
+}
+
+void scan_batches(ProcessScanBuffer& buffer, std::atomic<size_t>& cursor, bool include_threads, const ProcRoot& root, ProcUringReader* reader) {
+    const size_t rows = buffer.size();
+    while (true) {
+        const size_t begin = cursor.fetch_add(kScanBatchSize, std::memory_order_relaxed);
+        if (begin >= rows) {
+            break;
+        }
+        const size_t end = (begin + kScanBatchSize < rows) ? begin + kScanBatchSize : rows;
+
+        size_t lengths[kScanBatchSize];
+        if (reader != nullptr && reader->read_stats(&buffer.pids[begin], end - begin, lengths)) {
+            for (size_t row = begin; row < end; ++row) {
+                LinuxPidStat stat;
+                const size_t length = lengths[row - begin];
+                if (length > 0 && parse_linux_pid_stat(std::string_view(reader->buffer(row - begin), length), stat)) {
+                    store_row(buffer, row, stat, include_threads);
+                }
+            }
+            continue;
+        }
+
+        for (size_t row = begin; row < end; ++row) {
+            char stat_buffer[kLinuxPidStatBufferSize];
+            LinuxPidStat stat;
+            if (read_linux_pid_stat(buffer.pids[row], stat_buffer, sizeof(stat_buffer), stat, root)) {
+                store_row(buffer, row, stat, include_threads);
+            }
+        }
+    }
+}
+}  // namespace
+
+LinuxProcessScanner::LinuxProcessScanner(size_t worker_count, ProcRoot root)
+    : worker_count_((worker_count == 0) ? 1 : worker_count),
+      root_(std::move(root)) {
+}
+
+LinuxProcessScanner::~LinuxProcessScanner() {
+    {
+        std::lock_guard<std::mutex> lock(workers_mutex_);
+        stopping_ = true;
+    }
+    scan_started_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+bool LinuxProcessScanner::enable_process_events(std::string& error_message) {
+    auto connector = std::make_unique<ProcConnector>();
+    if (!connector->open(error_message)) {
+        return false;
+    }
+    connector_ = std::move(connector);
+    needs_listing_ = true;
+    return true;
+}
+
+bool LinuxProcessScanner::process_events_enabled() const {
+    return connector_ != nullptr;
+}
+
+bool LinuxProcessScanner::enable_io_uring(std::string& error_message) {
+    std::vector<std::unique_ptr<ProcUringReader>> readers;
+    readers.reserve(worker_count_);
+    for (size_t worker = 0; worker < worker_count_; ++worker) {
+        auto reader = std::make_unique<ProcUringReader>();
+        if (!reader->open(root_, error_message)) {
+            return false;
+        }
+        readers.push_back(std::move(reader));
+    }
+    uring_readers_ = std::move(readers);
+    return true;
+}
+
+bool LinuxProcessScanner::io_uring_enabled() const {
+    return !uring_readers_.empty();
+}
+
+size_t LinuxProcessScanner::worker_count() const {
+    return worker_count_;
+}
+
+const ProcRoot& LinuxProcessScanner::root() const {
+    return root_;
+}
+
+ProcUringReader* LinuxProcessScanner::reader_for(size_t worker) const {
+    return uring_readers_.empty() ? nullptr : uring_readers_[worker].get();
+}
+
+void LinuxProcessScanner::start_workers() {
+    workers_.reserve(worker_count_ - 1);
+    for (size_t worker = 1; worker < worker_count_; ++worker) {
+        workers_.emplace_back(&LinuxProcessScanner::run_worker, this, worker);
+    }
+}
+
+void LinuxProcessScanner::run_worker(size_t worker) {
+    uint64_t seen_generation = 0;
+    std::unique_lock<std::mutex> lock(workers_mutex_);
+    while (true) {
+        scan_started_.wait(lock, [&]() { return stopping_ || scan_generation_ != seen_generation; });
+        if (stopping_) {
+            return;
+        }
+        seen_generation = scan_generation_;
+        if (worker >= scan_workers_) {
+            continue;
+        }
+
+        const bool include_threads = include_threads_;
+        lock.unlock();
+        scan_batches(buffer_, cursor_, include_threads, root_, reader_for(worker));
+        lock.lock();
+        if (--busy_workers_ == 0) {
+            scan_finished_.notify_one();
+        }
+    }
+}
+
+bool LinuxProcessScanner::list_pids() {
+    pids_.clear();
+    agent_telemetry().proc_listings.fetch_add(1, std::memory_order_relaxed);
+
+    count_proc_syscalls(2);
+    DIR* proc_dir = ::opendir(root_.path().c_str());
+    if (proc_dir == nullptr) {
+        return false;
+    }
+
+    while (const dirent* entry = ::readdir(proc_dir)) {
+        int pid = 0;
+        if (parse_pid_name(entry->d_name, pid)) {
+            pids_.push_back(pid);
+        }
+    }
+    ::closedir(proc_dir);
+
+    // readdir on procfs normally yields PIDs in ascending order already.
+    if (!std::is_sorted(pids_.begin(), pids_.end())) {
+        std::sort(pids_.begin(), pids_.end());
+    }
+    return true;
+}
+
+bool LinuxProcessScanner::update_pids() {
+    if (!connector_) {
+        return list_pids();
+    }
+
+    // The subscription predates the listing, so events that raced with it
+    // are applied on the next scan at the latest.
+    events_.clear();
+    const bool complete = connector_->poll(events_);
+    if (!complete || needs_listing_) {
+        needs_listing_ = !list_pids();
+        return !needs_listing_;
+    }
+    apply_process_events(pids_, events_, changed_pids_, merged_pids_);
+    return true;
+}
+
+const ProcessScanBuffer& LinuxProcessScanner::scan(const MetricsSelection& selection) {
+    if (!update_pids()) {
+        buffer_.resize(0);
+        return buffer_;
+    }
+
+    buffer_.resize(pids_.size());
+    std::copy(pids_.begin(), pids_.end(), buffer_.pids.begin());
+
+    size_t workers = worker_count_;
+    const size_t useful_workers = pids_.size() / kMinPidsPerWorker;
+    if (workers > useful_workers) {
+        workers = (useful_workers == 0) ? 1 : useful_workers;
+    }
+
+    cursor_.store(0, std::memory_order_relaxed);
+    const bool include_threads = selection.process_threads;
+
+    if (workers > 1) {
+        if (workers_.empty()) {
+            start_workers();
+        }
+        {
+            std::lock_guard<std::mutex> lock(workers_mutex_);
+            include_threads_ = include_threads;
+            scan_workers_ = workers;
+            busy_workers_ = workers - 1;
+            ++scan_generation_;
+        }
+        scan_started_.notify_all();
+    }
+
+    scan_batches(buffer_, cursor_, include_threads, root_, reader_for(0));
+
+    if (workers > 1) {
+        std::unique_lock<std::mutex> lock(workers_mutex_);
+        scan_finished_.wait(lock, [this]() { return busy_workers_ == 0; });
+    }
+
+    // A failed read means the process is gone (or its exit event was
+    // missed); forget it so later scans do not retry it.
+    if (connector_) {
+        size_t kept = 0;
+        for (size_t row = 0; row < buffer_.size(); ++row) {
+            if (buffer_.valid[row]) {
+                pids_[kept++] = buffer_.pids[row];
+            }
+        }
+        pids_.resize(kept);
+    }
+
+    return buffer_;
+}
+
+#endif
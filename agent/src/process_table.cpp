@@ -0,0 +1,179 @@
+#include "process_table.h"
+
+#include <cstring>
+#include <utility>
+
+namespace {
+// Compact the name pool once it holds this many more names than live rows.
+constexpr size_t kNamePoolSlack = 1024;
+}  // namespace
+
+void ProcessScanBuffer::resize(size_t rows) {
+    pids.resize(rows);
+    cpu_times.resize(rows);
+    start_times.resize(rows);
+    rss_pages.resize(rows);
+    thread_counts.resize(rows);
+    valid.assign(rows, 0);
+    name_lengths.resize(rows);
+    names.resize(rows * kNameSlotSize);
+}
+
+size_t ProcessScanBuffer::size() const {
+    return pids.size();
+}
+
+void ProcessScanBuffer::set_name(size_t row, std::string_view name) {
+    const size_t length = (name.size() < kNameSlotSize) ? name.size() : kNameSlotSize;
+    std::memcpy(names.data() + row * kNameSlotSize, name.data(), length);
+    name_lengths[row] = static_cast<uint8_t>(length);
+}
+
+std::string_view ProcessScanBuffer::name(size_t row) const {
+    return std::string_view(names.data() + row * kNameSlotSize, name_lengths[row]);
+}
+
+uint32_t ProcessNamePool::intern(std::string_view name) {
+    const auto [it, inserted] = index_.try_emplace(std::string(name), static_cast<uint32_t>(names_by_id_.size()));
+    if (inserted) {
+        names_by_id_.push_back(&it->first);
+    }
+    return it->second;
+}
+
+std::string_view ProcessNamePool::view(uint32_t id) const {
+    return *names_by_id_[id];
+}
+
+size_t ProcessNamePool::size() const {
+    return names_by_id_.size();
+}
+
+void ProcessNamePool::clear() {
+    index_.clear();
+    names_by_id_.clear();
+}
+
+void ProcessTable::Columns::clear() {
+    pids.clear();
+    cpu_times.clear();
+    start_times.clear();
+    previous_cpu_times.clear();
+    cpu_deltas.clear();
+    rss_pages.clear();
+    thread_counts.clear();
+    name_ids.clear();
+}
+
+void ProcessTable::Columns::reserve(size_t rows) {
+    pids.reserve(rows);
+    cpu_times.reserve(rows);
+    start_times.reserve(rows);
+    previous_cpu_times.reserve(rows);
+    cpu_deltas.reserve(rows);
+    rss_pages.reserve(rows);
+    thread_counts.reserve(rows);
+    name_ids.reserve(rows);
+}
+
+void ProcessTable::update(const ProcessScanBuffer& scan) {
+    next_.clear();
+    next_.reserve(scan.size());
+
+    // Linear merge of two ascending PID columns replaces a hash join.
+    const size_t previous_rows = current_.pids.size();
+    size_t previous = 0;
+    for (size_t row = 0; row < scan.size(); ++row) {
+        if (!scan.valid[row]) {
+            continue;
+        }
+
+        const int pid = scan.pids[row];
+        while (previous < previous_rows && current_.pids[previous] < pid) {
+            ++previous;
+        }
+
+        const bool matched = previous < previous_rows &&
+                             current_.pids[previous] == pid &&
+                             current_.start_times[previous] == scan.start_times[row];
+
+        const std::string_view name = scan.name(row);
+        uint32_t name_id = 0;
+        if (matched && names_.view(current_.name_ids[previous]) == name) {
+            name_id = current_.name_ids[previous];
+        } else {
+            name_id = names_.intern(name);
+        }
+
+        next_.pids.push_back(pid);
+        next_.cpu_times.push_back(scan.cpu_times[row]);
+        next_.start_times.push_back(scan.start_times[row]);
+        // A new or reused PID is its own baseline, which yields a zero delta.
+        next_.previous_cpu_times.push_back(matched ? current_.cpu_times[previous] : scan.cpu_times[row]);
+        next_.rss_pages.push_back(scan.rss_pages[row]);
+        next_.thread_counts.push_back(scan.thread_counts[row]);
+        next_.name_ids.push_back(name_id);
+    }
+
+    // Branch-free delta pass over contiguous columns, left for the compiler to vectorize.
+    const size_t rows = next_.pids.size();
+    next_.cpu_deltas.resize(rows);
+    const uint64_t* current_ticks = next_.cpu_times.data();
+    const uint64_t* previous_ticks = next_.previous_cpu_times.data();
+    uint64_t* deltas = next_.cpu_deltas.data();
+    for (size_t row = 0; row < rows; ++row) {
+        const uint64_t current_value = current_ticks[row];
+        const uint64_t previous_value = previous_ticks[row];
+        deltas[row] = (current_value >= previous_value) ? (current_value - previous_value) : 0;
+    }
+
+    std::swap(current_, next_);
+
+    if (names_.size() > rows + kNamePoolSlack) {
+        compact_names();
+    }
+}
+
+void ProcessTable::compact_names() {
+    ProcessNamePool compacted;
+    for (auto& name_id : current_.name_ids) {
+        name_id = compacted.intern(names_.view(name_id));
+    }
+    names_ = std::move(compacted);
+}
+
+size_t ProcessTable::size() const {
+    return current_.pids.size();
+}
+
+int ProcessTable::pid(size_t row) const {
+    return current_.pids[row];
+}
+
+uint64_t ProcessTable::cpu_ticks_delta(size_t row) const {
+    return current_.cpu_deltas[row];
+}
+
+uint64_t ProcessTable::rss_pages(size_t row) const {
+    return current_.rss_pages[row];
+}
+
+int ProcessTable::thread_count(size_t row) const {
+    return current_.thread_counts[row];
+}
+
+std::string_view ProcessTable::name(size_t row) const {
+    return names_.view(current_.name_ids[row]);
+}
+
+const std::vector<uint64_t>& ProcessTable::cpu_ticks_deltas() const {
+    return current_.cpu_deltas;
+}
+
+const std::vector<uint64_t>& ProcessTable::rss_pages_column() const {
+    return current_.rss_pages;
+}
+
+size_t ProcessTable::interned_name_count() const {
+    return names_.size();
+}
@@ -0,0 +1,92 @@
+#include "retry_policy.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+uint32_t resolve_seed(uint32_t seed) {
+    if (seed != 0) {
+        return seed;
+    }
+    std::random_device device;
+    return device();
+}
+}  // namespace
+
+bool is_retryable_status(long http_status) {
+    return http_status == 0 || http_status == 429 || http_status == 502 ||
+           http_status == 503 || http_status == 504;
+}
+
+JitteredBackoff::JitteredBackoff(std::chrono::milliseconds base, std::chrono::milliseconds max, uint32_t seed)
+    : base_(std::max(base, std::chrono::milliseconds(1))),
+      max_(std::max(max, base_)),
+      random_(resolve_seed(seed)) {}
+
+std::chrono::milliseconds JitteredBackoff::delay(size_t attempt) {
+    // Double until the cap; comparing against max/2 avoids overflowing.
+    std::chrono::milliseconds ceiling = base_;
+    for (size_t i = 0; i < attempt && ceiling < max_; ++i) {
+        ceiling = ceiling > max_ / 2 ? max_ : ceiling * 2;
+    }
+    ceiling = std::min(ceiling, max_);
+
+    const auto half = ceiling.count() / 2;
+    std::uniform_int_distribution<std::chrono::milliseconds::rep> jitter(0, ceiling.count() - half);
+    return std::chrono::milliseconds(half + jitter(random_));
+}
+
+CircuitBreaker::CircuitBreaker(const RetryPolicy& policy, uint32_t seed)
+    : failure_threshold_(std::max<size_t>(policy.breaker_failure_threshold, 1)),
+      cool_down_(policy.breaker_open, policy.breaker_max_open, seed) {}
+
+bool CircuitBreaker::allow(std::chrono::steady_clock::time_point now) {
+    if (state_ == CircuitState::open) {
+        if (now < retry_at_) {
+            return false;
+        }
+        state_ = CircuitState::half_open;
+    }
+    return true;
+}
+
+void CircuitBreaker::record_success() {
+    state_ = CircuitState::closed;
+    consecutive_failures_ = 0;
+    consecutive_opens_ = 0;
+}
+
+void CircuitBreaker::record_failure(std::chrono::steady_clock::time_point now, std::chrono::milliseconds retry_after) {
+    if (state_ == CircuitState::half_open) {
+        open(now, retry_after);
+        return;
+    }
+
+    ++consecutive_failures_;
+    if (consecutive_failures_ >= failure_threshold_ || retry_after > std::chrono::milliseconds::zero()) {
+        open(now, retry_after);
+    }
+}
+
+void CircuitBreaker::open(std::chrono::steady_clock::time_point now, std::chrono::milliseconds retry_after) {
+    const std::chrono::milliseconds cool_down = std::max(cool_down_.delay(consecutive_opens_), retry_after);
+    state_ = CircuitState::open;
+    retry_at_ = now + cool_down;
+    consecutive_failures_ = 0;
+    if (consecutive_opens_ < std::numeric_limits<size_t>::max()) {
+        ++consecutive_opens_;
+    }
+    ++open_count_;
+}
+
+CircuitState CircuitBreaker::state() const {
+    return state_;
+}
+
+std::chrono::steady_clock::time_point CircuitBreaker::retry_at() const {
+    return retry_at_;
+}
+
+uint64_t CircuitBreaker::open_count() const {
+    return open_count_;
+}
@@ -0,0 +1,373 @@
+#include "snapshot_spool.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#if !defined(_WIN32)
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+constexpr char kSegmentMagic[4] = {'M', 'S', 'P', 'L'};
+constexpr uint32_t kSegmentVersion = 1;
+constexpr size_t kSegmentHeaderSize = 8;
+constexpr size_t kRecordHeaderSize = 12; // length, crc32, flags
+constexpr uint32_t kRecordAcked = 1;
+constexpr size_t kMinSegmentBytes = 4096;
+
+uint32_t load_u32(const unsigned char* data) {
+    uint32_t value = 0;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+void store_u32(unsigned char* data, uint32_t value) {
+    std::memcpy(data, &value, sizeof(value));
+}
+
+/**
+ * CRC-32 (IEEE 802.3, reflected), table built on first use.
+ */
+uint32_t crc32(const unsigned char* data, size_t size) {
+    static const auto table = []() {
+        std::vector<uint32_t> entries(256);
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t value = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                value = (value & 1) ? (0xEDB88320u ^ (value >> 1)) : (value >> 1);
+            }
+            entries[i] = value;
+        }
+        return entries;
+    }();
+
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; ++i) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+bool parse_segment_name(const char* name, uint64_t& id) {
+    unsigned long long value = 0;
+    int consumed = 0;
+    if (std::sscanf(name, "spool-%20llu.seg%n", &value, &consumed) != 1 ||
+        name[consumed] != '\0' || consumed != 30) {
+        return false;
+    }
+    id = value;
+    return true;
+}
+}  // namespace
+
+SnapshotSpool::SnapshotSpool(const SpoolOptions& options)
+    : options_(options) {
+    options_.segment_bytes = std::max(options_.segment_bytes, kMinSegmentBytes);
+}
+
+SnapshotSpool::~SnapshotSpool() {
+    for (auto& segment : segments_) {
+        close_segment(segment, false);
+    }
+}
+
+bool SnapshotSpool::open(std::string& error_message) {
+#if defined(_WIN32)
+    error_message = "spool is only supported on POSIX systems";
+    return false;
+#else
+    if (opened_) {
+        return true;
+    }
+    if (options_.directory.empty()) {
+        error_message = "spool directory is empty";
+        return false;
+    }
+    if (::mkdir(options_.directory.c_str(), 0750) != 0 && errno != EEXIST) {
+        error_message = "cannot create " + options_.directory + ": " + std::strerror(errno);
+        return false;
+    }
+
+    DIR* directory = ::opendir(options_.directory.c_str());
+    if (directory == nullptr) {
+        error_message = "cannot open " + options_.directory + ": " + std::strerror(errno);
+        return false;
+    }
+    std::vector<uint64_t> ids;
+    while (const dirent* entry = ::readdir(directory)) {
+        uint64_t id = 0;
+        if (parse_segment_name(entry->d_name, id)) {
+            ids.push_back(id);
+        }
+    }
+    ::closedir(directory);
+    std::sort(ids.begin(), ids.end());
+
+    for (uint64_t id : ids) {
+        Segment segment;
+        if (!open_segment(id, false, segment, error_message)) {
+            return false;
+        }
+        recover_segment(segment);
+        next_id_ = id + 1;
+        if (segment.pending == 0) {
+            close_segment(segment, true);
+            continue;
+        }
+        pending_ += segment.pending;
+        segments_.push_back(segment);
+    }
+
+    opened_ = true;
+    return true;
+#endif
+}
+
+size_t SnapshotSpool::append(const SystemMetrics* snapshots, size_t count) {
+    if (!opened_) {
+        return 0;
+    }
+
+    size_t written = 0;
+    for (size_t index = 0; index < count; ++index) {
+        encoder_.encode(&snapshots[index], 1, record_);
+        const size_t record_size = kRecordHeaderSize + record_.size();
+        if (kSegmentHeaderSize + record_size > options_.segment_bytes) {
+            continue;
+        }
+        if ((!active_ || segments_.back().write_offset + record_size > segments_.back().size) &&
+            !roll_segment()) {
+            break;
+        }
+
+        Segment& segment = segments_.back();
+        unsigned char* record = segment.data + segment.write_offset;
+        const auto* payload = reinterpret_cast<const unsigned char*>(record_.data());
+        store_u32(record + 4, crc32(payload, record_.size()));
+        store_u32(record + 8, 0);
+        std::memcpy(record + kRecordHeaderSize, payload, record_.size());
+        // The length goes in last: a zero length ends the segment, so a
+        // record interrupted before this store is never read back.
+        store_u32(record, static_cast<uint32_t>(record_.size()));
+
+        segment.write_offset += record_size;
+        ++segment.pending;
+        ++pending_;
+        ++written;
+    }
+
+#if !defined(_WIN32)
+    if (written > 0) {
+        const Segment& segment = segments_.back();
+        ::msync(segment.data, segment.write_offset, MS_ASYNC);
+    }
+#endif
+    return written;
+}
+
+size_t SnapshotSpool::peek(std::vector<SystemMetrics>& out, size_t max_count) {
+    out.clear();
+    for (const auto& segment : segments_) {
+        size_t offset = segment.read_offset;
+        while (out.size() < max_count && offset < segment.write_offset) {
+            const size_t length = load_u32(segment.data + offset);
+            const std::string_view payload(
+                reinterpret_cast<const char*>(segment.data + offset + kRecordHeaderSize), length);
+            if (!decode_binary_metrics(payload, out)) {
+                // Checked at append or recovery; only an encoder/decoder
+                // mismatch gets here, so stop rather than replay garbage.
+                return out.size();
+            }
+            offset += kRecordHeaderSize + length;
+        }
+        if (out.size() >= max_count) {
+            break;
+        }
+    }
+    return out.size();
+}
+
+void SnapshotSpool::consume(size_t count) {
+    while (count > 0 && !segments_.empty()) {
+        Segment& segment = segments_.front();
+        while (count > 0 && segment.read_offset < segment.write_offset) {
+            unsigned char* record = segment.data + segment.read_offset;
+            store_u32(record + 8, load_u32(record + 8) | kRecordAcked);
+            segment.read_offset += kRecordHeaderSize + load_u32(record);
+            --segment.pending;
+            --pending_;
+            --count;
+        }
+
+        const bool is_active = active_ && segments_.size() == 1;
+        if (segment.pending > 0 || is_active) {
+            break;
+        }
+        close_segment(segment, true);
+        segments_.erase(segments_.begin());
+    }
+}
+
+size_t SnapshotSpool::pending() const {
+    return pending_;
+}
+
+uint64_t SnapshotSpool::evicted() const {
+    return evicted_;
+}
+
+size_t SnapshotSpool::disk_bytes() const {
+    size_t total = 0;
+    for (const auto& segment : segments_) {
+        total += segment.size;
+    }
+    return total;
+}
+
+bool SnapshotSpool::open_segment(uint64_t id, bool create, Segment& segment, std::string& error_message) {
+#if defined(_WIN32)
+    (void)id;
+    (void)create;
+    (void)segment;
+    error_message = "spool is only supported on POSIX systems";
+    return false;
+#else
+    const std::string path = segment_path(id);
+    const int fd = ::open(path.c_str(), O_RDWR | O_CLOEXEC | (create ? O_CREAT | O_EXCL : 0), 0640);
+    if (fd < 0) {
+        error_message = "cannot open " + path + ": " + std::strerror(errno);
+        return false;
+    }
+
+    size_t size = options_.segment_bytes;
+    if (create) {
+        if (::ftruncate(fd, static_cast<off_t>(size)) != 0) {
+            error_message = "cannot size " + path + ": " + std::strerror(errno);
+            ::close(fd);
+            ::unlink(path.c_str());
+            return false;
+        }
+    } else {
+        struct stat info {};
+        if (::fstat(fd, &info) != 0) {
+            error_message = "cannot stat " + path + ": " + std::strerror(errno);
+            ::close(fd);
+            return false;
+        }
+        size = static_cast<size_t>(info.st_size);
+    }
+
+    void* data = nullptr;
+    if (size > 0) {
+        data = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (data == MAP_FAILED) {
+            error_message = "cannot map " + path + ": " + std::strerror(errno);
+            ::close(fd);
+            return false;
+        }
+    }
+
+    segment = Segment{};
+    segment.id = id;
+    segment.fd = fd;
+    segment.data = static_cast<unsigned char*>(data);
+    segment.size = size;
+    if (create) {
+        std::memcpy(segment.data, kSegmentMagic, sizeof(kSegmentMagic));
+        store_u32(segment.data + 4, kSegmentVersion);
+        segment.write_offset = kSegmentHeaderSize;
+        segment.read_offset = kSegmentHeaderSize;
+    }
+    return true;
+#endif
+}
+
+void SnapshotSpool::recover_segment(Segment& segment) {
+    segment.write_offset = 0;
+    segment.read_offset = 0;
+    segment.pending = 0;
+    if (segment.size < kSegmentHeaderSize ||
+        std::memcmp(segment.data, kSegmentMagic, sizeof(kSegmentMagic)) != 0 ||
+        load_u32(segment.data + 4) != kSegmentVersion) {
+        return;
+    }
+
+    size_t offset = kSegmentHeaderSize;
+    segment.read_offset = offset;
+    while (offset + kRecordHeaderSize <= segment.size) {
+        const unsigned char* record = segment.data + offset;
+        const size_t length = load_u32(record);
+        if (length == 0 || length > segment.size - offset - kRecordHeaderSize ||
+            crc32(record + kRecordHeaderSize, length) != load_u32(record + 4)) {
+            break;
+        }
+
+        offset += kRecordHeaderSize + length;
+        if (load_u32(record + 8) & kRecordAcked) {
+            // Records are acknowledged in order, so everything up to here was sent.
+            segment.read_offset = offset;
+            segment.pending = 0;
+        } else {
+            ++segment.pending;
+        }
+    }
+    segment.write_offset = offset;
+}
+
+bool SnapshotSpool::roll_segment() {
+    if (active_ && segments_.back().pending == 0) {
+        close_segment(segments_.back(), true);
+        segments_.pop_back();
+    }
+    active_ = false;
+
+    while (!segments_.empty() && disk_bytes() + options_.segment_bytes > options_.max_bytes) {
+        Segment& oldest = segments_.front();
+        evicted_ += oldest.pending;
+        pending_ -= oldest.pending;
+        close_segment(oldest, true);
+        segments_.erase(segments_.begin());
+    }
+
+    // Recovered segments may end in a torn record, so appends always go to
+    // a fresh, zero-filled segment.
+    Segment segment;
+    std::string error_message;
+    if (!open_segment(next_id_, true, segment, error_message)) {
+        return false;
+    }
+    ++next_id_;
+    segments_.push_back(segment);
+    active_ = true;
+    return true;
+}
+
+void SnapshotSpool::close_segment(Segment& segment, bool remove_file) {
+#if !defined(_WIN32)
+    if (segment.data != nullptr) {
+        ::munmap(segment.data, segment.size);
+    }
+    if (segment.fd >= 0) {
+        ::close(segment.fd);
+    }
+    if (remove_file) {
+        ::unlink(segment_path(segment.id).c_str());
+    }
+#else
+    (void)remove_file;
+#endif
+    segment.data = nullptr;
+    segment.fd = -1;
+}
+
+std::string SnapshotSpool::segment_path(uint64_t id) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "spool-%020llu.seg", static_cast<unsigned long long>(id));
+    return options_.directory + "/" + name;
+}
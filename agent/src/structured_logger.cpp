@@ -1,78 +1,361 @@
 #include "structured_logger.h"
+#include "json_writer.h"
 
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <cstddef>
 #include <ctime>
-#include <iomanip>
-#include <iostream>
-#include <sstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
 
 namespace {
-std::string escape_json_string(const std::string& input) {
-    std::ostringstream escaped;
-    for (const char character : input) {
-        switch (character) {
-            case '\\':
-                escaped << "\\\\";
-                break;
-            case '"':
-                escaped << "\\\"";
-                break;
-            case '\n':
-                escaped << "\\n";
-                break;
-            case '\r':
-                escaped << "\\r";
-                break;
-            case '\t':
-                escaped << "\\t";
-                break;
-            default:
-                escaped << character;
-                break;
-        }
+constexpr size_t kMaxBatchBytes = 64 * 1024;
+
+const char* level_name(LogLevel level) {
+    switch (level) {
+        case LogLevel::debug:
+            return "DEBUG";
+        case LogLevel::info:
+            return "INFO";
+        case LogLevel::warn:
+            return "WARN";
+        case LogLevel::error:
+            return "ERROR";
     }
-    return escaped.str();
+    return "INFO";
+}
+
+bool to_error_stream(LogLevel level) {
+    return level == LogLevel::warn || level == LogLevel::error;
 }
 
-std::string now_utc_iso8601() {
-    const auto now = std::chrono::system_clock::now();
-    const std::time_t current_time = std::chrono::system_clock::to_time_t(now);
+/**
+ * Formats the current UTC second, re-running strftime only when the second
+ * changes. The cache is per thread, so no locking is needed.
+ */
+std::string_view now_utc_iso8601() {
+    thread_local std::time_t cached_time = -1;
+    thread_local char cached_text[32] = {};
+    thread_local size_t cached_length = 0;
 
-    std::tm time_info{};
+    const std::time_t current_time = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    if (current_time != cached_time) {
+        std::tm time_info{};
 #if defined(_WIN32)
-    gmtime_s(&time_info, &current_time);
+        gmtime_s(&time_info, &current_time);
 #else
-    gmtime_r(&current_time, &time_info);
+        gmtime_r(&current_time, &time_info);
 #endif
+        cached_length = std::strftime(cached_text, sizeof(cached_text), "%Y-%m-%dT%H:%M:%SZ", &time_info);
+        cached_time = current_time;
+    }
+    return std::string_view(cached_text, cached_length);
+}
 
-    std::ostringstream out;
-    out << std::put_time(&time_info, "%Y-%m-%dT%H:%M:%SZ");
-    return out.str();
+void write_line(std::FILE* stream, const std::string& line) {
+    std::fwrite(line.data(), 1, line.size(), stream);
+    std::fputc('\n', stream);
+    std::fflush(stream);
 }
+
+/**
+ * Bounded multi-producer/single-consumer queue of formatted lines (Vyukov).
+ * Producers claim a position with a CAS and never wait: a full queue makes
+ * try_push fail. Lines are swapped in and out, so slot strings keep their
+ * capacity and steady-state logging does not allocate.
+ */
+class LogQueue {
+public:
+    explicit LogQueue(size_t capacity)
+        : capacity_(capacity > 0 ? capacity : 1),
+          slots_(new Slot[capacity_]) {
+        for (size_t i = 0; i < capacity_; ++i) {
+            slots_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    bool try_push(std::string& line, bool to_err) {
+        size_t position = enqueue_position_.load(std::memory_order_relaxed);
+        while (true) {
+            Slot& slot = slots_[position % capacity_];
+            const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            const std::ptrdiff_t free = static_cast<std::ptrdiff_t>(sequence - position);
+
+            if (free == 0) {
+                if (enqueue_position_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    slot.line.swap(line);
+                    slot.to_err = to_err;
+                    // seq_cst pairs with the writer's is_ready() re-check before it sleeps.
+                    slot.sequence.store(position + 1, std::memory_order_seq_cst);
+                    return true;
+                }
+            } else if (free < 0) {
+                return false;
+            } else {
+                position = enqueue_position_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Consumer only.
+    bool try_pop(std::string& line, bool& to_err) {
+        Slot& slot = slots_[dequeue_position_ % capacity_];
+        if (slot.sequence.load(std::memory_order_acquire) != dequeue_position_ + 1) {
+            return false;
+        }
+        line.swap(slot.line);
+        to_err = slot.to_err;
+        slot.sequence.store(dequeue_position_ + capacity_, std::memory_order_release);
+        ++dequeue_position_;
+        return true;
+    }
+
+    // Consumer only.
+    bool is_ready() const {
+        const Slot& slot = slots_[dequeue_position_ % capacity_];
+        return slot.sequence.load(std::memory_order_seq_cst) == dequeue_position_ + 1;
+    }
+
+private:
+    struct Slot {
+        std::atomic<size_t> sequence{0};
+        std::string line;
+        bool to_err = false;
+    };
+
+    const size_t capacity_;
+    std::unique_ptr<Slot[]> slots_;
+    alignas(64) std::atomic<size_t> enqueue_position_{0};
+    alignas(64) size_t dequeue_position_ = 0;
+};
+
+struct AsyncLoggerState {
+    std::mutex control_mutex; // start/stop
+    std::unique_ptr<LogQueue> queue;
+    std::thread writer;
+    std::FILE* out = nullptr;
+    std::FILE* err = nullptr;
+
+    std::atomic<bool> running{false};
+    std::atomic<size_t> active_producers{0};
+    std::atomic<bool> stopping{false};
+    std::atomic<bool> writer_waiting{false};
+    std::mutex wake_mutex;
+    std::condition_variable wake_cv;
+    std::atomic<size_t> dropped{0};
+};
+
+std::atomic<int> g_min_level{static_cast<int>(LogLevel::info)};
+std::mutex g_sync_mutex;
+
+AsyncLoggerState& async_state() {
+    static AsyncLoggerState state;
+    return state;
 }
 
-void log_event(
-    const std::string& level,
-    const std::string& event,
-    const std::string& message,
-    const std::map<std::string, std::string>& fields
-) {
-    std::ostringstream entry;
-    entry << "{";
-    entry << "\"ts\":\"" << escape_json_string(now_utc_iso8601()) << "\",";
-    entry << "\"level\":\"" << escape_json_string(level) << "\",";
-    entry << "\"event\":\"" << escape_json_string(event) << "\",";
-    entry << "\"message\":\"" << escape_json_string(message) << "\"";
+void flush_batch(std::FILE* stream, std::string& batch) {
+    if (batch.empty()) {
+        return;
+    }
+    std::fwrite(batch.data(), 1, batch.size(), stream);
+    std::fflush(stream);
+    batch.clear();
+}
+
+void run_writer(AsyncLoggerState& state) {
+    std::string line;
+    std::string out_batch;
+    std::string err_batch;
+    size_t reported_dropped = 0;
+    bool to_err = false;
+
+    while (true) {
+        while (state.queue->try_pop(line, to_err)) {
+            std::string& batch = to_err ? err_batch : out_batch;
+            batch += line;
+            batch.push_back('\n');
+            if (batch.size() >= kMaxBatchBytes) {
+                flush_batch(to_err ? state.err : state.out, batch);
+            }
+        }
 
-    for (const auto& [key, value] : fields) {
-        entry << ",\"" << escape_json_string(key) << "\":\"" << escape_json_string(value) << "\"";
+        const size_t dropped = state.dropped.load(std::memory_order_relaxed);
+        if (dropped != reported_dropped) {
+            const std::string dropped_text = std::to_string(dropped - reported_dropped);
+            append_log_line(err_batch, now_utc_iso8601(), LogLevel::warn, "log.dropped",
+                            "Log queue was full; lines were dropped", {{"dropped", dropped_text}});
+            err_batch.push_back('\n');
+            reported_dropped = dropped;
+        }
+
+        flush_batch(state.out, out_batch);
+        flush_batch(state.err, err_batch);
+
+        if (state.stopping.load(std::memory_order_acquire) && !state.queue->is_ready()) {
+            return;
+        }
+
+        std::unique_lock<std::mutex> lock(state.wake_mutex);
+        state.writer_waiting.store(true, std::memory_order_seq_cst);
+        if (!state.queue->is_ready() && !state.stopping.load(std::memory_order_acquire)) {
+            state.wake_cv.wait(lock);
+        }
+        state.writer_waiting.store(false, std::memory_order_relaxed);
     }
+}
+
+void wake_writer(AsyncLoggerState& state) {
+    if (state.writer_waiting.load(std::memory_order_seq_cst)) {
+        std::lock_guard<std::mutex> lock(state.wake_mutex);
+        state.wake_cv.notify_one();
+    }
+}
 
-    entry << "}";
+/**
+ * Hands `line` to the background writer if it is running.
+ * @return False if the caller has to write the line itself.
+ */
+bool enqueue_line(std::string& line, bool to_err) {
+    AsyncLoggerState& state = async_state();
 
-    if (level == "ERROR" || level == "WARN") {
-        std::cerr << entry.str() << std::endl;
+    // The producer count is raised before `running` is checked, so
+    // stop_async_logger() can wait out every push that saw it running.
+    state.active_producers.fetch_add(1, std::memory_order_seq_cst);
+    if (!state.running.load(std::memory_order_seq_cst)) {
+        state.active_producers.fetch_sub(1, std::memory_order_release);
+        return false;
+    }
+
+    if (!state.queue->try_push(line, to_err)) {
+        state.dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+    wake_writer(state);
+    state.active_producers.fetch_sub(1, std::memory_order_release);
+    return true;
+}
+}  // namespace
+
+bool parse_log_level(std::string_view text, LogLevel& level) {
+    std::string normalized(text);
+    for (char& c : normalized) {
+        if (c >= 'A' && c <= 'Z') {
+            c = static_cast<char>(c - 'A' + 'a');
+        }
+    }
+
+    if (normalized == "debug") {
+        level = LogLevel::debug;
+    } else if (normalized == "info") {
+        level = LogLevel::info;
+    } else if (normalized == "warn" || normalized == "warning") {
+        level = LogLevel::warn;
+    } else if (normalized == "error") {
+        level = LogLevel::error;
     } else {
-        std::cout << entry.str() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void set_log_level(LogLevel level) {
+    g_min_level.store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+bool log_enabled(LogLevel level) {
+    return static_cast<int>(level) >= g_min_level.load(std::memory_order_relaxed);
+}
+
+void start_async_logger(const LoggerOptions& options) {
+    AsyncLoggerState& state = async_state();
+    std::lock_guard<std::mutex> control(state.control_mutex);
+    if (state.running.load(std::memory_order_acquire)) {
+        return;
+    }
+
+    state.queue = std::make_unique<LogQueue>(options.queue_capacity);
+    state.out = options.out != nullptr ? options.out : stdout;
+    state.err = options.err != nullptr ? options.err : stderr;
+    state.stopping.store(false, std::memory_order_relaxed);
+    state.writer = std::thread(run_writer, std::ref(state));
+    state.running.store(true, std::memory_order_seq_cst);
+}
+
+void stop_async_logger() {
+    AsyncLoggerState& state = async_state();
+    std::lock_guard<std::mutex> control(state.control_mutex);
+    if (!state.running.load(std::memory_order_acquire)) {
+        return;
+    }
+
+    state.running.store(false, std::memory_order_seq_cst);
+    while (state.active_producers.load(std::memory_order_seq_cst) != 0) {
+        std::this_thread::yield();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(state.wake_mutex);
+        state.stopping.store(true, std::memory_order_release);
+    }
+    state.wake_cv.notify_one();
+    state.writer.join();
+    state.queue.reset();
+}
+
+size_t dropped_log_lines() {
+    return async_state().dropped.load(std::memory_order_relaxed);
+}
+
+void append_log_line(
+    std::string& out,
+    std::string_view timestamp,
+    LogLevel level,
+    std::string_view event,
+    std::string_view message,
+    std::initializer_list<LogField> fields
+) {
+    out += "{\"ts\":";
+    append_json_string(out, timestamp);
+    out += ",\"level\":\"";
+    out += level_name(level);
+    out += "\",\"event\":";
+    append_json_string(out, event);
+    out += ",\"message\":";
+    append_json_string(out, message);
+
+    for (const auto& field : fields) {
+        out.push_back(',');
+        append_json_string(out, field.key);
+        out.push_back(':');
+        append_json_string(out, field.value);
     }
+
+    out.push_back('}');
+}
+
+void log_event(
+    LogLevel level,
+    std::string_view event,
+    std::string_view message,
+    std::initializer_list<LogField> fields
+) {
+    if (!log_enabled(level)) {
+        return;
+    }
+
+    // Swapped into the queue, so after warm-up this buffer comes back with
+    // the capacity of an earlier line.
+    thread_local std::string line;
+    line.clear();
+    append_log_line(line, now_utc_iso8601(), level, event, message, fields);
+
+    const bool to_err = to_error_stream(level);
+    if (enqueue_line(line, to_err)) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(g_sync_mutex);
+    write_line(to_err ? stderr : stdout, line);
 }
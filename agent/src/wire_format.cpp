@@ -0,0 +1,364 @@
+#include "wire_format.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#if defined(METRICS_AGENT_HAVE_ZLIB)
+#include <zlib.h>
+#endif
+
+namespace {
+constexpr char kBinaryHeader[4] = {'M', 'T', 'B', 0x01};
+
+void append_uvarint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+void append_svarint(std::string& out, int64_t value) {
+    append_uvarint(out, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+}
+
+int64_t to_hundredths(double value) {
+    if (!std::isfinite(value)) {
+        return 0;
+    }
+    return static_cast<int64_t>(std::llround(value * 100.0));
+}
+
+void append_window_stats(std::string& out, const WindowStats& stats) {
+    append_svarint(out, to_hundredths(stats.min));
+    append_svarint(out, to_hundredths(stats.max));
+    append_svarint(out, to_hundredths(stats.mean));
+    append_svarint(out, to_hundredths(stats.p95));
+}
+
+/**
+ * Bounds-checked varint reader over a payload; every read fails once the
+ * input is exhausted, so callers check `ok` once per snapshot.
+ */
+struct VarintReader {
+    const unsigned char* data;
+    size_t size;
+    size_t offset = 0;
+    bool ok = true;
+
+    uint64_t uvarint() {
+        uint64_t value = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7) {
+            if (offset >= size) {
+                ok = false;
+                return 0;
+            }
+            const unsigned char byte = data[offset++];
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (byte < 0x80) {
+                return value;
+            }
+        }
+        ok = false;
+        return 0;
+    }
+
+    int64_t svarint() {
+        const uint64_t raw = uvarint();
+        return static_cast<int64_t>(raw >> 1) ^ -static_cast<int64_t>(raw & 1);
+    }
+
+    double hundredths() {
+        return static_cast<double>(svarint()) / 100.0;
+    }
+
+    WindowStats window_stats() {
+        WindowStats stats{};
+        stats.min = hundredths();
+        stats.max = hundredths();
+        stats.mean = hundredths();
+        stats.p95 = hundredths();
+        return stats;
+    }
+};
+
+// Limits that keep a corrupt payload from allocating without bound.
+constexpr uint64_t kMaxDecodedCores = 4096;
+constexpr uint64_t kMaxDecodedProcesses = 4096;
+constexpr uint64_t kMaxDecodedCgroups = 4096;
+}  // namespace
+
+bool parse_wire_format(const std::string& text, WireFormat& format) {
+    if (text == "json") {
+        format = WireFormat::json;
+        return true;
+    }
+    if (text == "binary") {
+        format = WireFormat::binary;
+        return true;
+    }
+    return false;
+}
+
+bool parse_wire_compression(const std::string& text, WireCompression& compression) {
+    if (text == "none") {
+        compression = WireCompression::none;
+        return true;
+    }
+    if (text == "gzip") {
+        compression = WireCompression::gzip;
+        return true;
+    }
+    return false;
+}
+
+bool wire_compression_available(WireCompression compression) {
+#if defined(METRICS_AGENT_HAVE_ZLIB)
+    (void)compression;
+    return true;
+#else
+    return compression == WireCompression::none;
+#endif
+}
+
+bool gzip_compress(const std::string& input, std::string& output) {
+#if defined(METRICS_AGENT_HAVE_ZLIB)
+    z_stream stream{};
+    // 15 window bits + 16 selects the gzip wrapper instead of raw zlib.
+    if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+
+    output.resize(deflateBound(&stream, static_cast<uLong>(input.size())) + 32);
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+    stream.avail_in = static_cast<uInt>(input.size());
+    stream.next_out = reinterpret_cast<Bytef*>(&output[0]);
+    stream.avail_out = static_cast<uInt>(output.size());
+
+    const int result = deflate(&stream, Z_FINISH);
+    const size_t written = output.size() - stream.avail_out;
+    deflateEnd(&stream);
+    if (result != Z_STREAM_END) {
+        output.clear();
+        return false;
+    }
+
+    output.resize(written);
+    return true;
+#else
+    (void)input;
+    output.clear();
+    return false;
+#endif
+}
+
+void BinaryMetricsEncoder::encode(const SystemMetrics* snapshots, size_t count, std::string& out) {
+    name_ids_.clear();
+    previous_cores_.clear();
+    previous_timestamp_ = 0;
+    previous_memory_total_ = 0;
+    previous_memory_used_ = 0;
+
+    out.assign(kBinaryHeader, sizeof(kBinaryHeader));
+    for (size_t index = 0; index < count; ++index) {
+        append_snapshot(snapshots[index], out);
+    }
+}
+
+void BinaryMetricsEncoder::append_snapshot(const SystemMetrics& metrics, std::string& out) {
+    append_svarint(out, metrics.timestamp_ms - previous_timestamp_);
+    previous_timestamp_ = metrics.timestamp_ms;
+
+    append_svarint(out, to_hundredths(metrics.total_cpu_percent));
+
+    const size_t core_count = metrics.per_core_cpu_percent.size();
+    append_uvarint(out, core_count);
+    if (previous_cores_.size() < core_count) {
+        previous_cores_.resize(core_count, 0);
+    }
+    for (size_t core = 0; core < core_count; ++core) {
+        const int64_t value = to_hundredths(metrics.per_core_cpu_percent[core]);
+        append_svarint(out, value - previous_cores_[core]);
+        previous_cores_[core] = value;
+    }
+
+    const int64_t memory_total = to_hundredths(metrics.system_memory_total_mb);
+    const int64_t memory_used = to_hundredths(metrics.system_memory_used_mb);
+    append_svarint(out, memory_total - previous_memory_total_);
+    append_svarint(out, memory_used - previous_memory_used_);
+    previous_memory_total_ = memory_total;
+    previous_memory_used_ = memory_used;
+
+    append_uvarint(out, metrics.top_processes.size());
+    for (const auto& proc : metrics.top_processes) {
+        append_svarint(out, proc.pid);
+        append_name(proc.name, out);
+        append_svarint(out, to_hundredths(proc.cpu_percent));
+        append_svarint(out, to_hundredths(proc.memory_mb));
+        append_svarint(out, proc.thread_count);
+        append_svarint(out, to_hundredths(proc.io_read_mb));
+        append_svarint(out, to_hundredths(proc.io_write_mb));
+        append_svarint(out, proc.handle_count);
+    }
+
+    append_uvarint(out, metrics.top_cgroups.size());
+    for (const auto& cgroup : metrics.top_cgroups) {
+        append_name(cgroup.path, out);
+        append_svarint(out, to_hundredths(cgroup.cpu_percent));
+        append_svarint(out, to_hundredths(cgroup.memory_mb));
+        append_svarint(out, to_hundredths(cgroup.io_read_mb));
+        append_svarint(out, to_hundredths(cgroup.io_write_mb));
+    }
+
+    const MetricsWindow& window = metrics.window;
+    append_uvarint(out, window.samples);
+    if (window.samples == 0) {
+        return;
+    }
+    append_uvarint(out, static_cast<uint64_t>(std::max<int64_t>(metrics.timestamp_ms - window.start_timestamp_ms, 0)));
+    append_window_stats(out, window.total_cpu_percent);
+    append_uvarint(out, window.per_core_cpu_percent.size());
+    for (const auto& core : window.per_core_cpu_percent) {
+        append_window_stats(out, core);
+    }
+    append_window_stats(out, window.system_memory_used_mb);
+    append_uvarint(out, window.top_processes.size());
+    for (const auto& proc : window.top_processes) {
+        append_uvarint(out, proc.samples);
+        append_window_stats(out, proc.cpu_percent);
+        append_window_stats(out, proc.memory_mb);
+    }
+}
+
+void BinaryMetricsEncoder::append_name(const std::string& name, std::string& out) {
+    const auto [it, inserted] = name_ids_.try_emplace(name, static_cast<uint32_t>(name_ids_.size()));
+    append_uvarint(out, it->second);
+    if (inserted) {
+        append_uvarint(out, name.size());
+        out.append(name);
+    }
+}
+
+bool decode_binary_metrics(std::string_view body, std::vector<SystemMetrics>& out) {
+    if (body.size() < sizeof(kBinaryHeader) ||
+        body.compare(0, sizeof(kBinaryHeader), std::string_view(kBinaryHeader, sizeof(kBinaryHeader))) != 0) {
+        return false;
+    }
+
+    VarintReader reader{reinterpret_cast<const unsigned char*>(body.data()), body.size(), sizeof(kBinaryHeader)};
+    std::vector<std::string> names;
+    const auto read_name = [&](std::string& name) {
+        const uint64_t name_id = reader.uvarint();
+        if (name_id == names.size()) {
+            const uint64_t length = reader.uvarint();
+            if (!reader.ok || length > reader.size - reader.offset) {
+                return false;
+            }
+            names.emplace_back(body.data() + reader.offset, length);
+            reader.offset += length;
+        } else if (name_id > names.size()) {
+            return false;
+        }
+        name = names[name_id];
+        return true;
+    };
+    std::vector<int64_t> cores;
+    int64_t timestamp_ms = 0;
+    int64_t memory_total = 0;
+    int64_t memory_used = 0;
+
+    while (reader.offset < reader.size) {
+        SystemMetrics metrics{};
+        timestamp_ms += reader.svarint();
+        metrics.timestamp_ms = timestamp_ms;
+        metrics.timestamp = static_cast<time_t>(timestamp_ms / 1000);
+        metrics.total_cpu_percent = reader.hundredths();
+
+        const uint64_t core_count = reader.uvarint();
+        if (!reader.ok || core_count > kMaxDecodedCores) {
+            return false;
+        }
+        if (cores.size() < core_count) {
+            cores.resize(core_count, 0);
+        }
+        metrics.per_core_cpu_percent.resize(core_count);
+        for (size_t core = 0; core < core_count; ++core) {
+            cores[core] += reader.svarint();
+            metrics.per_core_cpu_percent[core] = static_cast<double>(cores[core]) / 100.0;
+        }
+
+        memory_total += reader.svarint();
+        memory_used += reader.svarint();
+        metrics.system_memory_total_mb = static_cast<double>(memory_total) / 100.0;
+        metrics.system_memory_used_mb = static_cast<double>(memory_used) / 100.0;
+
+        const uint64_t process_count = reader.uvarint();
+        if (!reader.ok || process_count > kMaxDecodedProcesses) {
+            return false;
+        }
+        metrics.top_processes.resize(process_count);
+        for (auto& proc : metrics.top_processes) {
+            proc.pid = static_cast<int>(reader.svarint());
+            if (!read_name(proc.name)) {
+                return false;
+            }
+            proc.cpu_percent = reader.hundredths();
+            proc.memory_mb = reader.hundredths();
+            proc.thread_count = static_cast<int>(reader.svarint());
+            proc.io_read_mb = reader.hundredths();
+            proc.io_write_mb = reader.hundredths();
+            proc.handle_count = static_cast<int>(reader.svarint());
+        }
+
+        const uint64_t cgroup_count = reader.uvarint();
+        if (!reader.ok || cgroup_count > kMaxDecodedCgroups) {
+            return false;
+        }
+        metrics.top_cgroups.resize(cgroup_count);
+        for (auto& cgroup : metrics.top_cgroups) {
+            if (!read_name(cgroup.path)) {
+                return false;
+            }
+            cgroup.cpu_percent = reader.hundredths();
+            cgroup.memory_mb = reader.hundredths();
+            cgroup.io_read_mb = reader.hundredths();
+            cgroup.io_write_mb = reader.hundredths();
+        }
+
+        MetricsWindow& window = metrics.window;
+        window.samples = static_cast<uint32_t>(reader.uvarint());
+        if (window.samples > 0) {
+            window.start_timestamp_ms = timestamp_ms - static_cast<int64_t>(reader.uvarint());
+            window.total_cpu_percent = reader.window_stats();
+            const uint64_t window_cores = reader.uvarint();
+            if (!reader.ok || window_cores > kMaxDecodedCores) {
+                return false;
+            }
+            window.per_core_cpu_percent.resize(window_cores);
+            for (auto& core : window.per_core_cpu_percent) {
+                core = reader.window_stats();
+            }
+            window.system_memory_used_mb = reader.window_stats();
+            const uint64_t window_processes = reader.uvarint();
+            if (!reader.ok || window_processes > metrics.top_processes.size()) {
+                return false;
+            }
+            window.top_processes.resize(window_processes);
+            for (size_t index = 0; index < window_processes; ++index) {
+                ProcessWindowMetrics& proc = window.top_processes[index];
+                proc.pid = metrics.top_processes[index].pid;
+                proc.samples = static_cast<uint32_t>(reader.uvarint());
+                proc.cpu_percent = reader.window_stats();
+                proc.memory_mb = reader.window_stats();
+            }
+        }
+
+        if (!reader.ok) {
+            return false;
+        }
+        metrics.fresh_families = kMetricFamilyAll;
+        out.push_back(std::move(metrics));
+    }
+    return true;
+}
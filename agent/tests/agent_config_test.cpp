@@ -0,0 +1,100 @@
+#include "agent_config.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <string>
+
+TEST_CASE("parse_agent_config reads JSON keys by their full path") {
+    const std::string document = R"({
+  "backend_url": "http://backend:8000/a\"b",
+  "interval_ms": 500,
+  "batch_max_items": 16,
+  "delta_cpu_deadband_percent": 1.5,
+  "labels": {"interval_ms": 9000, "tags": ["top_n", {"top_n": 3}]},
+  "spool_dir": null,
+  "metrics": {
+    "per_core_cpu": false,
+    "top_cgroups": "off"
+  }
+})";
+
+    AgentConfig config = AgentConfig::defaults();
+    std::string error;
+    REQUIRE(parse_agent_config(document, config, error));
+    CHECK(config.backend_url == "http://backend:8000/a\"b");
+    CHECK(config.interval_ms == 500);
+    CHECK(config.batch_max_items == 16);
+    CHECK(config.delta_cpu_deadband_percent == 1.5);
+    CHECK(config.top_n == 12);
+    CHECK(config.spool_dir.empty());
+    CHECK_FALSE(config.selection.per_core_cpu);
+    CHECK_FALSE(config.selection.top_cgroups);
+    CHECK(config.selection.total_cpu);
+}
+
+TEST_CASE("parse_agent_config reads nested YAML sections, quotes and comments") {
+    const std::string document =
+        "# agent settings\n"
+        "backend_url: \"http://backend:8000\"  # quoted\n"
+        "interval_ms: 250\n"
+        "labels:\n"
+        "  interval_ms: 9000\n"
+        "  hosts:\n"
+        "    - a\n"
+        "    - b\n"
+        "metrics:\n"
+        "  total_cpu: false\n"
+        "\n"
+        "  process_io: no # trailing comment\n"
+        "spool_dir: '/var/lib/it''s'\n"
+        "log_level: debug\n"
+        "top_processes: false\r\n";
+
+    AgentConfig config = AgentConfig::defaults();
+    std::string error;
+    REQUIRE(parse_agent_config(document, config, error));
+    CHECK(config.backend_url == "http://backend:8000");
+    CHECK(config.interval_ms == 250);
+    CHECK(config.spool_dir == "/var/lib/it's");
+    CHECK(config.log_level == "debug");
+    CHECK_FALSE(config.selection.total_cpu);
+    CHECK_FALSE(config.selection.process_io);
+    // Top-level selection keys of older flat files still apply.
+    CHECK_FALSE(config.selection.top_processes);
+}
+
+TEST_CASE("parse_agent_config reports malformed documents with their line") {
+    AgentConfig config = AgentConfig::defaults();
+    std::string error;
+
+    CHECK_FALSE(parse_agent_config("{\n  \"interval_ms\": 500\n  \"top_n\": 3\n}", config, error));
+    CHECK(error == "expected ',' or '}' at line 3");
+
+    CHECK_FALSE(parse_agent_config("{\"backend_url\": \"http://x", config, error));
+    CHECK(error == "unterminated string at line 1");
+
+    CHECK_FALSE(parse_agent_config("interval_ms: 500\njust text\n", config, error));
+    CHECK(error == "expected 'key: value' at line 2");
+
+    CHECK_FALSE(parse_agent_config("backend_url: \"http://x\n", config, error));
+    CHECK(error == "unterminated quoted value at line 1");
+
+    CHECK_FALSE(parse_agent_config(" \n", config, error));
+    CHECK(config.interval_ms == 2000);
+}
+
+TEST_CASE("parse_agent_config keeps defaults for invalid values") {
+    AgentConfig config = AgentConfig::defaults();
+    std::string error;
+    REQUIRE(parse_agent_config("{\"interval_ms\": -5, \"top_n\": \"many\", \"backend_enabled\": \"maybe\"}", config, error));
+    CHECK(config.interval_ms == 2000);
+    CHECK(config.top_n == 12);
+    CHECK(config.backend_enabled);
+}
+
+TEST_CASE("load_agent_config_file names the file in its errors") {
+    AgentConfig config = AgentConfig::defaults();
+    std::string error;
+    CHECK_FALSE(load_agent_config_file("/nonexistent/agent.yaml", config, error));
+    CHECK(error == "Unable to open config file: /nonexistent/agent.yaml");
+}
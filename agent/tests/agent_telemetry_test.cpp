@@ -0,0 +1,94 @@
+#include "agent_telemetry.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <string>
+
+TEST_CASE("LatencyHistogram buckets are exact below 8 and within 12.5% above") {
+    for (uint64_t value = 0; value < 8; ++value) {
+        CHECK(LatencyHistogram::bucket_index(value) == value);
+        CHECK(LatencyHistogram::bucket_upper_bound(value) == value);
+    }
+
+    const uint64_t samples[] = {8, 9, 15, 16, 17, 100, 1000, 12345, 1000000, uint64_t{1} << 40, ~uint64_t{0}};
+    for (const uint64_t value : samples) {
+        const size_t index = LatencyHistogram::bucket_index(value);
+        REQUIRE(index < LatencyHistogram::kBucketCount);
+        const uint64_t upper = LatencyHistogram::bucket_upper_bound(index);
+        CHECK(upper >= value);
+        CHECK(upper - value <= value / 8);
+        CHECK(LatencyHistogram::bucket_index(upper) == index);
+    }
+    CHECK(LatencyHistogram::bucket_index(~uint64_t{0}) == LatencyHistogram::kBucketCount - 1);
+}
+
+TEST_CASE("LatencyHistogram snapshots report quantiles, sum and max") {
+    LatencyHistogram histogram;
+    LatencyHistogram::Snapshot snapshot;
+    histogram.snapshot(snapshot);
+    CHECK(snapshot.count == 0);
+    CHECK(snapshot.quantile(0.5) == 0);
+
+    for (uint64_t value = 1; value <= 100; ++value) {
+        histogram.record(value);
+    }
+    histogram.snapshot(snapshot);
+
+    CHECK(snapshot.count == 100);
+    CHECK(snapshot.sum == 5050);
+    CHECK(snapshot.max == 100);
+    CHECK(snapshot.quantile(0.0) == 1);
+    CHECK(snapshot.quantile(0.5) >= 50);
+    CHECK(snapshot.quantile(0.5) <= 55);
+    CHECK(snapshot.quantile(0.99) >= 99);
+    CHECK(snapshot.quantile(1.0) == 100);
+}
+
+TEST_CASE("LatencyHistogram::Snapshot::subtract keeps only the newer values") {
+    LatencyHistogram histogram;
+    for (int i = 0; i < 10; ++i) {
+        histogram.record(5000);
+    }
+    LatencyHistogram::Snapshot earlier;
+    histogram.snapshot(earlier);
+
+    for (int i = 0; i < 4; ++i) {
+        histogram.record(20);
+    }
+    LatencyHistogram::Snapshot interval;
+    histogram.snapshot(interval);
+    interval.subtract(earlier);
+
+    CHECK(interval.count == 4);
+    CHECK(interval.sum == 80);
+    CHECK(interval.quantile(0.99) >= 20);
+    CHECK(interval.quantile(0.99) < 24);
+    CHECK(interval.max < 5000);
+}
+
+TEST_CASE("AgentTelemetry renders stages and counters in the Prometheus text format") {
+    const uint64_t before = [] {
+        LatencyHistogram::Snapshot snapshot;
+        agent_telemetry().stage(TelemetryStage::serialize).snapshot(snapshot);
+        return snapshot.count;
+    }();
+    {
+        ScopedStageTimer timer(TelemetryStage::serialize);
+    }
+    LatencyHistogram::Snapshot after;
+    agent_telemetry().stage(TelemetryStage::serialize).snapshot(after);
+    CHECK(after.count == before + 1);
+
+    AgentTelemetry telemetry;
+    telemetry.stage(TelemetryStage::send).record(1500);
+    telemetry.bytes_sent.store(4096);
+    std::string out;
+    telemetry.render_prometheus(out);
+
+    CHECK(out.find("# TYPE metrics_agent_stage_duration_microseconds summary\n") != std::string::npos);
+    CHECK(out.find("metrics_agent_stage_duration_microseconds{stage=\"send\",quantile=\"0.99\"} 1500\n") != std::string::npos);
+    CHECK(out.find("metrics_agent_stage_duration_microseconds_count{stage=\"send\"} 1\n") != std::string::npos);
+    CHECK(out.find("metrics_agent_stage_duration_microseconds_count{stage=\"collect\"} 0\n") != std::string::npos);
+    CHECK(out.find("# TYPE metrics_agent_sent_bytes_total counter\nmetrics_agent_sent_bytes_total 4096\n") != std::string::npos);
+    CHECK(out.find("# TYPE metrics_agent_cycle_allocations gauge\n") != std::string::npos);
+}
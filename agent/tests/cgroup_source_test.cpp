@@ -0,0 +1,98 @@
+#include "cgroup_source.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#if defined(__linux__)
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+namespace {
+void write_file(const std::filesystem::path& path, const std::string& contents) {
+    std::ofstream(path) << contents;
+}
+
+void write_cgroup(const std::filesystem::path& directory, uint64_t usage_usec, uint64_t memory_bytes, const std::string& io) {
+    std::filesystem::create_directories(directory);
+    write_file(directory / "cpu.stat", "usage_usec " + std::to_string(usage_usec) + "\nuser_usec 1\nsystem_usec 2\n");
+    write_file(directory / "memory.current", std::to_string(memory_bytes) + "\n");
+    write_file(directory / "io.stat", io);
+}
+}  // namespace
+
+TEST_CASE("parse_cgroup_cpu_stat reads usage_usec") {
+    uint64_t usage = 0;
+    REQUIRE(parse_cgroup_cpu_stat("usage_usec 123456\nuser_usec 100000\nsystem_usec 23456\n", usage));
+    CHECK(usage == 123456);
+    CHECK_FALSE(parse_cgroup_cpu_stat("user_usec 1\n", usage));
+}
+
+TEST_CASE("parse_cgroup_io_stat sums bytes over devices") {
+    uint64_t read_bytes = 1;
+    uint64_t write_bytes = 1;
+    parse_cgroup_io_stat(
+        "8:0 rbytes=1024 wbytes=2048 rios=1 wios=2 dbytes=0 dios=0\n"
+        "259:0 rbytes=512 wbytes=0 rios=1 wios=0 dbytes=4096 dios=1\n",
+        read_bytes, write_bytes);
+    CHECK(read_bytes == 1536);
+    CHECK(write_bytes == 2048);
+
+    parse_cgroup_io_stat("", read_bytes, write_bytes);
+    CHECK(read_bytes == 0);
+    CHECK(write_bytes == 0);
+}
+
+TEST_CASE("LinuxCgroupSource reports the leaves of a hierarchy") {
+    const std::filesystem::path root =
+        std::filesystem::temp_directory_path() / ("metrics-agent-cgroup-test-" + std::to_string(::getpid()));
+    std::filesystem::remove_all(root);
+    std::filesystem::create_directories(root);
+    write_file(root / "cgroup.controllers", "cpu io memory\n");
+    write_cgroup(root / "kubepods.slice", 900, 4096, "");
+    write_cgroup(root / "kubepods.slice" / "pod-a" / "ctr-1", 500, 1024, "8:0 rbytes=10 wbytes=20\n");
+    write_cgroup(root / "kubepods.slice" / "pod-a" / "ctr-2", 400, 2048, "");
+    std::filesystem::create_directories(root / "system.slice" / "sshd.service");
+
+    LinuxCgroupSource source(root.string() + "/");
+    REQUIRE(source.is_available());
+
+    std::vector<CgroupSample> samples;
+    source.scan(samples);
+    std::sort(samples.begin(), samples.end(), [](const CgroupSample& left, const CgroupSample& right) {
+        return left.path < right.path;
+    });
+
+    REQUIRE(samples.size() == 3);
+    CHECK(samples[0].path == "kubepods.slice/pod-a/ctr-1");
+    CHECK(samples[0].cpu_usage_usec == 500);
+    CHECK(samples[0].memory_bytes == 1024);
+    CHECK(samples[0].io_read_bytes == 10);
+    CHECK(samples[0].io_write_bytes == 20);
+    CHECK(samples[1].path == "kubepods.slice/pod-a/ctr-2");
+    // A leaf without controller files still shows up, with zero usage.
+    CHECK(samples[2].path == "system.slice/sshd.service");
+    CHECK(samples[2].cpu_usage_usec == 0);
+
+    // Without child cgroups the root itself is the leaf.
+    const std::filesystem::path single = root / "kubepods.slice" / "pod-a" / "ctr-1";
+    write_file(single / "cgroup.controllers", "cpu io memory\n");
+    LinuxCgroupSource container(single.string());
+    container.scan(samples);
+    REQUIRE(samples.size() == 1);
+    CHECK(samples[0].path == "/");
+    CHECK(samples[0].cpu_usage_usec == 500);
+
+    LinuxCgroupSource missing((root / "absent").string());
+    CHECK_FALSE(missing.is_available());
+    missing.scan(samples);
+    CHECK(samples.empty());
+
+    std::filesystem::remove_all(root);
+}
+#endif
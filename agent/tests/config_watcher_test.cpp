@@ -0,0 +1,66 @@
+#include "config_watcher.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#if defined(__linux__)
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include <unistd.h>
+
+namespace {
+namespace fs = std::filesystem;
+
+struct ScratchDir {
+    explicit ScratchDir(const std::string& name)
+        : path(fs::temp_directory_path() / (name + "-" + std::to_string(::getpid()))) {
+        fs::remove_all(path);
+        fs::create_directories(path);
+    }
+    ~ScratchDir() {
+        std::error_code ignored;
+        fs::remove_all(path, ignored);
+    }
+
+    fs::path path;
+};
+
+void write_file(const fs::path& path, const std::string& content) {
+    std::ofstream file(path, std::ios::trunc);
+    file << content;
+}
+}  // namespace
+
+TEST_CASE("ConfigWatcher reports writes and renames of the config file only") {
+    ScratchDir dir("config-watcher-test");
+    const fs::path config = dir.path / "agent.yaml";
+    write_file(config, "interval_ms: 1000\n");
+
+    ConfigWatcher watcher;
+    std::string error;
+    REQUIRE(watcher.open(config.string(), error));
+    CHECK_FALSE(watcher.poll());
+
+    write_file(config, "interval_ms: 500\n");
+    CHECK(watcher.poll());
+    CHECK_FALSE(watcher.poll());
+
+    write_file(dir.path / "other.yaml", "interval_ms: 250\n");
+    CHECK_FALSE(watcher.poll());
+
+    // Editors and ConfigMap volumes replace the file by renaming over it.
+    write_file(dir.path / "agent.yaml.tmp", "interval_ms: 250\n");
+    fs::rename(dir.path / "agent.yaml.tmp", config);
+    CHECK(watcher.poll());
+}
+
+TEST_CASE("ConfigWatcher fails to open a missing directory") {
+    ConfigWatcher watcher;
+    std::string error;
+    CHECK_FALSE(watcher.open("/nonexistent-config-dir/agent.yaml", error));
+    CHECK_FALSE(error.empty());
+    CHECK_FALSE(watcher.is_open());
+    CHECK_FALSE(watcher.poll());
+}
+#endif
@@ -0,0 +1,81 @@
+#include "cpu_usage.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+void set_core(CpuCounterArrays& counters, size_t core, double idle, double total) {
+    counters.idle[core] = idle;
+    counters.total[core] = total;
+}
+}  // namespace
+
+TEST_CASE("compute_cpu_usage reports the busy share of each core") {
+    CpuCounterArrays previous;
+    CpuCounterArrays current;
+    previous.resize(5);
+    current.resize(5);
+    set_core(previous, 0, 800, 1000);
+    set_core(current, 0, 850, 1100); // half busy
+    set_core(previous, 1, 800, 1000);
+    set_core(current, 1, 800, 1000); // no progress
+    set_core(previous, 2, 800, 1000);
+    set_core(current, 2, 800, 1200); // fully busy
+    set_core(previous, 3, 800, 1000);
+    set_core(current, 3, 900, 900); // total went backwards
+    set_core(previous, 4, 800, 1000);
+    set_core(current, 4, 1000, 1100); // more idle than total
+
+    std::vector<double> usage(5, -1.0);
+    CHECK(compute_cpu_usage(previous, current, usage.data()) == 5);
+    CHECK(usage == std::vector<double>{50.0, 0.0, 100.0, 0.0, 0.0});
+}
+
+TEST_CASE("compute_cpu_usage covers the shorter of two samples") {
+    CpuCounterArrays previous;
+    CpuCounterArrays current;
+    previous.resize(2);
+    current.resize(3);
+    set_core(previous, 0, 0, 0);
+    set_core(previous, 1, 0, 0);
+    set_core(current, 0, 1, 4);
+    set_core(current, 1, 4, 4);
+    set_core(current, 2, 0, 4);
+
+    std::vector<double> usage(3, -1.0);
+    CHECK(compute_cpu_usage(previous, current, usage.data()) == 2);
+    CHECK(usage == std::vector<double>{75.0, 0.0, -1.0});
+}
+
+TEST_CASE("compute_cpu_usage matches the scalar kernel bit for bit") {
+    std::mt19937_64 random(42);
+    std::uniform_int_distribution<uint64_t> start(0, uint64_t{1} << 40);
+    std::uniform_int_distribution<int> step(-50, 400);
+
+    for (const size_t cores : {size_t{1}, size_t{2}, size_t{7}, size_t{192}}) {
+        CpuCounterArrays previous;
+        CpuCounterArrays current;
+        previous.resize(cores);
+        current.resize(cores);
+        for (size_t core = 0; core < cores; ++core) {
+            const double total = static_cast<double>(start(random));
+            const double idle = static_cast<double>(start(random) / 2);
+            set_core(previous, core, idle, total);
+            set_core(current, core, idle + step(random), total + step(random));
+        }
+
+        std::vector<double> vectorized(cores);
+        std::vector<double> scalar(cores);
+        CHECK(compute_cpu_usage(previous, current, vectorized.data()) == cores);
+        CHECK(compute_cpu_usage_scalar(previous, current, scalar.data()) == cores);
+        CHECK(std::memcmp(vectorized.data(), scalar.data(), cores * sizeof(double)) == 0);
+        for (const double value : vectorized) {
+            CHECK(value >= 0.0);
+            CHECK(value <= 100.0);
+        }
+    }
+}
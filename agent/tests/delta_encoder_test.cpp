@@ -0,0 +1,189 @@
+#include "delta_encoder.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <string>
+
+namespace {
+DeltaOptions test_options() {
+    DeltaOptions options;
+    options.keyframe_interval = 4;
+    options.cpu_deadband_percent = 0.5;
+    options.memory_deadband_mb = 1.0;
+    options.stream_id = "s1";
+    return options;
+}
+
+SystemMetrics snapshot(int64_t timestamp_ms) {
+    SystemMetrics metrics{};
+    metrics.timestamp = static_cast<time_t>(timestamp_ms / 1000);
+    metrics.timestamp_ms = timestamp_ms;
+    metrics.total_cpu_percent = 10.0;
+    metrics.per_core_cpu_percent = {10.0, 0.0};
+    metrics.system_memory_total_mb = 16000.0;
+    metrics.system_memory_used_mb = 8000.0;
+    metrics.top_processes = {
+        ProcessMetrics{1, "init", 5.0, 10.0, 1, 0.0, 0.0, 20},
+        ProcessMetrics{2, "db", 3.0, 500.0, 8, 1.0, 2.0, 40}
+    };
+    return metrics;
+}
+
+std::string encode(MetricsDeltaEncoder& encoder, const SystemMetrics& metrics) {
+    std::string out;
+    encoder.begin();
+    encoder.append(metrics, out);
+    encoder.commit();
+    return out;
+}
+}  // namespace
+
+TEST_CASE("MetricsDeltaEncoder starts with a keyframe and then sends only timestamps of an unchanged snapshot") {
+    MetricsDeltaEncoder encoder(test_options());
+    CHECK(encoder.stream_id() == "s1");
+
+    std::string out;
+    encoder.begin();
+    CHECK(encoder.append(snapshot(1000), out));
+    encoder.commit();
+    CHECK(out.rfind("{\"stream\":\"s1\",\"sequence\":1,\"keyframe\":{\"timestamp\":1,\"timestamp_ms\":1000,", 0) == 0);
+    CHECK(out.find("\"name\":\"db\"") != std::string::npos);
+
+    CHECK(encode(encoder, snapshot(2000)) ==
+          "{\"stream\":\"s1\",\"sequence\":2,\"delta\":{\"timestamp\":2,\"timestamp_ms\":2000}}");
+}
+
+TEST_CASE("MetricsDeltaEncoder holds back changes within the deadband until they add up") {
+    MetricsDeltaEncoder encoder(test_options());
+    encode(encoder, snapshot(1000));
+
+    SystemMetrics next = snapshot(2000);
+    next.total_cpu_percent = 10.4;
+    next.per_core_cpu_percent[1] = 42.0;
+    next.system_memory_used_mb = 8000.9;
+    CHECK(encode(encoder, next) ==
+          "{\"stream\":\"s1\",\"sequence\":2,\"delta\":{\"timestamp\":2,\"timestamp_ms\":2000,"
+          "\"per_core_cpu_percent\":{\"1\":42.00}}}");
+
+    // Compared with what was sent (10.0), not with the previous sample (10.4).
+    next = snapshot(3000);
+    next.total_cpu_percent = 10.6;
+    next.per_core_cpu_percent[1] = 42.0;
+    next.system_memory_used_mb = 8001.5;
+    CHECK(encode(encoder, next) ==
+          "{\"stream\":\"s1\",\"sequence\":3,\"delta\":{\"timestamp\":3,\"timestamp_ms\":3000,"
+          "\"total_cpu_percent\":10.60,\"system_memory_used_mb\":8001.50}}");
+}
+
+TEST_CASE("MetricsDeltaEncoder keys processes by pid and cgroups by path") {
+    MetricsDeltaEncoder encoder(test_options());
+    SystemMetrics first = snapshot(1000);
+    first.top_cgroups = {
+        CgroupMetrics{"a.slice", 1.0, 10.0, 0.0, 0.0},
+        CgroupMetrics{"b.slice", 2.0, 20.0, 0.0, 0.0}
+    };
+    encode(encoder, first);
+
+    SystemMetrics next = snapshot(2000);
+    next.top_processes = {
+        ProcessMetrics{2, "db", 30.0, 500.0, 9, 1.0, 2.0, 40},
+        ProcessMetrics{3, "job", 1.0, 5.0, 1, 0.0, 0.0, 3}
+    };
+    next.top_cgroups = {CgroupMetrics{"b.slice", 2.2, 25.0, 0.0, 0.0}};
+    CHECK(encode(encoder, next) ==
+          "{\"stream\":\"s1\",\"sequence\":2,\"delta\":{\"timestamp\":2,\"timestamp_ms\":2000,"
+          "\"top_processes\":[{\"pid\":2,\"cpu_percent\":30.00,\"thread_count\":9},"
+          "{\"pid\":3,\"name\":\"job\",\"cpu_percent\":1.00,\"memory_mb\":5.00,\"thread_count\":1,\"io_read_mb\":0.00,\"io_write_mb\":0.00,\"handle_count\":3}],"
+          "\"removed_pids\":[1],"
+          "\"top_cgroups\":[{\"path\":\"b.slice\",\"memory_mb\":25.00}],"
+          "\"removed_cgroups\":[\"a.slice\"]}}");
+
+    // A PID that comes back with another name is a new process.
+    next = snapshot(3000);
+    next.top_processes = {
+        ProcessMetrics{2, "db", 30.0, 500.0, 9, 1.0, 2.0, 40},
+        ProcessMetrics{3, "job2", 1.0, 5.0, 1, 0.0, 0.0, 3}
+    };
+    next.top_cgroups = {CgroupMetrics{"b.slice", 2.2, 25.0, 0.0, 0.0}};
+    const std::string out = encode(encoder, next);
+    CHECK(out.find("\"top_processes\":[{\"pid\":3,\"name\":\"job2\",") != std::string::npos);
+    CHECK(out.find("removed") == std::string::npos);
+    CHECK(out.find("top_cgroups") == std::string::npos);
+}
+
+TEST_CASE("MetricsDeltaEncoder sends the ranking when it differs from the rebuilt order") {
+    MetricsDeltaEncoder encoder(test_options());
+    SystemMetrics first = snapshot(1000);
+    first.top_cgroups = {
+        CgroupMetrics{"a.slice", 2.0, 10.0, 0.0, 0.0},
+        CgroupMetrics{"b.slice", 1.0, 20.0, 0.0, 0.0}
+    };
+    first.top_processes[1].cpu_percent = 4.9;
+    encode(encoder, first);
+
+    // 2 overtakes 1 by less than the deadband: no value is sent, the order is.
+    SystemMetrics next = first;
+    next.timestamp = 2;
+    next.timestamp_ms = 2000;
+    std::swap(next.top_processes[0], next.top_processes[1]);
+    next.top_processes[0].cpu_percent = 5.2;
+    std::swap(next.top_cgroups[0], next.top_cgroups[1]);
+    CHECK(encode(encoder, next) ==
+          "{\"stream\":\"s1\",\"sequence\":2,\"delta\":{\"timestamp\":2,\"timestamp_ms\":2000,"
+          "\"process_order\":[2,1],\"cgroup_order\":[\"b.slice\",\"a.slice\"]}}");
+
+    // Same order again: nothing to send.
+    next.timestamp = 3;
+    next.timestamp_ms = 3000;
+    CHECK(encode(encoder, next) == "{\"stream\":\"s1\",\"sequence\":3,\"delta\":{\"timestamp\":3,\"timestamp_ms\":3000}}");
+
+    // A new process ranked ahead of known ones is not where appending puts it.
+    next.timestamp = 4;
+    next.timestamp_ms = 4000;
+    next.top_processes.insert(next.top_processes.begin(), ProcessMetrics{9, "new", 50.0, 1.0, 1, 0.0, 0.0, 1});
+    const std::string out = encode(encoder, next);
+    CHECK(out.find("\"top_processes\":[{\"pid\":9,\"name\":\"new\",") != std::string::npos);
+    CHECK(out.find("\"process_order\":[9,2,1]") != std::string::npos);
+    CHECK(out.find("cgroup_order") == std::string::npos);
+}
+
+TEST_CASE("MetricsDeltaEncoder rewinds uncommitted requests and sends keyframes when needed") {
+    MetricsDeltaEncoder encoder(test_options());
+    encode(encoder, snapshot(1000));
+
+    // An abandoned request leaves no trace.
+    std::string out;
+    encoder.begin();
+    SystemMetrics busy = snapshot(2000);
+    busy.total_cpu_percent = 90.0;
+    CHECK_FALSE(encoder.append(busy, out));
+    out.clear();
+    encoder.begin();
+    CHECK_FALSE(encoder.append(busy, out));
+    CHECK(out.find("\"sequence\":2,") != std::string::npos);
+    CHECK(out.find("\"total_cpu_percent\":90.00") != std::string::npos);
+    encoder.commit();
+
+    // Every keyframe_interval-th document is a keyframe.
+    out.clear();
+    encoder.begin();
+    CHECK_FALSE(encoder.append(snapshot(3000), out));
+    CHECK_FALSE(encoder.append(snapshot(4000), out));
+    CHECK(encoder.append(snapshot(5000), out));
+    encoder.commit();
+
+    // So is the first document after a failure.
+    encoder.force_keyframe();
+    out.clear();
+    encoder.begin();
+    CHECK(encoder.append(snapshot(6000), out));
+    CHECK(out.rfind("{\"stream\":\"s1\",\"sequence\":6,\"keyframe\":", 0) == 0);
+    encoder.commit();
+
+    // And a change of the core count.
+    SystemMetrics resized = snapshot(7000);
+    resized.per_core_cpu_percent.push_back(0.0);
+    out.clear();
+    encoder.begin();
+    CHECK(encoder.append(resized, out));
+}
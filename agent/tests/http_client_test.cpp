@@ -6,6 +6,7 @@ TEST_CASE("HttpClient::metrics_to_json formats values with two decimals") {
 
     SystemMetrics metrics{};
     metrics.timestamp = 1700000000;
+    metrics.timestamp_ms = 1700000000250;
     metrics.total_cpu_percent = 12.345;
     metrics.per_core_cpu_percent = {10.0, 15.5};
     metrics.system_memory_total_mb = 16000.0;
@@ -18,6 +19,7 @@ TEST_CASE("HttpClient::metrics_to_json formats values with two decimals") {
     const std::string expected =
         "{"
         "\"timestamp\":1700000000,"
+        "\"timestamp_ms\":1700000000250,"
         "\"total_cpu_percent\":12.35,"
         "\"per_core_cpu_percent\":[10.00,15.50],"
         "\"system_memory_total_mb\":16000.00,"
@@ -36,6 +38,7 @@ TEST_CASE("HttpClient::metrics_to_json handles empty process list") {
 
     SystemMetrics metrics{};
     metrics.timestamp = 1700000001;
+    metrics.timestamp_ms = 1700000001000;
     metrics.total_cpu_percent = 0.0;
     metrics.per_core_cpu_percent = {};
     metrics.system_memory_total_mb = 0.0;
@@ -45,6 +48,7 @@ TEST_CASE("HttpClient::metrics_to_json handles empty process list") {
     const std::string expected =
         "{"
         "\"timestamp\":1700000001,"
+        "\"timestamp_ms\":1700000001000,"
         "\"total_cpu_percent\":0.00,"
         "\"per_core_cpu_percent\":[],"
         "\"system_memory_total_mb\":0.00,"
@@ -54,3 +58,30 @@ TEST_CASE("HttpClient::metrics_to_json handles empty process list") {
 
     CHECK(client.metrics_to_json(metrics) == expected);
 }
+
+TEST_CASE("HttpClient retries transport errors, then fails fast while the breaker is open") {
+    HttpClientOptions options;
+    options.connect_timeout_ms = 200;
+    options.request_timeout_ms = 500;
+    options.retry.max_attempts = 2;
+    options.retry.base_delay = std::chrono::milliseconds(1);
+    options.retry.max_delay = std::chrono::milliseconds(2);
+    options.retry.breaker_failure_threshold = 1;
+    options.retry.breaker_open = std::chrono::milliseconds(60000);
+    options.retry.breaker_max_open = std::chrono::milliseconds(60000);
+    options.jitter_seed = 1;
+    HttpClient client("http://127.0.0.1:1", options);
+
+    SystemMetrics metrics{};
+    CHECK_FALSE(client.send_metrics(metrics));
+    CHECK(client.last_attempts() == 2);
+    CHECK(client.last_http_status() == 0);
+    REQUIRE(client.circuit_state() == CircuitState::open);
+
+    CHECK_FALSE(client.send_metrics(metrics));
+    CHECK(client.last_attempts() == 0);
+    CHECK(client.last_error().find("Circuit breaker open") != std::string::npos);
+
+    client.cancel_retries();
+    CHECK_FALSE(client.wait_for_circuit());
+}
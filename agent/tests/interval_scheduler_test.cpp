@@ -0,0 +1,101 @@
+#include "interval_scheduler.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <chrono>
+#include <thread>
+
+using std::chrono::milliseconds;
+using std::chrono::steady_clock;
+
+TEST_CASE("advance_deadline keeps the cadence when a cycle finishes in time") {
+    const steady_clock::time_point start{};
+    steady_clock::time_point deadline = start;
+
+    CHECK(advance_deadline(deadline, start + milliseconds(40), milliseconds(250)) == 0);
+    CHECK(deadline == start + milliseconds(250));
+
+    // Work that ends exactly on the next slot still runs in that slot.
+    CHECK(advance_deadline(deadline, start + milliseconds(500), milliseconds(250)) == 0);
+    CHECK(deadline == start + milliseconds(500));
+}
+
+TEST_CASE("advance_deadline skips missed slots without shifting the phase") {
+    const steady_clock::time_point start{};
+    steady_clock::time_point deadline = start;
+
+    CHECK(advance_deadline(deadline, start + milliseconds(300), milliseconds(250)) == 1);
+    CHECK(deadline == start + milliseconds(500));
+
+    CHECK(advance_deadline(deadline, start + milliseconds(1510), milliseconds(250)) == 4);
+    CHECK(deadline == start + milliseconds(1750));
+}
+
+TEST_CASE("IntervalScheduler returns at once first and stop wakes a pending wait") {
+    IntervalScheduler scheduler(milliseconds(60 * 60 * 1000));
+    CHECK(scheduler.wait_next());
+
+    std::thread stopper([&]() {
+        std::this_thread::sleep_for(milliseconds(20));
+        scheduler.stop();
+    });
+
+    const auto before = steady_clock::now();
+    CHECK_FALSE(scheduler.wait_next());
+    CHECK(steady_clock::now() - before < std::chrono::seconds(5));
+    stopper.join();
+
+    CHECK_FALSE(scheduler.wait_next());
+    CHECK(scheduler.overruns() == 0);
+}
+
+TEST_CASE("IntervalScheduler uses a changed interval from the next slot") {
+    IntervalScheduler scheduler(milliseconds(60 * 60 * 1000));
+    REQUIRE(scheduler.wait_next());
+    scheduler.set_interval(milliseconds(10));
+
+    const auto before = steady_clock::now();
+    REQUIRE(scheduler.wait_next());
+    CHECK(steady_clock::now() - before < std::chrono::seconds(5));
+    CHECK(scheduler.slot() == 1);
+    CHECK(scheduler.overruns() == 0);
+}
+
+TEST_CASE("IntervalScheduler counts an overrunning cycle") {
+    IntervalScheduler scheduler(milliseconds(10));
+    REQUIRE(scheduler.wait_next());
+    std::this_thread::sleep_for(milliseconds(35));
+    REQUIRE(scheduler.wait_next());
+
+    CHECK(scheduler.last_skipped() >= 1);
+    CHECK(scheduler.overruns() == 1);
+    CHECK(scheduler.skipped_slots() == scheduler.last_skipped());
+}
+
+TEST_CASE("CollectionTiers runs each tier at its own period") {
+    CollectionTiers tiers;
+    tiers.add(1u, 1);
+    tiers.add(2u, 4);
+    tiers.add(4u, 20);
+
+    CHECK(tiers.due(0) == 7u);
+    CHECK(tiers.due(1) == 1u);
+    CHECK(tiers.due(3) == 1u);
+    CHECK(tiers.due(4) == 3u);
+    CHECK(tiers.due(8) == 3u);
+    CHECK(tiers.due(19) == 3u);
+    CHECK(tiers.due(20) == 5u);
+}
+
+TEST_CASE("CollectionTiers runs a tier whose slot was skipped on the next slot") {
+    CollectionTiers tiers;
+    tiers.add(1u, 1);
+    tiers.add(2u, 4);
+
+    CHECK(tiers.due(0) == 3u);
+    CHECK(tiers.due(3) == 1u);
+    // Slots 4 and 5 were skipped by an overrun.
+    CHECK(tiers.due(6) == 3u);
+    CHECK(tiers.due(9) == 1u);
+    CHECK(tiers.due(10) == 3u);
+}
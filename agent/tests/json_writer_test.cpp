@@ -0,0 +1,109 @@
+#include "json_writer.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <string>
+
+namespace {
+std::string json_string(std::string_view value) {
+    std::string out;
+    append_json_string(out, value);
+    return out;
+}
+
+std::string fixed2(double value) {
+    std::string out;
+    append_json_fixed2(out, value);
+    return out;
+}
+}  // namespace
+
+TEST_CASE("append_json_string escapes quotes, backslashes and control characters") {
+    CHECK(json_string("plain") == "\"plain\"");
+    CHECK(json_string("say \"hi\"") == "\"say \\\"hi\\\"\"");
+    CHECK(json_string("C:\\tools\\agent.exe") == "\"C:\\\\tools\\\\agent.exe\"");
+    CHECK(json_string("tab\there\nnext") == "\"tab\\there\\nnext\"");
+    CHECK(json_string(std::string_view("\x01\x1f", 2)) == "\"\\u0001\\u001f\"");
+    CHECK(json_string("") == "\"\"");
+}
+
+TEST_CASE("append_json_string keeps valid UTF-8 and replaces invalid bytes") {
+    CHECK(json_string("caf\xc3\xa9") == "\"caf\xc3\xa9\"");
+    CHECK(json_string("\xe2\x82\xac") == "\"\xe2\x82\xac\"");
+    CHECK(json_string("\xf0\x9f\x98\x80") == "\"\xf0\x9f\x98\x80\"");
+    CHECK(json_string("bad\xff") == "\"bad\\ufffd\"");
+    CHECK(json_string("cut\xc3") == "\"cut\\ufffd\"");
+    CHECK(json_string("\xc0\xaf") == "\"\\ufffd\\ufffd\"");
+    CHECK(json_string("\xed\xa0\x80") == "\"\\ufffd\\ufffd\\ufffd\"");
+}
+
+TEST_CASE("append_json_fixed2 matches fixed two-decimal stream output") {
+    CHECK(fixed2(0.0) == "0.00");
+    CHECK(fixed2(12.345) == "12.35");
+    CHECK(fixed2(98.765) == "98.77");
+    CHECK(fixed2(1024.25) == "1024.25");
+    CHECK(fixed2(-3.5) == "-3.50");
+    CHECK(fixed2(16000.0) == "16000.00");
+    CHECK(fixed2(0.005) == "0.01");
+}
+
+TEST_CASE("append_metrics_json escapes process names") {
+    SystemMetrics metrics{};
+    metrics.timestamp = 1700000002;
+    metrics.timestamp_ms = 1700000002500;
+    metrics.top_processes = {ProcessMetrics{7, "a\"b", 0.0, 0.0, 0, 0.0, 0.0, 0}};
+
+    std::string out = "prefix:";
+    append_metrics_json(out, metrics);
+
+    CHECK(out ==
+          "prefix:{\"timestamp\":1700000002,\"timestamp_ms\":1700000002500,\"total_cpu_percent\":0.00,\"per_core_cpu_percent\":[],"
+          "\"system_memory_total_mb\":0.00,\"system_memory_used_mb\":0.00,\"top_processes\":["
+          "{\"pid\":7,\"name\":\"a\\\"b\",\"cpu_percent\":0.00,\"memory_mb\":0.00,\"thread_count\":0,"
+          "\"io_read_mb\":0.00,\"io_write_mb\":0.00,\"handle_count\":0}]}");
+}
+
+TEST_CASE("append_metrics_json writes top_cgroups only when present") {
+    SystemMetrics metrics{};
+    metrics.timestamp = 1700000002;
+    metrics.timestamp_ms = 1700000002500;
+
+    std::string out;
+    append_metrics_json(out, metrics);
+    CHECK(out.find("top_cgroups") == std::string::npos);
+
+    metrics.top_cgroups = {CgroupMetrics{"kubepods.slice/pod-a/ctr-1", 150.5, 256.25, 10.5, 2.0}};
+    out.clear();
+    append_metrics_json(out, metrics);
+    CHECK(out ==
+          "{\"timestamp\":1700000002,\"timestamp_ms\":1700000002500,\"total_cpu_percent\":0.00,\"per_core_cpu_percent\":[],"
+          "\"system_memory_total_mb\":0.00,\"system_memory_used_mb\":0.00,\"top_processes\":[],\"top_cgroups\":["
+          "{\"path\":\"kubepods.slice/pod-a/ctr-1\",\"cpu_percent\":150.50,\"memory_mb\":256.25,"
+          "\"io_read_mb\":10.50,\"io_write_mb\":2.00}]}");
+}
+
+TEST_CASE("append_metrics_json writes the window of a summary") {
+    SystemMetrics metrics{};
+    metrics.timestamp = 1700000004;
+    metrics.timestamp_ms = 1700000004000;
+    metrics.per_core_cpu_percent = {25.0};
+    metrics.top_processes = {ProcessMetrics{7, "sh", 12.5, 4.0, 1, 0.0, 0.0, 3}};
+    metrics.window.samples = 4;
+    metrics.window.start_timestamp_ms = 1700000002500;
+    metrics.window.total_cpu_percent = WindowStats{10.0, 90.0, 25.0, 88.5};
+    metrics.window.per_core_cpu_percent = {WindowStats{0.0, 100.0, 25.0, 97.0}};
+    metrics.window.system_memory_used_mb = WindowStats{1.0, 2.0, 1.5, 2.0};
+    metrics.window.top_processes = {ProcessWindowMetrics{7, 2, WindowStats{5.0, 20.0, 12.5, 20.0}, WindowStats{4.0, 4.0, 4.0, 4.0}}};
+
+    std::string out;
+    append_metrics_json(out, metrics);
+    const size_t window = out.find(",\"window\":");
+    REQUIRE(window != std::string::npos);
+    CHECK(out.substr(window) ==
+          ",\"window\":{\"samples\":4,\"start_timestamp_ms\":1700000002500,"
+          "\"total_cpu_percent\":{\"min\":10.00,\"max\":90.00,\"mean\":25.00,\"p95\":88.50},"
+          "\"per_core_cpu_percent\":[{\"min\":0.00,\"max\":100.00,\"mean\":25.00,\"p95\":97.00}],"
+          "\"system_memory_used_mb\":{\"min\":1.00,\"max\":2.00,\"mean\":1.50,\"p95\":2.00},"
+          "\"top_processes\":[{\"pid\":7,\"samples\":2,\"cpu_percent\":{\"min\":5.00,\"max\":20.00,\"mean\":12.50,\"p95\":20.00},"
+          "\"memory_mb\":{\"min\":4.00,\"max\":4.00,\"mean\":4.00,\"p95\":4.00}}]}}");
+}
@@ -0,0 +1,200 @@
+#include "metrics_aggregator.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+SystemMetrics sample_at(int64_t timestamp_ms, double total_cpu, double memory_used_mb) {
+    SystemMetrics sample{};
+    sample.timestamp = static_cast<time_t>(timestamp_ms / 1000);
+    sample.timestamp_ms = timestamp_ms;
+    sample.total_cpu_percent = total_cpu;
+    sample.per_core_cpu_percent = {total_cpu, total_cpu / 2.0};
+    sample.system_memory_total_mb = 1024.0;
+    sample.system_memory_used_mb = memory_used_mb;
+    sample.fresh_families = kMetricFamilyAll;
+    return sample;
+}
+
+ProcessMetrics process(int pid, const std::string& name, double cpu_percent, double memory_mb) {
+    return ProcessMetrics{pid, name, cpu_percent, memory_mb, 1, 0.0, 0.0, 0};
+}
+}  // namespace
+
+TEST_CASE("P2Quantile is exact for up to five samples") {
+    P2Quantile quantile(0.95);
+    CHECK(quantile.value() == 0.0);
+
+    for (const double value : {3.0, 1.0, 2.0}) {
+        quantile.add(value);
+    }
+    CHECK(quantile.count() == 3);
+    CHECK(quantile.value() == 3.0);
+
+    P2Quantile median(0.5);
+    for (const double value : {5.0, 1.0, 4.0, 2.0, 3.0}) {
+        median.add(value);
+    }
+    CHECK(median.value() == 3.0);
+
+    median.reset();
+    median.add(7.0);
+    CHECK(median.count() == 1);
+    CHECK(median.value() == 7.0);
+}
+
+TEST_CASE("P2Quantile tracks the 95th percentile of a long stream") {
+    std::vector<double> values(2000);
+    std::iota(values.begin(), values.end(), 1.0);
+    std::mt19937 random(42);
+    std::shuffle(values.begin(), values.end(), random);
+
+    P2Quantile quantile(0.95);
+    for (const double value : values) {
+        quantile.add(value);
+    }
+    CHECK(quantile.count() == values.size());
+    CHECK(std::abs(quantile.value() - 1900.0) < 40.0);
+}
+
+TEST_CASE("RunningStats summarizes min, max, mean and p95") {
+    RunningStats stats;
+    CHECK(stats.summary().max == 0.0);
+
+    for (const double value : {10.0, 50.0, 20.0, 40.0}) {
+        stats.add(value);
+    }
+    const WindowStats summary = stats.summary();
+    CHECK(summary.min == 10.0);
+    CHECK(summary.max == 50.0);
+    CHECK(summary.mean == 30.0);
+    CHECK(summary.p95 == 50.0);
+
+    stats.reset();
+    stats.add(5.0);
+    CHECK(stats.summary().mean == 5.0);
+    CHECK(stats.summary().min == 5.0);
+}
+
+TEST_CASE("MetricsAggregator emits one summary per window") {
+    MetricsAggregator aggregator(4, 2);
+    SystemMetrics summary{};
+
+    const double cpu[] = {10.0, 90.0, 20.0, 40.0};
+    for (size_t index = 0; index < 3; ++index) {
+        CHECK_FALSE(aggregator.add(sample_at(1000 + static_cast<int64_t>(index) * 500, cpu[index], 100.0 + index), summary));
+    }
+    REQUIRE(aggregator.add(sample_at(2500, cpu[3], 103.0), summary));
+
+    CHECK(summary.timestamp_ms == 2500);
+    CHECK(summary.total_cpu_percent == 40.0);
+    CHECK(summary.per_core_cpu_percent == std::vector<double>{40.0, 20.0});
+    CHECK(summary.system_memory_used_mb == 101.5);
+    CHECK(summary.system_memory_total_mb == 1024.0);
+    CHECK(summary.fresh_families == kMetricFamilyAll);
+
+    const MetricsWindow& window = summary.window;
+    CHECK(window.samples == 4);
+    CHECK(window.start_timestamp_ms == 1000);
+    CHECK(window.total_cpu_percent.min == 10.0);
+    CHECK(window.total_cpu_percent.max == 90.0);
+    CHECK(window.total_cpu_percent.p95 == 90.0);
+    REQUIRE(window.per_core_cpu_percent.size() == 2);
+    CHECK(window.per_core_cpu_percent[1].max == 45.0);
+    CHECK(window.system_memory_used_mb.max == 103.0);
+
+    // The next window starts from scratch.
+    CHECK_FALSE(aggregator.add(sample_at(3000, 50.0, 100.0), summary));
+    CHECK_FALSE(aggregator.add(sample_at(3500, 50.0, 100.0), summary));
+    CHECK_FALSE(aggregator.add(sample_at(4000, 50.0, 100.0), summary));
+    REQUIRE(aggregator.add(sample_at(4500, 50.0, 100.0), summary));
+    CHECK(summary.window.start_timestamp_ms == 3000);
+    CHECK(summary.window.total_cpu_percent.min == 50.0);
+}
+
+TEST_CASE("MetricsAggregator keeps processes that spiked during the window") {
+    MetricsAggregator aggregator(3, 2);
+    SystemMetrics summary{};
+
+    SystemMetrics first = sample_at(1000, 10.0, 100.0);
+    first.top_processes = {process(1, "steady", 20.0, 50.0), process(2, "idle", 5.0, 10.0)};
+    SystemMetrics second = sample_at(2000, 95.0, 100.0);
+    second.top_processes = {process(3, "burst", 90.0, 5.0), process(1, "steady", 20.0, 52.0)};
+    SystemMetrics third = sample_at(3000, 10.0, 100.0);
+    third.top_processes = {process(1, "steady", 20.0, 54.0), process(2, "idle", 6.0, 10.0)};
+
+    CHECK_FALSE(aggregator.add(first, summary));
+    CHECK_FALSE(aggregator.add(second, summary));
+    REQUIRE(aggregator.add(third, summary));
+
+    // The burst is gone by the last sample but had the highest peak.
+    REQUIRE(summary.top_processes.size() == 2);
+    CHECK(summary.top_processes[0].name == "burst");
+    CHECK(summary.top_processes[0].cpu_percent == 90.0);
+    CHECK(summary.top_processes[1].name == "steady");
+    CHECK(summary.top_processes[1].memory_mb == 52.0);
+
+    REQUIRE(summary.window.top_processes.size() == 2);
+    CHECK(summary.window.top_processes[0].pid == 3);
+    CHECK(summary.window.top_processes[0].samples == 1);
+    CHECK(summary.window.top_processes[1].pid == 1);
+    CHECK(summary.window.top_processes[1].samples == 3);
+    CHECK(summary.window.top_processes[1].memory_mb.min == 50.0);
+    CHECK(summary.window.top_processes[1].memory_mb.max == 54.0);
+}
+
+TEST_CASE("MetricsAggregator starts over when a PID is reused") {
+    MetricsAggregator aggregator(2, 1);
+    SystemMetrics summary{};
+
+    SystemMetrics first = sample_at(1000, 10.0, 100.0);
+    first.top_processes = {process(5, "old", 80.0, 10.0)};
+    SystemMetrics second = sample_at(2000, 10.0, 100.0);
+    second.top_processes = {process(5, "new", 10.0, 20.0)};
+
+    CHECK_FALSE(aggregator.add(first, summary));
+    REQUIRE(aggregator.add(second, summary));
+    REQUIRE(summary.top_processes.size() == 1);
+    CHECK(summary.top_processes[0].name == "new");
+    CHECK(summary.window.top_processes[0].samples == 1);
+    CHECK(summary.window.top_processes[0].cpu_percent.max == 10.0);
+}
+
+TEST_CASE("MetricsAggregator only weighs freshly sampled families") {
+    MetricsAggregator aggregator(3, 1);
+    SystemMetrics summary{};
+
+    // Memory is sampled on the first tick only; later ticks carry it over.
+    SystemMetrics first = sample_at(1000, 10.0, 100.0);
+    first.top_processes = {process(1, "a", 10.0, 1.0)};
+    SystemMetrics second = sample_at(2000, 20.0, 100.0);
+    second.top_processes = first.top_processes;
+    second.fresh_families = kMetricFamilyCpu;
+    SystemMetrics third = sample_at(3000, 30.0, 100.0);
+    third.top_processes = first.top_processes;
+    third.fresh_families = kMetricFamilyCpu;
+
+    CHECK_FALSE(aggregator.add(first, summary));
+    CHECK_FALSE(aggregator.add(second, summary));
+    REQUIRE(aggregator.add(third, summary));
+    CHECK(summary.window.total_cpu_percent.mean == 20.0);
+    CHECK(summary.window.top_processes[0].samples == 1);
+
+    // A family that was never fresh in a window is summarized once from
+    // its carried-over value.
+    for (int64_t timestamp_ms : {4000, 5000, 6000}) {
+        SystemMetrics cpu_only = sample_at(timestamp_ms, 40.0, 200.0);
+        cpu_only.fresh_families = kMetricFamilyCpu;
+        aggregator.add(cpu_only, summary);
+    }
+    CHECK(summary.fresh_families == kMetricFamilyCpu);
+    CHECK(summary.window.system_memory_used_mb.mean == 200.0);
+    CHECK(summary.system_memory_used_mb == 200.0);
+    CHECK(summary.top_processes.empty());
+}
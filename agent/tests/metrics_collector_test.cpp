@@ -2,19 +2,35 @@
 
 #include <catch2/catch_test_macros.hpp>
 
+#include <chrono>
 #include <cmath>
-#include <ctime>
+
+#if defined(__linux__)
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <unistd.h>
+#endif
 
 TEST_CASE("MetricsCollector::collect returns valid timestamp and bounded process list") {
     MetricsCollector collector;
 
-    const std::time_t before = std::time(nullptr);
+    // Read the clock the collector uses; std::time may run on a coarser one.
+    const auto unix_seconds = []() {
+        return std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    };
+    const auto before = unix_seconds();
     const SystemMetrics metrics = collector.collect();
-    const std::time_t after = std::time(nullptr);
+    const auto after = unix_seconds();
 
     CHECK(metrics.timestamp >= before);
     CHECK(metrics.timestamp <= after);
-    CHECK(metrics.top_processes.size() <= 12);
+    CHECK(metrics.top_processes.size() <= CollectorOptions{}.top_n);
     CHECK(std::isfinite(metrics.total_cpu_percent));
     CHECK(metrics.total_cpu_percent >= 0.0);
     CHECK(std::isfinite(metrics.system_memory_total_mb));
@@ -49,3 +65,404 @@ TEST_CASE("MetricsCollector::collect returns non-negative per-process metrics")
         CHECK(process.handle_count >= 0);
     }
 }
+
+TEST_CASE("MetricsCollector::collect derives process CPU from the previous cycle") {
+    MetricsSelection selection{};
+    selection.total_cpu = false;
+    selection.per_core_cpu = false;
+    selection.system_memory = false;
+    MetricsCollector collector(selection);
+
+    const SystemMetrics baseline = collector.collect();
+    for (const auto& process : baseline.top_processes) {
+        CHECK(process.cpu_percent == 0.0);
+    }
+
+    const SystemMetrics second = collector.collect();
+    CHECK(second.top_processes.size() <= CollectorOptions{}.top_n);
+    for (const auto& process : second.top_processes) {
+        CHECK(std::isfinite(process.cpu_percent));
+        CHECK(process.cpu_percent >= 0.0);
+    }
+}
+
+TEST_CASE("MetricsCollector::collect leaves disabled per-process probes at zero") {
+    MetricsSelection selection{};
+    selection.process_threads = false;
+    selection.process_io = false;
+    selection.process_handles = false;
+    MetricsCollector collector(selection);
+    const SystemMetrics metrics = collector.collect();
+
+    for (const auto& process : metrics.top_processes) {
+        CHECK(process.thread_count == 0);
+        CHECK(process.io_read_mb == 0.0);
+        CHECK(process.io_write_mb == 0.0);
+        CHECK(process.handle_count == 0);
+    }
+}
+
+TEST_CASE("MetricsCollector::set_selection applies from the next collect") {
+    MetricsCollector collector;
+    SystemMetrics metrics = collector.collect();
+
+    MetricsSelection selection{};
+    selection.per_core_cpu = false;
+    selection.system_memory = false;
+    selection.top_processes = false;
+    collector.set_selection(selection);
+    collector.collect(metrics);
+
+    CHECK(metrics.per_core_cpu_percent.empty());
+    CHECK(metrics.system_memory_total_mb == 0.0);
+    CHECK(metrics.top_processes.empty());
+
+#if defined(__linux__)
+    collector.set_selection(MetricsSelection{});
+    collector.collect(metrics);
+    CHECK(metrics.system_memory_total_mb > 0.0);
+#endif
+}
+
+TEST_CASE("MetricsCollector::collect with a parallel process scan matches the bounded contract") {
+    CollectorOptions options;
+    options.collector_threads = 4;
+    MetricsCollector collector(MetricsSelection{}, options);
+
+    collector.collect();
+    const SystemMetrics metrics = collector.collect();
+    CHECK(metrics.top_processes.size() <= CollectorOptions{}.top_n);
+    for (const auto& process : metrics.top_processes) {
+        CHECK(process.pid > 0);
+        CHECK_FALSE(process.name.empty());
+        CHECK(process.cpu_percent >= 0.0);
+    }
+}
+
+TEST_CASE("MetricsCollector::collect honours top_n and ranks by CPU then memory") {
+    CollectorOptions options;
+    options.top_n = 3;
+    MetricsCollector collector(MetricsSelection{}, options);
+
+    collector.collect();
+    const SystemMetrics metrics = collector.collect();
+    CHECK(metrics.top_processes.size() <= 3);
+
+    for (size_t index = 1; index < metrics.top_processes.size(); ++index) {
+        const auto& previous = metrics.top_processes[index - 1];
+        const auto& current = metrics.top_processes[index];
+        CHECK(previous.cpu_percent >= current.cpu_percent);
+        if (previous.cpu_percent == current.cpu_percent) {
+            CHECK(previous.memory_mb >= current.memory_mb);
+        }
+    }
+}
+
+TEST_CASE("MetricsCollector::collect overwrites a recycled snapshot") {
+    MetricsSelection selection{};
+    selection.per_core_cpu = false;
+    selection.process_threads = false;
+    selection.process_io = false;
+    selection.process_handles = false;
+    MetricsCollector collector(selection);
+
+    // Stale contents from an earlier cycle, as the sender hands them back.
+    SystemMetrics metrics;
+    metrics.per_core_cpu_percent.assign(8, 50.0);
+    metrics.top_processes.resize(CollectorOptions{}.top_n + 4);
+    for (auto& process : metrics.top_processes) {
+        process.name = "stale";
+        process.thread_count = 99;
+        process.io_read_mb = 1.0;
+        process.io_write_mb = 1.0;
+        process.handle_count = 99;
+    }
+
+    collector.collect(metrics);
+
+    CHECK(metrics.per_core_cpu_percent.empty());
+    CHECK(metrics.top_processes.size() <= CollectorOptions{}.top_n);
+    for (const auto& process : metrics.top_processes) {
+        CHECK(process.name != "stale");
+        CHECK(process.thread_count == 0);
+        CHECK(process.io_read_mb == 0.0);
+        CHECK(process.io_write_mb == 0.0);
+        CHECK(process.handle_count == 0);
+    }
+}
+
+TEST_CASE("MetricsCollector::collect re-samples only the requested families") {
+    MetricsCollector collector;
+    SystemMetrics metrics{};
+    collector.collect(metrics);
+    CHECK(metrics.fresh_families == kMetricFamilyAll);
+
+    // Sentinels survive when their family is not due.
+    metrics.system_memory_total_mb = -1.0;
+    metrics.top_processes.assign(1, ProcessMetrics{-7, "carried", 0.0, 0.0, 0, 0.0, 0.0, 0});
+
+    collector.collect(metrics, kMetricFamilyCpu);
+    CHECK(metrics.fresh_families == kMetricFamilyCpu);
+    CHECK(metrics.system_memory_total_mb == -1.0);
+    REQUIRE(metrics.top_processes.size() == 1);
+    CHECK(metrics.top_processes[0].pid == -7);
+    CHECK(metrics.total_cpu_percent >= 0.0);
+
+    collector.collect(metrics, kMetricFamilyMemory | kMetricFamilyProcesses);
+    CHECK(metrics.fresh_families == (kMetricFamilyMemory | kMetricFamilyProcesses));
+    CHECK(metrics.system_memory_total_mb >= 0.0);
+    for (const auto& process : metrics.top_processes) {
+        CHECK(process.pid >= 0);
+    }
+}
+
+#if defined(__linux__)
+TEST_CASE("MetricsCollector::collect reads the configured proc_root") {
+    const std::filesystem::path root = std::filesystem::temp_directory_path() /
+        ("metrics-agent-collector-root-" + std::to_string(getpid()));
+    const auto write = [](const std::filesystem::path& path, const std::string& contents) {
+        std::ofstream(path) << contents;
+    };
+    std::filesystem::create_directories(root);
+    write(root / "stat", "cpu  100 0 100 800 0 0 0 0\ncpu0 100 0 100 800 0 0 0 0\n");
+    write(root / "meminfo", "MemTotal: 2048000 kB\nMemAvailable: 1024000 kB\n");
+    for (const int pid : {300, 301}) {
+        const std::filesystem::path directory = root / std::to_string(pid);
+        std::filesystem::create_directories(directory / "fd");
+        write(directory / "stat", std::to_string(pid) + " (replayed) S 1 1 1 0 -1 0 0 0 0 0 10 5 0 0 20 0 1 0 77 0 " +
+            std::to_string(pid == 300 ? 256 : 4096));
+        write(directory / "fd" / "0", "");
+    }
+
+    CollectorOptions options;
+    options.proc_root = root.string();
+    MetricsCollector collector(MetricsSelection{}, options);
+    collector.collect();
+    const SystemMetrics metrics = collector.collect();
+
+    CHECK(std::abs(metrics.system_memory_total_mb - 2000.0) < 0.01);
+    REQUIRE(metrics.top_processes.size() == 2);
+    CHECK(metrics.top_processes[0].pid == 301);
+    CHECK(metrics.top_processes[1].pid == 300);
+    CHECK(metrics.top_processes[0].name == "replayed");
+    CHECK(metrics.top_processes[0].handle_count == 1);
+
+    std::filesystem::remove_all(root);
+}
+
+TEST_CASE("MetricsCollector::collect reuses its scan workers across cycles") {
+    const std::filesystem::path root = std::filesystem::temp_directory_path() /
+        ("metrics-agent-collector-workers-" + std::to_string(getpid()));
+    const auto write = [](const std::filesystem::path& path, const std::string& contents) {
+        std::ofstream(path) << contents;
+    };
+    std::filesystem::create_directories(root);
+    write(root / "stat", "cpu  100 0 100 800 0 0 0 0\ncpu0 100 0 100 800 0 0 0 0\n");
+    write(root / "meminfo", "MemTotal: 2048000 kB\nMemAvailable: 1024000 kB\n");
+    // Enough PIDs for all four threads to take part in every scan.
+    for (int pid = 1000; pid < 2100; ++pid) {
+        const std::filesystem::path directory = root / std::to_string(pid);
+        std::filesystem::create_directories(directory);
+        write(directory / "stat", std::to_string(pid) + " (worker) S 1 1 1 0 -1 0 0 0 0 0 10 5 0 0 20 0 1 0 77 0 " +
+            std::to_string(pid));
+    }
+
+    MetricsSelection selection{};
+    selection.process_io = false;
+    selection.process_handles = false;
+    CollectorOptions options;
+    options.proc_root = root.string();
+    options.collector_threads = 4;
+    options.top_n = 2;
+    MetricsCollector collector(selection, options);
+
+    SystemMetrics metrics = collector.collect();
+    for (int cycle = 0; cycle < 5; ++cycle) {
+        collector.collect(metrics);
+        REQUIRE(metrics.top_processes.size() == 2);
+        CHECK(metrics.top_processes[0].pid == 2099);
+        CHECK(metrics.top_processes[1].pid == 2098);
+    }
+
+    std::filesystem::remove_all(root);
+}
+#endif
+
+#if defined(__linux__)
+TEST_CASE("MetricsCollector::collect keeps CPU baselines per collector") {
+    const std::filesystem::path root = std::filesystem::temp_directory_path() /
+        ("metrics-agent-collector-cpu-" + std::to_string(getpid()));
+    const auto write_stat = [&root](const std::string& contents) {
+        std::ofstream(root / "stat") << contents;
+    };
+    std::filesystem::create_directories(root);
+    write_stat("cpu  300 0 300 2400 0 0 0 0\n"
+               "cpu0 100 0 100 800 0 0 0 0\n"
+               "cpu1 100 0 100 800 0 0 0 0\n"
+               "cpu2 100 0 100 800 0 0 0 0\n");
+
+    MetricsSelection selection;
+    selection.top_processes = false;
+    selection.top_cgroups = false;
+    CollectorOptions options;
+    options.proc_root = root.string();
+    MetricsCollector first(selection, options);
+    MetricsCollector second(selection, options);
+    first.collect();
+
+    // Half busy, idle, fully busy.
+    write_stat("cpu  450 0 300 2550 0 0 0 0\n"
+               "cpu0 150 0 100 850 0 0 0 0\n"
+               "cpu1 100 0 100 900 0 0 0 0\n"
+               "cpu2 200 0 100 800 0 0 0 0\n");
+    const SystemMetrics baseline = second.collect();
+    CHECK(baseline.total_cpu_percent == 0.0);
+    CHECK(baseline.per_core_cpu_percent == std::vector<double>{0.0, 0.0, 0.0});
+
+    // The second collector's baseline does not reset the first one's.
+    const SystemMetrics metrics = first.collect();
+    CHECK(std::abs(metrics.total_cpu_percent - 50.0) < 0.01);
+    CHECK(metrics.per_core_cpu_percent == std::vector<double>{50.0, 0.0, 100.0});
+
+    std::filesystem::remove_all(root);
+}
+#endif
+
+#if defined(__linux__)
+TEST_CASE("MetricsCollector::collect keeps working with process events requested") {
+    MetricsCollector collector;
+    std::string error;
+    if (!collector.enable_process_events(error)) {
+        CHECK_FALSE(error.empty());
+    }
+
+    collector.collect();
+    const SystemMetrics metrics = collector.collect();
+    CHECK_FALSE(metrics.top_processes.empty());
+    CHECK(metrics.top_processes.size() <= CollectorOptions{}.top_n);
+}
+#endif
+
+#if defined(__linux__)
+TEST_CASE("MetricsCollector::collect reads the same processes through io_uring") {
+    const std::filesystem::path root =
+        std::filesystem::temp_directory_path() / ("metrics-agent-collector-uring-" + std::to_string(::getpid()));
+    std::filesystem::remove_all(root);
+    std::filesystem::create_directories(root);
+    std::ofstream(root / "stat") << "cpu  100 0 100 800 0 0 0 0\n";
+    std::ofstream(root / "meminfo") << "MemTotal: 2048 kB\nMemAvailable: 512 kB\n";
+    for (int pid = 100; pid < 300; ++pid) {
+        std::filesystem::create_directories(root / std::to_string(pid));
+        std::ofstream(root / std::to_string(pid) / "stat") << pid << " (proc" << pid << ") S 1 1 1 0 -1 0 0 0 0 0 "
+            << pid << " 0 0 0 20 0 1 0 " << pid << " 0 " << pid;
+    }
+
+    CollectorOptions options;
+    options.proc_root = root.string();
+    MetricsCollector plain({}, options);
+    MetricsCollector batched({}, options);
+    std::string error;
+    if (!batched.enable_io_uring(error)) {
+        CHECK_FALSE(error.empty());
+    }
+
+    const SystemMetrics expected = plain.collect();
+    const SystemMetrics metrics = batched.collect();
+    REQUIRE(metrics.top_processes.size() == expected.top_processes.size());
+    for (size_t index = 0; index < metrics.top_processes.size(); ++index) {
+        CHECK(metrics.top_processes[index].pid == expected.top_processes[index].pid);
+        CHECK(metrics.top_processes[index].name == expected.top_processes[index].name);
+        CHECK(metrics.top_processes[index].memory_mb == expected.top_processes[index].memory_mb);
+    }
+
+    std::filesystem::remove_all(root);
+}
+#endif
+
+#if defined(__linux__)
+TEST_CASE("MetricsCollector::collect ranks the configured cgroups") {
+    const std::filesystem::path root =
+        std::filesystem::temp_directory_path() / ("metrics-agent-collector-cgroups-" + std::to_string(::getpid()));
+    std::filesystem::remove_all(root);
+    const auto write = [](const std::filesystem::path& path, const std::string& contents) {
+        std::ofstream(path) << contents;
+    };
+    std::filesystem::create_directories(root);
+    write(root / "cgroup.controllers", "cpu memory io\n");
+    for (const auto& [name, memory_bytes] : {std::pair<const char*, int>{"small", 1048576}, {"large", 8388608}}) {
+        const std::filesystem::path directory = root / "pod" / name;
+        std::filesystem::create_directories(directory);
+        write(directory / "cpu.stat", "usage_usec 1000\n");
+        write(directory / "memory.current", std::to_string(memory_bytes));
+        write(directory / "io.stat", "8:0 rbytes=2097152 wbytes=0\n");
+    }
+
+    MetricsSelection selection{};
+    selection.top_processes = false;
+    CollectorOptions options;
+    options.cgroup_root = root.string();
+    options.top_n = 1;
+    MetricsCollector collector(selection, options);
+    collector.collect();
+    const SystemMetrics metrics = collector.collect();
+
+    REQUIRE(metrics.top_cgroups.size() == 1);
+    CHECK(metrics.top_cgroups[0].path == "pod/large");
+    CHECK(metrics.top_cgroups[0].cpu_percent == 0.0);
+    CHECK(std::abs(metrics.top_cgroups[0].memory_mb - 8.0) < 0.01);
+    CHECK(std::abs(metrics.top_cgroups[0].io_read_mb - 2.0) < 0.01);
+
+    selection.top_cgroups = false;
+    MetricsCollector disabled(selection, options);
+    CHECK(disabled.collect().top_cgroups.empty());
+
+    std::filesystem::remove_all(root);
+}
+
+TEST_CASE("MetricsCollector::collect keeps cgroup CPU baselines only while the cgroup exists") {
+    const std::filesystem::path root =
+        std::filesystem::temp_directory_path() / ("metrics-agent-collector-cgroup-baselines-" + std::to_string(::getpid()));
+    std::filesystem::remove_all(root);
+    const auto write = [](const std::filesystem::path& path, const std::string& contents) {
+        std::ofstream(path) << contents;
+    };
+    const std::filesystem::path directory = root / "pod" / "ctr";
+    const auto create_cgroup = [&](uint64_t usage_usec) {
+        std::filesystem::create_directories(directory);
+        write(directory / "cpu.stat", "usage_usec " + std::to_string(usage_usec) + "\n");
+        write(directory / "memory.current", "1048576");
+        write(directory / "io.stat", "");
+    };
+    std::filesystem::create_directories(root);
+    write(root / "cgroup.controllers", "cpu memory io\n");
+    create_cgroup(1000);
+
+    MetricsSelection selection{};
+    selection.top_processes = false;
+    CollectorOptions options;
+    options.cgroup_root = root.string();
+    MetricsCollector collector(selection, options);
+    SystemMetrics metrics = collector.collect();
+
+    // Wait long enough for the system CPU time to advance a few ticks.
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    create_cgroup(1000 + 50000);
+    collector.collect(metrics);
+    REQUIRE(metrics.top_cgroups.size() == 1);
+    CHECK(metrics.top_cgroups[0].cpu_percent > 0.0);
+
+    // Gone for a cycle: the returning cgroup gets no delta against its old usage.
+    std::filesystem::remove_all(directory);
+    collector.collect(metrics);
+    for (const auto& cgroup : metrics.top_cgroups) {
+        CHECK(cgroup.path != "pod/ctr");
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    create_cgroup(1000 + 900000);
+    collector.collect(metrics);
+    REQUIRE(metrics.top_cgroups.size() == 1);
+    CHECK(metrics.top_cgroups[0].cpu_percent == 0.0);
+
+    std::filesystem::remove_all(root);
+}
+#endif
@@ -0,0 +1,65 @@
+#include "metrics_endpoint.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <string>
+
+#if !defined(_WIN32)
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+std::string request(uint16_t port, const std::string& raw) {
+    const int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    REQUIRE(fd >= 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    ::inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+    REQUIRE(::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0);
+    REQUIRE(::send(fd, raw.data(), raw.size(), 0) == static_cast<ssize_t>(raw.size()));
+
+    std::string response;
+    char chunk[512];
+    ssize_t count = 0;
+    while ((count = ::recv(fd, chunk, sizeof(chunk), 0)) > 0) {
+        response.append(chunk, static_cast<size_t>(count));
+    }
+    ::close(fd);
+    return response;
+}
+}  // namespace
+
+TEST_CASE("MetricsEndpoint serves the rendered body on GET /metrics only") {
+    int renders = 0;
+    MetricsEndpoint endpoint("127.0.0.1", 0, [&renders](std::string& body) {
+        ++renders;
+        body += "metrics_agent_collections_total 3\n";
+    });
+    std::string error;
+    REQUIRE(endpoint.start(error));
+    REQUIRE(endpoint.port() != 0);
+
+    const std::string ok = request(endpoint.port(), "GET /metrics?x=1 HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    CHECK(ok.rfind("HTTP/1.1 200 OK\r\n", 0) == 0);
+    CHECK(ok.find("Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n") != std::string::npos);
+    CHECK(ok.find("Content-Length: 34\r\n") != std::string::npos);
+    CHECK(ok.find("\r\n\r\nmetrics_agent_collections_total 3\n") != std::string::npos);
+
+    CHECK(request(endpoint.port(), "GET / HTTP/1.1\r\n\r\n").rfind("HTTP/1.1 404 Not Found\r\n", 0) == 0);
+    CHECK(request(endpoint.port(), "POST /metrics HTTP/1.1\r\n\r\n").rfind("HTTP/1.1 405 Method Not Allowed\r\n", 0) == 0);
+
+    endpoint.stop();
+    endpoint.stop();
+    CHECK(renders == 1);
+}
+
+TEST_CASE("MetricsEndpoint rejects an invalid listen address") {
+    MetricsEndpoint endpoint("not-an-address", 0, [](std::string&) {});
+    std::string error;
+    CHECK_FALSE(endpoint.start(error));
+    CHECK(error.find("not-an-address") != std::string::npos);
+}
+#endif
@@ -0,0 +1,115 @@
+#include "proc_connector.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#if defined(__linux__)
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+namespace {
+ProcessEvent started(int pid) {
+    return {ProcessEvent::Kind::started, pid};
+}
+
+ProcessEvent exited(int pid) {
+    return {ProcessEvent::Kind::exited, pid};
+}
+
+// Scratch reused across calls, as the scanner does.
+std::vector<uint64_t> changed;
+std::vector<int> merged;
+
+void apply(std::vector<int>& pids, const std::vector<ProcessEvent>& events) {
+    apply_process_events(pids, events, changed, merged);
+}
+}  // namespace
+
+TEST_CASE("apply_process_events inserts and removes PIDs in order") {
+    std::vector<int> pids{1, 10, 20, 30};
+    apply(pids, {started(15), exited(20), started(5), started(40), exited(99)});
+
+    CHECK(pids == std::vector<int>{1, 5, 10, 15, 30, 40});
+}
+
+TEST_CASE("apply_process_events keeps the last state of a PID") {
+    std::vector<int> pids{7, 8};
+
+    // 8 exits and the PID is reused; 9 is born and dies within the batch.
+    apply(pids, {exited(8), started(8), started(9), exited(9)});
+    CHECK(pids == std::vector<int>{7, 8});
+
+    // exec reports an already known PID again.
+    apply(pids, {started(7), started(7)});
+    CHECK(pids == std::vector<int>{7, 8});
+}
+
+TEST_CASE("apply_process_events leaves the list alone without events") {
+    std::vector<int> pids{3, 4};
+    apply(pids, {});
+    CHECK(pids == std::vector<int>{3, 4});
+
+    std::vector<int> empty;
+    apply(empty, {started(2), started(1)});
+    CHECK(empty == std::vector<int>{1, 2});
+}
+
+TEST_CASE("apply_process_events reuses its scratch buffers") {
+    std::vector<int> pids{1, 2, 3, 4};
+    apply(pids, {started(5), exited(1), started(6), exited(6)});
+    REQUIRE(pids == std::vector<int>{2, 3, 4, 5});
+    apply(pids, {exited(5), started(1), started(7), exited(2)});
+    REQUIRE(pids == std::vector<int>{1, 3, 4, 7});
+
+    // Both PID buffers have grown by now; they only trade places.
+    const uint64_t* changed_data = changed.data();
+    const int* pids_data = pids.data();
+    const int* merged_data = merged.data();
+    apply(pids, {exited(7), started(2), started(8), exited(3)});
+    CHECK(pids == std::vector<int>{1, 2, 4, 8});
+    CHECK(changed.data() == changed_data);
+    CHECK(pids.data() == merged_data);
+    CHECK(merged.data() == pids_data);
+}
+
+TEST_CASE("ProcConnector reports a forked child starting and exiting") {
+    ProcConnector connector;
+    std::string error;
+    if (!connector.open(error)) {
+        // Subscribing needs CAP_NET_ADMIN; nothing to check without it.
+        return;
+    }
+
+    const pid_t child = ::fork();
+    REQUIRE(child >= 0);
+    if (child == 0) {
+        ::_exit(0);
+    }
+    int status = 0;
+    ::waitpid(child, &status, 0);
+
+    std::vector<ProcessEvent> events;
+    bool saw_start = false;
+    bool saw_exit = false;
+    for (int attempt = 0; attempt < 50 && !(saw_start && saw_exit); ++attempt) {
+        events.clear();
+        connector.poll(events);
+        for (const ProcessEvent& event : events) {
+            if (event.pid == child) {
+                saw_start = saw_start || event.kind == ProcessEvent::Kind::started;
+                saw_exit = saw_exit || event.kind == ProcessEvent::Kind::exited;
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    CHECK(saw_start);
+    CHECK(saw_exit);
+}
+#endif
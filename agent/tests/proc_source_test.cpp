@@ -0,0 +1,153 @@
+#include "proc_source.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#if defined(__linux__)
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+TEST_CASE("parse_linux_cpu_line aggregates idle and total jiffies") {
+    LinuxCpuTimes times{0, 0};
+    REQUIRE(parse_linux_cpu_line("cpu  100 20 30 400 50 6 7 8 9 10", times));
+    CHECK(times.idle_time == 450);
+    CHECK(times.total_time == 621);
+
+    REQUIRE(parse_linux_cpu_line("cpu3 1 2 3 4", times));
+    CHECK(times.idle_time == 4);
+    CHECK(times.total_time == 10);
+}
+
+TEST_CASE("parse_linux_cpu_line rejects malformed lines") {
+    LinuxCpuTimes times{0, 0};
+    CHECK_FALSE(parse_linux_cpu_line("intr 1 2 3 4", times));
+    CHECK_FALSE(parse_linux_cpu_line("cpu 1 2", times));
+    CHECK_FALSE(parse_linux_cpu_line("cpu", times));
+}
+
+TEST_CASE("LinuxProcSource re-reads system counters through persistent descriptors") {
+    LinuxProcSource source;
+
+    REQUIRE(source.refresh_cpu_times());
+    CHECK(source.has_cpu_times());
+    CHECK(source.total_cpu_times().total_time >= source.total_cpu_times().idle_time);
+    const auto first_total = source.total_cpu_times().total_time;
+    const auto core_count = source.per_core_cpu_times().size();
+    CHECK(core_count > 0);
+
+    REQUIRE(source.refresh_cpu_times());
+    CHECK(source.total_cpu_times().total_time >= first_total);
+    CHECK(source.per_core_cpu_times().size() == core_count);
+
+    uint64_t total_kb = 0;
+    uint64_t available_kb = 0;
+    REQUIRE(source.read_memory_info(total_kb, available_kb));
+    CHECK(total_kb > 0);
+    CHECK(available_kb <= total_kb);
+}
+#endif
+
+#if defined(__linux__)
+TEST_CASE("parse_linux_pid_stat extracts CPU, start time and RSS fields") {
+    const std::string_view line =
+        "4242 (my (odd) proc) S 1 4242 4242 0 -1 4194560 1234 0 5 0 "
+        "250 75 0 0 20 0 3 0 987654 1048576000 2560 18446744073709551615";
+
+    LinuxPidStat stat{};
+    REQUIRE(parse_linux_pid_stat(line, stat));
+    CHECK(stat.name == "my (odd) proc");
+    CHECK(stat.utime_ticks == 250);
+    CHECK(stat.stime_ticks == 75);
+    CHECK(stat.start_time_ticks == 987654);
+    CHECK(stat.num_threads == 3);
+    CHECK(stat.rss_pages == 2560);
+}
+
+TEST_CASE("parse_linux_pid_stat rejects truncated or malformed contents") {
+    LinuxPidStat stat{};
+    CHECK_FALSE(parse_linux_pid_stat("", stat));
+    CHECK_FALSE(parse_linux_pid_stat("12 (truncated S 1 2", stat));
+    CHECK_FALSE(parse_linux_pid_stat("12 (short) S 1 2 3", stat));
+    CHECK_FALSE(parse_linux_pid_stat("12 (bad) S 1 2 3 4 5 6 7 8 9 10 x 11 12 13 14 15 16 17 18 19 20", stat));
+}
+
+TEST_CASE("read_linux_pid_stat reads the current process") {
+    char buffer[kLinuxPidStatBufferSize];
+    LinuxPidStat stat{};
+    REQUIRE(read_linux_pid_stat(static_cast<int>(getpid()), buffer, sizeof(buffer), stat));
+    CHECK_FALSE(stat.name.empty());
+    CHECK(stat.rss_pages > 0);
+    CHECK_FALSE(read_linux_pid_stat(-1, buffer, sizeof(buffer), stat));
+}
+#endif
+
+#if defined(__linux__)
+TEST_CASE("read_linux_pid_fd_count and read_linux_pid_io probe the current process") {
+    const int self_pid = static_cast<int>(getpid());
+
+    int fd_count = 0;
+    REQUIRE(read_linux_pid_fd_count(self_pid, fd_count));
+    CHECK(fd_count >= 0);
+
+    uint64_t read_bytes = 0;
+    uint64_t write_bytes = 0;
+    CHECK(read_linux_pid_io(self_pid, read_bytes, write_bytes));
+    CHECK_FALSE(read_linux_pid_io(-1, read_bytes, write_bytes));
+}
+#endif
+
+#if defined(__linux__)
+TEST_CASE("ProcRoot points every reader at a copied procfs tree") {
+    const std::filesystem::path root = std::filesystem::temp_directory_path() /
+        ("metrics-agent-proc-root-" + std::to_string(getpid()));
+    std::filesystem::create_directories(root / "4242" / "fd");
+    const auto write = [](const std::filesystem::path& path, const char* contents) {
+        std::ofstream(path) << contents;
+    };
+    write(root / "stat", "cpu  100 0 100 800 0 0 0 0\ncpu0 100 0 100 800 0 0 0 0\n");
+    write(root / "meminfo", "MemTotal: 2048 kB\nMemAvailable: 512 kB\n");
+    write(root / "4242" / "stat", "4242 (fixture) S 1 4242 4242 0 -1 0 0 0 0 0 30 12 0 0 20 0 2 0 555 0 64");
+    write(root / "4242" / "io", "read_bytes: 4096\nwrite_bytes: 1024\n");
+    write(root / "4242" / "fd" / "0", "");
+    write(root / "4242" / "fd" / "1", "");
+
+    const ProcRoot proc_root(root.string() + "/");
+    CHECK(proc_root.path() == root.string());
+    CHECK_FALSE(proc_root.is_procfs());
+    CHECK(default_proc_root().is_procfs());
+
+    LinuxProcSource source(proc_root);
+    REQUIRE(source.refresh_cpu_times());
+    CHECK(source.total_cpu_times().total_time == 1000);
+    uint64_t total_kb = 0;
+    uint64_t available_kb = 0;
+    REQUIRE(source.read_memory_info(total_kb, available_kb));
+    CHECK(total_kb == 2048);
+
+    char buffer[kLinuxPidStatBufferSize];
+    LinuxPidStat stat{};
+    REQUIRE(read_linux_pid_stat(4242, buffer, sizeof(buffer), stat, proc_root));
+    CHECK(stat.name == "fixture");
+    CHECK(stat.rss_pages == 64);
+
+    int fd_count = 0;
+    REQUIRE(read_linux_pid_fd_count(4242, fd_count, proc_root));
+    CHECK(fd_count == 2);
+
+    uint64_t read_bytes = 0;
+    uint64_t write_bytes = 0;
+    REQUIRE(read_linux_pid_io(4242, read_bytes, write_bytes, proc_root));
+    CHECK(read_bytes == 4096);
+    CHECK(write_bytes == 1024);
+    CHECK_FALSE(read_linux_pid_stat(1, buffer, sizeof(buffer), stat, proc_root));
+
+    char small[16];
+    CHECK_FALSE(proc_root.format_pid_path(small, sizeof(small), 4242, "/stat"));
+
+    std::filesystem::remove_all(root);
+}
+#endif
@@ -0,0 +1,75 @@
+#include "proc_uring.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#if defined(__linux__)
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+TEST_CASE("ProcUringReader reads the stat files of a batch of PIDs") {
+    ProcUringReader reader;
+    std::string error;
+    if (!reader.open(default_proc_root(), error)) {
+        // Built without liburing, or io_uring is disabled in this sandbox.
+        CHECK_FALSE(error.empty());
+        return;
+    }
+
+    const int self_pid = static_cast<int>(getpid());
+    const int pids[] = {self_pid, -1, self_pid};
+    size_t lengths[3] = {};
+    REQUIRE(reader.read_stats(pids, 3, lengths));
+    CHECK(lengths[1] == 0);
+
+    char buffer[kLinuxPidStatBufferSize];
+    LinuxPidStat expected{};
+    REQUIRE(read_linux_pid_stat(self_pid, buffer, sizeof(buffer), expected));
+    for (size_t index : {size_t{0}, size_t{2}}) {
+        LinuxPidStat stat{};
+        REQUIRE(lengths[index] > 0);
+        REQUIRE(parse_linux_pid_stat(std::string_view(reader.buffer(index), lengths[index]), stat));
+        CHECK(stat.name == expected.name);
+        CHECK(stat.start_time_ticks == expected.start_time_ticks);
+    }
+
+    // The direct descriptor slots are released, so later batches still work.
+    for (int round = 0; round < 3; ++round) {
+        REQUIRE(reader.read_stats(pids, 1, lengths));
+        CHECK(lengths[0] > 0);
+    }
+}
+
+TEST_CASE("ProcUringReader follows the procfs root") {
+    const std::filesystem::path root = std::filesystem::temp_directory_path() /
+        ("metrics-agent-uring-root-" + std::to_string(getpid()));
+    std::filesystem::create_directories(root / "4242");
+    std::ofstream(root / "stat") << "cpu  100 0 100 800 0 0 0 0\n";
+    std::ofstream(root / "4242" / "stat") << "4242 (fixture) S 1 4242 4242 0 -1 0 0 0 0 0 30 12 0 0 20 0 2 0 555 0 64";
+
+    const ProcRoot proc_root(root.string());
+    ProcUringReader reader;
+    std::string error;
+    if (reader.open(proc_root, error)) {
+        const int pids[] = {4242, 4243};
+        size_t lengths[2] = {};
+        REQUIRE(reader.read_stats(pids, 2, lengths));
+        CHECK(lengths[1] == 0);
+
+        LinuxPidStat stat{};
+        REQUIRE(parse_linux_pid_stat(std::string_view(reader.buffer(0), lengths[0]), stat));
+        CHECK(stat.name == "fixture");
+        CHECK(stat.utime_ticks == 30);
+        CHECK(stat.rss_pages == 64);
+    } else {
+        CHECK_FALSE(error.empty());
+    }
+
+    std::filesystem::remove_all(root);
+}
+#endif
@@ -0,0 +1,126 @@
+#include "process_table.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <initializer_list>
+#include <string>
+
+namespace {
+struct ScanRow {
+    int pid;
+    const char* name;
+    uint64_t cpu_time;
+    uint64_t start_time;
+    uint64_t rss_pages;
+};
+
+void fill_scan(ProcessScanBuffer& scan, std::initializer_list<ScanRow> rows) {
+    scan.resize(rows.size());
+    size_t row = 0;
+    for (const auto& entry : rows) {
+        scan.pids[row] = entry.pid;
+        scan.cpu_times[row] = entry.cpu_time;
+        scan.start_times[row] = entry.start_time;
+        scan.rss_pages[row] = entry.rss_pages;
+        scan.thread_counts[row] = 1;
+        scan.set_name(row, entry.name);
+        scan.valid[row] = 1;
+        ++row;
+    }
+}
+}  // namespace
+
+TEST_CASE("ProcessTable reports zero deltas on the first update") {
+    ProcessScanBuffer scan;
+    fill_scan(scan, {{1, "init", 500, 1, 10}, {42, "worker", 80, 7, 20}});
+
+    ProcessTable table;
+    table.update(scan);
+
+    REQUIRE(table.size() == 2);
+    CHECK(table.pid(0) == 1);
+    CHECK(table.pid(1) == 42);
+    CHECK(table.cpu_ticks_delta(0) == 0);
+    CHECK(table.cpu_ticks_delta(1) == 0);
+    CHECK(table.rss_pages(1) == 20);
+    CHECK(table.name(1) == "worker");
+}
+
+TEST_CASE("ProcessTable joins consecutive scans by PID") {
+    ProcessScanBuffer scan;
+    ProcessTable table;
+
+    fill_scan(scan, {{1, "init", 500, 1, 10}, {42, "worker", 80, 7, 20}, {43, "gone", 5, 8, 1}});
+    table.update(scan);
+
+    // 43 exited, 50 appeared, 42 kept running.
+    fill_scan(scan, {{1, "init", 520, 1, 10}, {42, "worker", 130, 7, 25}, {50, "new", 9, 9, 2}});
+    table.update(scan);
+
+    REQUIRE(table.size() == 3);
+    CHECK(table.pid(0) == 1);
+    CHECK(table.cpu_ticks_delta(0) == 20);
+    CHECK(table.pid(1) == 42);
+    CHECK(table.cpu_ticks_delta(1) == 50);
+    CHECK(table.rss_pages(1) == 25);
+    CHECK(table.pid(2) == 50);
+    CHECK(table.cpu_ticks_delta(2) == 0);
+    CHECK(table.name(2) == "new");
+}
+
+TEST_CASE("ProcessTable treats a reused PID as a new process") {
+    ProcessScanBuffer scan;
+    ProcessTable table;
+
+    fill_scan(scan, {{42, "old", 900, 7, 1}});
+    table.update(scan);
+
+    fill_scan(scan, {{42, "fresh", 3, 1000, 1}});
+    table.update(scan);
+
+    REQUIRE(table.size() == 1);
+    CHECK(table.cpu_ticks_delta(0) == 0);
+    CHECK(table.name(0) == "fresh");
+}
+
+TEST_CASE("ProcessTable skips rows the scan could not read") {
+    ProcessScanBuffer scan;
+    fill_scan(scan, {{1, "init", 500, 1, 10}, {2, "vanished", 0, 0, 0}, {3, "kthreadd", 7, 2, 0}});
+    scan.valid[1] = 0;
+
+    ProcessTable table;
+    table.update(scan);
+
+    REQUIRE(table.size() == 2);
+    CHECK(table.pid(0) == 1);
+    CHECK(table.pid(1) == 3);
+}
+
+TEST_CASE("ProcessTable interns repeated names and drops stale ones") {
+    ProcessScanBuffer scan;
+    ProcessTable table;
+
+    fill_scan(scan, {{10, "postgres", 1, 1, 1}, {11, "postgres", 1, 2, 1}, {12, "postgres", 1, 3, 1}});
+    table.update(scan);
+    CHECK(table.interned_name_count() == 1);
+
+    // Churn through many short-lived names, then check the pool is compacted.
+    for (int cycle = 0; cycle < 2000; ++cycle) {
+        const std::string name = "job-" + std::to_string(cycle);
+        fill_scan(scan, {{10, "postgres", 1, 1, 1}, {100 + cycle, name.c_str(), 1, 100u + cycle, 1}});
+        table.update(scan);
+    }
+
+    CHECK(table.interned_name_count() <= 2 + 1024);
+    REQUIRE(table.size() == 2);
+    CHECK(table.name(0) == "postgres");
+    CHECK(table.name(1) == "job-1999");
+}
+
+TEST_CASE("ProcessScanBuffer truncates names to the slot size") {
+    ProcessScanBuffer scan;
+    scan.resize(1);
+    const std::string long_name(ProcessScanBuffer::kNameSlotSize + 10, 'x');
+    scan.set_name(0, long_name);
+    CHECK(scan.name(0).size() == ProcessScanBuffer::kNameSlotSize);
+}
@@ -0,0 +1,95 @@
+#include "retry_policy.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+using std::chrono::milliseconds;
+
+TEST_CASE("is_retryable_status accepts transport errors and overload statuses only") {
+    CHECK(is_retryable_status(0));
+    CHECK(is_retryable_status(429));
+    CHECK(is_retryable_status(502));
+    CHECK(is_retryable_status(503));
+    CHECK(is_retryable_status(504));
+    CHECK_FALSE(is_retryable_status(400));
+    CHECK_FALSE(is_retryable_status(401));
+    CHECK_FALSE(is_retryable_status(413));
+    CHECK_FALSE(is_retryable_status(500));
+}
+
+TEST_CASE("JitteredBackoff doubles up to the cap and keeps half of each delay") {
+    JitteredBackoff backoff(milliseconds(100), milliseconds(1000), 42);
+
+    for (int round = 0; round < 50; ++round) {
+        const milliseconds first = backoff.delay(0);
+        CHECK(first >= milliseconds(50));
+        CHECK(first <= milliseconds(100));
+
+        const milliseconds third = backoff.delay(2);
+        CHECK(third >= milliseconds(200));
+        CHECK(third <= milliseconds(400));
+
+        const milliseconds capped = backoff.delay(64);
+        CHECK(capped >= milliseconds(500));
+        CHECK(capped <= milliseconds(1000));
+    }
+
+    // Differently seeded clients spread out instead of retrying in lockstep.
+    JitteredBackoff other(milliseconds(100), milliseconds(1000), 7);
+    bool differs = false;
+    for (int round = 0; round < 20 && !differs; ++round) {
+        differs = backoff.delay(3) != other.delay(3);
+    }
+    CHECK(differs);
+}
+
+TEST_CASE("CircuitBreaker opens after consecutive failures and probes once the cool-down ends") {
+    RetryPolicy policy;
+    policy.breaker_failure_threshold = 3;
+    policy.breaker_open = milliseconds(1000);
+    policy.breaker_max_open = milliseconds(4000);
+    CircuitBreaker breaker(policy, 1);
+    const auto start = std::chrono::steady_clock::time_point{} + std::chrono::hours(1);
+
+    CHECK(breaker.allow(start));
+    breaker.record_failure(start, milliseconds(0));
+    breaker.record_failure(start, milliseconds(0));
+    CHECK(breaker.state() == CircuitState::closed);
+    breaker.record_failure(start, milliseconds(0));
+    REQUIRE(breaker.state() == CircuitState::open);
+    CHECK(breaker.open_count() == 1);
+
+    const auto first_retry = breaker.retry_at();
+    CHECK(first_retry >= start + milliseconds(500));
+    CHECK(first_retry <= start + milliseconds(1000));
+    CHECK_FALSE(breaker.allow(first_retry - milliseconds(1)));
+
+    // A failed probe re-opens with a longer cool-down.
+    CHECK(breaker.allow(first_retry));
+    CHECK(breaker.state() == CircuitState::half_open);
+    breaker.record_failure(first_retry, milliseconds(0));
+    REQUIRE(breaker.state() == CircuitState::open);
+    CHECK(breaker.retry_at() >= first_retry + milliseconds(1000));
+    CHECK(breaker.retry_at() <= first_retry + milliseconds(2000));
+
+    CHECK(breaker.allow(breaker.retry_at()));
+    breaker.record_success();
+    CHECK(breaker.state() == CircuitState::closed);
+
+    // The failure count starts over after a success.
+    breaker.record_failure(start, milliseconds(0));
+    breaker.record_failure(start, milliseconds(0));
+    CHECK(breaker.state() == CircuitState::closed);
+}
+
+TEST_CASE("CircuitBreaker honours a Retry-After longer than its cool-down") {
+    RetryPolicy policy;
+    policy.breaker_open = milliseconds(1000);
+    CircuitBreaker breaker(policy, 1);
+    const auto start = std::chrono::steady_clock::time_point{} + std::chrono::hours(1);
+
+    breaker.record_failure(start, milliseconds(30000));
+    REQUIRE(breaker.state() == CircuitState::open);
+    CHECK(breaker.retry_at() == start + milliseconds(30000));
+    CHECK_FALSE(breaker.allow(start + milliseconds(29999)));
+    CHECK(breaker.allow(start + milliseconds(30000)));
+}
@@ -0,0 +1,81 @@
+#include "ring_buffer.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <thread>
+#include <vector>
+
+TEST_CASE("BoundedRing delivers in order and drops the oldest when full") {
+    BoundedRing<int> ring(3);
+
+    for (int value = 1; value <= 3; ++value) {
+        int item = value;
+        CHECK_FALSE(ring.push(item));
+    }
+    CHECK(ring.size() == 3);
+
+    int item = 4;
+    CHECK(ring.push(item));
+    CHECK(ring.size() == 3);
+    CHECK(ring.dropped() == 1);
+    CHECK(ring.pushed() == 4);
+
+    std::vector<int> popped;
+    int out = 0;
+    while (ring.try_pop(out)) {
+        popped.push_back(out);
+    }
+    CHECK(popped == std::vector<int>{2, 3, 4});
+    CHECK(ring.empty());
+}
+
+TEST_CASE("BoundedRing swaps storage instead of freeing it") {
+    BoundedRing<std::vector<int>> ring(2);
+
+    std::vector<int> item(64, 7);
+    const int* buffer = item.data();
+    ring.push(item);
+    CHECK(item.empty());
+
+    std::vector<int> out;
+    REQUIRE(ring.try_pop(out));
+    CHECK(out.data() == buffer);
+    CHECK(out.size() == 64);
+
+    // The consumer's previous (empty) vector went back into the slot; push
+    // the popped buffer through again and it comes back out unchanged.
+    ring.push(out);
+    std::vector<int> again;
+    REQUIRE(ring.try_pop(again));
+    CHECK(again.data() == buffer);
+}
+
+TEST_CASE("BoundedRing wait_pop blocks until a push and drains after close") {
+    BoundedRing<int> ring(4);
+    std::vector<int> received;
+
+    std::thread consumer([&]() {
+        int value = 0;
+        while (ring.wait_pop(value)) {
+            received.push_back(value);
+        }
+    });
+
+    for (int value = 0; value < 1000; ++value) {
+        int item = value;
+        ring.push(item);
+        if (value % 100 == 0) {
+            std::this_thread::yield();
+        }
+    }
+    ring.close();
+    consumer.join();
+
+    // Drops are allowed under pressure, but what arrives is in order and
+    // nothing is lost or duplicated in the accounting.
+    CHECK(received.size() + ring.dropped() == 1000);
+    CHECK(received.back() == 999);
+    for (size_t i = 1; i < received.size(); ++i) {
+        CHECK(received[i - 1] < received[i]);
+    }
+}
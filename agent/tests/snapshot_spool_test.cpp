@@ -0,0 +1,181 @@
+#include "snapshot_spool.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#if !defined(_WIN32)
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+namespace {
+namespace fs = std::filesystem;
+
+struct ScratchDir {
+    explicit ScratchDir(const std::string& name)
+        : path(fs::temp_directory_path() / (name + "-" + std::to_string(::getpid()))) {
+        fs::remove_all(path);
+    }
+    ~ScratchDir() {
+        std::error_code ignored;
+        fs::remove_all(path, ignored);
+    }
+
+    size_t segment_count() const {
+        size_t count = 0;
+        for (const auto& entry : fs::directory_iterator(path)) {
+            count += entry.path().extension() == ".seg" ? 1 : 0;
+        }
+        return count;
+    }
+
+    fs::path path;
+};
+
+SystemMetrics snapshot(int64_t timestamp_ms, size_t process_count = 1) {
+    SystemMetrics metrics{};
+    metrics.timestamp = timestamp_ms / 1000;
+    metrics.timestamp_ms = timestamp_ms;
+    metrics.total_cpu_percent = 12.5;
+    metrics.per_core_cpu_percent = {10.0, 15.0};
+    metrics.system_memory_total_mb = 2048.0;
+    metrics.system_memory_used_mb = 1024.0;
+    for (size_t i = 0; i < process_count; ++i) {
+        metrics.top_processes.push_back(
+            ProcessMetrics{static_cast<int>(100 + i), "worker-" + std::to_string(i), 1.0, 2.0, 1, 0.0, 0.0, 0});
+    }
+    return metrics;
+}
+
+SpoolOptions options_for(const ScratchDir& dir) {
+    SpoolOptions options;
+    options.directory = dir.path.string();
+    options.max_bytes = 64 * 1024;
+    options.segment_bytes = 16 * 1024;
+    return options;
+}
+}  // namespace
+
+TEST_CASE("SnapshotSpool replays appended snapshots in order and drops consumed segments") {
+    ScratchDir dir("snapshot-spool-order");
+    SnapshotSpool spool(options_for(dir));
+    std::string error;
+    REQUIRE(spool.open(error));
+
+    const SystemMetrics batch[] = {snapshot(1000), snapshot(2000), snapshot(3000)};
+    CHECK(spool.append(batch, 3) == 3);
+    CHECK(spool.pending() == 3);
+
+    std::vector<SystemMetrics> out;
+    REQUIRE(spool.peek(out, 2) == 2);
+    CHECK(out[0].timestamp_ms == 1000);
+    CHECK(out[1].timestamp_ms == 2000);
+    CHECK(out[1].top_processes.at(0).name == "worker-0");
+    CHECK(spool.pending() == 3);
+
+    spool.consume(2);
+    CHECK(spool.pending() == 1);
+    REQUIRE(spool.peek(out, 8) == 1);
+    CHECK(out[0].timestamp_ms == 3000);
+
+    spool.consume(1);
+    CHECK(spool.pending() == 0);
+    CHECK(spool.peek(out, 8) == 0);
+}
+
+TEST_CASE("SnapshotSpool recovers unacknowledged snapshots after a restart") {
+    ScratchDir dir("snapshot-spool-recover");
+    {
+        SnapshotSpool spool(options_for(dir));
+        std::string error;
+        REQUIRE(spool.open(error));
+        const SystemMetrics batch[] = {snapshot(1000), snapshot(2000), snapshot(3000)};
+        REQUIRE(spool.append(batch, 3) == 3);
+
+        std::vector<SystemMetrics> out;
+        REQUIRE(spool.peek(out, 1) == 1);
+        spool.consume(1);
+    }
+
+    SnapshotSpool reopened(options_for(dir));
+    std::string error;
+    REQUIRE(reopened.open(error));
+    CHECK(reopened.pending() == 2);
+
+    std::vector<SystemMetrics> out;
+    REQUIRE(reopened.peek(out, 8) == 2);
+    CHECK(out[0].timestamp_ms == 2000);
+    CHECK(out[1].timestamp_ms == 3000);
+
+    // New appends go to a fresh segment after the recovered one.
+    const SystemMetrics later = snapshot(4000);
+    REQUIRE(reopened.append(&later, 1) == 1);
+    CHECK(dir.segment_count() == 2);
+    REQUIRE(reopened.peek(out, 8) == 3);
+    CHECK(out[2].timestamp_ms == 4000);
+
+    reopened.consume(3);
+    CHECK(reopened.pending() == 0);
+    CHECK(dir.segment_count() == 1);
+}
+
+TEST_CASE("SnapshotSpool evicts the oldest segment once the size cap is reached") {
+    ScratchDir dir("snapshot-spool-evict");
+    SpoolOptions options = options_for(dir);
+    options.max_bytes = 3 * options.segment_bytes;
+    SnapshotSpool spool(options);
+    std::string error;
+    REQUIRE(spool.open(error));
+
+    size_t appended = 0;
+    for (int64_t i = 0; i < 400; ++i) {
+        const SystemMetrics metrics = snapshot(1000 * (i + 1), 8);
+        appended += spool.append(&metrics, 1);
+    }
+    CHECK(appended == 400);
+    CHECK(spool.evicted() > 0);
+    CHECK(spool.pending() + spool.evicted() == appended);
+    CHECK(spool.disk_bytes() <= options.max_bytes);
+    CHECK(dir.segment_count() == 3);
+
+    // Replay starts at the oldest snapshot that survived.
+    std::vector<SystemMetrics> out;
+    REQUIRE(spool.peek(out, 1) == 1);
+    CHECK(out[0].timestamp_ms == static_cast<int64_t>(1000 * (spool.evicted() + 1)));
+}
+
+TEST_CASE("SnapshotSpool stops at a corrupt record when recovering") {
+    ScratchDir dir("snapshot-spool-corrupt");
+    const SystemMetrics batch[] = {snapshot(1000), snapshot(2000)};
+    {
+        SnapshotSpool spool(options_for(dir));
+        std::string error;
+        REQUIRE(spool.open(error));
+        REQUIRE(spool.append(batch, 2) == 2);
+    }
+
+    std::string encoded;
+    BinaryMetricsEncoder encoder;
+    encoder.encode(&batch[0], 1, encoded);
+    const size_t second_payload = 8 + 12 + encoded.size() + 12;
+
+    REQUIRE(dir.segment_count() == 1);
+    const fs::path segment = fs::directory_iterator(dir.path)->path();
+    {
+        std::fstream file(segment, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(static_cast<std::streamoff>(second_payload + 2));
+        file.put('\x7F');
+    }
+
+    SnapshotSpool reopened(options_for(dir));
+    std::string error;
+    REQUIRE(reopened.open(error));
+    CHECK(reopened.pending() == 1);
+
+    std::vector<SystemMetrics> out;
+    REQUIRE(reopened.peek(out, 8) == 1);
+    CHECK(out[0].timestamp_ms == 1000);
+}
+#endif
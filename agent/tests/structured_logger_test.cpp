@@ -0,0 +1,101 @@
+#include "structured_logger.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+std::string read_all(std::FILE* file) {
+    std::fflush(file);
+    std::rewind(file);
+    std::string content;
+    char buffer[4096];
+    size_t read = 0;
+    while ((read = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        content.append(buffer, read);
+    }
+    return content;
+}
+
+size_t count_lines(const std::string& content) {
+    size_t lines = 0;
+    for (const char c : content) {
+        lines += c == '\n' ? 1 : 0;
+    }
+    return lines;
+}
+}  // namespace
+
+TEST_CASE("append_log_line writes fields in call order and escapes values") {
+    std::string line;
+    append_log_line(line, "2024-01-01T00:00:00Z", LogLevel::warn, "sender.failed", "say \"hi\"", {
+        {"error", "a\nb"},
+        {"http_status", "503"}
+    });
+
+    CHECK(line ==
+          "{\"ts\":\"2024-01-01T00:00:00Z\",\"level\":\"WARN\",\"event\":\"sender.failed\","
+          "\"message\":\"say \\\"hi\\\"\",\"error\":\"a\\nb\",\"http_status\":\"503\"}");
+}
+
+TEST_CASE("parse_log_level accepts known levels case-insensitively") {
+    LogLevel level = LogLevel::info;
+    CHECK(parse_log_level("DEBUG", level));
+    CHECK(level == LogLevel::debug);
+    CHECK(parse_log_level("warn", level));
+    CHECK(level == LogLevel::warn);
+    CHECK(parse_log_level("Error", level));
+    CHECK(level == LogLevel::error);
+    CHECK_FALSE(parse_log_level("verbose", level));
+    CHECK(level == LogLevel::error);
+}
+
+TEST_CASE("log level filter drops lower-severity lines") {
+    set_log_level(LogLevel::warn);
+    CHECK_FALSE(log_enabled(LogLevel::debug));
+    CHECK_FALSE(log_enabled(LogLevel::info));
+    CHECK(log_enabled(LogLevel::warn));
+    CHECK(log_enabled(LogLevel::error));
+    set_log_level(LogLevel::info);
+    CHECK(log_enabled(LogLevel::info));
+}
+
+TEST_CASE("async logger writes every queued line from several threads before stopping") {
+    std::FILE* out = std::tmpfile();
+    std::FILE* err = std::tmpfile();
+    REQUIRE(out != nullptr);
+    REQUIRE(err != nullptr);
+
+    LoggerOptions options;
+    options.queue_capacity = 8192;
+    options.out = out;
+    options.err = err;
+    start_async_logger(options);
+
+    std::vector<std::thread> producers;
+    for (int producer = 0; producer < 4; ++producer) {
+        producers.emplace_back([producer]() {
+            for (int i = 0; i < 500; ++i) {
+                log_event(LogLevel::info, "test.line", "line", {{"producer", std::to_string(producer)}});
+            }
+        });
+    }
+    for (auto& producer : producers) {
+        producer.join();
+    }
+    log_event(LogLevel::error, "test.error", "to stderr");
+    log_event(LogLevel::debug, "test.debug", "filtered out");
+    stop_async_logger();
+
+    const std::string out_text = read_all(out);
+    const std::string err_text = read_all(err);
+    CHECK(count_lines(out_text) + dropped_log_lines() == 2000);
+    CHECK(err_text.find("\"event\":\"test.error\"") != std::string::npos);
+    CHECK(out_text.find("test.debug") == std::string::npos);
+
+    std::fclose(out);
+    std::fclose(err);
+}
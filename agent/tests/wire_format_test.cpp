@@ -0,0 +1,224 @@
+#include "wire_format.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <initializer_list>
+#include <string>
+
+#if defined(METRICS_AGENT_HAVE_ZLIB)
+#include <zlib.h>
+#endif
+
+namespace {
+std::string bytes(std::initializer_list<int> values) {
+    std::string out;
+    for (const int value : values) {
+        out.push_back(static_cast<char>(value));
+    }
+    return out;
+}
+}  // namespace
+
+TEST_CASE("parse_wire_format and parse_wire_compression accept known values only") {
+    WireFormat format = WireFormat::json;
+    CHECK(parse_wire_format("binary", format));
+    CHECK(format == WireFormat::binary);
+    CHECK(parse_wire_format("json", format));
+    CHECK(format == WireFormat::json);
+    CHECK_FALSE(parse_wire_format("protobuf", format));
+
+    WireCompression compression = WireCompression::none;
+    CHECK(parse_wire_compression("gzip", compression));
+    CHECK(compression == WireCompression::gzip);
+    CHECK_FALSE(parse_wire_compression("zstd", compression));
+    CHECK(wire_compression_available(WireCompression::none));
+}
+
+TEST_CASE("BinaryMetricsEncoder writes fixed-point values and per-payload name references") {
+    SystemMetrics first{};
+    first.timestamp = 100;
+    first.timestamp_ms = 100250;
+    first.total_cpu_percent = 12.34;
+    first.per_core_cpu_percent = {10.0, 1.5};
+    first.system_memory_total_mb = 1.0;
+    first.system_memory_used_mb = 0.5;
+    first.top_processes = {ProcessMetrics{7, "sh", 1.0, 2.0, 1, 0.0, 0.0, 3}};
+
+    SystemMetrics second = first;
+    second.timestamp = 100;
+    second.timestamp_ms = 100500;
+    second.per_core_cpu_percent = {9.0, 1.5};
+
+    const SystemMetrics snapshots[] = {first, second};
+    BinaryMetricsEncoder encoder;
+    std::string out;
+    encoder.encode(snapshots, 2, out);
+
+    const std::string first_expected = bytes({
+        // timestamp +100250 ms, total CPU 1234
+        0xB4, 0x9E, 0x0C, 0xA4, 0x13,
+        // two cores: +1000, +150
+        0x02, 0xD0, 0x0F, 0xAC, 0x02,
+        // memory total +100, used +50
+        0xC8, 0x01, 0x64,
+        // one process: pid 7, new name #0 "sh", cpu 100, mem 200, threads 1, io 0/0, handles 3
+        0x01, 0x0E, 0x00, 0x02, 's', 'h', 0xC8, 0x01, 0x90, 0x03, 0x02, 0x00, 0x00, 0x06,
+        // no cgroups, not a window summary
+        0x00, 0x00});
+    const std::string second_expected = bytes({
+        // timestamp +250 ms, total CPU 1234
+        0xF4, 0x03, 0xA4, 0x13,
+        // two cores: -100, +0
+        0x02, 0xC7, 0x01, 0x00,
+        // memory unchanged
+        0x00, 0x00,
+        // process refers back to name #0
+        0x01, 0x0E, 0x00, 0xC8, 0x01, 0x90, 0x03, 0x02, 0x00, 0x00, 0x06,
+        0x00, 0x00});
+
+    CHECK(out == std::string("MTB\x01", 4) + first_expected + second_expected);
+
+    // Encoder state does not leak into the next payload.
+    encoder.encode(snapshots, 1, out);
+    CHECK(out == std::string("MTB\x01", 4) + first_expected);
+
+    // Cgroup paths take IDs from the same table as process names.
+    first.top_cgroups = {CgroupMetrics{"sh", 2.5, 1.0, 0.0, 0.0}, CgroupMetrics{"k", 0.0, 0.0, 0.0, 0.0}};
+    encoder.encode(&first, 1, out);
+    const std::string without_sections = first_expected.substr(0, first_expected.size() - 2);
+    CHECK(out == std::string("MTB\x01", 4) + without_sections +
+        bytes({0x02, 0x00, 0xF4, 0x03, 0xC8, 0x01, 0x00, 0x00, 0x01, 0x01, 'k', 0x00, 0x00, 0x00, 0x00, 0x00}));
+
+    // A window summary appends its statistics.
+    first.top_cgroups.clear();
+    first.window.samples = 4;
+    first.window.start_timestamp_ms = 100000;
+    first.window.total_cpu_percent = WindowStats{1.0, 2.0, 1.5, 2.0};
+    encoder.encode(&first, 1, out);
+    CHECK(out == std::string("MTB\x01", 4) + without_sections + bytes({
+        0x00,
+        // 4 samples starting 250 ms earlier, total CPU 100/200/150/200
+        0x04, 0xFA, 0x01, 0xC8, 0x01, 0x90, 0x03, 0xAC, 0x02, 0x90, 0x03,
+        // no cores, zero memory stats, no processes
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00}));
+}
+
+TEST_CASE("decode_binary_metrics reads back what the encoder wrote") {
+    SystemMetrics first{};
+    first.timestamp = 1700000000;
+    first.timestamp_ms = 1700000000250;
+    first.total_cpu_percent = 12.34;
+    first.per_core_cpu_percent = {10.0, 1.5};
+    first.system_memory_total_mb = 16000.0;
+    first.system_memory_used_mb = 8000.25;
+    first.top_processes = {
+        ProcessMetrics{7, "sh", 1.0, 2.0, 1, 0.5, 0.25, 3},
+        ProcessMetrics{9, "caf\xc3\xa9", 98.77, 512.5, 12, 2048.5, 1024.25, 350}
+    };
+    SystemMetrics second = first;
+    second.timestamp_ms = 1700000000500;
+    second.per_core_cpu_percent = {9.0, 1.5, 3.0};
+    second.top_processes.pop_back();
+    first.top_cgroups = {CgroupMetrics{"kubepods.slice/pod-a/ctr-1", 150.5, 256.25, 10.5, 2.0}};
+
+    const SystemMetrics snapshots[] = {first, second};
+    BinaryMetricsEncoder encoder;
+    std::string body;
+    encoder.encode(snapshots, 2, body);
+
+    std::vector<SystemMetrics> decoded;
+    REQUIRE(decode_binary_metrics(body, decoded));
+    REQUIRE(decoded.size() == 2);
+    CHECK(decoded[0].timestamp == 1700000000);
+    CHECK(decoded[1].timestamp_ms == 1700000000500);
+    CHECK(decoded[1].per_core_cpu_percent == std::vector<double>{9.0, 1.5, 3.0});
+    CHECK(decoded[0].system_memory_used_mb == 8000.25);
+    REQUIRE(decoded[0].top_processes.size() == 2);
+    CHECK(decoded[0].top_processes[1].name == "caf\xc3\xa9");
+    CHECK(decoded[0].top_processes[1].handle_count == 350);
+    CHECK(decoded[1].top_processes[0].name == "sh");
+    CHECK(decoded[1].fresh_families == kMetricFamilyAll);
+    REQUIRE(decoded[0].top_cgroups.size() == 1);
+    CHECK(decoded[0].top_cgroups[0].path == "kubepods.slice/pod-a/ctr-1");
+    CHECK(decoded[0].top_cgroups[0].cpu_percent == 150.5);
+    CHECK(decoded[0].top_cgroups[0].io_read_mb == 10.5);
+    CHECK(decoded[1].top_cgroups.empty());
+    CHECK(decoded[0].window.samples == 0);
+
+    // Re-encoding the decoded snapshots reproduces the payload byte for byte.
+    std::string reencoded;
+    encoder.encode(decoded.data(), decoded.size(), reencoded);
+    CHECK(reencoded == body);
+
+    decoded.clear();
+    CHECK_FALSE(decode_binary_metrics(std::string_view(body).substr(0, body.size() - 2), decoded));
+    // Only the version this agent writes is accepted.
+    CHECK_FALSE(decode_binary_metrics(std::string("MTB\x02", 4) + body.substr(4), decoded));
+}
+
+TEST_CASE("decode_binary_metrics reads back window summaries") {
+    SystemMetrics summary{};
+    summary.timestamp = 1700000010;
+    summary.timestamp_ms = 1700000010000;
+    summary.total_cpu_percent = 40.0;
+    summary.per_core_cpu_percent = {30.0, 50.0};
+    summary.top_processes = {ProcessMetrics{7, "sh", 20.0, 2.0, 1, 0.0, 0.0, 3}};
+    summary.window.samples = 5;
+    summary.window.start_timestamp_ms = 1700000008000;
+    summary.window.total_cpu_percent = WindowStats{10.0, 90.0, 40.0, 85.5};
+    summary.window.per_core_cpu_percent = {WindowStats{0.0, 60.0, 30.0, 55.0}, WindowStats{20.0, 99.0, 50.0, 97.25}};
+    summary.window.system_memory_used_mb = WindowStats{100.0, 140.0, 120.0, 138.0};
+    summary.window.top_processes = {ProcessWindowMetrics{7, 3, WindowStats{5.0, 45.0, 20.0, 45.0}, WindowStats{2.0, 2.0, 2.0, 2.0}}};
+
+    BinaryMetricsEncoder encoder;
+    std::string body;
+    encoder.encode(&summary, 1, body);
+
+    std::vector<SystemMetrics> decoded;
+    REQUIRE(decode_binary_metrics(body, decoded));
+    REQUIRE(decoded.size() == 1);
+    const MetricsWindow& window = decoded[0].window;
+    CHECK(window.samples == 5);
+    CHECK(window.start_timestamp_ms == 1700000008000);
+    CHECK(window.total_cpu_percent.p95 == 85.5);
+    REQUIRE(window.per_core_cpu_percent.size() == 2);
+    CHECK(window.per_core_cpu_percent[1].max == 99.0);
+    CHECK(window.system_memory_used_mb.mean == 120.0);
+    REQUIRE(window.top_processes.size() == 1);
+    CHECK(window.top_processes[0].pid == 7);
+    CHECK(window.top_processes[0].samples == 3);
+    CHECK(window.top_processes[0].cpu_percent.max == 45.0);
+
+    std::string reencoded;
+    encoder.encode(decoded.data(), decoded.size(), reencoded);
+    CHECK(reencoded == body);
+
+    // More window processes than reported processes is malformed.
+    summary.window.top_processes.push_back(summary.window.top_processes[0]);
+    encoder.encode(&summary, 1, body);
+    decoded.clear();
+    CHECK_FALSE(decode_binary_metrics(body, decoded));
+}
+
+#if defined(METRICS_AGENT_HAVE_ZLIB)
+TEST_CASE("gzip_compress produces a gzip stream that inflates back") {
+    const std::string input(4096, 'a');
+    std::string compressed;
+    REQUIRE(gzip_compress(input, compressed));
+    REQUIRE(compressed.size() > 2);
+    CHECK(static_cast<unsigned char>(compressed[0]) == 0x1F);
+    CHECK(static_cast<unsigned char>(compressed[1]) == 0x8B);
+    CHECK(compressed.size() < input.size());
+
+    std::string inflated(input.size(), '\0');
+    z_stream stream{};
+    REQUIRE(inflateInit2(&stream, 15 + 16) == Z_OK);
+    stream.next_in = reinterpret_cast<Bytef*>(&compressed[0]);
+    stream.avail_in = static_cast<uInt>(compressed.size());
+    stream.next_out = reinterpret_cast<Bytef*>(&inflated[0]);
+    stream.avail_out = static_cast<uInt>(inflated.size());
+    CHECK(inflate(&stream, Z_FINISH) == Z_STREAM_END);
+    inflateEnd(&stream);
+    CHECK(inflated == input);
+}
+#endif
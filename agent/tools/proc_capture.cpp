@@ -0,0 +1,174 @@
+// proc_capture: records the parts of /proc the agent reads and replays them
+// through MetricsCollector, so collector timings can be reproduced for a
+// given process population on any Linux machine.
+//
+//   proc_capture record <output-dir> [--proc-root /proc]
+//   proc_capture replay <capture-dir> [--cycles 100] [--top-n 12] [--collector-threads 1]
+
+#include "agent_telemetry.h"
+#include "metrics_collector.h"
+#include "proc_source.h"
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#if defined(__linux__)
+#include <charconv>
+
+namespace {
+namespace fs = std::filesystem;
+
+bool read_file(const fs::path& path, std::string& contents) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    std::ostringstream buffer;
+    buffer << in.rdbuf();
+    contents = buffer.str();
+    return !contents.empty();
+}
+
+bool write_file(const fs::path& path, const std::string& contents) {
+    std::ofstream out(path, std::ios::binary);
+    out << contents;
+    return static_cast<bool>(out);
+}
+
+bool parse_pid(const std::string& name, int& pid) {
+    const char* end = name.data() + name.size();
+    const auto [parsed_end, error] = std::from_chars(name.data(), end, pid);
+    return error == std::errc() && parsed_end == end && pid > 0;
+}
+
+int record(const std::string& source, const fs::path& output) {
+    const ProcRoot root(source);
+    std::error_code error;
+    fs::create_directories(output, error);
+    if (error) {
+        std::fprintf(stderr, "cannot create %s: %s\n", output.c_str(), error.message().c_str());
+        return 1;
+    }
+
+    std::string contents;
+    for (const char* name : {"stat", "meminfo"}) {
+        if (!read_file(root.file(name), contents) || !write_file(output / name, contents)) {
+            std::fprintf(stderr, "cannot copy %s\n", root.file(name).c_str());
+            return 1;
+        }
+    }
+
+    // Processes that exit during the walk are skipped; missing io files
+    // (they need ptrace access) are left out, as the agent tolerates.
+    size_t processes = 0;
+    for (const fs::directory_entry& entry : fs::directory_iterator(root.path(), error)) {
+        int pid = 0;
+        if (!parse_pid(entry.path().filename().string(), pid) ||
+            !read_file(entry.path() / "stat", contents)) {
+            continue;
+        }
+
+        const fs::path directory = output / std::to_string(pid);
+        fs::create_directories(directory / "fd", error);
+        write_file(directory / "stat", contents);
+        if (read_file(entry.path() / "io", contents)) {
+            write_file(directory / "io", contents);
+        }
+
+        // Only the number of descriptors matters, so fd/ gets that many empty files.
+        int fd_count = 0;
+        if (read_linux_pid_fd_count(pid, fd_count, root)) {
+            for (int fd = 0; fd < fd_count; ++fd) {
+                write_file(directory / "fd" / std::to_string(fd), std::string());
+            }
+        }
+        ++processes;
+    }
+
+    std::printf("{\"processes\":%zu,\"output\":\"%s\"}\n", processes, output.c_str());
+    return 0;
+}
+
+int replay(const std::string& capture, size_t cycles, const CollectorOptions& base) {
+    CollectorOptions options = base;
+    options.proc_root = capture;
+    MetricsCollector collector(MetricsSelection{}, options);
+
+    // The first cycle only establishes the CPU baseline.
+    SystemMetrics metrics{};
+    collector.collect(metrics);
+
+    LatencyHistogram histogram;
+    for (size_t cycle = 0; cycle < cycles; ++cycle) {
+        const auto start = std::chrono::steady_clock::now();
+        collector.collect(metrics);
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        histogram.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count()));
+    }
+
+    LatencyHistogram::Snapshot snapshot;
+    histogram.snapshot(snapshot);
+    std::printf(
+        "{\"cycles\":%zu,\"top_processes\":%zu,\"collect_p50_us\":%llu,\"collect_p90_us\":%llu,"
+        "\"collect_p99_us\":%llu,\"collect_max_us\":%llu,\"proc_syscalls_per_cycle\":%llu}\n",
+        cycles,
+        metrics.top_processes.size(),
+        static_cast<unsigned long long>(snapshot.quantile(0.5)),
+        static_cast<unsigned long long>(snapshot.quantile(0.9)),
+        static_cast<unsigned long long>(snapshot.quantile(0.99)),
+        static_cast<unsigned long long>(snapshot.max),
+        static_cast<unsigned long long>(agent_telemetry().proc_syscalls.load() / (cycles + 1)));
+    return 0;
+}
+
+int usage() {
+    std::fprintf(stderr,
+        "usage: proc_capture record <output-dir> [--proc-root /proc]\n"
+        "       proc_capture replay <capture-dir> [--cycles 100] [--top-n 12] [--collector-threads 1]\n");
+    return 2;
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        return usage();
+    }
+    const std::string command = argv[1];
+    const std::string directory = argv[2];
+
+    std::string proc_root = "/proc";
+    size_t cycles = 100;
+    CollectorOptions options;
+    for (int i = 3; i + 1 < argc; i += 2) {
+        const std::string arg = argv[i];
+        if (arg == "--proc-root") {
+            proc_root = argv[i + 1];
+        } else if (arg == "--cycles") {
+            cycles = static_cast<size_t>(std::stoul(argv[i + 1]));
+        } else if (arg == "--top-n") {
+            options.top_n = static_cast<size_t>(std::stoul(argv[i + 1]));
+        } else if (arg == "--collector-threads") {
+            options.collector_threads = static_cast<size_t>(std::stoul(argv[i + 1]));
+        } else {
+            return usage();
+        }
+    }
+
+    if (command == "record") {
+        return record(proc_root, directory);
+    }
+    if (command == "replay" && cycles > 0) {
+        return replay(directory, cycles, options);
+    }
+    return usage();
+}
+#else
+int main() {
+    std::fprintf(stderr, "proc_capture is only supported on Linux\n");
+    return 1;
+}
+#endif
@@ -1,12 +1,44 @@
 import os
 import re
-from typing import List
+from typing import Any, Dict, List
 
 from fastapi import FastAPI
-from pydantic import BaseModel, Field
+from pydantic import BaseModel, ConfigDict, Field, model_validator
 
 
-class ProcessMetric(BaseModel):
+def _parse_int_env(name: str, default: str) -> int:
+    raw = os.getenv(name, default)
+    try:
+        return int(raw)
+    except (TypeError, ValueError):
+        match = re.search(r"(\d+)$", str(raw))
+        if match:
+            return int(match.group(1))
+        return int(default)
+
+
+def _parse_float_env(name: str, default: str) -> float:
+    raw = os.getenv(name, default)
+    try:
+        return float(raw)
+    except (TypeError, ValueError):
+        return float(default)
+
+
+MAX_TOP_PROCESSES = _parse_int_env("MAX_TOP_PROCESSES", "12")
+MAX_TOP_CGROUPS = _parse_int_env("MAX_TOP_CGROUPS", "12")
+MAX_BATCH_ITEMS = _parse_int_env("MAX_BATCH_ITEMS", "256")
+MAX_INGEST_BODY_BYTES = _parse_int_env("MAX_INGEST_BODY_BYTES", str(16 * 1024 * 1024))
+BINARY_METRICS_CONTENT_TYPE = "application/x-metrics-binary"
+
+
+class _SnapshotModel(BaseModel):
+    """Part of an ingested snapshot; NaN and infinities are rejected, PostgreSQL's JSON columns cannot hold them."""
+
+    model_config = ConfigDict(allow_inf_nan=False)
+
+
+class ProcessMetric(_SnapshotModel):
     pid: int
     name: str
     cpu_percent: float = Field(ge=0)
@@ -17,13 +49,65 @@ class ProcessMetric(BaseModel):
     handle_count: int = Field(default=0, ge=0)
 
 
-class MetricsPayload(BaseModel):
+class CgroupMetric(_SnapshotModel):
+    path: str
+    cpu_percent: float = Field(ge=0)
+    memory_mb: float = Field(default=0, ge=0)
+    io_read_mb: float = Field(default=0, ge=0)
+    io_write_mb: float = Field(default=0, ge=0)
+
+
+class WindowStats(_SnapshotModel):
+    min: float = 0
+    max: float = 0
+    mean: float = 0
+    p95: float = 0
+
+
+class ProcessWindowMetric(_SnapshotModel):
+    pid: int
+    samples: int = Field(ge=0)
+    cpu_percent: WindowStats = Field(default_factory=WindowStats)
+    memory_mb: WindowStats = Field(default_factory=WindowStats)
+
+
+class MetricsWindow(_SnapshotModel):
+    """Statistics over the samples an agent folded into one summary snapshot."""
+
+    samples: int = Field(ge=1)
+    start_timestamp_ms: int = Field(ge=0)
+    total_cpu_percent: WindowStats = Field(default_factory=WindowStats)
+    per_core_cpu_percent: List[WindowStats] = Field(default_factory=list)
+    system_memory_used_mb: WindowStats = Field(default_factory=WindowStats)
+    top_processes: List[ProcessWindowMetric] = Field(default_factory=list, max_length=MAX_TOP_PROCESSES)
+
+
+class MetricsPayload(_SnapshotModel):
     timestamp: int
+    timestamp_ms: int | None = Field(default=None, ge=0)
     total_cpu_percent: float = Field(ge=0, le=100)
     per_core_cpu_percent: List[float] = Field(default_factory=list)
     system_memory_total_mb: float = Field(default=0, ge=0)
     system_memory_used_mb: float = Field(default=0, ge=0)
-    top_processes: List[ProcessMetric] = Field(default_factory=list, max_length=12)
+    top_processes: List[ProcessMetric] = Field(default_factory=list, max_length=MAX_TOP_PROCESSES)
+    top_cgroups: List[CgroupMetric] = Field(default_factory=list, max_length=MAX_TOP_CGROUPS)
+    window: MetricsWindow | None = None
+    agent: str | None = Field(default=None, max_length=255)  # Set by the backend to the sending agent's ID.
+
+
+class DeltaDocument(BaseModel):
+    """One entry of an agent's delta stream: a whole snapshot or the changes since the previous one."""
+
+    stream: str = Field(min_length=1, max_length=64)
+    sequence: int = Field(ge=1)
+    keyframe: MetricsPayload | None = None
+    delta: Dict[str, Any] | None = None
+
+    @model_validator(mode="after")
+    def check_one_body(self) -> "DeltaDocument":
+        if (self.keyframe is None) == (self.delta is None):
+            raise ValueError("exactly one of keyframe and delta is required")
+        return self
 
 
 class AlertEvent(BaseModel):
@@ -40,32 +124,39 @@ class IngestResponse(BaseModel):
     timestamp: int
 
 
-class HealthResponse(BaseModel):
+class BatchIngestResponse(BaseModel):
     status: str
-    redis: str
-    postgres: str
+    accepted: int
+    latest_timestamp: int
 
 
-REDIS_HOST = os.getenv("REDIS_HOST", "localhost")
+class HistoryPoint(BaseModel):
+    """Total CPU and used memory of one agent over one bucket; a raw snapshot is a bucket of one sample."""
 
+    agent: str
+    timestamp: int
+    samples: int
+    cpu_mean: float
+    cpu_min: float
+    cpu_max: float
+    memory_used_mean_mb: float
+    memory_used_max_mb: float
+    memory_total_mb: float
 
-def _parse_int_env(name: str, default: str) -> int:
-    raw = os.getenv(name, default)
-    try:
-        return int(raw)
-    except (TypeError, ValueError):
-        match = re.search(r"(\d+)$", str(raw))
-        if match:
-            return int(match.group(1))
-        return int(default)
 
+class MetricsHistoryResponse(BaseModel):
+    resolution: str
+    points: List[HistoryPoint]
+    truncated: bool
 
-def _parse_float_env(name: str, default: str) -> float:
-    raw = os.getenv(name, default)
-    try:
-        return float(raw)
-    except (TypeError, ValueError):
-        return float(default)
+
+class HealthResponse(BaseModel):
+    status: str
+    redis: str
+    postgres: str
+
+
+REDIS_HOST = os.getenv("REDIS_HOST", "localhost")
 
 
 REDIS_PORT = _parse_int_env("REDIS_PORT", "6379")
@@ -73,9 +164,15 @@ REDIS_DB = _parse_int_env("REDIS_DB", "0")
 METRICS_KEY = os.getenv("REDIS_METRICS_KEY", "metrics:timeline")
 METRICS_CHANNEL = os.getenv("REDIS_METRICS_CHANNEL", "metrics:live")
 RETENTION_SECONDS = _parse_int_env("RETENTION_SECONDS", "300")
+DELTA_STATE_KEY_PREFIX = os.getenv("REDIS_DELTA_STATE_PREFIX", "metrics:delta:")
+DELTA_STATE_TTL_SECONDS = _parse_int_env("DELTA_STATE_TTL_SECONDS", "900")
 
 POSTGRES_DSN = os.getenv("POSTGRES_DSN", "")
 POSTGRES_TABLE = os.getenv("POSTGRES_TABLE", "metrics_snapshots")
+# Rows are inserted in the background at least this often; 0 inserts them within the request.
+POSTGRES_FLUSH_INTERVAL_MS = _parse_int_env("POSTGRES_FLUSH_INTERVAL_MS", "500")
+POSTGRES_FLUSH_MAX_ROWS = _parse_int_env("POSTGRES_FLUSH_MAX_ROWS", "500")
+POSTGRES_BUFFER_MAX_ROWS = _parse_int_env("POSTGRES_BUFFER_MAX_ROWS", "20000")
 
 AGENT_API_TOKEN = os.getenv("AGENT_API_TOKEN", "")
 AGENT_RATE_LIMIT_PER_MINUTE = _parse_int_env("AGENT_RATE_LIMIT_PER_MINUTE", "120")
@@ -87,6 +184,11 @@ ALERTS_CHANNEL = os.getenv("REDIS_ALERTS_CHANNEL", "alerts:live")
 ALERT_RETENTION_SECONDS = _parse_int_env("ALERT_RETENTION_SECONDS", "86400")
 
 POSTGRES_RETENTION_DAYS = _parse_int_env("POSTGRES_RETENTION_DAYS", "30")
+POSTGRES_ROLLUP_1M_RETENTION_DAYS = _parse_int_env("POSTGRES_ROLLUP_1M_RETENTION_DAYS", "90")
+POSTGRES_ROLLUP_1H_RETENTION_DAYS = _parse_int_env("POSTGRES_ROLLUP_1H_RETENTION_DAYS", "730")
+# Ranges up to this long are served from raw snapshots when the resolution is "auto".
+HISTORY_RAW_MAX_SECONDS = _parse_int_env("HISTORY_RAW_MAX_SECONDS", "900")
+HISTORY_MAX_ROWS = _parse_int_env("HISTORY_MAX_ROWS", "50000")
 
 
 app = FastAPI(
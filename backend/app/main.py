@@ -1,15 +1,21 @@
 """Backend API entrypoints for ingesting, querying, alerting, and streaming system metrics."""
 
+import asyncio
 import importlib
 import json
 import logging
 import re
 import threading
+import time
+import zlib
+from contextlib import ExitStack, contextmanager
 from collections import defaultdict, deque
 from datetime import datetime, timedelta, timezone
-from typing import Deque, Dict, List, Tuple
+from typing import Annotated, Any, Callable, Deque, Dict, FrozenSet, List, NamedTuple, Set, Tuple
 
-from fastapi import Header, HTTPException, Query, Request, WebSocket, WebSocketDisconnect
+from fastapi import Depends, Header, HTTPException, Query, Request, WebSocket
+from fastapi.exceptions import RequestValidationError
+from pydantic import Field, TypeAdapter, ValidationError
 from redis import Redis
 from redis.asyncio import Redis as AsyncRedis
 from redis.exceptions import RedisError
@@ -22,18 +28,36 @@ from .declarations import (
         ALERT_CPU_DURATION_SECONDS,
         ALERT_CPU_THRESHOLD,
         ALERT_RETENTION_SECONDS,
+        BINARY_METRICS_CONTENT_TYPE,
+        BatchIngestResponse,
+        DELTA_STATE_KEY_PREFIX,
+        DELTA_STATE_TTL_SECONDS,
+        DeltaDocument,
+        HISTORY_MAX_ROWS,
+        HISTORY_RAW_MAX_SECONDS,
         HealthResponse,
+        HistoryPoint,
         IngestResponse,
+        MAX_BATCH_ITEMS,
+        MAX_INGEST_BODY_BYTES,
+        MAX_TOP_CGROUPS,
+        MAX_TOP_PROCESSES,
         METRICS_CHANNEL,
         METRICS_KEY,
+        POSTGRES_BUFFER_MAX_ROWS,
         POSTGRES_DSN,
+        POSTGRES_FLUSH_INTERVAL_MS,
+        POSTGRES_FLUSH_MAX_ROWS,
         POSTGRES_RETENTION_DAYS,
+        POSTGRES_ROLLUP_1H_RETENTION_DAYS,
+        POSTGRES_ROLLUP_1M_RETENTION_DAYS,
         POSTGRES_TABLE,
         REDIS_DB,
         REDIS_HOST,
         REDIS_PORT,
         RETENTION_SECONDS,
         AlertEvent,
+        MetricsHistoryResponse,
         MetricsPayload,
         app,
 )
@@ -41,16 +65,32 @@ from .declarations import (
 
 logger = logging.getLogger(__name__)
 _postgres_schema_ready = False
+_postgres_raw_partitioned = False
+_postgres_partitions: Set[str] = set()  # Day partitions known to exist.
+# Per-agent state is guarded by one of a fixed set of locks picked by agent ID,
+# so requests from different agents rarely wait on each other.
+_STATE_SHARD_COUNT = 16
 _agent_rate_windows: Dict[str, Deque[int]] = defaultdict(deque)
-_rate_limit_lock = threading.Lock()
-_alert_state_lock = threading.Lock()
-_high_cpu_window_start_ts: int | None = None
-_high_cpu_alert_active = False
+_rate_limit_locks = [threading.Lock() for _ in range(_STATE_SHARD_COUNT)]
+_agent_alert_states: Dict[str, "_CpuAlertState"] = {}
+_alert_state_locks = [threading.Lock() for _ in range(_STATE_SHARD_COUNT)]
 _last_postgres_prune_epoch = 0
+_redis_client: Redis | None = None
+_redis_client_lock = threading.Lock()
+_batch_adapter = TypeAdapter(Annotated[List[MetricsPayload], Field(min_length=1, max_length=MAX_BATCH_ITEMS)])
+_delta_adapter = TypeAdapter(Annotated[List[DeltaDocument], Field(min_length=1, max_length=MAX_BATCH_ITEMS)])
+_BINARY_METRICS_MAGIC = b"MTB"
+_BINARY_METRICS_VERSION = 1
 
 
 def get_redis() -> Redis:
-        return Redis(host=REDIS_HOST, port=REDIS_PORT, db=REDIS_DB, decode_responses=True)
+        """Shared client; its connection pool is thread-safe, so requests reuse connections."""
+        global _redis_client
+        if _redis_client is None:
+                with _redis_client_lock:
+                        if _redis_client is None:
+                                _redis_client = Redis(host=REDIS_HOST, port=REDIS_PORT, db=REDIS_DB, decode_responses=True)
+        return _redis_client
 
 
 def get_async_redis() -> AsyncRedis:
@@ -76,8 +116,46 @@ def _resolve_postgres_table_name() -> str:
         return "metrics_snapshots"
 
 
+# Rollup tables: name suffix -> bucket width in seconds.
+_ROLLUPS = (("1m", 60), ("1h", 3600))
+_PARTITION_NAME = re.compile(r"_p(\d{8})$")
+
+
+class _PostgresRow(NamedTuple):
+        """One snapshot's raw-table parameters and its contribution to the rollups."""
+
+        params: tuple
+        agent: str
+        epoch_seconds: float
+        samples: int
+        cpu_sum: float
+        cpu_min: float
+        cpu_max: float
+        memory_used_sum: float
+        memory_used_max: float
+        memory_total_mb: float
+
+
+def _is_partitioned(cursor, table_name: str) -> bool:
+        cursor.execute(
+                """
+                SELECT c.relkind FROM pg_class c JOIN pg_namespace n ON n.oid = c.relnamespace
+                WHERE c.relname = %s AND n.nspname = current_schema()
+                """,
+                (table_name,),
+        )
+        row = cursor.fetchone()
+        return row is not None and row[0] == "p"
+
+
 def _ensure_postgres_schema(connection) -> None:
-        global _postgres_schema_ready
+        """Create the raw table and the rollup tables.
+
+        The raw table and the 1-minute rollup are partitioned by day, so retention drops whole
+        partitions; partitions are created as rows for new days arrive. A raw table created
+        before partitioning stays as it is and keeps row-by-row retention deletes.
+        """
+        global _postgres_schema_ready, _postgres_raw_partitioned
         if _postgres_schema_ready:
                 return
 
@@ -86,7 +164,7 @@ def _ensure_postgres_schema(connection) -> None:
                 cursor.execute(
                         f"""
                         CREATE TABLE IF NOT EXISTS {table_name} (
-                                id BIGSERIAL PRIMARY KEY,
+                                id BIGSERIAL,
                                 timestamp_utc TIMESTAMPTZ NOT NULL,
                                 epoch_seconds BIGINT NOT NULL,
                                 total_cpu_percent DOUBLE PRECISION NOT NULL,
@@ -94,8 +172,32 @@ def _ensure_postgres_schema(connection) -> None:
                                 system_memory_total_mb DOUBLE PRECISION NOT NULL DEFAULT 0,
                                 system_memory_used_mb DOUBLE PRECISION NOT NULL DEFAULT 0,
                                 top_processes JSONB NOT NULL DEFAULT '[]'::jsonb,
-                                created_at TIMESTAMPTZ NOT NULL DEFAULT NOW()
-                        )
+                                top_cgroups JSONB NOT NULL DEFAULT '[]'::jsonb,
+                                window_stats JSONB,
+                                agent TEXT,
+                                created_at TIMESTAMPTZ NOT NULL DEFAULT NOW(),
+                                PRIMARY KEY (id, timestamp_utc)
+                        ) PARTITION BY RANGE (timestamp_utc)
+                        """
+                )
+                # Tables created before cgroup reporting lack the column.
+                cursor.execute(
+                        f"""
+                        ALTER TABLE {table_name}
+                        ADD COLUMN IF NOT EXISTS top_cgroups JSONB NOT NULL DEFAULT '[]'::jsonb
+                        """
+                )
+                # Likewise for window summaries; raw snapshots leave it NULL.
+                cursor.execute(
+                        f"""
+                        ALTER TABLE {table_name}
+                        ADD COLUMN IF NOT EXISTS window_stats JSONB
+                        """
+                )
+                cursor.execute(
+                        f"""
+                        ALTER TABLE {table_name}
+                        ADD COLUMN IF NOT EXISTS agent TEXT
                         """
                 )
                 cursor.execute(
@@ -110,10 +212,93 @@ def _ensure_postgres_schema(connection) -> None:
                         ON {table_name} (created_at DESC)
                         """
                 )
+                cursor.execute(
+                        f"""
+                        CREATE INDEX IF NOT EXISTS idx_{table_name}_agent_timestamp_utc
+                        ON {table_name} (agent, timestamp_utc)
+                        """
+                )
+                for suffix, _ in _ROLLUPS:
+                        partitioning = "PARTITION BY RANGE (bucket)" if suffix == "1m" else ""
+                        cursor.execute(
+                                f"""
+                                CREATE TABLE IF NOT EXISTS {table_name}_{suffix} (
+                                        agent TEXT NOT NULL,
+                                        bucket TIMESTAMPTZ NOT NULL,
+                                        samples INTEGER NOT NULL,
+                                        cpu_sum DOUBLE PRECISION NOT NULL,
+                                        cpu_min DOUBLE PRECISION NOT NULL,
+                                        cpu_max DOUBLE PRECISION NOT NULL,
+                                        memory_used_sum DOUBLE PRECISION NOT NULL,
+                                        memory_used_max DOUBLE PRECISION NOT NULL,
+                                        memory_total_mb DOUBLE PRECISION NOT NULL,
+                                        PRIMARY KEY (agent, bucket)
+                                ) {partitioning}
+                                """
+                        )
+                _postgres_raw_partitioned = _is_partitioned(cursor, table_name)
 
+        if not _postgres_raw_partitioned:
+                logger.info("PostgreSQL table %s is not partitioned; retention deletes rows", table_name)
+        _postgres_partitions.clear()
         _postgres_schema_ready = True
 
 
+def _partition_day(epoch_seconds: float) -> datetime:
+        moment = datetime.fromtimestamp(epoch_seconds, tz=timezone.utc)
+        return moment.replace(hour=0, minute=0, second=0, microsecond=0)
+
+
+def _ensure_daily_partitions(connection, rows: List[_PostgresRow]) -> None:
+        """Create the day partitions `rows` fall into, outside any transaction.
+
+        Created partitions are remembered, so the DDL runs once per day and table; it is
+        committed on its own so that a failed insert does not roll it back behind the cache.
+        Two backends creating the same partition at once make one insert fail and be retried.
+        """
+        table_name = _resolve_postgres_table_name()
+        tables = [f"{table_name}_1m"]
+        if _postgres_raw_partitioned:
+                tables.append(table_name)
+
+        days = {_partition_day(row.epoch_seconds) for row in rows}
+        with connection.cursor() as cursor:
+                for day in sorted(days):
+                        for parent in tables:
+                                name = f"{parent}_p{day:%Y%m%d}"
+                                if name in _postgres_partitions:
+                                        continue
+                                cursor.execute(
+                                        f"""
+                                        CREATE TABLE IF NOT EXISTS {name} PARTITION OF {parent}
+                                        FOR VALUES FROM ('{day.isoformat()}') TO ('{(day + timedelta(days=1)).isoformat()}')
+                                        """
+                                )
+                                _postgres_partitions.add(name)
+
+
+def _drop_expired_partitions(cursor, parent: str, cutoff: datetime) -> None:
+        """Drop the day partitions of `parent` that end at or before `cutoff`."""
+        cursor.execute(
+                """
+                SELECT c.relname FROM pg_inherits i
+                JOIN pg_class c ON c.oid = i.inhrelid
+                JOIN pg_class p ON p.oid = i.inhparent
+                JOIN pg_namespace n ON n.oid = p.relnamespace
+                WHERE p.relname = %s AND n.nspname = current_schema()
+                """,
+                (parent,),
+        )
+        for (name,) in cursor.fetchall():
+                match = _PARTITION_NAME.search(name)
+                if match is None or name != f"{parent}_p{match.group(1)}":
+                        continue
+                day = datetime.strptime(match.group(1), "%Y%m%d").replace(tzinfo=timezone.utc)
+                if day + timedelta(days=1) <= cutoff:
+                        cursor.execute(f"DROP TABLE IF EXISTS {name}")
+                        _postgres_partitions.discard(name)
+
+
 def check_postgres_connection() -> None:
         if not POSTGRES_DSN:
                 return
@@ -127,9 +312,19 @@ def check_postgres_connection() -> None:
 
 
 def apply_postgres_retention_policy(reference_time: datetime) -> None:
+        """Drop expired partitions (or delete rows of an unpartitioned table) at most once a minute.
+
+        POSTGRES_RETENTION_DAYS applies to raw snapshots, the ROLLUP settings to the rollups;
+        0 keeps that data forever.
+        """
         global _last_postgres_prune_epoch
 
-        if not POSTGRES_DSN or POSTGRES_RETENTION_DAYS <= 0:
+        retention_days = {
+                "": POSTGRES_RETENTION_DAYS,
+                "_1m": POSTGRES_ROLLUP_1M_RETENTION_DAYS,
+                "_1h": POSTGRES_ROLLUP_1H_RETENTION_DAYS,
+        }
+        if not POSTGRES_DSN or all(days <= 0 for days in retention_days.values()):
                 return
 
         epoch_now = int(reference_time.timestamp())
@@ -138,68 +333,769 @@ def apply_postgres_retention_policy(reference_time: datetime) -> None:
 
         try:
                 psycopg, _ = _load_psycopg_modules()
-                cutoff = reference_time - timedelta(days=POSTGRES_RETENTION_DAYS)
                 table_name = _resolve_postgres_table_name()
 
                 with psycopg.connect(POSTGRES_DSN, autocommit=True) as connection:
                         _ensure_postgres_schema(connection)
                         with connection.cursor() as cursor:
-                                cursor.execute(
-                                        f"DELETE FROM {table_name} WHERE timestamp_utc < %s",
-                                        (cutoff,),
-                                )
+                                for suffix, days in retention_days.items():
+                                        if days <= 0:
+                                                continue
+                                        cutoff = reference_time - timedelta(days=days)
+                                        if suffix == "_1h":
+                                                cursor.execute(f"DELETE FROM {table_name}_1h WHERE bucket < %s", (cutoff,))
+                                        elif suffix == "" and not _postgres_raw_partitioned:
+                                                cursor.execute(f"DELETE FROM {table_name} WHERE timestamp_utc < %s", (cutoff,))
+                                        else:
+                                                _drop_expired_partitions(cursor, f"{table_name}{suffix}", cutoff)
 
                 _last_postgres_prune_epoch = epoch_now
         except Exception as ex:
                 logger.warning("PostgreSQL retention policy check failed: %s", str(ex))
 
 
-def store_metrics_in_postgres(payload: MetricsPayload) -> None:
-        if not POSTGRES_DSN:
+def _payload_epoch(payload: MetricsPayload) -> float:
+        """Collection time in seconds, with millisecond precision when the agent sent it."""
+        if payload.timestamp_ms is not None:
+                return payload.timestamp_ms / 1000.0
+        return float(payload.timestamp)
+
+
+def _postgres_rows(payloads: List[MetricsPayload], json_wrapper) -> List[_PostgresRow]:
+        rows: List[_PostgresRow] = []
+        for payload in payloads:
+                epoch = _payload_epoch(payload)
+                params = (
+                        datetime.fromtimestamp(epoch, tz=timezone.utc),
+                        payload.timestamp,
+                        payload.total_cpu_percent,
+                        json_wrapper(payload.per_core_cpu_percent),
+                        payload.system_memory_total_mb,
+                        payload.system_memory_used_mb,
+                        json_wrapper([process.model_dump() for process in payload.top_processes]),
+                        json_wrapper([cgroup.model_dump() for cgroup in payload.top_cgroups]),
+                        json_wrapper(payload.window.model_dump()) if payload.window is not None else None,
+                        payload.agent,
+                )
+                # A window summary stands for all of its samples in the rollups.
+                window = payload.window
+                if window is not None and window.samples > 0:
+                        samples = window.samples
+                        cpu = window.total_cpu_percent
+                        memory = window.system_memory_used_mb
+                        rollup = (samples, cpu.mean * samples, cpu.min, cpu.max, memory.mean * samples, memory.max)
+                else:
+                        cpu_value = payload.total_cpu_percent
+                        memory_value = payload.system_memory_used_mb
+                        rollup = (1, cpu_value, cpu_value, cpu_value, memory_value, memory_value)
+                rows.append(_PostgresRow(params, payload.agent or "", epoch, *rollup, payload.system_memory_total_mb))
+        return rows
+
+
+def _rollup_rows(rows: List[_PostgresRow], width_seconds: int) -> List[tuple]:
+        """Pre-aggregate rows per agent and bucket, so each bucket is upserted once per batch."""
+        buckets: Dict[Tuple[str, int], List[float]] = {}
+        for row in rows:
+                key = (row.agent, int(row.epoch_seconds // width_seconds) * width_seconds)
+                bucket = buckets.get(key)
+                if bucket is None:
+                        buckets[key] = [
+                                row.samples,
+                                row.cpu_sum,
+                                row.cpu_min,
+                                row.cpu_max,
+                                row.memory_used_sum,
+                                row.memory_used_max,
+                                row.memory_total_mb,
+                        ]
+                        continue
+                bucket[0] += row.samples
+                bucket[1] += row.cpu_sum
+                bucket[2] = min(bucket[2], row.cpu_min)
+                bucket[3] = max(bucket[3], row.cpu_max)
+                bucket[4] += row.memory_used_sum
+                bucket[5] = max(bucket[5], row.memory_used_max)
+                bucket[6] = max(bucket[6], row.memory_total_mb)
+        return [
+                (agent, datetime.fromtimestamp(start, tz=timezone.utc), *values)
+                for (agent, start), values in sorted(buckets.items(), key=lambda item: (item[0][1], item[0][0]))
+        ]
+
+
+def _insert_postgres_rows(connection, rows: List[_PostgresRow]) -> None:
+        """Insert raw rows and fold them into the rollups, in one transaction with one executemany per table."""
+        table_name = _resolve_postgres_table_name()
+        _ensure_daily_partitions(connection, rows)
+        with connection.transaction():
+                with connection.cursor() as cursor:
+                        cursor.executemany(
+                                f"""
+                                INSERT INTO {table_name} (
+                                        timestamp_utc,
+                                        epoch_seconds,
+                                        total_cpu_percent,
+                                        per_core_cpu_percent,
+                                        system_memory_total_mb,
+                                        system_memory_used_mb,
+                                        top_processes,
+                                        top_cgroups,
+                                        window_stats,
+                                        agent
+                                )
+                                VALUES (%s, %s, %s, %s, %s, %s, %s, %s, %s, %s)
+                                """,
+                                [row.params for row in rows],
+                        )
+                        for suffix, width_seconds in _ROLLUPS:
+                                cursor.executemany(
+                                        f"""
+                                        INSERT INTO {table_name}_{suffix} AS r (
+                                                agent, bucket, samples, cpu_sum, cpu_min, cpu_max,
+                                                memory_used_sum, memory_used_max, memory_total_mb
+                                        )
+                                        VALUES (%s, %s, %s, %s, %s, %s, %s, %s, %s)
+                                        ON CONFLICT (agent, bucket) DO UPDATE SET
+                                                samples = r.samples + EXCLUDED.samples,
+                                                cpu_sum = r.cpu_sum + EXCLUDED.cpu_sum,
+                                                cpu_min = LEAST(r.cpu_min, EXCLUDED.cpu_min),
+                                                cpu_max = GREATEST(r.cpu_max, EXCLUDED.cpu_max),
+                                                memory_used_sum = r.memory_used_sum + EXCLUDED.memory_used_sum,
+                                                memory_used_max = GREATEST(r.memory_used_max, EXCLUDED.memory_used_max),
+                                                memory_total_mb = GREATEST(r.memory_total_mb, EXCLUDED.memory_total_mb)
+                                        """,
+                                        _rollup_rows(rows, width_seconds),
+                                )
+
+
+def store_metrics_in_postgres(payloads: List[MetricsPayload]) -> None:
+        """Insert snapshots now, on a connection of their own."""
+        if not POSTGRES_DSN or not payloads:
                 return
 
         psycopg, json_wrapper = _load_psycopg_modules()
-        table_name = _resolve_postgres_table_name()
-        snapshot_time = datetime.fromtimestamp(payload.timestamp, tz=timezone.utc)
-        top_processes = [process.model_dump() for process in payload.top_processes]
+        rows = _postgres_rows(payloads, json_wrapper)
 
         try:
                 with psycopg.connect(POSTGRES_DSN, autocommit=True) as connection:
                         _ensure_postgres_schema(connection)
-                        with connection.cursor() as cursor:
-                                cursor.execute(
-                                        f"""
-                                        INSERT INTO {table_name} (
-                                                timestamp_utc,
-                                                epoch_seconds,
-                                                total_cpu_percent,
-                                                per_core_cpu_percent,
-                                                system_memory_total_mb,
-                                                system_memory_used_mb,
-                                                top_processes
-                                        )
-                                        VALUES (%s, %s, %s, %s, %s, %s, %s)
-                                        """,
-                                        (
-                                                snapshot_time,
-                                                payload.timestamp,
-                                                payload.total_cpu_percent,
-                                                json_wrapper(payload.per_core_cpu_percent),
-                                                payload.system_memory_total_mb,
-                                                payload.system_memory_used_mb,
-                                                json_wrapper(top_processes),
-                                        ),
-                                )
+                        _insert_postgres_rows(connection, rows)
         except Exception as ex:
                 raise HTTPException(status_code=503, detail=f"PostgreSQL unavailable: {str(ex)}") from ex
 
 
+def _is_postgres_data_error(ex: Exception) -> bool:
+        """True when PostgreSQL rejected the rows themselves, so retrying them cannot succeed."""
+        try:
+                psycopg, _ = _load_psycopg_modules()
+        except HTTPException:
+                return False
+        if isinstance(ex, (psycopg.OperationalError, psycopg.InterfaceError)):
+                return False
+        return isinstance(ex, psycopg.Error)
+
+
+class _BufferReservation:
+        """Write-behind room held for a request's rows until they are enqueued or released."""
+
+        def __init__(self, rows: int) -> None:
+                self.rows = rows
+
+
+class PostgresWriteBehind:
+        """Buffers snapshot rows for PostgreSQL and inserts them from one background thread.
+
+        Ingest requests only append rows. The thread inserts up to `flush_max_rows` of them per
+        transaction, at least every `flush_interval_ms`, on a connection it keeps open, and runs
+        the retention policy between flushes. Rows of a flush that lost its connection go back to
+        the front of the buffer; rows PostgreSQL rejects are dropped. Once `buffer_max_rows` rows are waiting or reserved, requests get 503 so agents back
+        off (and spool) instead of the buffer growing without bound.
+        """
+
+        def __init__(self, flush_interval_ms: int, flush_max_rows: int, buffer_max_rows: int) -> None:
+                self._flush_interval = max(flush_interval_ms, 1) / 1000.0
+                self._flush_max_rows = max(flush_max_rows, 1)
+                self._buffer_max_rows = max(buffer_max_rows, self._flush_max_rows)
+                self._rows: Deque[_PostgresRow] = deque()
+                self._in_flight = 0
+                self._reserved = 0
+                self._condition = threading.Condition()
+                self._thread: threading.Thread | None = None
+                self._stopping = False
+                self._connection = None
+
+        def reserve(self, count: int) -> "_BufferReservation":
+                """Hold room for `count` rows, or answer 503 when the buffer cannot take them."""
+                with self._condition:
+                        self._check_room(count)
+                        self._reserved += count
+                        return _BufferReservation(count)
+
+        def release(self, reservation: "_BufferReservation") -> None:
+                """Give back the part of a reservation that enqueue did not use."""
+                with self._condition:
+                        self._reserved -= reservation.rows
+                        reservation.rows = 0
+
+        def enqueue(self, rows: List[_PostgresRow], reservation: "_BufferReservation | None" = None) -> None:
+                with self._condition:
+                        if reservation is not None:
+                                self._reserved -= reservation.rows
+                                reservation.rows = 0
+                        self._check_room(len(rows))
+                        self._rows.extend(rows)
+                        if self._thread is None:
+                                self._stopping = False
+                                self._thread = threading.Thread(target=self._run, name="postgres-write-behind", daemon=True)
+                                self._thread.start()
+                        elif len(self._rows) >= self._flush_max_rows:
+                                self._condition.notify_all()
+
+        def _check_room(self, count: int) -> None:
+                if len(self._rows) + self._in_flight + self._reserved + count > self._buffer_max_rows:
+                        raise HTTPException(
+                                status_code=503,
+                                detail="PostgreSQL write buffer full",
+                                headers={"Retry-After": "1"},
+                        )
+
+        def pending(self) -> int:
+                """Rows not yet committed, the ones being inserted included."""
+                with self._condition:
+                        return len(self._rows) + self._in_flight
+
+        def flush(self, timeout_seconds: float) -> bool:
+                """Wait until every buffered row is committed; False on timeout."""
+                deadline = time.monotonic() + timeout_seconds
+                with self._condition:
+                        self._condition.notify_all()
+                        while self._rows or self._in_flight:
+                                remaining = deadline - time.monotonic()
+                                if remaining <= 0 or self._thread is None:
+                                        return False
+                                self._condition.wait(remaining)
+                        return True
+
+        def stop(self, timeout_seconds: float) -> None:
+                """Flush what is buffered, then end the thread; rows left after the timeout are dropped."""
+                with self._condition:
+                        self._stopping = True
+                        self._condition.notify_all()
+                        thread = self._thread
+                if thread is not None:
+                        thread.join(timeout_seconds)
+                with self._condition:
+                        if self._rows:
+                                logger.error("PostgreSQL write-behind dropped %d rows at shutdown", len(self._rows))
+                                self._rows.clear()
+                if thread is None or not thread.is_alive():
+                        self._close_connection()
+
+        def _run(self) -> None:
+                while True:
+                        with self._condition:
+                                if len(self._rows) < self._flush_max_rows and not self._stopping:
+                                        self._condition.wait(self._flush_interval)
+                                if not self._rows:
+                                        if self._stopping:
+                                                self._thread = None
+                                                self._condition.notify_all()
+                                                return
+                                        continue
+                                batch = [self._rows.popleft() for _ in range(min(len(self._rows), self._flush_max_rows))]
+                                self._in_flight = len(batch)
+
+                        retry = self._insert_batch(batch)
+                        failed = bool(retry)
+
+                        with self._condition:
+                                self._in_flight = 0
+                                if failed:
+                                        self._rows.extendleft(reversed(retry))
+                                        if self._stopping:
+                                                self._thread = None
+                                                self._condition.notify_all()
+                                                return
+                                self._condition.notify_all()
+                                if failed:
+                                        # Retry after a pause rather than in a tight loop against a down server.
+                                        self._condition.wait(self._flush_interval)
+
+                        if not failed:
+                                apply_postgres_retention_policy(datetime.now(timezone.utc))
+
+        def _insert_batch(self, batch: List[_PostgresRow]) -> List[_PostgresRow]:
+                """Insert a batch; returns the rows to retry, none unless the connection failed.
+
+                Only connection and operational errors are retried. Rows PostgreSQL rejects would fail
+                every retry and hold up the whole buffer behind them, so on a data error the failing
+                part is split until the rejected rows are found, and those are logged and dropped.
+                """
+                parts = [batch]
+                while parts:
+                        rows = parts.pop()
+                        try:
+                                self._insert(rows)
+                        except Exception as ex:
+                                if _is_postgres_data_error(ex):
+                                        if len(rows) == 1:
+                                                logger.error("PostgreSQL write-behind dropped a row it rejected: %s", str(ex))
+                                        else:
+                                                middle = len(rows) // 2
+                                                parts.extend((rows[middle:], rows[:middle]))
+                                        continue
+                                logger.warning("PostgreSQL write-behind flush of %d rows failed: %s", len(rows), str(ex))
+                                self._close_connection()
+                                # The failure may have been a partition dropped or created elsewhere.
+                                _postgres_partitions.clear()
+                                return rows + [row for part in reversed(parts) for row in part]
+                return []
+
+        def _insert(self, rows: List[_PostgresRow]) -> None:
+                if self._connection is None:
+                        psycopg, _ = _load_psycopg_modules()
+                        self._connection = psycopg.connect(POSTGRES_DSN, autocommit=True)
+                        _ensure_postgres_schema(self._connection)
+                _insert_postgres_rows(self._connection, rows)
+
+        def _close_connection(self) -> None:
+                connection, self._connection = self._connection, None
+                if connection is None:
+                        return
+                try:
+                        connection.close()
+                except Exception:
+                        pass
+
+
+_postgres_writer = PostgresWriteBehind(POSTGRES_FLUSH_INTERVAL_MS, POSTGRES_FLUSH_MAX_ROWS, POSTGRES_BUFFER_MAX_ROWS)
+
+
+@contextmanager
+def postgres_buffer_reservation(count: int):
+        """Hold write-behind room for `count` snapshots while a request stores them.
+
+        Taken before any Redis side effect, so a 503 for a full buffer means nothing of the request
+        was applied and the agent's retry duplicates nothing. Room persist_metrics_in_postgres did
+        not use (the request failed first) is given back on exit. Yields None when the buffer is
+        disabled.
+        """
+        if not (POSTGRES_DSN and POSTGRES_FLUSH_INTERVAL_MS > 0):
+                yield None
+                return
+
+        reservation = _postgres_writer.reserve(count)
+        try:
+                yield reservation
+        finally:
+                _postgres_writer.release(reservation)
+
+
+def persist_metrics_in_postgres(
+        payloads: List[MetricsPayload],
+        reference_time: datetime,
+        reservation: _BufferReservation | None = None,
+) -> None:
+        """Hand snapshots to the write-behind buffer, or insert them now when it is disabled."""
+        if POSTGRES_DSN and POSTGRES_FLUSH_INTERVAL_MS > 0:
+                _, json_wrapper = _load_psycopg_modules()
+                _postgres_writer.enqueue(_postgres_rows(payloads, json_wrapper), reservation)
+                return
+
+        store_metrics_in_postgres(payloads)
+        apply_postgres_retention_policy(reference_time)
+
+
+def store_metrics_in_redis(
+        payloads: List[MetricsPayload],
+        min_ts: int,
+        delta_states: Dict[str, Dict[str, Any]] | None = None,
+) -> None:
+        """Add snapshots to the rolling window and publish each one, all in one pipeline.
+
+        `delta_states` (from reconstruct_delta_documents) are saved in the same pipeline, so a
+        stream's state never gets ahead of the snapshots it was rebuilt from.
+        """
+        try:
+                client = get_redis()
+                serialized = [payload.model_dump_json() for payload in payloads]
+
+                pipe = client.pipeline()
+                pipe.zadd(METRICS_KEY, {item: _payload_epoch(payload) for item, payload in zip(serialized, payloads)})
+                pipe.zremrangebyscore(METRICS_KEY, "-inf", min_ts)
+                if hasattr(pipe, "publish"):
+                        for item in serialized:
+                                pipe.publish(METRICS_CHANNEL, item)
+                pipe.expire(METRICS_KEY, RETENTION_SECONDS * 2)
+                for stream, state in (delta_states or {}).items():
+                        pipe.set(_delta_state_key(stream), json.dumps(state), ex=DELTA_STATE_TTL_SECONDS)
+                pipe.execute()
+        except RedisError as ex:
+                raise HTTPException(status_code=503, detail=f"Redis unavailable: {str(ex)}") from ex
+
+
+class _BinaryReader:
+        """Cursor over a binary metrics body; see the agent's BinaryMetricsEncoder for the layout."""
+
+        def __init__(self, data: bytes) -> None:
+                self.data = data
+                self.offset = 0
+
+        def at_end(self) -> bool:
+                return self.offset >= len(self.data)
+
+        def uvarint(self) -> int:
+                value = 0
+                shift = 0
+                while True:
+                        if self.offset >= len(self.data) or shift > 63:
+                                raise ValueError("truncated or oversized varint")
+                        byte = self.data[self.offset]
+                        self.offset += 1
+                        value |= (byte & 0x7F) << shift
+                        if byte < 0x80:
+                                return value
+                        shift += 7
+
+        def svarint(self) -> int:
+                raw = self.uvarint()
+                return (raw >> 1) ^ -(raw & 1)
+
+        def hundredths(self) -> float:
+                return self.svarint() / 100.0
+
+        def raw(self, length: int) -> bytes:
+                end = self.offset + length
+                if end > len(self.data):
+                        raise ValueError("truncated string")
+                chunk = self.data[self.offset:end]
+                self.offset = end
+                return chunk
+
+
+def decode_binary_metrics(body: bytes) -> List[Dict[str, Any]]:
+        """Decode an `application/x-metrics-binary` body into MetricsPayload-shaped dicts."""
+        if len(body) < 4 or not body.startswith(_BINARY_METRICS_MAGIC):
+                raise ValueError("missing binary metrics header")
+        if body[3] != _BINARY_METRICS_VERSION:
+                raise ValueError("unsupported binary metrics version")
+
+        reader = _BinaryReader(body)
+        reader.offset = 4
+        names: List[str] = []
+        snapshots: List[Dict[str, Any]] = []
+        timestamp_ms = 0
+        cores: List[int] = []
+        memory_total = 0
+        memory_used = 0
+
+        def read_name() -> str:
+                name_id = reader.uvarint()
+                if name_id == len(names):
+                        names.append(reader.raw(reader.uvarint()).decode("utf-8", errors="replace"))
+                elif name_id > len(names):
+                        raise ValueError("undefined name reference")
+                return names[name_id]
+
+        def read_window_stats() -> Dict[str, float]:
+                return {
+                        "min": reader.hundredths(),
+                        "max": reader.hundredths(),
+                        "mean": reader.hundredths(),
+                        "p95": reader.hundredths(),
+                }
+
+        while not reader.at_end():
+                if len(snapshots) >= MAX_BATCH_ITEMS:
+                        raise ValueError("too many snapshots")
+
+                timestamp_ms += reader.svarint()
+                total_cpu = reader.hundredths()
+
+                core_count = reader.uvarint()
+                if core_count > 4096:
+                        raise ValueError("implausible core count")
+                if len(cores) < core_count:
+                        cores.extend([0] * (core_count - len(cores)))
+                for core in range(core_count):
+                        cores[core] += reader.svarint()
+
+                memory_total += reader.svarint()
+                memory_used += reader.svarint()
+
+                process_count = reader.uvarint()
+                if process_count > MAX_TOP_PROCESSES:
+                        raise ValueError("too many processes")
+                processes = []
+                for _ in range(process_count):
+                        pid = reader.svarint()
+                        name = read_name()
+                        processes.append(
+                                {
+                                        "pid": pid,
+                                        "name": name,
+                                        "cpu_percent": reader.hundredths(),
+                                        "memory_mb": reader.hundredths(),
+                                        "thread_count": reader.svarint(),
+                                        "io_read_mb": reader.hundredths(),
+                                        "io_write_mb": reader.hundredths(),
+                                        "handle_count": reader.svarint(),
+                                }
+                        )
+
+                cgroups = []
+                cgroup_count = reader.uvarint()
+                if cgroup_count > MAX_TOP_CGROUPS:
+                        raise ValueError("too many cgroups")
+                for _ in range(cgroup_count):
+                        cgroups.append(
+                                {
+                                        "path": read_name(),
+                                        "cpu_percent": reader.hundredths(),
+                                        "memory_mb": reader.hundredths(),
+                                        "io_read_mb": reader.hundredths(),
+                                        "io_write_mb": reader.hundredths(),
+                                }
+                        )
+
+                window = None
+                window_samples = reader.uvarint()
+                if window_samples > 0:
+                        start_timestamp_ms = timestamp_ms - reader.uvarint()
+                        total_cpu_stats = read_window_stats()
+                        window_core_count = reader.uvarint()
+                        if window_core_count > 4096:
+                                raise ValueError("implausible core count")
+                        core_stats = [read_window_stats() for _ in range(window_core_count)]
+                        memory_stats = read_window_stats()
+                        window_process_count = reader.uvarint()
+                        if window_process_count > len(processes):
+                                raise ValueError("too many window processes")
+                        window_processes = []
+                        # Entries follow top_processes, so the PID is not repeated.
+                        for index in range(window_process_count):
+                                window_processes.append(
+                                        {
+                                                "pid": processes[index]["pid"],
+                                                "samples": reader.uvarint(),
+                                                "cpu_percent": read_window_stats(),
+                                                "memory_mb": read_window_stats(),
+                                        }
+                                )
+                        window = {
+                                "samples": window_samples,
+                                "start_timestamp_ms": start_timestamp_ms,
+                                "total_cpu_percent": total_cpu_stats,
+                                "per_core_cpu_percent": core_stats,
+                                "system_memory_used_mb": memory_stats,
+                                "top_processes": window_processes,
+                        }
+
+                snapshots.append(
+                        {
+                                "timestamp": timestamp_ms // 1000,
+                                "timestamp_ms": timestamp_ms,
+                                "total_cpu_percent": total_cpu,
+                                "per_core_cpu_percent": [value / 100.0 for value in cores[:core_count]],
+                                "system_memory_total_mb": memory_total / 100.0,
+                                "system_memory_used_mb": memory_used / 100.0,
+                                "top_processes": processes,
+                                "top_cgroups": cgroups,
+                                "window": window,
+                        }
+                )
+
+        return snapshots
+
+
+def _body_error(message: str) -> RequestValidationError:
+        return RequestValidationError([{"type": "value_error", "loc": ("body",), "msg": message, "input": None}])
+
+
+def _decode_request_body(body: bytes, content_encoding: str) -> bytes:
+        if content_encoding in ("", "identity"):
+                return body
+        if content_encoding != "gzip":
+                raise HTTPException(status_code=415, detail=f"Unsupported Content-Encoding: {content_encoding}")
+
+        decompressor = zlib.decompressobj(wbits=31)
+        try:
+                decoded = decompressor.decompress(body, MAX_INGEST_BODY_BYTES)
+        except zlib.error as ex:
+                raise _body_error(f"invalid gzip body: {str(ex)}") from ex
+        if decompressor.unconsumed_tail:
+                raise HTTPException(status_code=413, detail="Decompressed body too large")
+        return decoded
+
+
+def _ingest_body(batch: bool) -> Callable:
+        """Build a dependency that parses JSON or binary ingest bodies into MetricsPayload objects."""
+
+        async def parse(request: Request) -> List[MetricsPayload]:
+                body = _decode_request_body(
+                        await request.body(),
+                        request.headers.get("content-encoding", "").strip().lower(),
+                )
+                content_type = request.headers.get("content-type", "").split(";")[0].strip().lower()
+
+                try:
+                        if content_type == BINARY_METRICS_CONTENT_TYPE:
+                                try:
+                                        decoded = decode_binary_metrics(body)
+                                except ValueError as ex:
+                                        raise _body_error(f"invalid binary metrics body: {str(ex)}") from ex
+                                if not batch and len(decoded) != 1:
+                                        raise _body_error("expected exactly one snapshot")
+                                return _batch_adapter.validate_python(decoded)
+                        if batch:
+                                return _batch_adapter.validate_json(body)
+                        return [MetricsPayload.model_validate_json(body)]
+                except ValidationError as ex:
+                        raise RequestValidationError(
+                                [{**error, "loc": ("body", *error["loc"])} for error in ex.errors(include_url=False)]
+                        ) from ex
+
+        return parse
+
+
+def _delta_body() -> Callable:
+        """Parse a JSON array of delta documents (see the agent's MetricsDeltaEncoder)."""
+
+        async def parse(request: Request) -> List[DeltaDocument]:
+                body = _decode_request_body(
+                        await request.body(),
+                        request.headers.get("content-encoding", "").strip().lower(),
+                )
+                content_type = request.headers.get("content-type", "").split(";")[0].strip().lower()
+                if content_type not in ("", "application/json"):
+                        raise HTTPException(status_code=415, detail=f"Unsupported Content-Type for deltas: {content_type}")
+                try:
+                        return _delta_adapter.validate_json(body)
+                except ValidationError as ex:
+                        raise RequestValidationError(
+                                [{**error, "loc": ("body", *error["loc"])} for error in ex.errors(include_url=False)]
+                        ) from ex
+
+        return parse
+
+
+def _ordered_entries(entries: Dict[Any, Dict[str, Any]], order: List[Any] | None, field: str) -> List[Dict[str, Any]]:
+        if order is None:
+                return list(entries.values())
+        if len(order) != len(entries) or set(order) != entries.keys():
+                raise ValueError(f"{field} does not list the rebuilt entries")
+        return [entries[key] for key in order]
+
+
+def apply_metrics_delta(base: Dict[str, Any], delta: Dict[str, Any]) -> Dict[str, Any]:
+        """Rebuild a whole snapshot from the previous one of the stream and the changes in `delta`.
+
+        Fields missing from `delta` keep their previous value; `window` belongs to a single
+        snapshot and is never carried over. Processes are keyed by pid (an entry with a
+        `name` replaces the process, one without updates a known one) and cgroups by path.
+        Both lists keep the previous order, with removed entries dropped and new ones appended,
+        unless `process_order` (pids) or `cgroup_order` (paths) gives the agent's ranking, which
+        must list exactly the rebuilt entries. So the rebuilt lists are in the agent's order and
+        `window.top_processes` stays aligned with `top_processes`.
+        """
+        if "timestamp" not in delta:
+                raise ValueError("delta without timestamp")
+        snapshot = {key: value for key, value in base.items() if key != "window"}
+        for key in ("timestamp", "timestamp_ms", "total_cpu_percent", "system_memory_total_mb", "system_memory_used_mb", "window"):
+                if key in delta:
+                        snapshot[key] = delta[key]
+
+        cores = list(snapshot.get("per_core_cpu_percent", []))
+        for index, value in delta.get("per_core_cpu_percent", {}).items():
+                core = int(index)
+                if not 0 <= core < len(cores):
+                        raise ValueError(f"core {index} out of range")
+                cores[core] = value
+        snapshot["per_core_cpu_percent"] = cores
+
+        processes = {process["pid"]: process for process in snapshot.get("top_processes", [])}
+        for pid in delta.get("removed_pids", []):
+                processes.pop(pid, None)
+        for entry in delta.get("top_processes", []):
+                pid = entry["pid"]
+                if "name" in entry:
+                        processes[pid] = dict(entry)
+                elif pid in processes:
+                        processes[pid] = {**processes[pid], **entry}
+                else:
+                        raise ValueError(f"change for unknown pid {pid}")
+        snapshot["top_processes"] = _ordered_entries(processes, delta.get("process_order"), "process_order")
+
+        cgroups = {cgroup["path"]: cgroup for cgroup in snapshot.get("top_cgroups", [])}
+        for path in delta.get("removed_cgroups", []):
+                cgroups.pop(path, None)
+        for entry in delta.get("top_cgroups", []):
+                cgroups[entry["path"]] = {**cgroups.get(entry["path"], {}), **entry}
+        snapshot["top_cgroups"] = _ordered_entries(cgroups, delta.get("cgroup_order"), "cgroup_order")
+        return snapshot
+
+
+def _delta_state_key(stream: str) -> str:
+        return f"{DELTA_STATE_KEY_PREFIX}{stream}"
+
+
+def reconstruct_delta_documents(documents: List[DeltaDocument]) -> Tuple[List[MetricsPayload], Dict[str, Dict[str, Any]]]:
+        """Turn delta documents into whole snapshots, using each stream's last snapshot from Redis.
+
+        Returns the snapshots and the new state of every stream, to be saved by
+        store_metrics_in_redis() along with the snapshots. A delta that does not follow the
+        stream's last sequence number (its base is missing or expired) raises 409, which
+        tells the agent to start over from a keyframe.
+        """
+        states: Dict[str, Dict[str, Any] | None] = {}
+        # One MGET for the streams whose first document in this request is a delta.
+        for document in documents:
+                if document.stream not in states:
+                        states[document.stream] = {} if document.keyframe is not None else None
+        stored_streams = [stream for stream, state in states.items() if state is None]
+        if stored_streams:
+                try:
+                        raw_states = get_redis().mget([_delta_state_key(stream) for stream in stored_streams])
+                except RedisError as ex:
+                        raise HTTPException(status_code=503, detail=f"Redis unavailable: {str(ex)}") from ex
+                for stream, raw in zip(stored_streams, raw_states):
+                        states[stream] = json.loads(raw) if raw else None
+
+        payloads: List[MetricsPayload] = []
+        for document in documents:
+                if document.keyframe is not None:
+                        payload = document.keyframe
+                else:
+                        state = states[document.stream]
+                        if state is None or state["sequence"] != document.sequence - 1:
+                                raise HTTPException(status_code=409, detail="Delta base missing; send a keyframe")
+                        try:
+                                payload = MetricsPayload.model_validate(apply_metrics_delta(state["snapshot"], document.delta))
+                        except ValidationError as ex:
+                                raise RequestValidationError(
+                                        [{**error, "loc": ("body", "delta", *error["loc"])} for error in ex.errors(include_url=False)]
+                                ) from ex
+                        except (ValueError, TypeError, KeyError, AttributeError) as ex:
+                                raise _body_error(f"invalid delta: {str(ex)}") from ex
+                states[document.stream] = {
+                        "sequence": document.sequence,
+                        "snapshot": payload.model_dump(exclude={"window"}),
+                }
+                payloads.append(payload)
+        return payloads, {stream: state for stream, state in states.items() if state is not None}
+
+
 def _agent_client_id(request: Request) -> str:
         if request.client and request.client.host:
                 return request.client.host
         return "unknown-agent"
 
 
+def _stamp_agent(payloads: List[MetricsPayload], client_id: str) -> None:
+        """Record which agent sent each snapshot, for subscription filters and per-agent queries."""
+        for payload in payloads:
+                payload.agent = client_id
+
+
 def enforce_agent_auth(x_agent_token: str | None) -> None:
         if not AGENT_API_TOKEN:
                 return
@@ -208,18 +1104,28 @@ def enforce_agent_auth(x_agent_token: str | None) -> None:
                 raise HTTPException(status_code=401, detail="Invalid or missing agent token")
 
 
+def _state_lock(locks: List[threading.Lock], client_id: str) -> threading.Lock:
+        return locks[hash(client_id) % len(locks)]
+
+
 def enforce_rate_limit(client_id: str, request_time_epoch: int) -> None:
         if AGENT_RATE_LIMIT_PER_MINUTE <= 0:
                 return
 
-        with _rate_limit_lock:
+        with _state_lock(_rate_limit_locks, client_id):
                 window = _agent_rate_windows[client_id]
                 lower_bound = request_time_epoch - 60
                 while window and window[0] < lower_bound:
                         window.popleft()
 
                 if len(window) >= AGENT_RATE_LIMIT_PER_MINUTE:
-                        raise HTTPException(status_code=429, detail="Agent rate limit exceeded")
+                        # Seconds until the oldest request leaves the window; agents back off at least this long.
+                        retry_after = max(1, window[0] + 60 - request_time_epoch)
+                        raise HTTPException(
+                                status_code=429,
+                                detail="Agent rate limit exceeded",
+                                headers={"Retry-After": str(retry_after)},
+                        )
 
                 window.append(request_time_epoch)
 
@@ -241,18 +1147,29 @@ def publish_alert(alert: AlertEvent) -> None:
                 logger.warning("Alert publish failed: %s", str(ex))
 
 
-def evaluate_cpu_alert_rule(payload: MetricsPayload) -> AlertEvent | None:
-        global _high_cpu_window_start_ts, _high_cpu_alert_active
+class _CpuAlertState:
+        __slots__ = ("window_start_ts", "active")
+
+        def __init__(self) -> None:
+                self.window_start_ts: int | None = None
+                self.active = False
+
+
+def evaluate_cpu_alert_rule(payload: MetricsPayload, client_id: str) -> AlertEvent | None:
+        """Track how long an agent's CPU has stayed above the threshold; each agent has its own window."""
+        with _state_lock(_alert_state_locks, client_id):
+                state = _agent_alert_states.get(client_id)
+                if state is None:
+                        state = _agent_alert_states[client_id] = _CpuAlertState()
 
-        with _alert_state_lock:
                 current_cpu = float(payload.total_cpu_percent)
                 if current_cpu >= ALERT_CPU_THRESHOLD:
-                        if _high_cpu_window_start_ts is None:
-                                _high_cpu_window_start_ts = payload.timestamp
+                        if state.window_start_ts is None:
+                                state.window_start_ts = payload.timestamp
 
-                        elapsed = payload.timestamp - _high_cpu_window_start_ts
-                        if elapsed >= ALERT_CPU_DURATION_SECONDS and not _high_cpu_alert_active:
-                                _high_cpu_alert_active = True
+                        elapsed = payload.timestamp - state.window_start_ts
+                        if elapsed >= ALERT_CPU_DURATION_SECONDS and not state.active:
+                                state.active = True
                                 return AlertEvent(
                                         timestamp=payload.timestamp,
                                         rule="cpu_threshold_duration",
@@ -266,8 +1183,8 @@ def evaluate_cpu_alert_rule(payload: MetricsPayload) -> AlertEvent | None:
                                 )
                         return None
 
-                _high_cpu_window_start_ts = None
-                _high_cpu_alert_active = False
+                state.window_start_ts = None
+                state.active = False
                 return None
 
 
@@ -284,15 +1201,14 @@ def initialize_postgres_schema() -> None:
 
 @app.on_event("shutdown")
 def shutdown_cleanup() -> None:
-        """Release in-memory runtime state during graceful shutdown."""
-        global _high_cpu_window_start_ts, _high_cpu_alert_active
+        """Flush buffered PostgreSQL rows and release in-memory runtime state during graceful shutdown."""
+        _postgres_writer.stop(timeout_seconds=10.0)
 
-        with _rate_limit_lock:
+        with ExitStack() as stack:
+                for lock in _rate_limit_locks + _alert_state_locks:
+                        stack.enter_context(lock)
                 _agent_rate_windows.clear()
-
-        with _alert_state_lock:
-                _high_cpu_window_start_ts = None
-                _high_cpu_alert_active = False
+                _agent_alert_states.clear()
 
         logger.info("Backend shutdown cleanup completed")
 
@@ -328,51 +1244,124 @@ def health_check() -> dict:
         "/ingest/metrics",
         response_model=IngestResponse,
         summary="Ingest metrics snapshot",
-        description="Receives metrics from the agent, applies auth/rate limits, stores in Redis/PostgreSQL, and evaluates alerts.",
+        description=(
+                "Receives metrics from the agent, applies auth/rate limits, stores in Redis/PostgreSQL, and evaluates alerts. "
+                f"Accepts a MetricsPayload JSON object or a single-snapshot {BINARY_METRICS_CONTENT_TYPE} body, "
+                "optionally with Content-Encoding: gzip."
+        ),
 )
 def ingest_metrics(
-        payload: MetricsPayload,
         request: Request,
+        payloads: List[MetricsPayload] = Depends(_ingest_body(batch=False)),
         x_agent_token: str | None = Header(default=None, alias="X-Agent-Token"),
 ) -> dict:
         now = datetime.now(timezone.utc)
         now_epoch = int(now.timestamp())
         min_ts = int((now - timedelta(seconds=RETENTION_SECONDS)).timestamp())
 
+        client_id = _agent_client_id(request)
         enforce_agent_auth(x_agent_token)
-        enforce_rate_limit(_agent_client_id(request), now_epoch)
-
-        try:
-                client = get_redis()
-                serialized = payload.model_dump_json()
-
-                pipe = client.pipeline()
-                pipe.zadd(METRICS_KEY, {serialized: payload.timestamp})
-                pipe.zremrangebyscore(METRICS_KEY, "-inf", min_ts)
-                if hasattr(pipe, "publish"):
-                        pipe.publish(METRICS_CHANNEL, serialized)
-                pipe.expire(METRICS_KEY, RETENTION_SECONDS * 2)
-                pipe.execute()
-        except RedisError as ex:
-                raise HTTPException(status_code=503, detail=f"Redis unavailable: {str(ex)}") from ex
+        enforce_rate_limit(client_id, now_epoch)
 
-        store_metrics_in_postgres(payload)
-        apply_postgres_retention_policy(now)
+        _stamp_agent(payloads, client_id)
+        payload = payloads[0]
+        with postgres_buffer_reservation(1) as reservation:
+                store_metrics_in_redis([payload], min_ts)
+                persist_metrics_in_postgres([payload], now, reservation)
 
-        alert = evaluate_cpu_alert_rule(payload)
+        alert = evaluate_cpu_alert_rule(payload, client_id)
         if alert is not None:
                 publish_alert(alert)
 
         return {"status": "accepted", "timestamp": payload.timestamp}
 
 
+@app.post(
+        "/ingest/metrics/batch",
+        response_model=BatchIngestResponse,
+        summary="Ingest a batch of metrics snapshots",
+        description=(
+                "Receives a JSON array of snapshots queued by the agent (or a multi-snapshot "
+                f"{BINARY_METRICS_CONTENT_TYPE} body) and stores them with one Redis pipeline and one PostgreSQL "
+                "executemany. Counts as a single request for rate limiting."
+        ),
+)
+def ingest_metrics_batch(
+        request: Request,
+        payloads: List[MetricsPayload] = Depends(_ingest_body(batch=True)),
+        x_agent_token: str | None = Header(default=None, alias="X-Agent-Token"),
+) -> dict:
+        now = datetime.now(timezone.utc)
+        now_epoch = int(now.timestamp())
+        min_ts = int((now - timedelta(seconds=RETENTION_SECONDS)).timestamp())
+
+        client_id = _agent_client_id(request)
+        enforce_agent_auth(x_agent_token)
+        enforce_rate_limit(client_id, now_epoch)
+
+        ordered = sorted(payloads, key=_payload_epoch)
+        _stamp_agent(ordered, client_id)
+        with postgres_buffer_reservation(len(ordered)) as reservation:
+                store_metrics_in_redis(ordered, min_ts)
+                persist_metrics_in_postgres(ordered, now, reservation)
+
+        for payload in ordered:
+                alert = evaluate_cpu_alert_rule(payload, client_id)
+                if alert is not None:
+                        publish_alert(alert)
+
+        return {"status": "accepted", "accepted": len(ordered), "latest_timestamp": ordered[-1].timestamp}
+
+
+@app.post(
+        "/ingest/metrics/delta",
+        response_model=BatchIngestResponse,
+        summary="Ingest change-only metrics documents",
+        description=(
+                "Receives a JSON array of an agent's delta documents: keyframes with a whole MetricsPayload, and "
+                "deltas with only what changed since the previous document of the stream. Whole snapshots are rebuilt "
+                "and stored like a batch. Answers 409 when a delta's base is unknown, after which the agent resends "
+                "from a keyframe."
+        ),
+        responses={409: {"description": "The stream's previous snapshot is unknown; resend from a keyframe"}},
+)
+def ingest_metrics_delta(
+        request: Request,
+        documents: List[DeltaDocument] = Depends(_delta_body()),
+        x_agent_token: str | None = Header(default=None, alias="X-Agent-Token"),
+) -> dict:
+        now = datetime.now(timezone.utc)
+        now_epoch = int(now.timestamp())
+        min_ts = int((now - timedelta(seconds=RETENTION_SECONDS)).timestamp())
+
+        client_id = _agent_client_id(request)
+        enforce_agent_auth(x_agent_token)
+        enforce_rate_limit(client_id, now_epoch)
+
+        payloads, states = reconstruct_delta_documents(documents)
+        _stamp_agent(payloads, client_id)
+        with postgres_buffer_reservation(len(payloads)) as reservation:
+                store_metrics_in_redis(payloads, min_ts, states)
+                persist_metrics_in_postgres(payloads, now, reservation)
+
+        for payload in payloads:
+                alert = evaluate_cpu_alert_rule(payload, client_id)
+                if alert is not None:
+                        publish_alert(alert)
+
+        return {"status": "accepted", "accepted": len(payloads), "latest_timestamp": payloads[-1].timestamp}
+
+
 @app.get(
         "/api/metrics/recent",
         response_model=List[MetricsPayload],
         summary="Recent metrics",
-        description="Returns metric snapshots retained in the active Redis rolling window.",
+        description=(
+                "Returns metric snapshots retained in the active Redis rolling window, "
+                "optionally only those of the given agents (repeat `agent`)."
+        ),
 )
-def get_recent_metrics() -> List[MetricsPayload]:
+def get_recent_metrics(agent: List[str] | None = Query(default=None)) -> List[MetricsPayload]:
         now = datetime.now(timezone.utc)
         min_ts = int((now - timedelta(seconds=RETENTION_SECONDS)).timestamp())
 
@@ -382,12 +1371,15 @@ def get_recent_metrics() -> List[MetricsPayload]:
         except RedisError as ex:
                 raise HTTPException(status_code=503, detail=f"Redis unavailable: {str(ex)}") from ex
 
+        agents = set(agent) if agent else None
         parsed: List[MetricsPayload] = []
         for item in data:
                 try:
-                        parsed.append(MetricsPayload.model_validate_json(item))
+                        payload = MetricsPayload.model_validate_json(item)
                 except (ValueError, json.JSONDecodeError):
                         continue
+                if agents is None or payload.agent in agents:
+                        parsed.append(payload)
 
         return parsed
 
@@ -418,27 +1410,218 @@ def get_recent_alerts(minutes: int = Query(default=60, ge=1, le=1440)) -> List[A
         return parsed
 
 
+def choose_history_resolution(range_seconds: float, max_points: int) -> str:
+        """Finest resolution that serves `range_seconds` in at most `max_points` points per agent."""
+        if range_seconds <= HISTORY_RAW_MAX_SECONDS:
+                return "raw"
+        for suffix, width_seconds in _ROLLUPS:
+                if range_seconds / width_seconds <= max_points:
+                        return suffix
+        return _ROLLUPS[-1][0]
+
+
+def _history_query(resolution: str, filter_agents: bool) -> str:
+        table_name = _resolve_postgres_table_name()
+        agent_filter = "AND COALESCE(agent, '') = ANY(%s)" if filter_agents else ""
+        if resolution == "raw":
+                return f"""
+                        SELECT COALESCE(agent, ''), epoch_seconds, 1, total_cpu_percent, total_cpu_percent,
+                                total_cpu_percent, system_memory_used_mb, system_memory_used_mb, system_memory_total_mb
+                        FROM {table_name}
+                        WHERE timestamp_utc >= %s AND timestamp_utc < %s {agent_filter}
+                        ORDER BY timestamp_utc, agent
+                        LIMIT %s
+                        """
+        return f"""
+                SELECT agent, EXTRACT(EPOCH FROM bucket)::BIGINT, samples, cpu_sum / samples, cpu_min, cpu_max,
+                        memory_used_sum / samples, memory_used_max, memory_total_mb
+                FROM {table_name}_{resolution}
+                WHERE bucket >= %s AND bucket < %s {agent_filter}
+                ORDER BY bucket, agent
+                LIMIT %s
+                """
+
+
+@app.get(
+        "/api/metrics/history",
+        response_model=MetricsHistoryResponse,
+        summary="Historical metrics",
+        description=(
+                "Returns total CPU and memory from PostgreSQL between `start` and `end` (epoch seconds), "
+                "as raw snapshots or 1-minute or 1-hour rollups. `auto` picks the finest resolution "
+                "that yields at most `max_points` points per agent."
+        ),
+)
+def get_metrics_history(
+        start: int = Query(ge=0),
+        end: int | None = Query(default=None, ge=0),
+        agent: List[str] | None = Query(default=None),
+        resolution: str = Query(default="auto", pattern="^(auto|raw|1m|1h)$"),
+        max_points: int = Query(default=1000, ge=1, le=10000),
+) -> MetricsHistoryResponse:
+        if not POSTGRES_DSN:
+                raise HTTPException(status_code=503, detail="PostgreSQL persistence is disabled")
+
+        end_epoch = end if end is not None else int(datetime.now(timezone.utc).timestamp())
+        if end_epoch <= start:
+                raise HTTPException(status_code=422, detail="end must be after start")
+        if resolution == "auto":
+                resolution = choose_history_resolution(end_epoch - start, max_points)
+
+        # Rollup buckets are selected by their start, so include the one `start` falls into.
+        start_epoch = start
+        for suffix, width_seconds in _ROLLUPS:
+                if suffix == resolution:
+                        start_epoch = start - start % width_seconds
+
+        params: List[Any] = [
+                datetime.fromtimestamp(start_epoch, tz=timezone.utc),
+                datetime.fromtimestamp(end_epoch, tz=timezone.utc),
+        ]
+        if agent:
+                params.append(list(agent))
+        # One row beyond the cap tells whether the result was cut short.
+        params.append(HISTORY_MAX_ROWS + 1)
+
+        try:
+                psycopg, _ = _load_psycopg_modules()
+                with psycopg.connect(POSTGRES_DSN, autocommit=True) as connection:
+                        _ensure_postgres_schema(connection)
+                        with connection.cursor() as cursor:
+                                cursor.execute(_history_query(resolution, bool(agent)), params)
+                                rows = cursor.fetchall()
+        except HTTPException:
+                raise
+        except Exception as ex:
+                raise HTTPException(status_code=503, detail=f"PostgreSQL unavailable: {str(ex)}") from ex
+
+        truncated = len(rows) > HISTORY_MAX_ROWS
+        points = [
+                HistoryPoint(
+                        agent=row[0],
+                        timestamp=int(row[1]),
+                        samples=int(row[2]),
+                        cpu_mean=float(row[3]),
+                        cpu_min=float(row[4]),
+                        cpu_max=float(row[5]),
+                        memory_used_mean_mb=float(row[6]),
+                        memory_used_max_mb=float(row[7]),
+                        memory_total_mb=float(row[8]),
+                )
+                for row in rows[:HISTORY_MAX_ROWS]
+        ]
+        return MetricsHistoryResponse(resolution=resolution, points=points, truncated=truncated)
+
+
+class _MetricsSubscriber:
+        """One /ws/metrics client: its agent filter and the updates it has not been sent yet."""
+
+        __slots__ = ("agents", "pending", "ready")
+
+        def __init__(self, agents: FrozenSet[str] | None) -> None:
+                self.agents = agents
+                # Latest message per agent; a slow client skips intermediate snapshots.
+                self.pending: Dict[str | None, str] = {}
+                self.ready = asyncio.Event()
+
+        def wants(self, agent: str | None) -> bool:
+                return self.agents is None or agent in self.agents
+
+        def offer(self, agent: str | None, message: str) -> bool:
+                """Queue `message`; True if it replaced an unsent one of the same agent."""
+                replaced = self.pending.pop(agent, None) is not None
+                self.pending[agent] = message
+                self.ready.set()
+                return replaced
+
+
+class MetricsFanout:
+        """Shares one Redis subscription to METRICS_CHANNEL among the /ws/metrics clients of a process.
+
+        Each published snapshot is parsed once to find its agent and then handed, as the same
+        string, to every subscriber whose filter matches. Subscribers keep only the latest
+        unsent snapshot per agent, so a slow socket costs a bounded amount of memory and gets
+        current data once it catches up. The subscription starts with the first client and
+        ends with the last.
+        """
+
+        def __init__(self) -> None:
+                self._subscribers: Set[_MetricsSubscriber] = set()
+                self._task: asyncio.Task | None = None
+                self.coalesced = 0
+
+        def subscribe(self, agents: FrozenSet[str] | None) -> _MetricsSubscriber:
+                subscriber = _MetricsSubscriber(agents)
+                self._subscribers.add(subscriber)
+                if self._task is None or self._task.done():
+                        self._task = asyncio.create_task(self._run())
+                return subscriber
+
+        def unsubscribe(self, subscriber: _MetricsSubscriber) -> None:
+                self._subscribers.discard(subscriber)
+                if not self._subscribers and self._task is not None:
+                        self._task.cancel()
+                        self._task = None
+
+        def dispatch(self, message: str) -> None:
+                try:
+                        agent = json.loads(message).get("agent")
+                except (ValueError, AttributeError):
+                        return
+                for subscriber in self._subscribers:
+                        if subscriber.wants(agent) and subscriber.offer(agent, message):
+                                self.coalesced += 1
+
+        async def _run(self) -> None:
+                while True:
+                        client = get_async_redis()
+                        pubsub = client.pubsub()
+                        try:
+                                await pubsub.subscribe(METRICS_CHANNEL)
+                                async for message in pubsub.listen():
+                                        if message.get("type") != "message" or message.get("data") is None:
+                                                continue
+                                        self.dispatch(str(message["data"]))
+                        except RedisError as ex:
+                                logger.warning("Live metrics subscription failed: %s", str(ex))
+                        finally:
+                                try:
+                                        await pubsub.unsubscribe(METRICS_CHANNEL)
+                                        await pubsub.close()
+                                        await client.aclose()
+                                except RedisError:
+                                        pass
+                        await asyncio.sleep(1.0)
+
+
+_metrics_fanout = MetricsFanout()
+
+
 @app.websocket("/ws/metrics")
 async def metrics_updates_ws(websocket: WebSocket) -> None:
+        """Stream snapshots as JSON text frames; `?agent=` (repeatable) limits them to some agents."""
         await websocket.accept()
-        client = get_async_redis()
-        pubsub = client.pubsub()
+        agents = websocket.query_params.getlist("agent")
+        subscriber = _metrics_fanout.subscribe(frozenset(agents) if agents else None)
+
+        async def send_updates() -> None:
+                while True:
+                        await subscriber.ready.wait()
+                        subscriber.ready.clear()
+                        pending, subscriber.pending = subscriber.pending, {}
+                        for message in pending.values():
+                                await websocket.send_text(message)
+
+        async def wait_for_close() -> None:
+                # Clients send nothing; receiving is how a close is noticed while no updates arrive.
+                while (await websocket.receive())["type"] != "websocket.disconnect":
+                        pass
 
+        tasks = {asyncio.create_task(send_updates()), asyncio.create_task(wait_for_close())}
         try:
-                await pubsub.subscribe(METRICS_CHANNEL)
-                async for message in pubsub.listen():
-                        if message.get("type") != "message":
-                                continue
-                        payload = message.get("data")
-                        if payload is None:
-                                continue
-                        await websocket.send_text(str(payload))
-        except (WebSocketDisconnect, RedisError):
-                pass
+                await asyncio.wait(tasks, return_when=asyncio.FIRST_COMPLETED)
         finally:
-                try:
-                        await pubsub.unsubscribe(METRICS_CHANNEL)
-                        await pubsub.close()
-                        await client.aclose()
-                except RedisError:
-                        pass
+                _metrics_fanout.unsubscribe(subscriber)
+                for task in tasks:
+                        task.cancel()
+                await asyncio.gather(*tasks, return_exceptions=True)
@@ -3,10 +3,13 @@
 These tests validate endpoint behavior without requiring a live Redis instance.
 """
 
+import asyncio
+import gzip
 import json
 from collections import defaultdict, deque
 from datetime import datetime, timezone
 
+import pytest
 from fastapi.testclient import TestClient
 from redis.exceptions import RedisError
 
@@ -21,6 +24,7 @@ class FakePipeline:
         self.zremrangebyscore_args = None
         self.publish_args = None
         self.expire_args = None
+        self.set_args = []
         self.executed = False
 
     def zadd(self, key, mapping):
@@ -39,6 +43,10 @@ class FakePipeline:
         self.publish_args = (channel, message)
         return self
 
+    def set(self, key, value, ex=None):
+        self.set_args.append((key, value, ex))
+        return self
+
     def execute(self):
         self.executed = True
         return [1, 0, 1]
@@ -59,6 +67,31 @@ class FakeRedisIngest:
         return pipeline
 
 
+class FakeRedisDelta(FakeRedisIngest):
+    """Redis stub that also keeps the string keys holding delta stream state."""
+
+    def __init__(self):
+        super().__init__()
+        self.values = {}
+        self.expiries = {}
+
+    def mget(self, keys):
+        return [self.values.get(key) for key in keys]
+
+    def pipeline(self):
+        pipeline = super().pipeline()
+        execute = pipeline.execute
+
+        def execute_and_set():
+            for key, value, ex in pipeline.set_args:
+                self.values[key] = value
+                self.expiries[key] = ex
+            return execute()
+
+        pipeline.execute = execute_and_set
+        return pipeline
+
+
 class FakeRedisRecent:
     """Redis stub exposing zrangebyscore for recent metrics retrieval tests."""
 
@@ -164,6 +197,430 @@ def test_ingest_metrics_success(monkeypatch):
     assert json.loads(stored_json)["timestamp"] == payload["timestamp"]
 
 
+def test_ingest_metrics_batch_success(monkeypatch):
+    """Stores a batch with one pipeline and one PostgreSQL call, publishing each snapshot."""
+
+    fake_redis = FakeRedisIngest()
+    monkeypatch.setattr(backend_main, "get_redis", lambda: fake_redis)
+    stored_batches = []
+    monkeypatch.setattr(backend_main, "store_metrics_in_postgres", stored_batches.append)
+
+    now = int(datetime.now(timezone.utc).timestamp())
+    payloads = [sample_payload(now - 2), sample_payload(now), sample_payload(now - 4)]
+    client = TestClient(backend_main.app)
+    response = client.post("/ingest/metrics/batch", json=payloads)
+
+    assert response.status_code == 200
+    assert response.json() == {"status": "accepted", "accepted": 3, "latest_timestamp": now}
+
+    assert len(fake_redis.pipeline_instances) == 1
+    pipeline = fake_redis.pipeline_instances[0]
+    assert pipeline.executed is True
+    assert pipeline.zadd_payload[0] == backend_main.METRICS_KEY
+    assert sorted(pipeline.zadd_payload[1].values()) == [now - 4, now - 2, now]
+    assert json.loads(pipeline.publish_args[1])["timestamp"] == now
+
+    assert len(stored_batches) == 1
+    assert [payload.timestamp for payload in stored_batches[0]] == [now - 4, now - 2, now]
+
+
+def test_ingest_metrics_batch_rejects_empty_batch(monkeypatch):
+    """Returns 422 for an empty batch."""
+
+    monkeypatch.setattr(backend_main, "get_redis", lambda: FakeRedisIngest())
+
+    client = TestClient(backend_main.app)
+    response = client.post("/ingest/metrics/batch", json=[])
+
+    assert response.status_code == 422
+
+
+def _uvarint(value):
+    out = bytearray()
+    while value >= 0x80:
+        out.append((value & 0x7F) | 0x80)
+        value >>= 7
+    out.append(value)
+    return bytes(out)
+
+
+def _svarint(value):
+    return _uvarint((value << 1) ^ (value >> 63))
+
+
+def encode_binary_snapshots(payloads, version=1):
+    """Encode payloads the way the agent's BinaryMetricsEncoder does."""
+
+    out = bytearray(b"MTB" + bytes([version]))
+    names = {}
+
+    def name_reference(name):
+        if name in names:
+            return _uvarint(names[name])
+        names[name] = len(names)
+        encoded = name.encode("utf-8")
+        return _uvarint(names[name]) + _uvarint(len(encoded)) + encoded
+
+    def window_stats(stats):
+        return b"".join(_svarint(round(stats[key] * 100)) for key in ("min", "max", "mean", "p95"))
+
+    previous_timestamp = 0
+    for payload in payloads:
+        timestamp_ms = payload.get("timestamp_ms", payload["timestamp"] * 1000)
+        out += _svarint(timestamp_ms - previous_timestamp)
+        previous_timestamp = timestamp_ms
+        out += _svarint(round(payload["total_cpu_percent"] * 100))
+        out += _uvarint(0)
+        out += _svarint(0) + _svarint(0)
+        out += _uvarint(len(payload["top_processes"]))
+        for process in payload["top_processes"]:
+            out += _svarint(process["pid"])
+            out += name_reference(process["name"])
+            out += _svarint(round(process["cpu_percent"] * 100))
+            out += _svarint(round(process["memory_mb"] * 100))
+            out += _svarint(0) + _svarint(0) + _svarint(0) + _svarint(0)
+        cgroups = payload.get("top_cgroups", [])
+        out += _uvarint(len(cgroups))
+        for cgroup in cgroups:
+            out += name_reference(cgroup["path"])
+            for key in ("cpu_percent", "memory_mb", "io_read_mb", "io_write_mb"):
+                out += _svarint(round(cgroup[key] * 100))
+        window = payload.get("window")
+        if window is None:
+            out += _uvarint(0)
+            continue
+        out += _uvarint(window["samples"])
+        out += _uvarint(timestamp_ms - window["start_timestamp_ms"])
+        out += window_stats(window["total_cpu_percent"])
+        out += _uvarint(len(window["per_core_cpu_percent"]))
+        for core in window["per_core_cpu_percent"]:
+            out += window_stats(core)
+        out += window_stats(window["system_memory_used_mb"])
+        out += _uvarint(len(window["top_processes"]))
+        for process in window["top_processes"]:
+            out += _uvarint(process["samples"])
+            out += window_stats(process["cpu_percent"]) + window_stats(process["memory_mb"])
+    return bytes(out)
+
+
+def test_ingest_metrics_accepts_binary_body(monkeypatch):
+    """Decodes a single-snapshot binary body on the regular ingest endpoint."""
+
+    fake_redis = FakeRedisIngest()
+    monkeypatch.setattr(backend_main, "get_redis", lambda: fake_redis)
+
+    payload = sample_payload()
+    client = TestClient(backend_main.app)
+    response = client.post(
+        "/ingest/metrics",
+        content=encode_binary_snapshots([payload]),
+        headers={"Content-Type": backend_main.BINARY_METRICS_CONTENT_TYPE},
+    )
+
+    assert response.status_code == 200
+    assert response.json() == {"status": "accepted", "timestamp": payload["timestamp"]}
+
+    stored = json.loads(next(iter(fake_redis.pipeline_instances[0].zadd_payload[1].keys())))
+    assert stored["total_cpu_percent"] == 42.5
+    assert stored["top_processes"][0]["name"] == "python.exe"
+    assert stored["top_processes"][0]["memory_mb"] == 256.4
+
+
+def test_ingest_metrics_batch_accepts_gzipped_binary_body(monkeypatch):
+    """Decodes gzip-compressed binary batches with shared process names."""
+
+    fake_redis = FakeRedisIngest()
+    monkeypatch.setattr(backend_main, "get_redis", lambda: fake_redis)
+
+    now = int(datetime.now(timezone.utc).timestamp())
+    client = TestClient(backend_main.app)
+    response = client.post(
+        "/ingest/metrics/batch",
+        content=gzip.compress(encode_binary_snapshots([sample_payload(now - 2), sample_payload(now)])),
+        headers={
+            "Content-Type": backend_main.BINARY_METRICS_CONTENT_TYPE,
+            "Content-Encoding": "gzip",
+        },
+    )
+
+    assert response.status_code == 200
+    assert response.json() == {"status": "accepted", "accepted": 2, "latest_timestamp": now}
+
+
+def test_ingest_metrics_batch_keeps_millisecond_timestamps(monkeypatch):
+    """Binary bodies carry millisecond timestamps into the Redis scores."""
+
+    fake_redis = FakeRedisIngest()
+    monkeypatch.setattr(backend_main, "get_redis", lambda: fake_redis)
+
+    now = int(datetime.now(timezone.utc).timestamp())
+    first = dict(sample_payload(now), timestamp_ms=now * 1000 + 250)
+    second = dict(sample_payload(now), timestamp_ms=now * 1000 + 500)
+    client = TestClient(backend_main.app)
+    response = client.post(
+        "/ingest/metrics/batch",
+        content=encode_binary_snapshots([second, first]),
+        headers={"Content-Type": backend_main.BINARY_METRICS_CONTENT_TYPE},
+    )
+
+    assert response.status_code == 200
+    scores = list(fake_redis.pipeline_instances[0].zadd_payload[1].values())
+    assert scores == [now + 0.25, now + 0.5]
+    stored = [json.loads(item) for item in fake_redis.pipeline_instances[0].zadd_payload[1]]
+    assert [item["timestamp_ms"] for item in stored] == [now * 1000 + 250, now * 1000 + 500]
+    assert all(item["timestamp"] == now for item in stored)
+
+
+def test_ingest_metrics_batch_accepts_cgroups(monkeypatch):
+    """Binary bodies and JSON bodies carry top_cgroups into storage."""
+
+    fake_redis = FakeRedisIngest()
+    monkeypatch.setattr(backend_main, "get_redis", lambda: fake_redis)
+
+    now = int(datetime.now(timezone.utc).timestamp())
+    cgroup = {
+        "path": "kubepods.slice/pod-a/ctr-1",
+        "cpu_percent": 150.5,
+        "memory_mb": 256.25,
+        "io_read_mb": 10.5,
+        "io_write_mb": 2.0,
+    }
+    with_cgroups = dict(sample_payload(now), timestamp_ms=now * 1000, top_cgroups=[cgroup])
+    without_cgroups = dict(sample_payload(now), timestamp_ms=now * 1000 + 500)
+    client = TestClient(backend_main.app)
+    response = client.post(
+        "/ingest/metrics/batch",
+        content=encode_binary_snapshots([with_cgroups, without_cgroups]),
+        headers={"Content-Type": backend_main.BINARY_METRICS_CONTENT_TYPE},
+    )
+
+    assert response.status_code == 200
+    stored = [json.loads(item) for item in fake_redis.pipeline_instances[0].zadd_payload[1]]
+    assert stored[0]["top_cgroups"] == [cgroup]
+    assert stored[1]["top_cgroups"] == []
+    assert stored[0]["top_processes"][0]["name"] == "python.exe"
+
+    response = client.post("/ingest/metrics", json=dict(sample_payload(now), top_cgroups=[cgroup]))
+    assert response.status_code == 200
+    stored = json.loads(next(iter(fake_redis.pipeline_instances[1].zadd_payload[1].keys())))
+    assert stored["top_cgroups"] == [cgroup]
+
+
+def test_ingest_metrics_batch_accepts_window_summaries(monkeypatch):
+    """Binary bodies carry the window statistics of downsampled snapshots."""
+
+    fake_redis = FakeRedisIngest()
+    monkeypatch.setattr(backend_main, "get_redis", lambda: fake_redis)
+
+    now = int(datetime.now(timezone.utc).timestamp())
+    window = {
+        "samples": 4,
+        "start_timestamp_ms": now * 1000 - 3000,
+        "total_cpu_percent": {"min": 10.0, "max": 90.0, "mean": 40.0, "p95": 90.0},
+        "per_core_cpu_percent": [{"min": 5.0, "max": 45.0, "mean": 20.0, "p95": 45.0}],
+        "system_memory_used_mb": {"min": 100.0, "max": 103.0, "mean": 101.5, "p95": 103.0},
+        "top_processes": [
+            {
+                "pid": 123,
+                "samples": 3,
+                "cpu_percent": {"min": 2.5, "max": 30.0, "mean": 10.2, "p95": 30.0},
+                "memory_mb": {"min": 250.0, "max": 260.0, "mean": 256.4, "p95": 260.0},
+            }
+        ],
+    }
+    summary = dict(sample_payload(now), timestamp_ms=now * 1000, window=window)
+    raw = dict(sample_payload(now), timestamp_ms=now * 1000 + 500)
+    client = TestClient(backend_main.app)
+    response = client.post(
+        "/ingest/metrics/batch",
+        content=encode_binary_snapshots([summary, raw]),
+        headers={"Content-Type": backend_main.BINARY_METRICS_CONTENT_TYPE},
+    )
+
+    assert response.status_code == 200
+    stored = [json.loads(item) for item in fake_redis.pipeline_instances[0].zadd_payload[1]]
+    assert stored[0]["window"] == window
+    assert stored[1]["window"] is None
+    assert stored[0]["total_cpu_percent"] == 42.5
+
+    mismatched = dict(window, top_processes=window["top_processes"] * 2)
+    response = client.post(
+        "/ingest/metrics",
+        content=encode_binary_snapshots([dict(summary, window=mismatched)]),
+        headers={"Content-Type": backend_main.BINARY_METRICS_CONTENT_TYPE},
+    )
+    assert response.status_code == 422
+
+
+def test_ingest_metrics_delta_rebuilds_snapshots_from_keyframes(monkeypatch):
+    """Deltas are applied to the stream's previous snapshot, within a request and across requests."""
+
+    fake_redis = FakeRedisDelta()
+    monkeypatch.setattr(backend_main, "get_redis", lambda: fake_redis)
+
+    now = int(datetime.now(timezone.utc).timestamp())
+    keyframe = dict(
+        sample_payload(now),
+        timestamp_ms=now * 1000,
+        per_core_cpu_percent=[10.0, 20.0],
+        system_memory_total_mb=16000.0,
+        system_memory_used_mb=8000.0,
+    )
+    keyframe["top_processes"].append({"pid": 7, "name": "db", "cpu_percent": 1.0, "memory_mb": 50.0})
+    delta = {
+        "timestamp": now,
+        "timestamp_ms": now * 1000 + 500,
+        "total_cpu_percent": 55.0,
+        "per_core_cpu_percent": {"1": 90.0},
+        "top_processes": [{"pid": 7, "cpu_percent": 30.0}],
+        "process_order": [7, 123],
+    }
+    client = TestClient(backend_main.app)
+    response = client.post(
+        "/ingest/metrics/delta",
+        json=[
+            {"stream": "s1", "sequence": 1, "keyframe": keyframe},
+            {"stream": "s1", "sequence": 2, "delta": delta},
+        ],
+    )
+
+    assert response.status_code == 200
+    assert response.json() == {"status": "accepted", "accepted": 2, "latest_timestamp": now}
+    stored = [json.loads(item) for item in fake_redis.pipeline_instances[0].zadd_payload[1]]
+    assert stored[1]["total_cpu_percent"] == 55.0
+    assert stored[1]["per_core_cpu_percent"] == [10.0, 90.0]
+    assert stored[1]["system_memory_used_mb"] == 8000.0
+    assert [process["pid"] for process in stored[1]["top_processes"]] == [7, 123]
+    assert stored[1]["top_processes"][0]["memory_mb"] == 50.0
+    assert fake_redis.expiries["metrics:delta:s1"] == backend_main.DELTA_STATE_TTL_SECONDS
+
+    response = client.post(
+        "/ingest/metrics/delta",
+        json=[
+            {
+                "stream": "s1",
+                "sequence": 3,
+                "delta": {"timestamp": now + 1, "removed_pids": [123], "top_processes": [{"pid": 9, "name": "job", "cpu_percent": 2.0, "memory_mb": 1.0}]},
+            }
+        ],
+    )
+    assert response.status_code == 200
+    stored = json.loads(next(iter(fake_redis.pipeline_instances[1].zadd_payload[1].keys())))
+    assert stored["total_cpu_percent"] == 55.0
+    assert [process["name"] for process in stored["top_processes"]] == ["db", "job"]
+
+
+def test_ingest_metrics_delta_requires_a_known_base(monkeypatch):
+    """Returns 409 for a delta whose previous snapshot the backend does not hold."""
+
+    fake_redis = FakeRedisDelta()
+    monkeypatch.setattr(backend_main, "get_redis", lambda: fake_redis)
+
+    now = int(datetime.now(timezone.utc).timestamp())
+    client = TestClient(backend_main.app)
+    response = client.post("/ingest/metrics/delta", json=[{"stream": "s2", "sequence": 5, "delta": {"timestamp": now}}])
+    assert response.status_code == 409
+    assert fake_redis.pipeline_instances == []
+
+    response = client.post("/ingest/metrics/delta", json=[{"stream": "s2", "sequence": 5, "keyframe": sample_payload(now)}])
+    assert response.status_code == 200
+
+    # Sequence 6 was lost, so 7 does not apply.
+    response = client.post("/ingest/metrics/delta", json=[{"stream": "s2", "sequence": 7, "delta": {"timestamp": now}}])
+    assert response.status_code == 409
+
+    response = client.post(
+        "/ingest/metrics/delta",
+        json=[{"stream": "s2", "sequence": 6, "delta": {"timestamp": now, "top_processes": [{"pid": 1, "cpu_percent": 1.0}]}}],
+    )
+    assert response.status_code == 422
+
+    response = client.post("/ingest/metrics/delta", json=[{"stream": "s2", "sequence": 6}])
+    assert response.status_code == 422
+
+
+def test_apply_metrics_delta_does_not_carry_windows_over():
+    """A window belongs to one summary; reused PIDs are replaced and cgroups keyed by path."""
+
+    base = {
+        "timestamp": 1,
+        "total_cpu_percent": 5.0,
+        "per_core_cpu_percent": [1.0],
+        "top_processes": [{"pid": 4, "name": "old", "cpu_percent": 3.0, "memory_mb": 9.0}],
+        "top_cgroups": [{"path": "a", "cpu_percent": 1.0}, {"path": "b", "cpu_percent": 2.0}],
+        "window": {"samples": 2},
+    }
+    snapshot = backend_main.apply_metrics_delta(
+        base,
+        {
+            "timestamp": 2,
+            "top_processes": [{"pid": 4, "name": "new", "cpu_percent": 1.0, "memory_mb": 2.0}],
+            "top_cgroups": [{"path": "a", "cpu_percent": 7.0}],
+            "removed_cgroups": ["b"],
+        },
+    )
+    assert "window" not in snapshot
+    assert snapshot["top_processes"] == [{"pid": 4, "name": "new", "cpu_percent": 1.0, "memory_mb": 2.0}]
+    assert snapshot["top_cgroups"] == [{"path": "a", "cpu_percent": 7.0}]
+    assert base["top_cgroups"][0]["cpu_percent"] == 1.0
+
+
+def test_apply_metrics_delta_keeps_the_agent_order():
+    """Lists keep the base order with new entries appended unless the delta sends the agent's ranking."""
+
+    base = {
+        "timestamp": 1,
+        "total_cpu_percent": 5.0,
+        "top_processes": [
+            {"pid": 1, "name": "a", "cpu_percent": 5.0, "memory_mb": 1.0},
+            {"pid": 2, "name": "b", "cpu_percent": 5.0, "memory_mb": 9.0},
+        ],
+        "top_cgroups": [{"path": "x", "cpu_percent": 1.0}, {"path": "y", "cpu_percent": 2.0}],
+    }
+
+    # Deadbanded values are not re-ranked: 2 stays behind 1 despite more CPU.
+    snapshot = backend_main.apply_metrics_delta(
+        base,
+        {"timestamp": 2, "top_processes": [{"pid": 2, "cpu_percent": 6.0}, {"pid": 3, "name": "c", "cpu_percent": 0.5, "memory_mb": 1.0}]},
+    )
+    assert [process["pid"] for process in snapshot["top_processes"]] == [1, 2, 3]
+    assert [cgroup["path"] for cgroup in snapshot["top_cgroups"]] == ["x", "y"]
+
+    snapshot = backend_main.apply_metrics_delta(
+        snapshot, {"timestamp": 3, "process_order": [3, 2, 1], "cgroup_order": ["y", "x"]}
+    )
+    assert [process["pid"] for process in snapshot["top_processes"]] == [3, 2, 1]
+    assert [cgroup["path"] for cgroup in snapshot["top_cgroups"]] == ["y", "x"]
+
+    with pytest.raises(ValueError):
+        backend_main.apply_metrics_delta(snapshot, {"timestamp": 4, "process_order": [3, 2]})
+    with pytest.raises(ValueError):
+        backend_main.apply_metrics_delta(snapshot, {"timestamp": 4, "removed_pids": [1], "process_order": [3, 2, 1]})
+
+
+def test_ingest_metrics_rejects_malformed_binary_body(monkeypatch):
+    """Returns 422 for truncated binary bodies and unknown format versions."""
+
+    monkeypatch.setattr(backend_main, "get_redis", lambda: FakeRedisIngest())
+
+    client = TestClient(backend_main.app)
+    response = client.post(
+        "/ingest/metrics",
+        content=encode_binary_snapshots([sample_payload()])[:-3],
+        headers={"Content-Type": backend_main.BINARY_METRICS_CONTENT_TYPE},
+    )
+
+    assert response.status_code == 422
+
+    response = client.post(
+        "/ingest/metrics",
+        content=encode_binary_snapshots([sample_payload()], version=2),
+        headers={"Content-Type": backend_main.BINARY_METRICS_CONTENT_TYPE},
+    )
+
+    assert response.status_code == 422
+
+
 def test_ingest_metrics_redis_error(monkeypatch):
     """Returns 503 when ingest path cannot reach Redis."""
 
@@ -309,6 +766,17 @@ def test_ingest_metrics_rejects_negative_process_memory():
     assert response.status_code == 422
 
 
+def test_ingest_metrics_rejects_non_finite_values():
+    """Returns 422 for Infinity or NaN, which would otherwise reach PostgreSQL's JSON columns."""
+
+    payload = json.dumps(sample_payload())
+    client = TestClient(backend_main.app)
+    for value in ("Infinity", "NaN"):
+        body = payload.replace('"memory_mb": 256.4', f'"memory_mb": {value}')
+        response = client.post("/ingest/metrics", content=body, headers={"Content-Type": "application/json"})
+        assert response.status_code == 422
+
+
 def test_ingest_requires_agent_token_when_configured(monkeypatch):
     """Returns 401 when AGENT_API_TOKEN is configured and header is missing/invalid."""
 
@@ -344,6 +812,7 @@ def test_ingest_applies_rate_limit(monkeypatch):
 
     assert first.status_code == 200
     assert second.status_code == 429
+    assert 1 <= int(second.headers["Retry-After"]) <= 60
 
 
 def test_ingest_triggers_alert_notification(monkeypatch):
@@ -356,8 +825,7 @@ def test_ingest_triggers_alert_notification(monkeypatch):
     monkeypatch.setattr(backend_main, "_agent_rate_windows", defaultdict(deque))
     monkeypatch.setattr(backend_main, "ALERT_CPU_THRESHOLD", 10.0)
     monkeypatch.setattr(backend_main, "ALERT_CPU_DURATION_SECONDS", 0)
-    monkeypatch.setattr(backend_main, "_high_cpu_window_start_ts", None)
-    monkeypatch.setattr(backend_main, "_high_cpu_alert_active", False)
+    monkeypatch.setattr(backend_main, "_agent_alert_states", {})
 
     published = []
     monkeypatch.setattr(backend_main, "publish_alert", lambda alert: published.append(alert))
@@ -390,3 +858,421 @@ def test_get_recent_alerts(monkeypatch):
     assert response.status_code == 200
     assert len(response.json()) == 1
     assert response.json()[0]["rule"] == "cpu_threshold_duration"
+
+
+def test_cpu_alert_windows_are_kept_per_agent(monkeypatch):
+    """One agent's normal CPU does not reset another agent's high-CPU window."""
+
+    monkeypatch.setattr(backend_main, "ALERT_CPU_THRESHOLD", 50.0)
+    monkeypatch.setattr(backend_main, "ALERT_CPU_DURATION_SECONDS", 10)
+    monkeypatch.setattr(backend_main, "_agent_alert_states", {})
+
+    def payload(ts, cpu):
+        return backend_main.MetricsPayload.model_validate(dict(sample_payload(ts), total_cpu_percent=cpu))
+
+    now = int(datetime.now(timezone.utc).timestamp())
+    assert backend_main.evaluate_cpu_alert_rule(payload(now, 90.0), "10.0.0.1") is None
+    assert backend_main.evaluate_cpu_alert_rule(payload(now + 5, 5.0), "10.0.0.2") is None
+    alert = backend_main.evaluate_cpu_alert_rule(payload(now + 10, 95.0), "10.0.0.1")
+    assert alert is not None
+    assert alert.current_value == 95.0
+    assert backend_main.evaluate_cpu_alert_rule(payload(now + 11, 95.0), "10.0.0.1") is None
+    assert backend_main.evaluate_cpu_alert_rule(payload(now + 11, 95.0), "10.0.0.2") is None
+
+
+class FakePostgresConnection:
+    """psycopg connection stub recording executemany batches and committed transactions."""
+
+    def __init__(self, fail_times=0):
+        self.fail_times = fail_times
+        self.batches = []
+        self.closed = False
+
+    def cursor(self):
+        connection = self
+
+        class Cursor:
+            def __enter__(self):
+                return self
+
+            def __exit__(self, *exc):
+                return False
+
+            def execute(self, query, params=None):
+                return None
+
+            def executemany(self, query, rows):
+                if connection.fail_times > 0:
+                    connection.fail_times -= 1
+                    raise RuntimeError("connection reset")
+                assert "INSERT INTO" in query
+                connection.batches.append(list(rows))
+
+        return Cursor()
+
+    def transaction(self):
+        class Transaction:
+            def __enter__(self):
+                return self
+
+            def __exit__(self, *exc):
+                return False
+
+        return Transaction()
+
+    def close(self):
+        self.closed = True
+
+
+def test_postgres_write_behind_batches_rows_and_retries_failed_flushes(monkeypatch):
+    """Requests only buffer rows; the background thread inserts them in batches and retries failures."""
+
+    connections = []
+
+    class FakePsycopg:
+        @staticmethod
+        def connect(dsn, autocommit=False):
+            connection = FakePostgresConnection(fail_times=1 if not connections else 0)
+            connections.append(connection)
+            return connection
+
+    monkeypatch.setattr(backend_main, "POSTGRES_DSN", "postgresql://metrics")
+    monkeypatch.setattr(backend_main, "POSTGRES_RETENTION_DAYS", 0)
+    monkeypatch.setattr(backend_main, "POSTGRES_ROLLUP_1M_RETENTION_DAYS", 0)
+    monkeypatch.setattr(backend_main, "POSTGRES_ROLLUP_1H_RETENTION_DAYS", 0)
+    monkeypatch.setattr(backend_main, "_postgres_schema_ready", True)
+    monkeypatch.setattr(backend_main, "_load_psycopg_modules", lambda: (FakePsycopg, lambda value: value))
+
+    def insert_raw_rows(connection, rows):
+        with connection.cursor() as cursor:
+            cursor.executemany("INSERT INTO metrics_snapshots", rows)
+
+    monkeypatch.setattr(backend_main, "_insert_postgres_rows", insert_raw_rows)
+
+    writer = backend_main.PostgresWriteBehind(flush_interval_ms=10, flush_max_rows=2, buffer_max_rows=4)
+    writer.enqueue([("row", 1), ("row", 2), ("row", 3)])
+    assert writer.flush(timeout_seconds=5.0)
+    assert writer.pending() == 0
+
+    # The first connection failed its flush and was closed; the rows went in on the next one.
+    assert connections[0].closed is True
+    assert connections[1].batches == [[("row", 1), ("row", 2)], [("row", 3)]]
+
+    writer.enqueue([("row", 4)] * 4)
+    writer.stop(timeout_seconds=5.0)
+    assert sum(len(batch) for batch in connections[1].batches) == 7
+
+
+def test_postgres_write_behind_rejects_rows_beyond_the_buffer():
+    """A full buffer answers 503 so agents back off instead of the backend growing without bound."""
+
+    writer = backend_main.PostgresWriteBehind(flush_interval_ms=60000, flush_max_rows=10, buffer_max_rows=10)
+    with writer._condition:
+        writer._rows.extend([("row", index) for index in range(10)])
+    try:
+        writer.enqueue([("row", 10)])
+    except backend_main.HTTPException as ex:
+        assert ex.status_code == 503
+        assert ex.headers == {"Retry-After": "1"}
+    else:
+        raise AssertionError("expected 503")
+    assert writer.pending() == 10
+
+
+def test_postgres_write_behind_drops_rows_postgres_rejects(monkeypatch):
+    """A rejected row is isolated and dropped instead of being retried ahead of every other row."""
+
+    class FakePsycopgError(Exception):
+        pass
+
+    class FakePsycopg:
+        Error = FakePsycopgError
+        OperationalError = type("OperationalError", (FakePsycopgError,), {})
+        InterfaceError = type("InterfaceError", (FakePsycopgError,), {})
+        DataError = type("DataError", (FakePsycopgError,), {})
+
+        @staticmethod
+        def connect(dsn, autocommit=False):
+            connections.append(FakePostgresConnection())
+            return connections[-1]
+
+    connections = []
+    monkeypatch.setattr(backend_main, "POSTGRES_DSN", "postgresql://metrics")
+    monkeypatch.setattr(backend_main, "POSTGRES_RETENTION_DAYS", 0)
+    monkeypatch.setattr(backend_main, "POSTGRES_ROLLUP_1M_RETENTION_DAYS", 0)
+    monkeypatch.setattr(backend_main, "POSTGRES_ROLLUP_1H_RETENTION_DAYS", 0)
+    monkeypatch.setattr(backend_main, "_postgres_schema_ready", True)
+    monkeypatch.setattr(backend_main, "_load_psycopg_modules", lambda: (FakePsycopg, lambda value: value))
+
+    def insert_raw_rows(connection, rows):
+        if ("row", "bad") in rows:
+            raise FakePsycopg.DataError("numeric field overflow")
+        with connection.cursor() as cursor:
+            cursor.executemany("INSERT INTO metrics_snapshots", rows)
+
+    monkeypatch.setattr(backend_main, "_insert_postgres_rows", insert_raw_rows)
+
+    writer = backend_main.PostgresWriteBehind(flush_interval_ms=10, flush_max_rows=4, buffer_max_rows=8)
+    writer.enqueue([("row", 1), ("row", "bad"), ("row", 2), ("row", 3), ("row", 4)])
+    assert writer.flush(timeout_seconds=5.0)
+    writer.stop(timeout_seconds=5.0)
+
+    # Data errors keep the connection; every row but the rejected one is committed, once.
+    assert len(connections) == 1
+    assert sorted(row for batch in connections[0].batches for row in batch) == [("row", index) for index in range(1, 5)]
+
+
+def test_ingest_checks_the_write_buffer_before_touching_redis(monkeypatch):
+    """A full buffer answers 503 before anything is published or a delta stream moves on."""
+
+    writer = backend_main.PostgresWriteBehind(flush_interval_ms=60000, flush_max_rows=10, buffer_max_rows=10)
+    with writer._condition:
+        writer._rows.extend([("row", index) for index in range(10)])
+    fake_redis = FakeRedisDelta()
+    monkeypatch.setattr(backend_main, "get_redis", lambda: fake_redis)
+    monkeypatch.setattr(backend_main, "POSTGRES_DSN", "postgresql://metrics")
+    monkeypatch.setattr(backend_main, "POSTGRES_FLUSH_INTERVAL_MS", 1000)
+    monkeypatch.setattr(backend_main, "_postgres_writer", writer)
+    monkeypatch.setattr(backend_main, "_load_psycopg_modules", lambda: (None, lambda value: value))
+
+    now = int(datetime.now(timezone.utc).timestamp())
+    client = TestClient(backend_main.app)
+    assert client.post("/ingest/metrics", json=sample_payload(now)).status_code == 503
+    assert client.post("/ingest/metrics/batch", json=[sample_payload(now)]).status_code == 503
+    response = client.post("/ingest/metrics/delta", json=[{"stream": "s3", "sequence": 1, "keyframe": sample_payload(now)}])
+    assert response.status_code == 503
+    assert fake_redis.pipeline_instances == []
+    assert fake_redis.values == {}
+
+    # Room held for a request that then fails in Redis is given back.
+    with writer._condition:
+        writer._rows.clear()
+
+    def _raise():
+        raise RedisError("connection failed")
+
+    monkeypatch.setattr(backend_main, "get_redis", _raise)
+    assert client.post("/ingest/metrics/batch", json=[sample_payload(now)] * 3).status_code == 503
+    assert writer.pending() == 0
+    assert writer._reserved == 0
+
+
+class RecordingPostgresConnection(FakePostgresConnection):
+    """Connection stub keeping every statement, and answering queries with `result`."""
+
+    def __init__(self, result=None):
+        super().__init__()
+        self.statements = []
+        self.result = result or []
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        return False
+
+    def cursor(self):
+        connection = self
+
+        class Cursor:
+            def __enter__(self):
+                return self
+
+            def __exit__(self, *exc):
+                return False
+
+            def execute(self, query, params=None):
+                connection.statements.append((" ".join(query.split()), params))
+
+            def executemany(self, query, rows):
+                connection.statements.append((" ".join(query.split()), list(rows)))
+
+            def fetchall(self):
+                return connection.result
+
+        return Cursor()
+
+
+def test_postgres_rows_are_folded_into_rollup_buckets(monkeypatch):
+    """Rollups add up the samples per agent and bucket; a window summary counts as all of its samples."""
+
+    monkeypatch.setattr(backend_main, "_postgres_schema_ready", True)
+    monkeypatch.setattr(backend_main, "_postgres_raw_partitioned", True)
+    monkeypatch.setattr(backend_main, "_postgres_partitions", set())
+
+    start = 1707662400
+    window = {
+        "samples": 4,
+        "start_timestamp_ms": start * 1000,
+        "total_cpu_percent": {"min": 10.0, "max": 90.0, "mean": 40.0, "p95": 90.0},
+        "system_memory_used_mb": {"min": 100.0, "max": 103.0, "mean": 101.5, "p95": 103.0},
+    }
+    payloads = [
+        backend_main.MetricsPayload.model_validate(
+            dict(sample_payload(start + 3), window=window, system_memory_total_mb=512.0, agent="a")
+        ),
+        backend_main.MetricsPayload.model_validate(
+            dict(sample_payload(start + 30), system_memory_used_mb=200.0, system_memory_total_mb=512.0, agent="a")
+        ),
+        backend_main.MetricsPayload.model_validate(dict(sample_payload(start + 61), agent="a")),
+        backend_main.MetricsPayload.model_validate(dict(sample_payload(start + 62), agent="b")),
+    ]
+    rows = backend_main._postgres_rows(payloads, lambda value: value)
+
+    minute = datetime.fromtimestamp(start, tz=timezone.utc)
+    one_minute = backend_main._rollup_rows(rows, 60)
+    assert one_minute[0] == ("a", minute, 5, 40.0 * 4 + 42.5, 10.0, 90.0, 101.5 * 4 + 200.0, 200.0, 512.0)
+    assert [(row[0], row[2]) for row in one_minute[1:]] == [("a", 1), ("b", 1)]
+    assert [(row[0], row[2]) for row in backend_main._rollup_rows(rows, 3600)] == [("a", 6), ("b", 1)]
+
+    connection = RecordingPostgresConnection()
+    backend_main._insert_postgres_rows(connection, rows)
+    backend_main._insert_postgres_rows(connection, rows)
+    partitions = [query for query, _ in connection.statements if "PARTITION OF" in query]
+    assert len(partitions) == 2
+    assert partitions[0].startswith("CREATE TABLE IF NOT EXISTS metrics_snapshots_1m_p20240211 PARTITION OF")
+    upserts = [params for query, params in connection.statements if "ON CONFLICT (agent, bucket)" in query]
+    assert upserts[:2] == [one_minute, backend_main._rollup_rows(rows, 3600)]
+
+
+def test_choose_history_resolution_keeps_points_under_the_limit():
+    """Short ranges come from raw snapshots, longer ones from the finest rollup that fits."""
+
+    assert backend_main.choose_history_resolution(600, 1000) == "raw"
+    assert backend_main.choose_history_resolution(6 * 3600, 1000) == "1m"
+    assert backend_main.choose_history_resolution(7 * 86400, 1000) == "1h"
+    assert backend_main.choose_history_resolution(3650 * 86400, 1000) == "1h"
+
+
+def test_get_metrics_history_reads_rollups(monkeypatch):
+    """Half a day of history is served from the 1-minute rollup, averaged per bucket."""
+
+    connection = RecordingPostgresConnection(result=[("10.0.0.1", 1707662400, 4, 50.0, 10.0, 90.0, 100.0, 120.0, 512.0)])
+
+    class FakePsycopg:
+        @staticmethod
+        def connect(dsn, autocommit=False):
+            return connection
+
+    monkeypatch.setattr(backend_main, "POSTGRES_DSN", "postgresql://metrics")
+    monkeypatch.setattr(backend_main, "_postgres_schema_ready", True)
+    monkeypatch.setattr(backend_main, "_load_psycopg_modules", lambda: (FakePsycopg, lambda value: value))
+
+    client = TestClient(backend_main.app)
+    response = client.get(
+        "/api/metrics/history",
+        params={"start": 1707662430, "end": 1707662430 + 43200, "agent": "10.0.0.1"},
+    )
+    assert response.status_code == 200
+    body = response.json()
+    assert body["resolution"] == "1m"
+    assert body["truncated"] is False
+    assert body["points"][0]["cpu_mean"] == 50.0
+    assert body["points"][0]["samples"] == 4
+
+    query, params = connection.statements[-1]
+    assert "FROM metrics_snapshots_1m" in query
+    assert params[0] == datetime.fromtimestamp(1707662400, tz=timezone.utc)
+    assert params[2] == ["10.0.0.1"]
+
+    monkeypatch.setattr(backend_main, "POSTGRES_DSN", "")
+    assert client.get("/api/metrics/history", params={"start": 0}).status_code == 503
+
+
+def test_metrics_fanout_filters_by_agent_and_keeps_the_latest_unsent_snapshot():
+    """Each subscriber holds at most one unsent snapshot per agent, and only of the agents it asked for."""
+
+    fanout = backend_main.MetricsFanout()
+    everything = backend_main._MetricsSubscriber(None)
+    only_a = backend_main._MetricsSubscriber(frozenset({"10.0.0.1"}))
+    fanout._subscribers.update({everything, only_a})
+
+    first = json.dumps(dict(sample_payload(100), agent="10.0.0.1"))
+    other = json.dumps(dict(sample_payload(101), agent="10.0.0.2"))
+    latest = json.dumps(dict(sample_payload(102), agent="10.0.0.1"))
+    for message in (first, other, latest, "not json"):
+        fanout.dispatch(message)
+
+    assert list(everything.pending.values()) == [other, latest]
+    assert list(only_a.pending.values()) == [latest]
+    assert fanout.coalesced == 2
+    assert only_a.ready.is_set()
+
+
+class FakeAsyncPubSub:
+    """redis.asyncio pub/sub stub that replays messages and then stays subscribed."""
+
+    def __init__(self, messages):
+        self.messages = messages
+        self.channels = []
+
+    async def subscribe(self, channel):
+        self.channels.append(channel)
+
+    async def listen(self):
+        yield {"type": "subscribe", "data": 1}
+        for message in self.messages:
+            yield {"type": "message", "data": message}
+        await asyncio.Event().wait()
+
+    async def unsubscribe(self, channel):
+        return None
+
+    async def close(self):
+        return None
+
+
+class FakeAsyncRedis:
+    def __init__(self, messages):
+        self.pubsubs = []
+        self.messages = messages
+
+    def pubsub(self):
+        pubsub = FakeAsyncPubSub(self.messages)
+        self.pubsubs.append(pubsub)
+        return pubsub
+
+    async def aclose(self):
+        return None
+
+
+def test_metrics_websocket_sends_json_of_the_requested_agent(monkeypatch):
+    """The socket gets published snapshots unchanged, filtered by ?agent=, over one shared subscription."""
+
+    messages = [
+        json.dumps(dict(sample_payload(100), agent="10.0.0.1")),
+        json.dumps(dict(sample_payload(101), agent="10.0.0.2")),
+        json.dumps(dict(sample_payload(102), agent="10.0.0.1")),
+    ]
+    fake_redis = FakeAsyncRedis(messages)
+    monkeypatch.setattr(backend_main, "get_async_redis", lambda: fake_redis)
+    monkeypatch.setattr(backend_main, "_metrics_fanout", backend_main.MetricsFanout())
+
+    client = TestClient(backend_main.app)
+    with client.websocket_connect("/ws/metrics?agent=10.0.0.1") as websocket:
+        received = json.loads(websocket.receive_text())
+
+    # Both snapshots of 10.0.0.1 arrived before the socket was written to; only the latest is sent.
+    assert received["timestamp"] == 102
+    assert received["agent"] == "10.0.0.1"
+    assert len(fake_redis.pubsubs) == 1
+    assert fake_redis.pubsubs[0].channels == [backend_main.METRICS_CHANNEL]
+
+
+def test_ingest_records_the_sending_agent(monkeypatch):
+    """Stored and published snapshots carry the agent ID; recent metrics can be filtered by it."""
+
+    fake_redis = FakeRedisIngest()
+    monkeypatch.setattr(backend_main, "get_redis", lambda: fake_redis)
+
+    client = TestClient(backend_main.app)
+    response = client.post("/ingest/metrics", json=dict(sample_payload(), agent="spoofed"))
+    assert response.status_code == 200
+    published = json.loads(fake_redis.pipeline_instances[0].publish_args[1])
+    assert published["agent"] == "testclient"
+
+    stored = [published, dict(sample_payload(), agent="10.0.0.9")]
+    monkeypatch.setattr(backend_main, "get_redis", lambda: FakeRedisRecent([json.dumps(item) for item in stored]))
+    response = client.get("/api/metrics/recent", params={"agent": "testclient"})
+    assert response.status_code == 200
+    assert [item["agent"] for item in response.json()] == ["testclient"]
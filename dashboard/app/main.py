@@ -44,10 +44,11 @@ app.mount("/static", StaticFiles(directory=STATIC_DIR), name="static")
 app.add_middleware(SessionMiddleware, secret_key=settings.session_secret)
 
 
-def _backend_ws_metrics_url() -> str:
+def _backend_ws_metrics_url(query: str = "") -> str:
+    suffix = f"/ws/metrics?{query}" if query else "/ws/metrics"
     if settings.backend_base_url.startswith("https://"):
-        return f"wss://{settings.backend_base_url[len('https://'):]}/ws/metrics"
-    return f"ws://{settings.backend_base_url[len('http://'):]}/ws/metrics"
+        return f"wss://{settings.backend_base_url[len('https://'):]}{suffix}"
+    return f"ws://{settings.backend_base_url[len('http://'):]}{suffix}"
 
 
 def _require_auth(request: Request) -> None:
@@ -140,13 +141,25 @@ def index(request: Request):
 @app.get("/api/metrics/recent")
 async def proxy_recent_metrics(request: Request) -> list[dict]:
     _require_auth(request)
-    data = await _proxy_backend_get("/api/metrics/recent")
+    agents = request.query_params.getlist("agent")
+    data = await _proxy_backend_get("/api/metrics/recent", params={"agent": agents} if agents else None)
     if not isinstance(data, list):
         raise HTTPException(status_code=502, detail="Unexpected backend response format")
 
     return data
 
 
+@app.get("/api/metrics/history")
+async def proxy_metrics_history(request: Request) -> dict:
+    _require_auth(request)
+    # start, end, resolution, max_points and repeated agent parameters go through unchanged.
+    params = {key: request.query_params.getlist(key) for key in request.query_params.keys()}
+    data = await _proxy_backend_get("/api/metrics/history", params=params)
+    if not isinstance(data, dict):
+        raise HTTPException(status_code=502, detail="Unexpected backend response format")
+    return data
+
+
 @app.get("/api/alerts/recent")
 async def proxy_recent_alerts(request: Request, minutes: int = 60) -> list[dict]:
     _require_auth(request)
@@ -208,7 +221,8 @@ async def proxy_live_metrics(websocket: WebSocket) -> None:
         return
 
     await websocket.accept()
-    target = _backend_ws_metrics_url()
+    # Agent filters (`?agent=`) are applied by the backend, so unwanted snapshots never reach the proxy.
+    target = _backend_ws_metrics_url(websocket.url.query)
 
     try:
         async with ws_connect(target) as backend_ws: